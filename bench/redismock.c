@@ -0,0 +1,2743 @@
+/******************************************************************************
+ * File: redismock.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Mock RESP server with latency and fault injection, built on
+ *              Linux with gmake mock-linux. It keeps an in-memory data set
+ *              and answers the commands the UDFs send (strings, hashes,
+ *              lists, sets, sorted sets, SCAN/KEYS, MULTI/EXEC/WATCH, the
+ *              blocking pops, the connection handshake and CLUSTER SLOTS), so the UDFs and redisperf can
+ *              run against it without a Redis server. There is no Lua:
+ *              SCRIPT LOAD, EVAL and EVALSHA accept scripts of the form
+ *              "return redis.call(...)" and "return {...}" (see
+ *              run_script), plus the scripts under lua/ (REDIS_SCAN_FILTER,
+ *              the batch pops), emulated in C.
+ *
+ *              Faults are injected on every Nth data command (handshake
+ *              commands are not counted), which makes them deterministic:
+ *              -ERR, -MOVED, -ASK and -LOADING replies, connection resets,
+ *              replies cut off half-way, stalls past the client timeout
+ *              and giant replies. Replies can also be delayed, jittered
+ *              and split into small TCP segments. Everything can be
+ *              changed at run time with the MOCK command, e.g.
+ *              redis-cli -p 6390 MOCK FAULT reset 10.
+ *
+ *              Usage: redismock [-p port] [-d usec] [-j usec]
+ *                               [-c bytes] [-C usec] [-f name:every[:arg]]... [-v]
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**********************************************************************/
+/* Settings and Faults */
+/**********************************************************************/
+
+#define MOCK_BUCKETS 65536 // Hash table size of the key space
+#define MOCK_MAX_ARGS 4096 // Arguments accepted per command
+#define MOCK_MAX_WATCH 64  // Keys watched per connection
+#define MOCK_MAX_SCRIPTS 256 // Scripts kept by SCRIPT LOAD
+
+enum
+{
+    FAULT_ERR,     // -ERR reply, command not run
+    FAULT_MOVED,   // -MOVED <slot> <this server>, command not run
+    FAULT_ASK,     // -ASK <slot> <this server>, command not run
+    FAULT_LOADING, // -LOADING reply, command not run
+    FAULT_RESET,   // Connection reset (RST), command not run
+    FAULT_PARTIAL, // Command run, half of the reply sent, then reset
+    FAULT_STALL,   // Reply held back for arg microseconds
+    FAULT_GIANT,   // Bulk reply of arg bytes instead of the real reply
+    FAULT_COUNT
+};
+
+typedef struct
+{
+    const char *name;
+    long every;       // Inject on every Nth data command (0 = off)
+    long arg;         // Fault argument (stall time, giant size)
+    long default_arg;
+} MockFault;
+
+static MockFault faults[FAULT_COUNT] = {
+    {"err", 0, 0, 0},
+    {"moved", 0, 0, 0},
+    {"ask", 0, 0, 0},
+    {"loading", 0, 0, 0},
+    {"reset", 0, 0, 0},
+    {"partial", 0, 0, 0},
+    {"stall", 0, 0, 2000000}, // Beyond the 1 s receive timeout of the UDFs
+    {"giant", 0, 0, 1048576},
+};
+
+static int port = 6390;
+static long delay_us = 0;      // Added before every reply
+static long jitter_us = 0;     // Random extra delay, 0..jitter_us
+static long chunk_bytes = 0;   // Reply segment size (0 = one write)
+static long chunk_us = 0;      // Pause between segments
+static int verbose = 0;
+static unsigned long data_commands = 0; // Commands counted for fault injection
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mock_changed = PTHREAD_COND_INITIALIZER; // Wakes blocked BLPOP/BRPOP/BLMOVE
+
+/**********************************************************************/
+/* Key Space */
+/**********************************************************************/
+
+enum
+{
+    TYPE_STRING,
+    TYPE_HASH,
+    TYPE_LIST,
+    TYPE_SET,
+    TYPE_ZSET
+};
+
+static const char *type_names[] = {"string", "hash", "list", "set", "zset"};
+
+typedef struct
+{
+    char *field; // Hash field, set member, sorted set member (NULL otherwise)
+    size_t field_len;
+    char *value; // String value, hash value, list element (NULL otherwise)
+    size_t value_len;
+    double score;
+} MockItem;
+
+typedef struct MockKey
+{
+    struct MockKey *next; // Bucket chain
+    char *name;
+    size_t len;
+    int type;
+    MockItem *items; // One item for strings
+    long count, cap;
+    long long expire_ms; // Absolute expiry time (0 = none)
+} MockKey;
+
+static MockKey *buckets[MOCK_BUCKETS];
+static long key_count = 0;
+
+/**
+ * Function: now_ms
+ * Description: Returns the current time in milliseconds.
+ */
+static long long now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+/**
+ * Function: dup_bytes
+ * Description: Copies a byte string into a new null-terminated buffer.
+ */
+static char *dup_bytes(const char *s, size_t len)
+{
+    char *p = malloc(len + 1);
+
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+/**
+ * Function: key_hash
+ * Description: FNV-1a hash of a key.
+ */
+static unsigned int key_hash(const char *s, size_t len)
+{
+    unsigned int h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h % MOCK_BUCKETS;
+}
+
+/**
+ * Function: free_item
+ * Description: Releases the buffers of one item.
+ */
+static void free_item(MockItem *it)
+{
+    free(it->field);
+    free(it->value);
+}
+
+/**
+ * Function: free_key
+ * Description: Releases a key that is no longer linked into the key space.
+ */
+static void free_key(MockKey *k)
+{
+    long i;
+
+    for (i = 0; i < k->count; i++)
+        free_item(&k->items[i]);
+    free(k->items);
+    free(k->name);
+    free(k);
+}
+
+/**
+ * Function: remove_key
+ * Description: Unlinks and frees a key.
+ * Returns:
+ *   - 1 if the key existed, 0 otherwise.
+ */
+static int remove_key(const char *name, size_t len)
+{
+    MockKey **pp = &buckets[key_hash(name, len)], *k;
+
+    for (; *pp != NULL; pp = &(*pp)->next)
+    {
+        k = *pp;
+        if (k->len == len && memcmp(k->name, name, len) == 0)
+        {
+            *pp = k->next;
+            free_key(k);
+            key_count--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Function: find_key
+ * Description: Looks a key up, expiring it first when its time has passed.
+ * Returns:
+ *   - Key, NULL if it does not exist.
+ */
+static MockKey *find_key(const char *name, size_t len)
+{
+    MockKey *k;
+
+    for (k = buckets[key_hash(name, len)]; k != NULL; k = k->next)
+    {
+        if (k->len == len && memcmp(k->name, name, len) == 0)
+        {
+            if (k->expire_ms != 0 && k->expire_ms <= now_ms())
+            {
+                remove_key(name, len);
+                return NULL;
+            }
+            return k;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Function: create_key
+ * Description: Creates an empty key of the given type.
+ */
+static MockKey *create_key(const char *name, size_t len, int type)
+{
+    unsigned int h = key_hash(name, len);
+    MockKey *k = calloc(1, sizeof(MockKey));
+
+    k->name = dup_bytes(name, len);
+    k->len = len;
+    k->type = type;
+    k->next = buckets[h];
+    buckets[h] = k;
+    key_count++;
+    return k;
+}
+
+/**
+ * Function: add_item
+ * Description: Appends an empty item to a key and returns it.
+ */
+static MockItem *add_item(MockKey *k)
+{
+    if (k->count == k->cap)
+    {
+        k->cap = k->cap ? k->cap * 2 : 4;
+        k->items = realloc(k->items, k->cap * sizeof(MockItem));
+    }
+    memset(&k->items[k->count], 0, sizeof(MockItem));
+    return &k->items[k->count++];
+}
+
+/**
+ * Function: remove_item
+ * Description: Removes the item at an index, keeping the order.
+ */
+static void remove_item(MockKey *k, long index)
+{
+    free_item(&k->items[index]);
+    memmove(&k->items[index], &k->items[index + 1], (k->count - index - 1) * sizeof(MockItem));
+    k->count--;
+}
+
+/**
+ * Function: find_field
+ * Description: Returns the index of a field/member, -1 if absent.
+ */
+static long find_field(const MockKey *k, const char *field, size_t len)
+{
+    long i;
+
+    for (i = 0; i < k->count; i++)
+    {
+        if (k->items[i].field_len == len && memcmp(k->items[i].field, field, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Function: drop_if_empty
+ * Description: Deletes a collection key that has no items left.
+ */
+static void drop_if_empty(MockKey *k)
+{
+    if (k->type != TYPE_STRING && k->count == 0)
+        remove_key(k->name, k->len);
+}
+
+/**
+ * Function: glob_match
+ * Description: Redis-style glob matching (*, ?, [set], [^set], \x).
+ */
+static int glob_match(const char *p, size_t plen, const char *s, size_t slen)
+{
+    size_t i;
+    int negate, match;
+
+    while (plen > 0)
+    {
+        switch (*p)
+        {
+        case '*':
+            while (plen > 1 && p[1] == '*')
+            {
+                p++;
+                plen--;
+            }
+            if (plen == 1)
+                return 1;
+            for (i = 0; i <= slen; i++)
+            {
+                if (glob_match(p + 1, plen - 1, s + i, slen - i))
+                    return 1;
+            }
+            return 0;
+        case '?':
+            if (slen == 0)
+                return 0;
+            s++;
+            slen--;
+            break;
+        case '[':
+            if (slen == 0)
+                return 0;
+            p++;
+            plen--;
+            negate = plen > 0 && *p == '^';
+            if (negate)
+            {
+                p++;
+                plen--;
+            }
+            match = 0;
+            while (plen > 0 && *p != ']')
+            {
+                if (*p == '\\' && plen > 1)
+                {
+                    p++;
+                    plen--;
+                    match |= *p == *s;
+                }
+                else if (plen > 2 && p[1] == '-' && p[2] != ']')
+                {
+                    match |= *s >= p[0] && *s <= p[2];
+                    p += 2;
+                    plen -= 2;
+                }
+                else
+                {
+                    match |= *p == *s;
+                }
+                p++;
+                plen--;
+            }
+            if (match == negate)
+                return 0;
+            s++;
+            slen--;
+            break;
+        case '\\':
+            if (plen > 1)
+            {
+                p++;
+                plen--;
+            }
+            /* fall through */
+        default:
+            if (slen == 0 || *p != *s)
+                return 0;
+            s++;
+            slen--;
+            break;
+        }
+        p++;
+        plen--;
+    }
+    return slen == 0;
+}
+
+/**********************************************************************/
+/* Reply Building */
+/**********************************************************************/
+
+typedef struct
+{
+    char *buf;
+    size_t len, cap;
+} MockReply;
+
+static void reply_raw(MockReply *r, const char *s, size_t len)
+{
+    if (r->len + len > r->cap)
+    {
+        while (r->len + len > r->cap)
+            r->cap = r->cap ? r->cap * 2 : 256;
+        r->buf = realloc(r->buf, r->cap);
+    }
+    memcpy(r->buf + r->len, s, len);
+    r->len += len;
+}
+
+static void reply_fmt(MockReply *r, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void reply_fmt(MockReply *r, const char *fmt, ...)
+{
+    char tmp[512];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    reply_raw(r, tmp, n < (int)sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+}
+
+static void reply_bulk(MockReply *r, const char *s, size_t len)
+{
+    reply_fmt(r, "$%zu\r\n", len);
+    reply_raw(r, s, len);
+    reply_raw(r, "\r\n", 2);
+}
+
+static void reply_nil(MockReply *r)
+{
+    reply_raw(r, "$-1\r\n", 5);
+}
+
+static void reply_ok(MockReply *r)
+{
+    reply_raw(r, "+OK\r\n", 5);
+}
+
+static void reply_int(MockReply *r, long long v)
+{
+    reply_fmt(r, ":%lld\r\n", v);
+}
+
+static void reply_array(MockReply *r, long n)
+{
+    reply_fmt(r, "*%ld\r\n", n);
+}
+
+static void reply_wrongtype(MockReply *r)
+{
+    reply_fmt(r, "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n");
+}
+
+/**
+ * Function: reply_double
+ * Description: Sends a score as a bulk string in the shortest form that
+ *              reads back to the same value, like Redis.
+ */
+static void reply_double(MockReply *r, double v)
+{
+    char tmp[64];
+    int precision;
+
+    if (isinf(v))
+    {
+        reply_bulk(r, v > 0 ? "inf" : "-inf", v > 0 ? 3 : 4);
+        return;
+    }
+    for (precision = 1; precision <= 17; precision++)
+    {
+        snprintf(tmp, sizeof(tmp), "%.*g", precision, v);
+        if (strtod(tmp, NULL) == v)
+            break;
+    }
+    reply_bulk(r, tmp, strlen(tmp));
+}
+
+/**********************************************************************/
+/* Argument Helpers */
+/**********************************************************************/
+
+typedef struct
+{
+    int argc;
+    char *argv[MOCK_MAX_ARGS];
+    size_t argl[MOCK_MAX_ARGS];
+} MockCommand;
+
+static int arg_is(const MockCommand *c, int i, const char *word)
+{
+    return i < c->argc && c->argl[i] == strlen(word) && strncasecmp(c->argv[i], word, c->argl[i]) == 0;
+}
+
+/**
+ * Function: arg_long
+ * Description: Parses an integer argument.
+ * Returns:
+ *   - 0 on success, -1 if it is not an integer.
+ */
+static int arg_long(const MockCommand *c, int i, long long *out)
+{
+    char *end;
+
+    if (i >= c->argc || c->argl[i] == 0)
+        return -1;
+    errno = 0;
+    *out = strtoll(c->argv[i], &end, 10);
+    return (errno != 0 || end != c->argv[i] + c->argl[i]) ? -1 : 0;
+}
+
+/**
+ * Function: arg_score
+ * Description: Parses a score or score range bound ("(1.5", "-inf", "+inf").
+ * Returns:
+ *   - 0 on success, -1 if it is not a number.
+ */
+static int arg_score(const MockCommand *c, int i, double *out, int *exclusive)
+{
+    const char *s = c->argv[i];
+    char *end;
+
+    *exclusive = 0;
+    if (*s == '(')
+    {
+        *exclusive = 1;
+        s++;
+    }
+    if (strcasecmp(s, "-inf") == 0)
+        *out = -INFINITY;
+    else if (strcasecmp(s, "+inf") == 0 || strcasecmp(s, "inf") == 0)
+        *out = INFINITY;
+    else
+    {
+        *out = strtod(s, &end);
+        if (end == s || *end != '\0')
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * Function: lookup
+ * Description: Finds a key and checks its type.
+ * Returns:
+ *   - 1 if found with the right type, 0 if absent, -1 on wrong type
+ *     (the WRONGTYPE error is already in the reply).
+ */
+static int lookup(MockReply *r, const MockCommand *c, int type, MockKey **k)
+{
+    *k = find_key(c->argv[1], c->argl[1]);
+    if (*k == NULL)
+        return 0;
+    if ((*k)->type != type)
+    {
+        reply_wrongtype(r);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Function: lookup_or_create
+ * Description: Finds a key of the given type or creates it.
+ * Returns:
+ *   - Key, NULL on wrong type (the WRONGTYPE error is already in the reply).
+ */
+static MockKey *lookup_or_create(MockReply *r, const MockCommand *c, int type)
+{
+    MockKey *k;
+    int rc = lookup(r, c, type, &k);
+
+    if (rc < 0)
+        return NULL;
+    if (rc == 0)
+        k = create_key(c->argv[1], c->argl[1], type);
+    return k;
+}
+
+/**
+ * Function: set_string
+ * Description: Stores a string value, replacing whatever the key held.
+ */
+static MockKey *set_string(const char *name, size_t len, const char *value, size_t value_len)
+{
+    MockKey *k;
+    MockItem *it;
+
+    remove_key(name, len);
+    k = create_key(name, len, TYPE_STRING);
+    it = add_item(k);
+    it->value = dup_bytes(value, value_len);
+    it->value_len = value_len;
+    return k;
+}
+
+/**
+ * Function: range_bounds
+ * Description: Converts Redis start/stop indexes (negative = from the end)
+ *              to a half-open range over count items.
+ */
+static void range_bounds(long long start, long long stop, long count, long *from, long *to)
+{
+    if (start < 0)
+        start += count;
+    if (stop < 0)
+        stop += count;
+    if (start < 0)
+        start = 0;
+    if (stop >= count)
+        stop = count - 1;
+    *from = (long)start;
+    *to = start > stop ? (long)start : (long)stop + 1;
+}
+
+/**
+ * Function: zset_insert
+ * Description: Inserts an item into a sorted set, keeping it ordered by
+ *              score, then member.
+ */
+static void zset_insert(MockKey *k, const char *member, size_t len, double score)
+{
+    MockItem tmp;
+    long i;
+    int cmp;
+
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.field = dup_bytes(member, len);
+    tmp.field_len = len;
+    tmp.score = score;
+    add_item(k);
+    for (i = k->count - 1; i > 0; i--)
+    {
+        MockItem *prev = &k->items[i - 1];
+        cmp = prev->score < score ? -1 : prev->score > score ? 1 : 0;
+        if (cmp == 0)
+        {
+            cmp = memcmp(prev->field, member, prev->field_len < len ? prev->field_len : len);
+            if (cmp == 0)
+                cmp = prev->field_len < len ? -1 : prev->field_len > len;
+        }
+        if (cmp <= 0)
+            break;
+        k->items[i] = *prev;
+    }
+    k->items[i] = tmp;
+}
+
+/**
+ * Function: scan_reply
+ * Description: Shared part of SCAN/HSCAN/SSCAN: walks count entries from
+ *              the cursor and returns the matching ones.
+ */
+static void scan_reply(MockReply *r, const MockCommand *c, int first_option, long long cursor,
+                       MockKey *k)
+{
+    const char *pattern = NULL;
+    size_t pattern_len = 0;
+    long long count = 10, pos = 0, next;
+    long matched = 0, i, b;
+    MockReply items = {0};
+    MockKey *it;
+    char cur[32];
+    int opt, n;
+
+    for (opt = first_option; opt + 1 < c->argc; opt += 2)
+    {
+        if (arg_is(c, opt, "MATCH"))
+        {
+            pattern = c->argv[opt + 1];
+            pattern_len = c->argl[opt + 1];
+        }
+        else if (arg_is(c, opt, "COUNT") && (arg_long(c, opt + 1, &count) != 0 || count < 1))
+        {
+            reply_fmt(r, "-ERR syntax error\r\n");
+            return;
+        }
+    }
+
+    next = cursor;
+    if (k == NULL)
+    {
+        // Key space: walk the buckets in order, the cursor counts keys
+        for (b = 0; b < MOCK_BUCKETS && next < cursor + count; b++)
+        {
+            for (it = buckets[b]; it != NULL; it = it->next, pos++)
+            {
+                if (pos < cursor)
+                    continue;
+                if (next >= cursor + count)
+                    break;
+                next++;
+                if (pattern == NULL || glob_match(pattern, pattern_len, it->name, it->len))
+                {
+                    reply_bulk(&items, it->name, it->len);
+                    matched++;
+                }
+            }
+        }
+        if (next - cursor < count || next >= key_count)
+            next = 0;
+    }
+    else
+    {
+        for (i = (long)cursor; i < k->count && i < cursor + count; i++)
+        {
+            MockItem *item = &k->items[i];
+            if (pattern != NULL && !glob_match(pattern, pattern_len, item->field, item->field_len))
+                continue;
+            reply_bulk(&items, item->field, item->field_len);
+            matched++;
+            if (k->type == TYPE_HASH)
+            {
+                reply_bulk(&items, item->value, item->value_len);
+                matched++;
+            }
+        }
+        next = i >= k->count ? 0 : i;
+    }
+
+    reply_array(r, 2);
+    n = snprintf(cur, sizeof(cur), "%lld", next);
+    reply_bulk(r, cur, n);
+    reply_array(r, matched);
+    if (items.len > 0)
+        reply_raw(r, items.buf, items.len);
+    free(items.buf);
+}
+
+/**********************************************************************/
+/* Commands */
+/**********************************************************************/
+
+static void run_script(MockReply *r, const MockCommand *c);
+
+/**
+ * Function: run_command
+ * Description: Runs one command against the key space (under mock_lock).
+ */
+static void run_command(MockReply *r, const MockCommand *c)
+{
+    const char *cmd = c->argv[0];
+    MockKey *k, *dest;
+    MockItem *it, moved;
+    long long n, m;
+    long i, from, to, added;
+    int rc, excl_min, excl_max, withscores;
+    double score, min, max;
+
+#define IS(name) (strcasecmp(cmd, name) == 0)
+#define NEED(min_args)                                                                     \
+    if (c->argc < (min_args))                                                            \
+    {                                                                                      \
+        reply_fmt(r, "-ERR wrong number of arguments for '%s' command\r\n", cmd);          \
+        return;                                                                            \
+    }
+
+    /* Connection */
+    if (IS("PING"))
+    {
+        if (c->argc > 1)
+            reply_bulk(r, c->argv[1], c->argl[1]);
+        else
+            reply_raw(r, "+PONG\r\n", 7);
+    }
+    else if (IS("HELLO"))
+    {
+        reply_array(r, 6);
+        reply_bulk(r, "server", 6);
+        reply_bulk(r, "redis", 5);
+        reply_bulk(r, "version", 7);
+        reply_bulk(r, "7.2.0", 5);
+        reply_bulk(r, "proto", 5);
+        reply_int(r, 2);
+    }
+    else if (IS("AUTH") || IS("SELECT") || IS("CLIENT") || IS("ASKING"))
+    {
+        reply_ok(r);
+    }
+    else if (IS("CLUSTER"))
+    {
+        // One node owning every slot: this server
+        if (!arg_is(c, 1, "SLOTS"))
+        {
+            reply_fmt(r, "-ERR unsupported CLUSTER subcommand\r\n");
+            return;
+        }
+        reply_fmt(r, "*1\r\n*3\r\n:0\r\n:16383\r\n*2\r\n$9\r\n127.0.0.1\r\n:%d\r\n", port);
+    }
+    else if (IS("SCRIPT") || IS("EVAL") || IS("EVALSHA"))
+    {
+        run_script(r, c);
+    }
+    else if (IS("DBSIZE"))
+    {
+        reply_int(r, key_count);
+    }
+    else if (IS("FLUSHDB") || IS("FLUSHALL"))
+    {
+        for (i = 0; i < MOCK_BUCKETS; i++)
+        {
+            while (buckets[i] != NULL)
+            {
+                k = buckets[i];
+                buckets[i] = k->next;
+                free_key(k);
+            }
+        }
+        key_count = 0;
+        reply_ok(r);
+    }
+
+    /* Keys */
+    else if (IS("DEL") || IS("UNLINK") || IS("EXISTS"))
+    {
+        NEED(2);
+        for (n = 0, i = 1; i < c->argc; i++)
+        {
+            if (IS("EXISTS"))
+                n += find_key(c->argv[i], c->argl[i]) != NULL;
+            else
+                n += find_key(c->argv[i], c->argl[i]) != NULL && remove_key(c->argv[i], c->argl[i]);
+        }
+        reply_int(r, n);
+    }
+    else if (IS("EXPIRE") || IS("PEXPIRE"))
+    {
+        NEED(3);
+        if (arg_long(c, 2, &n) != 0)
+        {
+            reply_fmt(r, "-ERR value is not an integer or out of range\r\n");
+            return;
+        }
+        k = find_key(c->argv[1], c->argl[1]);
+        if (k != NULL)
+            k->expire_ms = now_ms() + (IS("EXPIRE") ? n * 1000 : n);
+        reply_int(r, k != NULL);
+    }
+    else if (IS("TTL") || IS("PTTL"))
+    {
+        NEED(2);
+        k = find_key(c->argv[1], c->argl[1]);
+        if (k == NULL)
+            reply_int(r, -2);
+        else if (k->expire_ms == 0)
+            reply_int(r, -1);
+        else
+            reply_int(r, IS("TTL") ? (k->expire_ms - now_ms() + 999) / 1000 : k->expire_ms - now_ms());
+    }
+    else if (IS("PERSIST"))
+    {
+        NEED(2);
+        k = find_key(c->argv[1], c->argl[1]);
+        rc = k != NULL && k->expire_ms != 0;
+        if (rc)
+            k->expire_ms = 0;
+        reply_int(r, rc);
+    }
+    else if (IS("TYPE"))
+    {
+        NEED(2);
+        k = find_key(c->argv[1], c->argl[1]);
+        reply_fmt(r, "+%s\r\n", k == NULL ? "none" : type_names[k->type]);
+    }
+    else if (IS("RENAME"))
+    {
+        NEED(3);
+        k = find_key(c->argv[1], c->argl[1]);
+        if (k == NULL)
+        {
+            reply_fmt(r, "-ERR no such key\r\n");
+            return;
+        }
+        // Unlink from the old bucket, rename and relink
+        {
+            MockKey **pp = &buckets[key_hash(k->name, k->len)];
+            while (*pp != k)
+                pp = &(*pp)->next;
+            *pp = k->next;
+        }
+        key_count--;
+        remove_key(c->argv[2], c->argl[2]);
+        free(k->name);
+        k->name = dup_bytes(c->argv[2], c->argl[2]);
+        k->len = c->argl[2];
+        k->next = buckets[key_hash(k->name, k->len)];
+        buckets[key_hash(k->name, k->len)] = k;
+        key_count++;
+        reply_ok(r);
+    }
+    else if (IS("KEYS"))
+    {
+        MockReply items = {0};
+        NEED(2);
+        for (n = 0, i = 0; i < MOCK_BUCKETS; i++)
+        {
+            for (k = buckets[i]; k != NULL; k = k->next)
+            {
+                if (glob_match(c->argv[1], c->argl[1], k->name, k->len))
+                {
+                    reply_bulk(&items, k->name, k->len);
+                    n++;
+                }
+            }
+        }
+        reply_array(r, n);
+        if (items.len > 0)
+            reply_raw(r, items.buf, items.len);
+        free(items.buf);
+    }
+    else if (IS("SCAN"))
+    {
+        NEED(2);
+        if (arg_long(c, 1, &n) != 0 || n < 0)
+        {
+            reply_fmt(r, "-ERR invalid cursor\r\n");
+            return;
+        }
+        scan_reply(r, c, 2, n, NULL);
+    }
+
+    /* Strings */
+    else if (IS("GET"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, TYPE_STRING, &k)) < 0)
+            return;
+        if (rc == 0)
+            reply_nil(r);
+        else
+            reply_bulk(r, k->items[0].value, k->items[0].value_len);
+    }
+    else if (IS("SET"))
+    {
+        long long expire = 0;
+        int nx = 0, xx = 0;
+        NEED(3);
+        for (i = 3; i < c->argc; i++)
+        {
+            if (arg_is(c, i, "NX"))
+                nx = 1;
+            else if (arg_is(c, i, "XX"))
+                xx = 1;
+            else if ((arg_is(c, i, "EX") || arg_is(c, i, "PX")) && arg_long(c, i + 1, &n) == 0 && n > 0)
+            {
+                expire = arg_is(c, i, "EX") ? n * 1000 : n;
+                i++;
+            }
+            else
+            {
+                reply_fmt(r, "-ERR syntax error\r\n");
+                return;
+            }
+        }
+        k = find_key(c->argv[1], c->argl[1]);
+        if ((nx && k != NULL) || (xx && k == NULL))
+        {
+            reply_nil(r);
+            return;
+        }
+        k = set_string(c->argv[1], c->argl[1], c->argv[2], c->argl[2]);
+        if (expire > 0)
+            k->expire_ms = now_ms() + expire;
+        reply_ok(r);
+    }
+    else if (IS("SETEX"))
+    {
+        NEED(4);
+        if (arg_long(c, 2, &n) != 0 || n <= 0)
+        {
+            reply_fmt(r, "-ERR invalid expire time in 'setex' command\r\n");
+            return;
+        }
+        k = set_string(c->argv[1], c->argl[1], c->argv[3], c->argl[3]);
+        k->expire_ms = now_ms() + n * 1000;
+        reply_ok(r);
+    }
+    else if (IS("SETNX"))
+    {
+        NEED(3);
+        rc = find_key(c->argv[1], c->argl[1]) == NULL;
+        if (rc)
+            set_string(c->argv[1], c->argl[1], c->argv[2], c->argl[2]);
+        reply_int(r, rc);
+    }
+    else if (IS("GETSET"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, TYPE_STRING, &k)) < 0)
+            return;
+        if (rc == 0)
+            reply_nil(r);
+        else
+            reply_bulk(r, k->items[0].value, k->items[0].value_len);
+        set_string(c->argv[1], c->argl[1], c->argv[2], c->argl[2]);
+    }
+    else if (IS("APPEND"))
+    {
+        NEED(3);
+        if ((k = lookup_or_create(r, c, TYPE_STRING)) == NULL)
+            return;
+        if (k->count == 0)
+        {
+            it = add_item(k);
+            it->value = dup_bytes("", 0);
+        }
+        it = &k->items[0];
+        it->value = realloc(it->value, it->value_len + c->argl[2] + 1);
+        memcpy(it->value + it->value_len, c->argv[2], c->argl[2]);
+        it->value_len += c->argl[2];
+        it->value[it->value_len] = '\0';
+        reply_int(r, (long long)it->value_len);
+    }
+    else if (IS("STRLEN"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, TYPE_STRING, &k)) < 0)
+            return;
+        reply_int(r, rc == 0 ? 0 : (long long)k->items[0].value_len);
+    }
+    else if (IS("INCR") || IS("DECR") || IS("INCRBY") || IS("DECRBY"))
+    {
+        char num[32];
+        NEED(IS("INCR") || IS("DECR") ? 2 : 3);
+        m = 1;
+        if (c->argc > 2 && arg_long(c, 2, &m) != 0)
+        {
+            reply_fmt(r, "-ERR value is not an integer or out of range\r\n");
+            return;
+        }
+        if (IS("DECR") || IS("DECRBY"))
+            m = -m;
+        if ((rc = lookup(r, c, TYPE_STRING, &k)) < 0)
+            return;
+        n = 0;
+        if (rc == 1)
+        {
+            char *end;
+            n = strtoll(k->items[0].value, &end, 10);
+            if (k->items[0].value_len == 0 || end != k->items[0].value + k->items[0].value_len)
+            {
+                reply_fmt(r, "-ERR value is not an integer or out of range\r\n");
+                return;
+            }
+        }
+        n += m;
+        i = snprintf(num, sizeof(num), "%lld", n);
+        if (rc == 1)
+        {
+            free(k->items[0].value);
+            k->items[0].value = dup_bytes(num, i);
+            k->items[0].value_len = i;
+        }
+        else
+        {
+            set_string(c->argv[1], c->argl[1], num, i);
+        }
+        reply_int(r, n);
+    }
+    else if (IS("MGET"))
+    {
+        NEED(2);
+        reply_array(r, c->argc - 1);
+        for (i = 1; i < c->argc; i++)
+        {
+            k = find_key(c->argv[i], c->argl[i]);
+            if (k == NULL || k->type != TYPE_STRING)
+                reply_nil(r);
+            else
+                reply_bulk(r, k->items[0].value, k->items[0].value_len);
+        }
+    }
+    else if (IS("MSET"))
+    {
+        if (c->argc < 3 || c->argc % 2 == 0)
+        {
+            reply_fmt(r, "-ERR wrong number of arguments for 'mset' command\r\n");
+            return;
+        }
+        for (i = 1; i < c->argc; i += 2)
+            set_string(c->argv[i], c->argl[i], c->argv[i + 1], c->argl[i + 1]);
+        reply_ok(r);
+    }
+
+    /* Hashes */
+    else if (IS("HSET"))
+    {
+        if (c->argc < 4 || c->argc % 2 != 0)
+        {
+            reply_fmt(r, "-ERR wrong number of arguments for 'hset' command\r\n");
+            return;
+        }
+        if ((k = lookup_or_create(r, c, TYPE_HASH)) == NULL)
+            return;
+        for (added = 0, i = 2; i < c->argc; i += 2)
+        {
+            from = find_field(k, c->argv[i], c->argl[i]);
+            if (from < 0)
+            {
+                it = add_item(k);
+                it->field = dup_bytes(c->argv[i], c->argl[i]);
+                it->field_len = c->argl[i];
+                added++;
+            }
+            else
+            {
+                it = &k->items[from];
+                free(it->value);
+            }
+            it->value = dup_bytes(c->argv[i + 1], c->argl[i + 1]);
+            it->value_len = c->argl[i + 1];
+        }
+        reply_int(r, added);
+    }
+    else if (IS("HGET") || IS("HEXISTS"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, TYPE_HASH, &k)) < 0)
+            return;
+        from = rc == 1 ? find_field(k, c->argv[2], c->argl[2]) : -1;
+        if (IS("HEXISTS"))
+            reply_int(r, from >= 0);
+        else if (from < 0)
+            reply_nil(r);
+        else
+            reply_bulk(r, k->items[from].value, k->items[from].value_len);
+    }
+    else if (IS("HDEL"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, TYPE_HASH, &k)) < 0)
+            return;
+        for (n = 0, i = 2; rc == 1 && i < c->argc; i++)
+        {
+            from = find_field(k, c->argv[i], c->argl[i]);
+            if (from >= 0)
+            {
+                remove_item(k, from);
+                n++;
+            }
+        }
+        if (rc == 1)
+            drop_if_empty(k);
+        reply_int(r, n);
+    }
+    else if (IS("HINCRBY"))
+    {
+        char num[32];
+        NEED(4);
+        if (arg_long(c, 3, &m) != 0)
+        {
+            reply_fmt(r, "-ERR value is not an integer or out of range\r\n");
+            return;
+        }
+        if ((k = lookup_or_create(r, c, TYPE_HASH)) == NULL)
+            return;
+        from = find_field(k, c->argv[2], c->argl[2]);
+        if (from < 0)
+        {
+            it = add_item(k);
+            it->field = dup_bytes(c->argv[2], c->argl[2]);
+            it->field_len = c->argl[2];
+            n = 0;
+        }
+        else
+        {
+            it = &k->items[from];
+            n = strtoll(it->value, NULL, 10);
+            free(it->value);
+        }
+        n += m;
+        i = snprintf(num, sizeof(num), "%lld", n);
+        it->value = dup_bytes(num, i);
+        it->value_len = i;
+        reply_int(r, n);
+    }
+    else if (IS("HLEN"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, TYPE_HASH, &k)) < 0)
+            return;
+        reply_int(r, rc == 1 ? k->count : 0);
+    }
+    else if (IS("HGETALL"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, TYPE_HASH, &k)) < 0)
+            return;
+        reply_array(r, rc == 1 ? k->count * 2 : 0);
+        for (i = 0; rc == 1 && i < k->count; i++)
+        {
+            reply_bulk(r, k->items[i].field, k->items[i].field_len);
+            reply_bulk(r, k->items[i].value, k->items[i].value_len);
+        }
+    }
+    else if (IS("HSCAN") || IS("SSCAN"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, IS("HSCAN") ? TYPE_HASH : TYPE_SET, &k)) < 0)
+            return;
+        if (arg_long(c, 2, &n) != 0 || n < 0)
+        {
+            reply_fmt(r, "-ERR invalid cursor\r\n");
+            return;
+        }
+        if (rc == 0)
+            reply_raw(r, "*2\r\n$1\r\n0\r\n*0\r\n", 15);
+        else
+            scan_reply(r, c, 3, n, k);
+    }
+
+    /* Lists */
+    else if (IS("LPUSH") || IS("RPUSH"))
+    {
+        NEED(3);
+        if ((k = lookup_or_create(r, c, TYPE_LIST)) == NULL)
+            return;
+        for (i = 2; i < c->argc; i++)
+        {
+            it = add_item(k);
+            if (IS("LPUSH"))
+            {
+                memmove(&k->items[1], &k->items[0], (k->count - 1) * sizeof(MockItem));
+                it = &k->items[0];
+                memset(it, 0, sizeof(MockItem));
+            }
+            it->value = dup_bytes(c->argv[i], c->argl[i]);
+            it->value_len = c->argl[i];
+        }
+        reply_int(r, k->count);
+    }
+    else if (IS("LPOP") || IS("RPOP"))
+    {
+        NEED(2);
+        n = -1; // Single element, no array
+        if (c->argc > 2 && (arg_long(c, 2, &n) != 0 || n < 0))
+        {
+            reply_fmt(r, "-ERR value is out of range, must be positive\r\n");
+            return;
+        }
+        if ((rc = lookup(r, c, TYPE_LIST, &k)) < 0)
+            return;
+        if (rc == 0)
+        {
+            reply_raw(r, n < 0 ? "$-1\r\n" : "*-1\r\n", 5);
+            return;
+        }
+        m = n < 0 ? 1 : (n < k->count ? n : k->count);
+        if (n >= 0)
+            reply_array(r, m);
+        for (i = 0; i < m; i++)
+        {
+            from = IS("LPOP") ? 0 : k->count - 1;
+            reply_bulk(r, k->items[from].value, k->items[from].value_len);
+            remove_item(k, from);
+        }
+        drop_if_empty(k);
+    }
+    else if (IS("BLPOP") || IS("BRPOP"))
+    {
+        // Pops without waiting; client_thread parks the connection while the reply is nil
+        NEED(3);
+        if (arg_score(c, c->argc - 1, &score, &rc) != 0 || rc || score < 0)
+        {
+            reply_fmt(r, "-ERR timeout is not a float or out of range\r\n");
+            return;
+        }
+        for (i = 1; i < c->argc - 1; i++)
+        {
+            if ((k = find_key(c->argv[i], c->argl[i])) == NULL)
+                continue;
+            if (k->type != TYPE_LIST)
+            {
+                reply_wrongtype(r);
+                return;
+            }
+            from = IS("BLPOP") ? 0 : k->count - 1;
+            reply_array(r, 2);
+            reply_bulk(r, k->name, k->len);
+            reply_bulk(r, k->items[from].value, k->items[from].value_len);
+            remove_item(k, from);
+            drop_if_empty(k);
+            return;
+        }
+        reply_raw(r, "*-1\r\n", 5);
+    }
+    else if (IS("LMOVE") || IS("BLMOVE"))
+    {
+        NEED(IS("LMOVE") ? 5 : 6);
+        if ((!arg_is(c, 3, "LEFT") && !arg_is(c, 3, "RIGHT")) || (!arg_is(c, 4, "LEFT") && !arg_is(c, 4, "RIGHT")))
+        {
+            reply_fmt(r, "-ERR syntax error\r\n");
+            return;
+        }
+        if (IS("BLMOVE") && (arg_score(c, 5, &score, &rc) != 0 || rc || score < 0))
+        {
+            reply_fmt(r, "-ERR timeout is not a float or out of range\r\n");
+            return;
+        }
+        if ((rc = lookup(r, c, TYPE_LIST, &k)) < 0)
+            return;
+        if (rc == 0)
+        {
+            reply_raw(r, IS("LMOVE") ? "$-1\r\n" : "*-1\r\n", 5);
+            return;
+        }
+        dest = find_key(c->argv[2], c->argl[2]);
+        if (dest != NULL && dest->type != TYPE_LIST)
+        {
+            reply_wrongtype(r);
+            return;
+        }
+
+        // The element changes list, its memory with it (source and destination may be one list)
+        from = arg_is(c, 3, "LEFT") ? 0 : k->count - 1;
+        moved = k->items[from];
+        memmove(&k->items[from], &k->items[from + 1], (k->count - from - 1) * sizeof(MockItem));
+        k->count--;
+        if (dest != k)
+            drop_if_empty(k);
+        if (dest == NULL)
+            dest = create_key(c->argv[2], c->argl[2], TYPE_LIST);
+        it = add_item(dest);
+        if (arg_is(c, 4, "LEFT"))
+        {
+            memmove(&dest->items[1], &dest->items[0], (dest->count - 1) * sizeof(MockItem));
+            it = &dest->items[0];
+        }
+        *it = moved;
+        reply_bulk(r, moved.value, moved.value_len);
+    }
+    else if (IS("LLEN"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, TYPE_LIST, &k)) < 0)
+            return;
+        reply_int(r, rc == 1 ? k->count : 0);
+    }
+    else if (IS("LRANGE"))
+    {
+        NEED(4);
+        if (arg_long(c, 2, &n) != 0 || arg_long(c, 3, &m) != 0)
+        {
+            reply_fmt(r, "-ERR value is not an integer or out of range\r\n");
+            return;
+        }
+        if ((rc = lookup(r, c, TYPE_LIST, &k)) < 0)
+            return;
+        if (rc == 0)
+        {
+            reply_array(r, 0);
+            return;
+        }
+        range_bounds(n, m, k->count, &from, &to);
+        reply_array(r, to - from);
+        for (i = from; i < to; i++)
+            reply_bulk(r, k->items[i].value, k->items[i].value_len);
+    }
+
+    /* Sets */
+    else if (IS("SADD"))
+    {
+        NEED(3);
+        if ((k = lookup_or_create(r, c, TYPE_SET)) == NULL)
+            return;
+        for (added = 0, i = 2; i < c->argc; i++)
+        {
+            if (find_field(k, c->argv[i], c->argl[i]) >= 0)
+                continue;
+            it = add_item(k);
+            it->field = dup_bytes(c->argv[i], c->argl[i]);
+            it->field_len = c->argl[i];
+            added++;
+        }
+        reply_int(r, added);
+    }
+    else if (IS("SREM") || IS("ZREM"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, IS("SREM") ? TYPE_SET : TYPE_ZSET, &k)) < 0)
+            return;
+        for (n = 0, i = 2; rc == 1 && i < c->argc; i++)
+        {
+            from = find_field(k, c->argv[i], c->argl[i]);
+            if (from >= 0)
+            {
+                remove_item(k, from);
+                n++;
+            }
+        }
+        if (rc == 1)
+            drop_if_empty(k);
+        reply_int(r, n);
+    }
+    else if (IS("SISMEMBER"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, TYPE_SET, &k)) < 0)
+            return;
+        reply_int(r, rc == 1 && find_field(k, c->argv[2], c->argl[2]) >= 0);
+    }
+    else if (IS("SCARD") || IS("ZCARD"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, IS("SCARD") ? TYPE_SET : TYPE_ZSET, &k)) < 0)
+            return;
+        reply_int(r, rc == 1 ? k->count : 0);
+    }
+    else if (IS("SMEMBERS"))
+    {
+        NEED(2);
+        if ((rc = lookup(r, c, TYPE_SET, &k)) < 0)
+            return;
+        reply_array(r, rc == 1 ? k->count : 0);
+        for (i = 0; rc == 1 && i < k->count; i++)
+            reply_bulk(r, k->items[i].field, k->items[i].field_len);
+    }
+
+    /* Sorted sets */
+    else if (IS("ZADD"))
+    {
+        if (c->argc < 4 || c->argc % 2 != 0)
+        {
+            reply_fmt(r, "-ERR syntax error\r\n");
+            return;
+        }
+        for (i = 2; i < c->argc; i += 2)
+        {
+            if (arg_score(c, i, &score, &excl_min) != 0 || excl_min)
+            {
+                reply_fmt(r, "-ERR value is not a valid float\r\n");
+                return;
+            }
+        }
+        if ((k = lookup_or_create(r, c, TYPE_ZSET)) == NULL)
+            return;
+        for (added = 0, i = 2; i < c->argc; i += 2)
+        {
+            arg_score(c, i, &score, &excl_min);
+            from = find_field(k, c->argv[i + 1], c->argl[i + 1]);
+            if (from >= 0)
+                remove_item(k, from);
+            else
+                added++;
+            zset_insert(k, c->argv[i + 1], c->argl[i + 1], score);
+        }
+        reply_int(r, added);
+    }
+    else if (IS("ZSCORE") || IS("ZRANK"))
+    {
+        NEED(3);
+        if ((rc = lookup(r, c, TYPE_ZSET, &k)) < 0)
+            return;
+        from = rc == 1 ? find_field(k, c->argv[2], c->argl[2]) : -1;
+        if (from < 0)
+            reply_nil(r);
+        else if (IS("ZSCORE"))
+            reply_double(r, k->items[from].score);
+        else
+            reply_int(r, from);
+    }
+    else if (IS("ZRANGE"))
+    {
+        NEED(4);
+        withscores = arg_is(c, 4, "WITHSCORES");
+        if (arg_long(c, 2, &n) != 0 || arg_long(c, 3, &m) != 0)
+        {
+            reply_fmt(r, "-ERR value is not an integer or out of range\r\n");
+            return;
+        }
+        if ((rc = lookup(r, c, TYPE_ZSET, &k)) < 0)
+            return;
+        if (rc == 0)
+        {
+            reply_array(r, 0);
+            return;
+        }
+        range_bounds(n, m, k->count, &from, &to);
+        reply_array(r, (to - from) * (withscores ? 2 : 1));
+        for (i = from; i < to; i++)
+        {
+            reply_bulk(r, k->items[i].field, k->items[i].field_len);
+            if (withscores)
+                reply_double(r, k->items[i].score);
+        }
+    }
+    else if (IS("ZRANGEBYSCORE"))
+    {
+        long long offset = 0, limit = -1;
+        MockReply items = {0};
+        NEED(4);
+        if (arg_score(c, 2, &min, &excl_min) != 0 || arg_score(c, 3, &max, &excl_max) != 0)
+        {
+            reply_fmt(r, "-ERR min or max is not a float\r\n");
+            return;
+        }
+        withscores = 0;
+        for (i = 4; i < c->argc; i++)
+        {
+            if (arg_is(c, i, "WITHSCORES"))
+                withscores = 1;
+            else if (arg_is(c, i, "LIMIT") && arg_long(c, i + 1, &offset) == 0 && arg_long(c, i + 2, &limit) == 0)
+                i += 2;
+            else
+            {
+                reply_fmt(r, "-ERR syntax error\r\n");
+                return;
+            }
+        }
+        if ((rc = lookup(r, c, TYPE_ZSET, &k)) < 0)
+            return;
+        for (n = 0, i = 0; rc == 1 && i < k->count; i++)
+        {
+            score = k->items[i].score;
+            if (score < min || (excl_min && score == min) || score > max || (excl_max && score == max))
+                continue;
+            if (offset > 0)
+            {
+                offset--;
+                continue;
+            }
+            if (limit >= 0 && n >= limit)
+                break;
+            reply_bulk(&items, k->items[i].field, k->items[i].field_len);
+            if (withscores)
+                reply_double(&items, score);
+            n++;
+        }
+        reply_array(r, n * (withscores ? 2 : 1));
+        if (items.len > 0)
+            reply_raw(r, items.buf, items.len);
+        free(items.buf);
+    }
+    else
+    {
+        reply_fmt(r, "-ERR unknown command '%.64s'\r\n", cmd);
+    }
+#undef IS
+#undef NEED
+}
+
+/**********************************************************************/
+/* Scripts */
+/**********************************************************************/
+
+static char *script_sha[MOCK_MAX_SCRIPTS];
+static char *script_body[MOCK_MAX_SCRIPTS];
+static int script_count = 0;
+
+// First lines of the scripts under lua/, run in C instead
+#define MOCK_SCAN_FILTER "-- redis400 scan filter"
+#define MOCK_LIST_POP "-- redis400 list pop"
+
+/**
+ * Function: sha1_hex
+ * Description: SHA1 of a script as 40 lowercase hex digits, the name
+ *              EVALSHA uses.
+ */
+static void sha1_hex(const char *data, size_t len, char *out)
+{
+    unsigned int h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    unsigned int w[80], a, b, c, d, e, f, t;
+    unsigned char block[64];
+    size_t done, total = ((len + 8) / 64 + 1) * 64;
+    int i;
+
+    for (done = 0; done < total; done += 64)
+    {
+        for (i = 0; i < 64; i++)
+        {
+            size_t at = done + i;
+            block[i] = at < len ? (unsigned char)data[at] : at == len ? 0x80 : 0;
+            if (at >= total - 8)
+                block[i] = (unsigned char)(((unsigned long long)len * 8) >> (8 * (total - 1 - at)));
+        }
+        for (i = 0; i < 16; i++)
+            w[i] = (unsigned)block[4 * i] << 24 | (unsigned)block[4 * i + 1] << 16 |
+                   (unsigned)block[4 * i + 2] << 8 | block[4 * i + 3];
+        for (; i < 80; i++)
+        {
+            t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (t << 1) | (t >> 31);
+        }
+        a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (i = 0; i < 80; i++)
+        {
+            f = i < 20 ? ((b & c) | (~b & d)) + 0x5A827999
+                : i < 40 ? (b ^ c ^ d) + 0x6ED9EBA1
+                : i < 60 ? ((b & c) | (b & d) | (c & d)) + 0x8F1BBCDC
+                         : (b ^ c ^ d) + 0xCA62C1D6;
+            t = ((a << 5) | (a >> 27)) + f + e + w[i];
+            e = d, d = c, c = (b << 30) | (b >> 2), b = a, a = t;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    }
+    for (i = 0; i < 5; i++)
+        sprintf(out + 8 * i, "%08x", h[i]);
+}
+
+// Position in a script being run
+typedef struct
+{
+    const char *p;
+    const MockCommand *c; // The EVAL/EVALSHA command, for KEYS and ARGV
+    long keys;            // numkeys
+    int run;              // 0 to check the syntax only (SCRIPT LOAD)
+} MockScript;
+
+static void skip_blanks(MockScript *sp)
+{
+    while (isspace((unsigned char)*sp->p))
+        sp->p++;
+}
+
+static int take(MockScript *sp, const char *word)
+{
+    skip_blanks(sp);
+    if (strncmp(sp->p, word, strlen(word)) != 0)
+        return 0;
+    sp->p += strlen(word);
+    return 1;
+}
+
+/**
+ * Function: script_atom
+ * Description: Reads a string literal, a number, KEYS[n] or ARGV[n].
+ * Returns:
+ *   - 1 for a string, 2 for a number, 0 for a syntax error.
+ */
+static int script_atom(MockScript *sp, const char **s, size_t *len, long long *number)
+{
+    static const char nothing[] = "";
+    const char *start;
+    long index, base;
+
+    skip_blanks(sp);
+    if (*sp->p == '\'' || *sp->p == '"')
+    {
+        start = ++sp->p;
+        while (*sp->p != '\0' && *sp->p != start[-1])
+            sp->p++;
+        if (*sp->p == '\0')
+            return 0;
+        *s = start;
+        *len = sp->p++ - start;
+        return 1;
+    }
+    if (isdigit((unsigned char)*sp->p) || *sp->p == '-')
+    {
+        *number = strtoll(sp->p, (char **)&sp->p, 10);
+        return 2;
+    }
+    base = take(sp, "KEYS[") ? 3 : take(sp, "ARGV[") ? 3 + sp->keys : -1;
+    if (base < 0)
+        return 0;
+    index = strtol(sp->p, (char **)&sp->p, 10);
+    if (!take(sp, "]"))
+        return 0;
+    *s = nothing;
+    *len = 0;
+    if (sp->run && index >= 1 && base + index - 1 < sp->c->argc &&
+        (base == 3 ? index <= sp->keys : 1))
+    {
+        *s = sp->c->argv[base + index - 1];
+        *len = sp->c->argl[base + index - 1];
+    }
+    return 1;
+}
+
+/**
+ * Function: script_value
+ * Description: Evaluates redis.call(...), {...} or an atom into a reply.
+ * Returns:
+ *   - 0 on success, -1 for a syntax error.
+ */
+static int script_value(MockScript *sp, MockReply *r)
+{
+    MockCommand *call;
+    MockReply items = {0};
+    char digits[24];
+    const char *s;
+    size_t len;
+    long long number;
+    int kind, n;
+
+    if (take(sp, "redis.call("))
+    {
+        call = calloc(1, sizeof(MockCommand));
+        for (n = 0; !take(sp, ")"); n++)
+        {
+            if ((n > 0 && !take(sp, ",")) || n == MOCK_MAX_ARGS ||
+                (kind = script_atom(sp, &s, &len, &number)) == 0)
+            {
+                while (n > 0)
+                    free(call->argv[--n]);
+                free(call);
+                return -1;
+            }
+            if (kind == 2)
+            {
+                len = sprintf(digits, "%lld", number);
+                s = digits;
+            }
+            call->argv[n] = dup_bytes(s, len);
+            call->argl[n] = len;
+        }
+        call->argc = n;
+        if (n == 0)
+            reply_fmt(r, "-ERR Please specify at least one argument for this redis lib call\r\n");
+        else if (sp->run)
+            run_command(r, call);
+        else
+            reply_ok(r);
+        while (n > 0)
+            free(call->argv[--n]);
+        free(call);
+        return 0;
+    }
+    if (take(sp, "{"))
+    {
+        for (n = 0; !take(sp, "}"); n++)
+        {
+            if ((n > 0 && !take(sp, ",")) || script_value(sp, &items) != 0)
+            {
+                free(items.buf);
+                return -1;
+            }
+        }
+        reply_array(r, n);
+        reply_raw(r, items.buf, items.len);
+        free(items.buf);
+        return 0;
+    }
+    kind = script_atom(sp, &s, &len, &number);
+    if (kind == 1)
+        reply_bulk(r, s, len);
+    else if (kind == 2)
+        reply_int(r, number);
+    return kind == 0 ? -1 : 0;
+}
+
+/**
+ * Function: filter_passes
+ * Description: The predicate of scan_filter: EQ, PREFIX, RANGE (numeric,
+ *              '' for an open bound) or none.
+ */
+static int filter_passes(const MockCommand *c, int a, const char *value, size_t len)
+{
+    const char *op = c->argv[a + 4], *low = c->argv[a + 5], *high = c->argv[a + 6];
+    char text[64], *end;
+    double n;
+
+    if (strcmp(op, "EQ") == 0)
+        return len == c->argl[a + 5] && memcmp(value, low, len) == 0;
+    if (strcmp(op, "PREFIX") == 0)
+        return len >= c->argl[a + 5] && memcmp(value, low, c->argl[a + 5]) == 0;
+    if (strcmp(op, "RANGE") != 0)
+        return 1;
+    if (len == 0 || len >= sizeof(text))
+        return 0;
+    memcpy(text, value, len);
+    text[len] = '\0';
+    n = strtod(text, &end);
+    return *end == '\0' && (*low == '\0' || n >= atof(low)) && (*high == '\0' || n <= atof(high));
+}
+
+/**
+ * Function: scan_filter
+ * Description: Stands in for lua/scan_filter.lua (REDIS_SCAN_FILTER),
+ *              which the mock cannot run: one SCAN batch filtered on a
+ *              predicate, with the same arguments, reply and COUNT halving.
+ */
+static void scan_filter(MockReply *r, const MockCommand *c, int a)
+{
+    const char *field = c->argv[a + 3];
+    size_t field_len = c->argl[a + 3], len;
+    long long cursor, count, budget, next, pos, size;
+    long elements, b, i, f;
+    MockReply out;
+    MockKey *it;
+    const char *value;
+    char cur[32];
+    int n;
+
+    if (c->argc < a + 8 || arg_long(c, a, &cursor) != 0 || arg_long(c, a + 2, &count) != 0 ||
+        arg_long(c, a + 7, &budget) != 0 || count < 1)
+    {
+        reply_fmt(r, "-ERR user_script:1: bad arguments to the scan filter\r\n");
+        return;
+    }
+    for (;;)
+    {
+        memset(&out, 0, sizeof(out));
+        elements = 0;
+        size = 64;
+        next = cursor;
+        pos = 0;
+        for (b = 0; b < MOCK_BUCKETS && next < cursor + count; b++)
+        {
+            for (it = buckets[b]; it != NULL && next < cursor + count; it = it->next, pos++)
+            {
+                if (pos < cursor)
+                    continue;
+                next++;
+                if (!glob_match(c->argv[a + 1], c->argl[a + 1], it->name, it->len))
+                    continue;
+                if (field_len == 0 && it->type == TYPE_STRING)
+                    f = 0;
+                else if (field_len == 0 || it->type != TYPE_HASH || (f = find_field(it, field, field_len)) < 0)
+                    continue;
+                value = it->items[f].value;
+                len = it->items[f].value_len;
+                if (!filter_passes(c, a, value, len))
+                    continue;
+
+                reply_bulk(&out, it->name, it->len);
+                size += (long long)it->len + 40;
+                elements += 2;
+                if (field_len == 0 || c->argc == a + 8)
+                {
+                    reply_int(&out, 1);
+                    if (field_len == 0)
+                        reply_nil(&out);
+                    else
+                        reply_bulk(&out, field, field_len);
+                    reply_bulk(&out, value, len);
+                    size += (long long)field_len + len + 32;
+                    elements += 2;
+                }
+                else if (strcmp(c->argv[a + 8], "*") == 0)
+                {
+                    reply_int(&out, it->count);
+                    for (i = 0; i < it->count; i++)
+                    {
+                        reply_bulk(&out, it->items[i].field, it->items[i].field_len);
+                        reply_bulk(&out, it->items[i].value, it->items[i].value_len);
+                        size += (long long)(it->items[i].field_len + it->items[i].value_len) + 32;
+                    }
+                    elements += 2 * it->count;
+                }
+                else
+                {
+                    reply_int(&out, c->argc - a - 8);
+                    for (i = a + 8; i < c->argc; i++)
+                    {
+                        reply_bulk(&out, c->argv[i], c->argl[i]);
+                        size += (long long)c->argl[i] + 16;
+                        if ((f = find_field(it, c->argv[i], c->argl[i])) < 0)
+                        {
+                            reply_nil(&out);
+                            size += 16;
+                        }
+                        else
+                        {
+                            reply_bulk(&out, it->items[f].value, it->items[f].value_len);
+                            size += (long long)it->items[f].value_len + 16;
+                        }
+                    }
+                    elements += 2 * (c->argc - a - 8);
+                }
+            }
+        }
+        if (next - cursor < count || next >= key_count)
+            next = 0;
+
+        if (size <= budget)
+        {
+            reply_array(r, elements + 1);
+            n = snprintf(cur, sizeof(cur), "%lld", next);
+            reply_bulk(r, cur, n);
+            if (out.len > 0)
+                reply_raw(r, out.buf, out.len);
+            free(out.buf);
+            return;
+        }
+        free(out.buf);
+        if (count <= 1)
+        {
+            reply_fmt(r, "-ERR scan filter: one key does not fit in the reply budget\r\n");
+            return;
+        }
+        count /= 2;
+    }
+}
+
+/**
+ * Function: list_pop
+ * Description: Stands in for lua/list_pop.lua (REDIS_LPOP_N, REDIS_RPOP_N,
+ *              REDIS_LMPOP): pops up to COUNT elements of the first
+ *              non-empty list, as many as fit in the reply budget.
+ */
+static void list_pop(MockReply *r, const MockCommand *c, long keys)
+{
+    long long count, budget, size;
+    long a = 3 + keys, take, i;
+    int left;
+    MockKey *k = NULL;
+
+    if (c->argc < a + 3 || arg_long(c, a + 1, &count) != 0 || arg_long(c, a + 2, &budget) != 0)
+    {
+        reply_fmt(r, "-ERR user_script:1: bad arguments to the list pop\r\n");
+        return;
+    }
+    left = strcmp(c->argv[a], "LEFT") == 0;
+    if (count > budget / 16)
+        count = budget / 16;
+    for (i = 3; i < a && k == NULL; i++)
+    {
+        k = find_key(c->argv[i], c->argl[i]);
+        if (k != NULL && k->type != TYPE_LIST)
+        {
+            reply_wrongtype(r);
+            return;
+        }
+    }
+    if (k == NULL)
+    {
+        reply_nil(r);
+        return;
+    }
+
+    size = 64 + (long long)k->len;
+    for (take = 0; take < count && take < k->count; take++)
+    {
+        size += (long long)k->items[left ? take : k->count - 1 - take].value_len + 16;
+        if (size > budget)
+            break;
+    }
+    if (take == 0)
+    {
+        reply_fmt(r, "-ERR list pop: the next element does not fit in the reply budget\r\n");
+        return;
+    }
+    reply_array(r, 2);
+    reply_bulk(r, k->name, k->len);
+    reply_array(r, take);
+    for (i = 0; i < take; i++)
+    {
+        long from = left ? 0 : k->count - 1;
+        reply_bulk(r, k->items[from].value, k->items[from].value_len);
+        remove_item(k, from);
+    }
+    drop_if_empty(k);
+}
+
+/**
+ * Function: run_script
+ * Description: Runs SCRIPT LOAD | EXISTS | FLUSH, EVAL and EVALSHA. A
+ *              script is "return <value>", where a value is
+ *              redis.call(<atoms>), {<values>} or an atom: a quoted
+ *              string, an integer, KEYS[n] or ARGV[n].
+ */
+static void run_script(MockReply *r, const MockCommand *c)
+{
+    MockScript sp = {0};
+    MockReply out = {0};
+    char sha[41];
+    const char *body = NULL;
+    long long keys;
+    int i, filter;
+
+    if (arg_is(c, 0, "SCRIPT") && (arg_is(c, 1, "FLUSH") || arg_is(c, 1, "EXISTS")))
+    {
+        if (arg_is(c, 1, "FLUSH"))
+        {
+            while (script_count > 0)
+            {
+                script_count--;
+                free(script_sha[script_count]);
+                free(script_body[script_count]);
+            }
+            reply_ok(r);
+            return;
+        }
+        reply_array(r, c->argc - 2);
+        for (i = 2; i < c->argc; i++)
+        {
+            int found = 0, j;
+            for (j = 0; j < script_count && !found; j++)
+                found = strcasecmp(script_sha[j], c->argv[i]) == 0;
+            reply_int(r, found);
+        }
+        return;
+    }
+    if (arg_is(c, 0, "SCRIPT") && !arg_is(c, 1, "LOAD"))
+    {
+        reply_fmt(r, "-ERR unknown subcommand '%.32s'\r\n", c->argc > 1 ? c->argv[1] : "");
+        return;
+    }
+    if (c->argc < 3)
+    {
+        reply_fmt(r, "-ERR wrong number of arguments for '%s' command\r\n", c->argv[0]);
+        return;
+    }
+
+    // The body: given, or looked up by SHA1
+    if (arg_is(c, 0, "EVALSHA"))
+    {
+        for (i = 0; i < script_count && body == NULL; i++)
+        {
+            if (strcasecmp(script_sha[i], c->argv[1]) == 0)
+                body = script_body[i];
+        }
+        if (body == NULL)
+        {
+            reply_fmt(r, "-NOSCRIPT No matching script. Please use EVAL.\r\n");
+            return;
+        }
+    }
+    else
+    {
+        body = arg_is(c, 0, "SCRIPT") ? c->argv[2] : c->argv[1];
+    }
+
+    // Compile: check the syntax without running
+    filter = strncmp(body, MOCK_SCAN_FILTER, strlen(MOCK_SCAN_FILTER)) == 0 ? 1
+             : strncmp(body, MOCK_LIST_POP, strlen(MOCK_LIST_POP)) == 0    ? 2
+                                                                         : 0;
+    sp.p = body;
+    sp.c = c;
+    if (!filter && (!take(&sp, "return") || script_value(&sp, &out) != 0 || (skip_blanks(&sp), *sp.p != '\0')))
+    {
+        free(out.buf);
+        reply_fmt(r, "-ERR Error compiling script (mock): only 'return redis.call(...)' and "
+                     "'return {...}' are supported\r\n");
+        return;
+    }
+    free(out.buf);
+
+    if (arg_is(c, 0, "SCRIPT") || arg_is(c, 0, "EVAL"))
+    {
+        sha1_hex(body, strlen(body), sha);
+        for (i = 0; i < script_count && strcmp(script_sha[i], sha) != 0; i++)
+            ;
+        if (i == script_count && script_count < MOCK_MAX_SCRIPTS)
+        {
+            script_sha[script_count] = dup_bytes(sha, 40);
+            script_body[script_count++] = dup_bytes(body, strlen(body));
+        }
+        if (arg_is(c, 0, "SCRIPT"))
+        {
+            reply_bulk(r, sha, 40);
+            return;
+        }
+    }
+
+    if (arg_long(c, 2, &keys) != 0 || keys < 0 || keys > c->argc - 3)
+    {
+        reply_fmt(r, "-ERR Number of keys can't be greater than number of args\r\n");
+        return;
+    }
+    if (filter == 1)
+    {
+        scan_filter(r, c, 3 + (int)keys);
+        return;
+    }
+    if (filter == 2)
+    {
+        list_pop(r, c, (long)keys);
+        return;
+    }
+    sp.p = body;
+    sp.keys = (long)keys;
+    sp.run = 1;
+    take(&sp, "return");
+    script_value(&sp, r);
+}
+
+/**********************************************************************/
+/* Fault Injection */
+/**********************************************************************/
+
+/**
+ * Function: counted_command
+ * Description: Tells whether a command counts for fault injection.
+ *              Handshake, cluster discovery and MOCK commands do not, so
+ *              faults land on the same data commands however many
+ *              connections the client opens.
+ */
+static int counted_command(const MockCommand *c)
+{
+    static const char *skip[] = {"HELLO", "AUTH", "SELECT", "CLIENT", "ASKING", "CLUSTER", "MOCK", NULL};
+    int i;
+
+    for (i = 0; skip[i] != NULL; i++)
+    {
+        if (arg_is(c, 0, skip[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Function: key_slot
+ * Description: Redis Cluster hash slot of a key (CRC16/XMODEM, hash tags).
+ */
+static int key_slot(const char *key, size_t len)
+{
+    unsigned short crc = 0;
+    size_t i, start = 0, end = len;
+    int bit;
+
+    for (i = 0; i < len && key[i] != '{'; i++)
+        ;
+    if (i < len)
+    {
+        size_t j;
+        for (j = i + 1; j < len && key[j] != '}'; j++)
+            ;
+        if (j < len && j > i + 1)
+        {
+            start = i + 1;
+            end = j;
+        }
+    }
+    for (i = start; i < end; i++)
+    {
+        crc ^= (unsigned short)((unsigned char)key[i] << 8);
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x1021) : (unsigned short)(crc << 1);
+    }
+    return crc & 16383;
+}
+
+/**
+ * Function: pick_fault
+ * Description: Counts a data command and returns the fault to inject on it.
+ * Returns:
+ *   - FAULT_* value, or -1 for a normal reply.
+ */
+static int pick_fault(const MockCommand *c, long *arg)
+{
+    unsigned long n;
+    int f;
+
+    if (!counted_command(c))
+        return -1;
+    n = ++data_commands;
+    for (f = 0; f < FAULT_COUNT; f++)
+    {
+        if (faults[f].every > 0 && n % (unsigned long)faults[f].every == 0)
+        {
+            *arg = faults[f].arg > 0 ? faults[f].arg : faults[f].default_arg;
+            return f;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Function: set_fault
+ * Description: Sets how often a fault is injected (every = 0 turns it off).
+ * Returns:
+ *   - 0 on success, -1 for an unknown fault name.
+ */
+static int set_fault(const char *name, long every, long arg)
+{
+    int f;
+
+    for (f = 0; f < FAULT_COUNT; f++)
+    {
+        if (strcasecmp(faults[f].name, name) == 0)
+        {
+            faults[f].every = every;
+            faults[f].arg = arg;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Function: run_mock
+ * Description: Runs a MOCK control command:
+ *              MOCK FAULT <name> <every> [arg] | MOCK DELAY <usec> [jitter]
+ *              | MOCK CHUNK <bytes> [usec] | MOCK COUNT | MOCK CLEAR.
+ */
+static void run_mock(MockReply *r, const MockCommand *c)
+{
+    long long a = 0, b = 0;
+
+    if (arg_is(c, 1, "FAULT") && c->argc >= 4 && arg_long(c, 3, &a) == 0 &&
+        (c->argc < 5 || arg_long(c, 4, &b) == 0))
+    {
+        if (set_fault(c->argv[2], (long)a, (long)b) != 0)
+            reply_fmt(r, "-ERR unknown fault '%.32s'\r\n", c->argv[2]);
+        else
+            reply_ok(r);
+    }
+    else if (arg_is(c, 1, "DELAY") && arg_long(c, 2, &a) == 0 && (c->argc < 4 || arg_long(c, 3, &b) == 0))
+    {
+        delay_us = (long)a;
+        jitter_us = (long)b;
+        reply_ok(r);
+    }
+    else if (arg_is(c, 1, "CHUNK") && arg_long(c, 2, &a) == 0 && (c->argc < 4 || arg_long(c, 3, &b) == 0))
+    {
+        chunk_bytes = (long)a;
+        chunk_us = (long)b;
+        reply_ok(r);
+    }
+    else if (arg_is(c, 1, "COUNT"))
+    {
+        reply_int(r, (long long)data_commands);
+    }
+    else if (arg_is(c, 1, "CLEAR"))
+    {
+        for (a = 0; a < FAULT_COUNT; a++)
+            faults[a].every = 0;
+        delay_us = jitter_us = chunk_bytes = chunk_us = 0;
+        data_commands = 0;
+        reply_ok(r);
+    }
+    else
+    {
+        reply_fmt(r, "-ERR usage: MOCK FAULT <name> <every> [arg] | DELAY <usec> [jitter] | "
+                     "CHUNK <bytes> [usec] | COUNT | CLEAR\r\n");
+    }
+}
+
+/**********************************************************************/
+/* Transactions */
+/**********************************************************************/
+
+// MULTI/EXEC and WATCH state of one connection
+typedef struct
+{
+    int multi;         // Between MULTI and EXEC
+    int dirty;         // A command was rejected while queued: EXEC aborts
+    MockReply queued;  // Commands queued since MULTI, as received
+    long queued_count;
+    int watch_count;
+    char *watch_name[MOCK_MAX_WATCH];
+    size_t watch_len[MOCK_MAX_WATCH];
+    unsigned long long watch_digest[MOCK_MAX_WATCH]; // Content when watched
+} MockSession;
+
+/**
+ * Function: key_digest
+ * Description: FNV-1a digest of the content of a key, 0 if it does not
+ *              exist. WATCH compares digests instead of tracking writes, so
+ *              a write that leaves the content unchanged goes unnoticed.
+ */
+static unsigned long long key_digest(const char *name, size_t len)
+{
+    MockKey *k = find_key(name, len);
+    unsigned long long h = 14695981039346656037ULL;
+    const unsigned char *p;
+    size_t n;
+    long i;
+
+#define MIX(data, size)                                   \
+    for (p = (const unsigned char *)(data), n = (size); n > 0; n--) \
+        h = (h ^ *p++) * 1099511628211ULL;
+
+    if (k == NULL)
+        return 0;
+    MIX(&k->type, sizeof(k->type));
+    MIX(&k->expire_ms, sizeof(k->expire_ms));
+    for (i = 0; i < k->count; i++)
+    {
+        MIX(k->items[i].field, k->items[i].field != NULL ? k->items[i].field_len : 0);
+        MIX(k->items[i].value, k->items[i].value != NULL ? k->items[i].value_len : 0);
+        MIX(&k->items[i].score, sizeof(double));
+        MIX("|", 1);
+    }
+#undef MIX
+    return h != 0 ? h : 1;
+}
+
+/**
+ * Function: unwatch
+ * Description: Forgets the keys watched by a connection.
+ */
+static void unwatch(MockSession *s)
+{
+    while (s->watch_count > 0)
+        free(s->watch_name[--s->watch_count]);
+}
+
+static long parse_command(char *buf, size_t len, MockCommand *c);
+
+/**
+ * Function: run_session
+ * Description: Runs MULTI, EXEC, DISCARD, WATCH and UNWATCH, and queues
+ *              the other commands between MULTI and EXEC. Caller holds
+ *              mock_lock, so EXEC runs the queue atomically.
+ * Parameters:
+ *   - raw: The command as received, kept for EXEC.
+ *   - tmp: Work command for parsing the queue.
+ * Returns:
+ *   - 1 if the command was handled, 0 to run it normally.
+ */
+static int run_session(MockSession *s, MockReply *r, const MockCommand *c, const char *raw,
+                       size_t raw_len, MockCommand *tmp)
+{
+    size_t pos;
+    long used;
+    int i;
+
+    if (arg_is(c, 0, "MULTI"))
+    {
+        if (s->multi)
+        {
+            reply_fmt(r, "-ERR MULTI calls can not be nested\r\n");
+            return 1;
+        }
+        s->multi = 1;
+        s->dirty = 0;
+        s->queued.len = 0;
+        s->queued_count = 0;
+        reply_ok(r);
+    }
+    else if (arg_is(c, 0, "EXEC") || arg_is(c, 0, "DISCARD"))
+    {
+        if (!s->multi)
+        {
+            reply_fmt(r, "-ERR %s without MULTI\r\n", arg_is(c, 0, "EXEC") ? "EXEC" : "DISCARD");
+            return 1;
+        }
+        s->multi = 0;
+        if (arg_is(c, 0, "DISCARD"))
+        {
+            reply_ok(r);
+        }
+        else if (s->dirty)
+        {
+            reply_fmt(r, "-EXECABORT Transaction discarded because of previous errors.\r\n");
+        }
+        else
+        {
+            for (i = 0; i < s->watch_count; i++)
+            {
+                if (key_digest(s->watch_name[i], s->watch_len[i]) != s->watch_digest[i])
+                    break;
+            }
+            if (i < s->watch_count)
+            {
+                reply_raw(r, "*-1\r\n", 5); // A watched key changed
+            }
+            else
+            {
+                reply_array(r, s->queued_count);
+                for (pos = 0; pos < s->queued.len; pos += used)
+                {
+                    used = parse_command(s->queued.buf + pos, s->queued.len - pos, tmp);
+                    if (used <= 0)
+                        break;
+                    run_command(r, tmp);
+                }
+            }
+        }
+        unwatch(s);
+    }
+    else if (arg_is(c, 0, "WATCH"))
+    {
+        if (s->multi)
+        {
+            reply_fmt(r, "-ERR WATCH inside MULTI is not allowed\r\n");
+            return 1;
+        }
+        for (i = 1; i < c->argc && s->watch_count < MOCK_MAX_WATCH; i++)
+        {
+            s->watch_name[s->watch_count] = dup_bytes(c->argv[i], c->argl[i]);
+            s->watch_len[s->watch_count] = c->argl[i];
+            s->watch_digest[s->watch_count++] = key_digest(c->argv[i], c->argl[i]);
+        }
+        reply_ok(r);
+    }
+    else if (arg_is(c, 0, "UNWATCH"))
+    {
+        unwatch(s);
+        reply_ok(r);
+    }
+    else if (s->multi)
+    {
+        reply_raw(&s->queued, raw, raw_len);
+        s->queued_count++;
+        reply_raw(r, "+QUEUED\r\n", 9);
+    }
+    else
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/**********************************************************************/
+/* Connections */
+/**********************************************************************/
+
+/**
+ * Function: reset_connection
+ * Description: Closes a socket with an RST instead of a FIN.
+ */
+static void reset_connection(int fd)
+{
+    struct linger lg = {1, 0};
+
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(fd);
+}
+
+/**
+ * Function: send_reply
+ * Description: Writes a reply, split into chunk_bytes segments if set.
+ * Returns:
+ *   - 0 on success, -1 if the client went away.
+ */
+static int send_reply(int fd, const char *buf, size_t len, long chunk, long pause)
+{
+    size_t sent = 0, part;
+    ssize_t rc;
+
+    while (sent < len)
+    {
+        part = chunk > 0 && (size_t)chunk < len - sent ? (size_t)chunk : len - sent;
+        rc = send(fd, buf + sent, part, MSG_NOSIGNAL);
+        if (rc <= 0)
+            return -1;
+        sent += rc;
+        if (chunk > 0 && pause > 0 && sent < len)
+            usleep(pause);
+    }
+    return 0;
+}
+
+/**
+ * Function: parse_command
+ * Description: Parses one RESP array of bulk strings from the input buffer.
+ *              Arguments are null-terminated in place.
+ * Returns:
+ *   - Bytes consumed, 0 if the command is incomplete, -1 on protocol error.
+ */
+static long parse_command(char *buf, size_t len, MockCommand *c)
+{
+    size_t pos = 0;
+    long n, l, i;
+    char *end;
+
+    if (len == 0)
+        return 0;
+    if (buf[0] != '*')
+        return -1;
+    end = memchr(buf, '\n', len);
+    if (end == NULL)
+        return 0;
+    n = strtol(buf + 1, NULL, 10);
+    if (n < 1 || n > MOCK_MAX_ARGS)
+        return -1;
+    pos = end - buf + 1;
+    for (i = 0; i < n; i++)
+    {
+        if (pos >= len)
+            return 0;
+        if (buf[pos] != '$')
+            return -1;
+        end = memchr(buf + pos, '\n', len - pos);
+        if (end == NULL)
+            return 0;
+        l = strtol(buf + pos + 1, NULL, 10);
+        if (l < 0)
+            return -1;
+        pos = end - buf + 1;
+        if (pos + l + 2 > len)
+            return 0;
+        c->argv[i] = buf + pos;
+        c->argl[i] = l;
+        pos += l + 2;
+    }
+    c->argc = (int)n;
+    for (i = 0; i < n; i++)
+        c->argv[i][c->argl[i]] = '\0'; // Overwrites the '\r' after each argument
+    return (long)pos;
+}
+
+/**
+ * Function: wait_for_push
+ * Description: Parks a BLPOP, BRPOP or BLMOVE that found every list empty
+ *              until another connection changes the data set or the
+ *              command's timeout (0 = none) expires, then runs it again.
+ *              Caller holds mock_lock, released while waiting.
+ */
+static void wait_for_push(MockReply *r, const MockCommand *c)
+{
+    struct timespec deadline;
+    double timeout;
+    int exclusive, rc = 0;
+
+    if (!arg_is(c, 0, "BLPOP") && !arg_is(c, 0, "BRPOP") && !arg_is(c, 0, "BLMOVE"))
+        return;
+    if (r->len != 5 || memcmp(r->buf, "*-1\r\n", 5) != 0)
+        return;
+    arg_score(c, c->argc - 1, &timeout, &exclusive); // Checked by run_command
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t)timeout;
+    deadline.tv_nsec += (long)((timeout - (time_t)timeout) * 1e9);
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (rc != ETIMEDOUT && r->len == 5 && memcmp(r->buf, "*-1\r\n", 5) == 0)
+    {
+        rc = timeout > 0 ? pthread_cond_timedwait(&mock_changed, &mock_lock, &deadline)
+                         : pthread_cond_wait(&mock_changed, &mock_lock);
+        r->len = 0;
+        run_command(r, c);
+    }
+}
+
+/**
+ * Function: client_thread
+ * Description: Serves one client connection.
+ */
+static void *client_thread(void *arg)
+{
+    int fd = (int)(long)arg, fault, one = 1;
+    char *in = NULL;
+    size_t in_len = 0, in_cap = 0;
+    long consumed, fault_arg = 0, wait_us, chunk, pause;
+    MockCommand *c = malloc(sizeof(MockCommand)), *tmp = malloc(sizeof(MockCommand));
+    MockSession session = {0};
+    MockReply r = {0};
+    ssize_t got;
+    unsigned int seed = (unsigned int)fd * 2654435761u;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    for (;;)
+    {
+        if (in_cap - in_len < 65536)
+        {
+            in_cap = in_cap ? in_cap * 2 : 131072;
+            in = realloc(in, in_cap);
+        }
+        got = recv(fd, in + in_len, in_cap - in_len, 0);
+        if (got <= 0)
+            break;
+        in_len += got;
+
+        while ((consumed = parse_command(in, in_len, c)) > 0)
+        {
+            r.len = 0;
+            pthread_mutex_lock(&mock_lock);
+            fault = pick_fault(c, &fault_arg);
+            if (verbose)
+                fprintf(stderr, "fd %d #%lu %s%s%s\n", fd, data_commands, c->argv[0],
+                        fault >= 0 ? " -> " : "", fault >= 0 ? faults[fault].name : "");
+            if (arg_is(c, 0, "MOCK"))
+                run_mock(&r, c);
+            else if (fault == FAULT_ERR)
+            {
+                reply_fmt(&r, "-ERR injected fault\r\n");
+                session.dirty |= session.multi; // Rejected while queued
+            }
+            else if (fault == FAULT_MOVED || fault == FAULT_ASK)
+                reply_fmt(&r, "-%s %d 127.0.0.1:%d\r\n", fault == FAULT_MOVED ? "MOVED" : "ASK",
+                          c->argc > 1 ? key_slot(c->argv[1], c->argl[1]) : 0, port);
+            else if (fault == FAULT_LOADING)
+                reply_fmt(&r, "-LOADING Redis is loading the dataset in memory\r\n");
+            else if (fault != FAULT_RESET && fault != FAULT_GIANT &&
+                     !run_session(&session, &r, c, in, consumed, tmp))
+            {
+                run_command(&r, c);
+                wait_for_push(&r, c);
+            }
+            pthread_cond_broadcast(&mock_changed);
+            wait_us = delay_us + (jitter_us > 0 ? (long)(rand_r(&seed) % (jitter_us + 1)) : 0);
+            chunk = chunk_bytes;
+            pause = chunk_us;
+            pthread_mutex_unlock(&mock_lock);
+
+            if (fault == FAULT_GIANT)
+            {
+                // Bulk string of fault_arg bytes in place of the real reply
+                reply_fmt(&r, "$%ld\r\n", fault_arg);
+                r.buf = realloc(r.buf, r.len + fault_arg + 2);
+                memset(r.buf + r.len, 'x', fault_arg);
+                r.len += fault_arg;
+                r.cap = r.len + 2;
+                reply_raw(&r, "\r\n", 2);
+            }
+            if (fault == FAULT_RESET)
+                goto reset;
+            if (fault == FAULT_STALL)
+                usleep(fault_arg);
+            if (wait_us > 0)
+                usleep(wait_us);
+            if (fault == FAULT_PARTIAL)
+            {
+                send_reply(fd, r.buf, r.len / 2 > 0 ? r.len / 2 : 1, chunk, pause);
+                goto reset;
+            }
+            if (send_reply(fd, r.buf, r.len, chunk, pause) != 0)
+                goto done;
+
+            memmove(in, in + consumed, in_len - consumed);
+            in_len -= consumed;
+        }
+        if (consumed < 0)
+        {
+            send_reply(fd, "-ERR Protocol error\r\n", 21, 0, 0);
+            break;
+        }
+    }
+done:
+    close(fd);
+    goto out;
+reset:
+    reset_connection(fd);
+out:
+    unwatch(&session);
+    free(session.queued.buf);
+    free(in);
+    free(r.buf);
+    free(c);
+    free(tmp);
+    return NULL;
+}
+
+/**********************************************************************/
+/* Main */
+/**********************************************************************/
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: redismock [-p port] [-d usec] [-j usec] [-c bytes] [-C usec] [-f name:every[:arg]]... [-v]\n"
+            "  -p  Port to listen on on 127.0.0.1 (default 6390)\n"
+            "  -d  Delay before every reply, microseconds\n"
+            "  -j  Random extra delay, 0..usec\n"
+            "  -c  Split replies into segments of this many bytes\n"
+            "  -C  Pause between segments, microseconds\n"
+            "  -f  Fault on every Nth data command: err, moved, ask, loading, reset,\n"
+            "      partial, stall[:usec] (default 2000000), giant[:bytes] (default 1048576)\n"
+            "  -v  Log every command to stderr\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    pthread_t thread;
+    int listener, fd, opt, one = 1;
+    char name[32];
+    long every, arg;
+
+    while ((opt = getopt(argc, argv, "p:d:j:c:C:f:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'd':
+            delay_us = atol(optarg);
+            break;
+        case 'j':
+            jitter_us = atol(optarg);
+            break;
+        case 'c':
+            chunk_bytes = atol(optarg);
+            break;
+        case 'C':
+            chunk_us = atol(optarg);
+            break;
+        case 'f':
+            arg = 0;
+            if (sscanf(optarg, "%31[^:]:%ld:%ld", name, &every, &arg) < 2 || set_fault(name, every, arg) != 0)
+            {
+                fprintf(stderr, "redismock: bad fault '%s'\n", optarg);
+                usage();
+                return 1;
+            }
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 128) != 0)
+    {
+        fprintf(stderr, "redismock: cannot listen on port %d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "redismock listening on 127.0.0.1:%d\n", port);
+
+    for (;;)
+    {
+        fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+            continue;
+        if (pthread_create(&thread, NULL, client_thread, (void *)(long)fd) != 0)
+        {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return 0;
+}
@@ -0,0 +1,328 @@
+/******************************************************************************
+ * File: redisstress.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Regression run of counter coalescing and write-behind on
+ *              Linux, built and run against redismock with gmake
+ *              stress-linux. It keeps both going past a full counter
+ *              table and a full write-behind queue, where the drain of
+ *              the table and the flusher thread must not wait for each
+ *              other:
+ *                - table: more 250-byte counter keys than
+ *                  REDIS_COALESCE_KEYS, so a full table is drained into
+ *                  more than REDIS_WRITE_BEHIND_QUEUE bytes;
+ *                - queue: 4 KB write-behind SETs between the increments,
+ *                  so the queue fills while counters are drained.
+ *              Every total is read back and compared. A run that does not
+ *              finish within the time limit is reported as a hang.
+ *
+ *              Usage: redisstress [seconds]
+ *              The server is the one configured in .env (REDIS_IP/REDIS_PORT).
+ *              Keys are written under the "stress:" prefix.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define STRESS_KEY 250       // Length of the counter keys
+#define STRESS_KEYS 5000     // Counter keys, more than REDIS_COALESCE_KEYS
+#define STRESS_PASSES 3      // Increments of each key in the table run
+#define STRESS_VALUE 4096    // Size of the write-behind SET values
+#define STRESS_VALUES 256    // Keys of the SET values
+#define STRESS_OPS 60000     // Increments of the queue run
+#define STRESS_TIMEOUT 120   // Default time limit in seconds
+
+void SQL_API_FN getRedisValue(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *value,
+                              SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd,
+                              char *sqlstate, char *funcname, char *specname, char *msgtext,
+                              short *sqlcode, SQLUDF_NULLIND *nullind);
+void SQL_API_FN setRedisValue(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *value, SQLUDF_VARCHAR *response,
+                              SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd,
+                              SQLUDF_NULLIND *responseInd,
+                              char *sqlstate, char *funcname, char *specname, char *msgtext,
+                              short *sqlcode, SQLUDF_NULLIND *nullind);
+void SQL_API_FN incrbyRedisValue(SQLUDF_VARCHAR *key, SQLUDF_BIGINT *increment, SQLUDF_BIGINT *result,
+                                 SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *incrInd,
+                                 SQLUDF_NULLIND *resultInd,
+                                 char *sqlstate, char *funcname, char *specname, char *msgtext,
+                                 short *sqlcode, SQLUDF_NULLIND *nullind);
+void SQL_API_FN coalesceRedis(SQLUDF_VARCHAR *mode, SQLUDF_VARCHAR *value,
+                              SQLUDF_NULLIND *modeInd, SQLUDF_NULLIND *valueInd,
+                              char *sqlstate, char *funcname, char *specname, char *msgtext,
+                              short *sqlcode, SQLUDF_NULLIND *nullind);
+void SQL_API_FN writeBehindRedis(SQLUDF_VARCHAR *mode, SQLUDF_VARCHAR *value,
+                                 SQLUDF_NULLIND *modeInd, SQLUDF_NULLIND *valueInd,
+                                 char *sqlstate, char *funcname, char *specname, char *msgtext,
+                                 short *sqlcode, SQLUDF_NULLIND *nullind);
+void SQL_API_FN flushRedisWrites(SQLUDF_BIGINT *value, SQLUDF_NULLIND *valueInd,
+                                 char *sqlstate, char *funcname, char *specname, char *msgtext,
+                                 short *sqlcode, SQLUDF_NULLIND *nullind);
+
+static const char *phase = "start"; // Run in progress, for the hang report
+
+/**********************************************************************/
+/* Helpers */
+/**********************************************************************/
+
+/**
+ * Function: on_timeout
+ * Description: SIGALRM handler: the run is stuck.
+ */
+static void on_timeout(int sig)
+{
+    char text[128];
+    int len = snprintf(text, sizeof(text), "FAIL %s: no progress before the time limit (hang)\n", phase);
+
+    (void)sig;
+    if (write(STDOUT_FILENO, text, len) < 0)
+        _exit(2);
+    _exit(2);
+}
+
+/**
+ * Function: to_ebcdic
+ * Description: Copies a native string into a UDF input buffer (EBCDIC).
+ */
+static void to_ebcdic(const char *native, char *out)
+{
+    size_t len = strlen(native);
+
+    ConvertToEBCDIC((char *)native, len, out, len);
+    out[len] = '\0';
+}
+
+/**
+ * Function: report
+ * Description: Prints the error of a failed call.
+ * Returns:
+ *   - 1 if the call failed, 0 otherwise.
+ */
+static int report(const char *what, const char *sqlstate, const char *msgtext)
+{
+    char text[71];
+    size_t len;
+
+    if (strncmp(sqlstate, "00000", 5) == 0)
+        return 0;
+    len = strnlen(msgtext, 70);
+    ConvertToASCII((char *)msgtext, len, text, len);
+    text[len] = '\0';
+    printf("FAIL %s %s: %.5s %s\n", phase, what, sqlstate, text);
+    return 1;
+}
+
+/**
+ * Function: counter_key
+ * Description: Builds the STRESS_KEY-byte key of a counter (EBCDIC).
+ */
+static void counter_key(int n, char *out)
+{
+    char native[STRESS_KEY + 1];
+    int len = sprintf(native, "stress:c:%d:", n);
+
+    memset(native + len, 'x', STRESS_KEY - len);
+    native[STRESS_KEY] = '\0';
+    to_ebcdic(native, out);
+}
+
+/**
+ * Function: set_mode
+ * Description: Switches coalescing or write-behind on or off.
+ */
+static int set_mode(int coalesce, const char *mode)
+{
+    char in[4], out[4], sqlstate[6] = "00000", msgtext[71] = "";
+    short inInd = 0, outInd;
+
+    to_ebcdic(mode, in);
+    if (coalesce)
+        coalesceRedis(in, out, &inInd, &outInd, sqlstate, NULL, NULL, msgtext, NULL, NULL);
+    else
+        writeBehindRedis(in, out, &inInd, &outInd, sqlstate, NULL, NULL, msgtext, NULL, NULL);
+    return report(coalesce ? "REDIS_COALESCE" : "REDIS_WRITE_BEHIND", sqlstate, msgtext);
+}
+
+/**
+ * Function: increment
+ * Description: Adds a delta to a counter.
+ */
+static int increment(int n, long long delta)
+{
+    char key[STRESS_KEY + 1], sqlstate[6] = "00000", msgtext[71] = "";
+    long long result;
+    short keyInd = 0, incrInd = 0, resultInd;
+
+    counter_key(n, key);
+    incrbyRedisValue(key, &delta, &result, &keyInd, &incrInd, &resultInd,
+                     sqlstate, NULL, NULL, msgtext, NULL, NULL);
+    return report("REDIS_INCRBY", sqlstate, msgtext);
+}
+
+/**
+ * Function: flush
+ * Description: Waits for the queued writes and checks that none failed.
+ */
+static int flush(void)
+{
+    char sqlstate[6] = "00000", msgtext[71] = "";
+    long long failed = 0;
+    short failedInd;
+
+    flushRedisWrites(&failed, &failedInd, sqlstate, NULL, NULL, msgtext, NULL, NULL);
+    if (report("REDIS_FLUSH", sqlstate, msgtext))
+        return 1;
+    if (failed != 0)
+    {
+        printf("FAIL %s REDIS_FLUSH: %lld writes failed\n", phase, failed);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function: reset_totals
+ * Description: Sets the counters to 0, left over from an earlier run.
+ */
+static int reset_totals(void)
+{
+    char key[STRESS_KEY + 1], zero[2], response[129], sqlstate[6], msgtext[71];
+    short keyInd = 0, valueInd = 0, responseInd;
+    int n;
+
+    to_ebcdic("0", zero);
+    for (n = 0; n < STRESS_KEYS; n++)
+    {
+        counter_key(n, key);
+        strcpy(sqlstate, "00000");
+        setRedisValue(key, zero, response, &keyInd, &valueInd, &responseInd,
+                      sqlstate, NULL, NULL, msgtext, NULL, NULL);
+        if (report("REDIS_SET", sqlstate, msgtext))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function: check_totals
+ * Description: Reads the counters back and compares their sum.
+ */
+static int check_totals(long long expected)
+{
+    static char value[16371];
+    char key[STRESS_KEY + 1], native[32], sqlstate[6], msgtext[71];
+    long long total = 0;
+    short keyInd = 0, valueInd;
+    size_t len;
+    int n;
+
+    for (n = 0; n < STRESS_KEYS; n++)
+    {
+        counter_key(n, key);
+        strcpy(sqlstate, "00000");
+        getRedisValue(key, value, &keyInd, &valueInd, sqlstate, NULL, NULL, msgtext, NULL, NULL);
+        if (report("REDIS_GET", sqlstate, msgtext))
+            return 1;
+        if (valueInd < 0)
+            continue;
+        len = strlen(value);
+        if (len >= sizeof(native))
+            len = sizeof(native) - 1;
+        ConvertToASCII(value, len, native, len);
+        native[len] = '\0';
+        total += atoll(native);
+    }
+    if (total != expected)
+    {
+        printf("FAIL %s: counters add up to %lld, expected %lld\n", phase, total, expected);
+        return 1;
+    }
+    return 0;
+}
+
+/**********************************************************************/
+/* Runs */
+/**********************************************************************/
+
+/**
+ * Function: run_table
+ * Description: Fills the counter table several times over with long keys.
+ */
+static int run_table(void)
+{
+    int pass, n;
+
+    phase = "table";
+    if (reset_totals() || set_mode(1, "ON"))
+        return 1;
+    for (pass = 0; pass < STRESS_PASSES; pass++)
+    {
+        for (n = 0; n < STRESS_KEYS; n++)
+        {
+            if (increment(n, 1))
+                return 1;
+        }
+    }
+    if (flush() || set_mode(1, "OFF"))
+        return 1;
+    return check_totals((long long)STRESS_PASSES * STRESS_KEYS);
+}
+
+/**
+ * Function: run_queue
+ * Description: Interleaves write-behind SETs and coalesced increments.
+ */
+static int run_queue(void)
+{
+    static char value[STRESS_VALUE + 1];
+    char key[32], native[32], response[129], sqlstate[6], msgtext[71];
+    short keyInd = 0, valueInd = 0, responseInd;
+    int i;
+
+    phase = "queue";
+    for (i = 0; i < STRESS_VALUE; i++)
+        value[i] = (char)0xA5; // EBCDIC 'v'
+    value[STRESS_VALUE] = '\0';
+    if (set_mode(0, "ON") || set_mode(1, "ON"))
+        return 1;
+    for (i = 0; i < STRESS_OPS; i++)
+    {
+        sprintf(native, "stress:v:%d", i % STRESS_VALUES);
+        to_ebcdic(native, key);
+        strcpy(sqlstate, "00000");
+        setRedisValue(key, value, response, &keyInd, &valueInd, &responseInd,
+                      sqlstate, NULL, NULL, msgtext, NULL, NULL);
+        if (report("REDIS_SET", sqlstate, msgtext) || increment(i % STRESS_KEYS, 1))
+            return 1;
+    }
+    if (flush() || set_mode(1, "OFF") || set_mode(0, "OFF"))
+        return 1;
+    // The table run left STRESS_PASSES in each counter
+    return check_totals((long long)STRESS_PASSES * STRESS_KEYS + STRESS_OPS);
+}
+
+/**********************************************************************/
+/* Main */
+/**********************************************************************/
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : STRESS_TIMEOUT;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    signal(SIGALRM, on_timeout);
+    alarm(seconds > 0 ? seconds : STRESS_TIMEOUT);
+
+    if (run_table())
+        return 1;
+    printf("ok table: %d passes over %d counters of %d bytes\n", STRESS_PASSES, STRESS_KEYS, STRESS_KEY);
+    if (run_queue())
+        return 1;
+    printf("ok queue: %d write-behind SETs of %d bytes and %d increments\n", STRESS_OPS, STRESS_VALUE, STRESS_OPS);
+    return 0;
+}
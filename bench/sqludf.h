@@ -0,0 +1,106 @@
+/******************************************************************************
+ * File: sqludf.h
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Stand-in for the IBM i <sqludf.h> used to build the UDF
+ *              modules and the redisperf driver on Linux (gmake perf-linux).
+ *              Only the types the modules use are defined.
+ *
+ *              The UDFs expect to run in an EBCDIC job: they receive EBCDIC
+ *              strings and parse reply numbers with atoi()/atol() after
+ *              converting them to EBCDIC. On Linux those calls are routed to
+ *              a parser that accepts EBCDIC digits as well as ASCII ones
+ *              (configuration values such as REDIS_PORT stay ASCII).
+ *
+ *              Never put this directory on the include path of an IBM i
+ *              build; the system header must be used there.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#ifndef SQLUDF_H
+#define SQLUDF_H
+
+#include <stdlib.h> // Included before atoi/atol are redefined below
+
+/**********************************************************************/
+/* SQL Types */
+/**********************************************************************/
+
+typedef char SQLUDF_VARCHAR;
+typedef char SQLUDF_CHAR;
+typedef char SQLUDF_DATE;  // ISO date text (YYYY-MM-DD)
+typedef char SQLUDF_STAMP; // Timestamp text (YYYY-MM-DD-HH.MM.SS.ffffff)
+typedef short SQLUDF_NULLIND;
+typedef short SQLUDF_SMALLINT;
+typedef int SQLUDF_INTEGER;
+typedef long long SQLUDF_BIGINT;
+typedef double SQLUDF_DOUBLE;
+typedef int SQLUDF_CALL_TYPE;
+
+#define SQL_API_FN
+
+// Scratchpad passed to functions created with SCRATCHPAD
+#define SQLUDF_SCRATCHPAD_LEN 100
+typedef struct sqludf_scratchpad
+{
+    unsigned long length;
+    char data[SQLUDF_SCRATCHPAD_LEN];
+} SQLUDF_SCRATCHPAD;
+
+// Scalar function call types (FINAL CALL)
+#define SQLUDF_FIRST_CALL -1
+#define SQLUDF_NORMAL_CALL 0
+#define SQLUDF_FINAL_CALL 1
+
+// Table function call types (PARAMETER STYLE DB2SQL)
+#define SQLUDF_TF_FIRST -2
+#define SQLUDF_TF_OPEN -1
+#define SQLUDF_TF_FETCH 0
+#define SQLUDF_TF_CLOSE 1
+#define SQLUDF_TF_FINAL 2
+
+/**********************************************************************/
+/* EBCDIC Job Emulation */
+/**********************************************************************/
+
+/**
+ * Function: sqludf_shim_atol
+ * Description: atol() accepting EBCDIC (0xF0-0xF9, '-' 0x60, ' ' 0x40) and
+ *              ASCII digits, signs and blanks.
+ * Parameters:
+ *   - s: Null-terminated number.
+ * Returns:
+ *   - Parsed value (0 when no digits are found).
+ */
+static long sqludf_shim_atol(const char *s)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    long value = 0;
+    int negative = 0;
+
+    while (*p == 0x20 || *p == 0x40 || *p == 0x09)
+        p++;
+    if (*p == 0x2D || *p == 0x60)
+    {
+        negative = 1;
+        p++;
+    }
+    else if (*p == 0x2B || *p == 0x4E)
+        p++;
+    for (;; p++)
+    {
+        if (*p >= 0x30 && *p <= 0x39)
+            value = value * 10 + (*p - 0x30);
+        else if (*p >= 0xF0 && *p <= 0xF9)
+            value = value * 10 + (*p - 0xF0);
+        else
+            break;
+    }
+    return negative ? -value : value;
+}
+
+#define atoi(s) ((int)sqludf_shim_atol(s))
+#define atol(s) sqludf_shim_atol(s)
+
+#endif // SQLUDF_H
@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# Start (or stop) a local Redis Cluster for testing REDIS_CLUSTER=1.
+# Runs N master processes on consecutive ports under /tmp/redis400-cluster
+# (works on Linux and IBM i PASE). Point .env at the first node:
+#   REDIS_IP=127.0.0.1  REDIS_PORT=7000  REDIS_CLUSTER=1
+#
+# Usage: ./cluster_up.sh [start|stop] [first_port] [nodes]
+
+ACTION=${1:-start}
+FIRST_PORT=${2:-7000}
+NODES=${3:-3}
+DIR=/tmp/redis400-cluster
+
+if [ "$ACTION" == "stop" ]; then
+    for ((i = 0; i < NODES; i++)); do
+        redis-cli -p $((FIRST_PORT + i)) SHUTDOWN NOSAVE >/dev/null 2>&1
+    done
+    rm -rf "$DIR"
+    echo "Cluster stopped"
+    exit 0
+fi
+
+if ! command -v redis-server >/dev/null || ! command -v redis-cli >/dev/null; then
+    echo "Error: redis-server and redis-cli are required"
+    exit 1
+fi
+
+mkdir -p "$DIR"
+NODE_LIST=""
+for ((i = 0; i < NODES; i++)); do
+    PORT=$((FIRST_PORT + i))
+    mkdir -p "$DIR/$PORT"
+    redis-server --port $PORT --cluster-enabled yes --cluster-config-file "$DIR/$PORT/nodes.conf" \
+        --dir "$DIR/$PORT" --appendonly no --save "" --daemonize yes \
+        --logfile "$DIR/$PORT/redis.log" || exit 1
+    NODE_LIST="$NODE_LIST 127.0.0.1:$PORT"
+done
+
+# Wait for the nodes to accept connections
+for ((i = 0; i < NODES; i++)); do
+    until redis-cli -p $((FIRST_PORT + i)) PING >/dev/null 2>&1; do sleep 0.1; done
+done
+
+redis-cli --cluster create $NODE_LIST --cluster-replicas 0 --cluster-yes || exit 1
+
+until redis-cli -p $FIRST_PORT CLUSTER INFO | grep -q "cluster_state:ok"; do sleep 0.2; done
+echo "Cluster ready on ports $FIRST_PORT-$((FIRST_PORT + NODES - 1))"
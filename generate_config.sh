@@ -22,7 +22,7 @@ EOF
 while IFS='=' read -r key value; do
     # Skip empty, comment lines, and build-only flags
     [[ -z "$key" || "$key" =~ ^# ]] && continue
-    [[ "$key" == "USE_ICONV" ]] && continue
+    [[ "$key" == "USE_ICONV" || "$key" == "REDIS_PROBES" ]] && continue
     # Trim whitespace
     key=$(echo "$key" | xargs)
     value=$(echo "$value" | xargs)
@@ -33,9 +33,68 @@ done < "$ENV_FILE"
 
 echo "#endif /* REDIS_CONFIG_H */" >> "$OUTPUT_HEADER"
 
+# Prebuilt RESP headers ("*<argc>\r\n$<len>\r\n<NAME>\r\n") of the hot
+# commands, already in ASCII. The ILE C compiler stores string literals in
+# EBCDIC, so the bytes are written as hex escapes.
+TEMPLATE_HEADER="include/redis_templates.h"
+
+ascii_hex() {
+    local text="$1" out="" i
+    for ((i = 0; i < ${#text}; i++)); do
+        out+=$(printf '\\x%02X' "'${text:i:1}")
+    done
+    printf '%s' "$out"
+}
+
+cat > "$TEMPLATE_HEADER" << 'EOF'
+/* Generated by generate_config.sh - DO NOT EDIT MANUALLY */
+#ifndef REDIS_TEMPLATES_H
+#define REDIS_TEMPLATES_H
+
+EOF
+
+# Command name and argument count (command name included)
+crlf='\x0D\x0A'
+while read -r name argc; do
+    header="$(ascii_hex "*$argc")$crlf$(ascii_hex "\$${#name}")$crlf$(ascii_hex "$name")$crlf"
+    echo "#define REDIS_TEMPLATE_$name \"$header\" // *$argc \$${#name} $name" >> "$TEMPLATE_HEADER"
+done << 'EOF'
+GET 2
+SET 3
+HGET 3
+INCR 2
+ZADD 4
+ZSCORE 3
+SETEX 4
+EXPIRE 3
+INCRBY 3
+HINCRBY 4
+MULTI 1
+EXEC 1
+SCRIPT 3
+EOF
+
+# Lua scripts run through the script registry, one hex literal per line
+lua_literal() {
+    echo "#define $1 \\" >> "$TEMPLATE_HEADER"
+    od -An -v -tx1 "$2" | tr -s ' \n' '\n' | awk '
+        NF { line = line "\\x" toupper($1)
+             if ($1 == "0a") { print "    \"" line "\" \\"; line = "" } }
+        END { if (line != "") print "    \"" line "\" \\"; print "    \"\"" }' >> "$TEMPLATE_HEADER"
+}
+
+echo "" >> "$TEMPLATE_HEADER"
+lua_literal REDIS_SCRIPT_SCAN_FILTER lua/scan_filter.lua
+echo "" >> "$TEMPLATE_HEADER"
+lua_literal REDIS_SCRIPT_LIST_POP lua/list_pop.lua
+
+echo "" >> "$TEMPLATE_HEADER"
+echo "#endif /* REDIS_TEMPLATES_H */" >> "$TEMPLATE_HEADER"
+
 # Copy headers to srcfile/ for ILE C compiler (INCDIR doesn't work reliably
 # with quoted includes on IBM i - compiler finds headers in source dir)
 cp "$OUTPUT_HEADER" srcfile/redis_config.h
+cp "$TEMPLATE_HEADER" srcfile/redis_templates.h
 cp include/redis_utils.h srcfile/redis_utils.h
 
-echo "Generated $OUTPUT_HEADER from $ENV_FILE"
+echo "Generated $OUTPUT_HEADER and $TEMPLATE_HEADER from $ENV_FILE"
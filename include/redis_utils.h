@@ -15,7 +15,9 @@
 
 #include <sqludf.h>       // Required for SQL UDF functions
 #include <sys/types.h>    // Required for size_t and other types
+#include <sys/time.h>     // Required for struct timeval
 #include "redis_config.h" // Generated from .env
+#include "redis_templates.h" // Generated ASCII command headers
 
 #ifdef USE_ICONV
 #include <iconv.h>    // Required for iconv conversion
@@ -34,12 +36,192 @@ static int initialized = 0; // Flag to track if iconv descriptors are initialize
 #define REDIS_SERVER_ADDR REDIS_IP
 #define REDIS_SERVER_PORT atoi(REDIS_PORT)
 
+// Connection handshake settings (optional in .env, empty = not sent)
+#ifndef REDIS_USER
+#define REDIS_USER ""        // ACL user name (defaults to "default" when a password is set)
+#endif
+#ifndef REDIS_PASSWORD
+#define REDIS_PASSWORD ""    // Password for AUTH (requirepass or ACL user)
+#endif
+#ifndef REDIS_DB
+#define REDIS_DB "0"         // Database index for SELECT
+#endif
+#ifndef REDIS_CLIENT_NAME
+#define REDIS_CLIENT_NAME "" // Name reported by CLIENT LIST
+#endif
+
+// Read replicas: "host:port,host:port" (empty = all commands go to REDIS_IP)
+#ifndef REDIS_REPLICAS
+#define REDIS_REPLICAS ""
+#endif
+#ifndef REDIS_READ_POLICY
+#define REDIS_READ_POLICY "round-robin" // or "least-outstanding", "latency"
+#endif
+
+// Redis Cluster: "1" routes every key to the node owning its hash slot
+#ifndef REDIS_CLUSTER
+#define REDIS_CLUSTER "0"
+#endif
+
+// Client-side sharding: "host:port,host:port" of standalone servers that
+// share the keys through a consistent-hash ring (empty = not sharded)
+#ifndef REDIS_SHARDS
+#define REDIS_SHARDS ""
+#endif
+
+// Sentinel: "host:port,host:port" of Sentinels that track REDIS_MASTER_NAME
+// (empty = REDIS_IP is always the primary)
+#ifndef REDIS_SENTINELS
+#define REDIS_SENTINELS ""
+#endif
+#ifndef REDIS_MASTER_NAME
+#define REDIS_MASTER_NAME "mymaster"
+#endif
+
+// Flight recorder: file the recent calls are appended to when a call
+// fails (empty = only REDIS_FLIGHT_DUMP writes them)
+#ifndef REDIS_RECORDER_FILE
+#define REDIS_RECORDER_FILE "/tmp/redis400-recorder.log"
+#endif
+
+// Bulk loader (REDIS_LOAD): rows per pipelined batch, batches in flight on
+// each connection, and connections of one load when keys are not sharded
+#ifndef REDIS_LOAD_BATCH
+#define REDIS_LOAD_BATCH "500"
+#endif
+#ifndef REDIS_LOAD_WINDOW
+#define REDIS_LOAD_WINDOW "4"
+#endif
+#ifndef REDIS_LOAD_CONNECTIONS
+#define REDIS_LOAD_CONNECTIONS "4"
+#endif
+
+// Write-behind (REDIS_WRITE_BEHIND): bytes of commands queued before a
+// writer waits for the flusher
+#ifndef REDIS_WRITE_BEHIND_QUEUE
+#define REDIS_WRITE_BEHIND_QUEUE "1048576"
+#endif
+
+// Counter coalescing (REDIS_COALESCE): counters held before they are
+// written, and age in milliseconds of the oldest delta (0 = no limit)
+#ifndef REDIS_COALESCE_KEYS
+#define REDIS_COALESCE_KEYS "4096"
+#endif
+#ifndef REDIS_COALESCE_MS
+#define REDIS_COALESCE_MS "1000"
+#endif
+
+#define REDIS_POOL_SIZE 8    // Idle connections kept open per job
+#define REDIS_RECV_TIMEOUT 1 // Seconds a receive waits for a reply
+#define REDIS_MAX_ENDPOINTS 16 // Primary, replicas and discovered cluster nodes
+#define REDIS_CLUSTER_SLOTS 16384 // Hash slots in a Redis Cluster
+#define REDIS_MAX_REDIRECTS 5  // MOVED/ASK hops followed for one command
+#define REDIS_SHARD_VNODES 160 // Ring points per shard
+#define REDIS_MAX_ARGS 16    // Maximum arguments accepted by format_redis_command
+#define REDIS_CURSOR_DEPTH 16 // Nested arrays followed by redis_reply_row
+#define REDIS_DOUBLE_TEXT 32 // Longest text written by format_redis_double
+#define REDIS_MANY_VALUES 40 // Values of one REDIS_HSET_MANY, REDIS_SADD_MANY, ... call
+
+// Prebuilt ASCII header of a command and its length, for format_redis_template,
+// e.g. REDIS_TEMPLATE(GET) for "*2\r\n$3\r\nGET\r\n" (see generate_config.sh)
+#define REDIS_TEMPLATE(name) REDIS_TEMPLATE_##name, sizeof(REDIS_TEMPLATE_##name) - 1
+#define REDIS_RECORDER_SIZE 256    // Calls kept by the flight recorder
+#define REDIS_RECORDER_PREFIX 64   // Bytes of each command and reply kept
+#define REDIS_RECORDER_INTERVAL 60 // Seconds between automatic dumps
+#define REDIS_ARENA_BLOCK 262144   // Smallest block of a call arena
+#define REDIS_ARENA_KEEP 1048576   // Largest arena kept between calls
+#define REDIS_LOAD_SLOTS 16        // Loads running at once in a job
+#define REDIS_LOAD_HISTORY 16      // Finished loads kept for REDIS_LOAD_REPORT
+#define REDIS_LOAD_MAX_BATCH 100000 // Largest batch of rows
+#define REDIS_LOAD_MAX_WINDOW 64   // Most batches in flight per connection
+
+// Encoded rows of REDIS_CACHE_ROW and REDIS_FETCH_ROW: a version byte, the
+// column count, then per column a type tag (REDIS_ROW_NULL set for NULL,
+// without payload) and its payload
+#define REDIS_ROW_VERSION 1      // First byte of an encoded row
+#define REDIS_ROW_COLUMNS 40     // COL1 .. COL40
+#define REDIS_ROW_RECORD 32000   // Longest encoded row (fits the REDIS_FETCH_ROW scratchpad)
+#define REDIS_ROW_INTEGER 1      // Zigzag varint
+#define REDIS_ROW_DECIMAL 2      // Scale byte, then a zigzag varint of the unscaled value, or
+                                 // with REDIS_ROW_PACKED set in the scale, a length and packed digits
+#define REDIS_ROW_DATE 3         // 3 bytes: days since 0001-01-01, big-endian
+#define REDIS_ROW_TIMESTAMP 4    // 8 bytes: microseconds since 0001-01-01-00.00.00, big-endian
+#define REDIS_ROW_VARCHAR 5      // Varint length, then the bytes (ASCII)
+#define REDIS_ROW_NULL 0x80      // Tag bit of a NULL column
+#define REDIS_ROW_PACKED 0x40    // Scale bit of a DECIMAL too long for a varint
+
+// Phases of a call timed by the profiling probes (see REDIS_PROFILE)
+#define REDIS_PHASE_CONNECT 0   // Taking a connection: pool lookup, TCP connect, handshake
+#define REDIS_PHASE_ENCODE 1    // Building the command, until it is sent
+#define REDIS_PHASE_TRANSLATE 2 // EBCDIC/ASCII conversion
+#define REDIS_PHASE_SEND 3      // Writing the command to the socket
+#define REDIS_PHASE_WAIT 4      // Waiting for and reading the reply
+#define REDIS_PHASE_PARSE 5     // Decoding the reply, until the connection is released
+#define REDIS_PHASES 6
+
+// Probes around the phases of the shared call path. Building with
+// REDIS_NO_PROBES defined (REDIS_PROBES=0 in .env) compiles them out.
+#ifndef REDIS_NO_PROBES
+#define REDIS_PROBE_ENTER() redis_probe_enter()
+#define REDIS_PROBE_LEAVE(phase) redis_probe_leave(phase)
+#else
+#define REDIS_PROBE_ENTER() ((void)0)
+#define REDIS_PROBE_LEAVE(phase) ((void)0)
+#endif
+
 /**********************************************************************/
 /* Types */
 /**********************************************************************/
 
 typedef unsigned char uchar; // Alias for unsigned char
 
+// One value of a RESP reply, as read by redis_reply_item
+typedef struct
+{
+    char type;        // RESP type byte (ASCII '+', '-', ':', '$' or '*')
+    int nil;          // 1 for a nil bulk string or array
+    const char *data; // Text of strings, errors and integers (ASCII, not null-terminated)
+    size_t len;       // Length of data; element count of arrays
+    long long number; // Value of integers; element count of arrays
+} RedisReplyItem;
+
+// Position of a table function in a reply kept in its scratchpad
+typedef struct
+{
+    int pos;                           // Offset of the next value in the reply
+    int len;                           // Length of the reply
+    int depth;                         // Arrays open at pos
+    int remaining[REDIS_CURSOR_DEPTH]; // Elements left in each open array
+    int index[REDIS_CURSOR_DEPTH];     // Elements returned from each open array
+} RedisReplyCursor;
+
+// Progress or outcome of a bulk load, as returned by redis_load_report
+typedef struct
+{
+    long long id;        // Load number in the job, from 1
+    int status;          // REDIS_LOAD_RUNNING, REDIS_LOAD_DONE or REDIS_LOAD_FAILED
+    long long rows;      // Rows queued
+    long long commands;  // Commands sent or queued
+    long long failed;    // Commands answered with an error or lost with a connection
+    long long batches;   // Batches sent
+    int connections;     // Connections opened
+    double seconds;      // From the first row to the end (or to now while running)
+    char error[71];      // First error (EBCDIC), empty if none
+} RedisLoadReport;
+
+// Column of a REDIS_CACHE_ROW layout, as read by parse_redis_layout
+typedef struct
+{
+    const char *name; // Column name in the layout (EBCDIC, not null-terminated)
+    size_t name_len;  // Length of the name
+    int type;         // REDIS_ROW_INTEGER .. REDIS_ROW_VARCHAR
+    int scale;        // Digits after the point of a DECIMAL, -1 if not given
+} RedisRowColumn;
+
+#define REDIS_LOAD_RUNNING 0
+#define REDIS_LOAD_DONE 1
+#define REDIS_LOAD_FAILED 2
+
 /**********************************************************************/
 /* EBCDIC/ASCII Translation Tables (No USE_ICONV) */
 /**********************************************************************/
@@ -166,6 +348,1150 @@ int ConvertToASCII(char *ibuf, size_t ileft, char *obuf, size_t oleft);
  */
 int connect_to_redis(int *sockfd);
 
+/**
+ * Function: connect_to_redis_read
+ * Description: Establishes a connection for a read-only command. Uses a
+ *              replica from REDIS_REPLICAS (per REDIS_READ_POLICY) unless
+ *              reads were routed to the primary with set_redis_read_mode.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_read(int *sockfd);
+
+/**
+ * Function: set_redis_read_mode
+ * Description: Switches where read-only commands are sent for this job.
+ * Parameters:
+ *   - primary: 1 to read from the primary (read-your-writes), 0 for replicas.
+ * Returns:
+ *   - The previous setting.
+ */
+int set_redis_read_mode(int primary);
+
+/**
+ * Function: release_redis_connection
+ * Description: Returns a connection obtained from connect_to_redis. The socket
+ *              is kept open for the next call unless the call failed.
+ * Parameters:
+ *   - sockfd: Socket file descriptor from connect_to_redis (ignored if negative).
+ *   - sqlstate: SQLSTATE of the call; anything outside class 00-02 closes it,
+ *     except 38911 (error reply from Redis, read in full) and 38912
+ *     (transaction aborted by WATCH, read in full).
+ */
+void release_redis_connection(int sockfd, const char *sqlstate);
+
+/**
+ * Function: recv_redis_reply
+ * Description: Receives one complete RESP reply (ASCII) from Redis. In
+ *              cluster mode, -MOVED and -ASK redirections are followed by
+ *              resending the last command to the node that owns the slot.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the reply.
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure (errno set by recv).
+ */
+int recv_redis_reply(int sockfd, char *buf, size_t size);
+
+/**
+ * Function: recv_redis_replies
+ * Description: Receives a number of pipelined RESP replies (ASCII) without
+ *              following cluster redirections.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the replies.
+ *   - size: Size of the buffer.
+ *   - count: Number of replies expected.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure.
+ */
+int recv_redis_replies(int sockfd, char *buf, size_t size, int count);
+
+/**
+ * Function: recv_redis_stream
+ * Description: Receives whatever has arrived of a pipelined reply stream
+ *              (at least one byte); the caller counts the replies.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the data.
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure.
+ */
+int recv_redis_stream(int sockfd, char *buf, size_t size);
+
+/**
+ * Function: redis_reply_span
+ * Description: Finds the end of the RESP reply (ASCII) starting at pos.
+ * Parameters:
+ *   - buf: Buffer holding the replies.
+ *   - len: Number of bytes in the buffer.
+ *   - pos: Offset of the reply.
+ * Returns:
+ *   - Offset just past the reply, -1 if incomplete, -2 if malformed.
+ */
+long redis_reply_span(const char *buf, size_t len, size_t pos);
+
+/**
+ * Function: redis_reply_item
+ * Description: Reads the RESP value (ASCII) at *pos. Arrays yield a header
+ *              with their element count; the elements follow.
+ * Parameters:
+ *   - buf: Buffer holding the reply.
+ *   - len: Number of bytes in the buffer.
+ *   - pos: Offset of the value; advanced past it (past the header for arrays).
+ *   - item: Receives the value.
+ * Returns:
+ *   - 0 on success, -1 if incomplete, -2 if malformed.
+ */
+int redis_reply_item(const char *buf, size_t len, size_t *pos, RedisReplyItem *item);
+
+/**
+ * Function: redis_reply_row
+ * Description: Reads the next row of a reply returned by a table function
+ *              (REDIS_COMMAND_TABLE and the like). A single value is one
+ *              row at level 0; the elements of an array are rows at level
+ *              1, a nested array is a row of its own followed by its
+ *              elements one level deeper.
+ * Parameters:
+ *   - reply: Reply (ASCII).
+ *   - cursor: Position in the reply; advanced past the row.
+ *   - item: Receives the value of the row.
+ *   - position: Receives the 1-based position in the enclosing array.
+ *   - level: Receives the nesting level.
+ * Returns:
+ *   - 0 for a row, 1 at the end, -1 if the reply is malformed, -2 if it
+ *     is nested deeper than REDIS_CURSOR_DEPTH.
+ */
+int redis_reply_row(const char *reply, RedisReplyCursor *cursor, RedisReplyItem *item,
+                    int *position, int *level);
+
+/**
+ * Function: redis_reply_type
+ * Description: Returns the TYPE column of a row: status, error, integer,
+ *              string, array or nil.
+ * Parameters:
+ *   - item: Value of the row.
+ * Returns:
+ *   - Type name (job CCSID).
+ */
+const char *redis_reply_type(const RedisReplyItem *item);
+
+/**
+ * Function: send_redis_command
+ * Description: Sends an encoded command (ASCII) and remembers it so that a
+ *              cluster redirection can resend it.
+ * Parameters:
+ *   - sockfd: Socket file descriptor from connect_to_redis.
+ *   - buf: Encoded command (ASCII). Must stay valid until the reply is read.
+ *   - len: Length of the command.
+ * Returns:
+ *   - Number of bytes sent, negative value on failure.
+ */
+int send_redis_command(int sockfd, const char *buf, size_t len);
+
+/**
+ * Function: connect_to_redis_key
+ * Description: Returns a connection for a command that writes one key. In
+ *              cluster mode this is the node owning the key's hash slot.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - key: Redis key (EBCDIC, null-terminated).
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_key(int *sockfd, const char *key);
+
+/**
+ * Function: connect_to_redis_read_key
+ * Description: Returns a connection for a command that reads one key. In
+ *              cluster mode this is the node owning the key's hash slot,
+ *              otherwise the connect_to_redis_read routing applies.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - key: Redis key (EBCDIC, null-terminated).
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_read_key(int *sockfd, const char *key);
+
+/**
+ * Function: connect_to_redis_addr
+ * Description: Opens a plain connection (no pooling, no handshake), e.g. to
+ *              query a Sentinel. Close it with close().
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_addr(int *sockfd, const char *addr, int port);
+
+/**
+ * Function: set_redis_primary
+ * Description: Moves the primary to a new address after a failover; pooled
+ *              connections to the old primary are closed.
+ * Parameters:
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ * Returns:
+ *   - 1 if the primary changed, 0 otherwise.
+ */
+int set_redis_primary(const char *addr, int port);
+
+/**
+ * Function: set_redis_replica
+ * Description: Adds or removes an address from the replicas used for reads.
+ * Parameters:
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ *   - replica: 1 to serve reads from the address, 0 to stop.
+ */
+void set_redis_replica(const char *addr, int port, int replica);
+
+/**
+ * Function: redis_sentinel_poll
+ * Description: Applies pending Sentinel failover events; called before a
+ *              connection is handed out. No-op without REDIS_SENTINELS.
+ */
+void redis_sentinel_poll(void);
+
+/**
+ * Function: redis_sentinel_refresh
+ * Description: Asks the Sentinels for the current primary again.
+ * Returns:
+ *   - 1 if the primary changed, 0 otherwise.
+ */
+int redis_sentinel_refresh(void);
+
+/**
+ * Function: connect_to_redis_endpoint
+ * Description: Returns a pooled connection to a specific endpoint.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - endpoint: Endpoint index from find_redis_endpoint.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_endpoint(int *sockfd, int endpoint);
+
+/**
+ * Function: redis_connection_endpoint
+ * Description: Tells which endpoint a pooled connection is open to.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ * Returns:
+ *   - Endpoint index, -1 if the connection is not pooled.
+ */
+int redis_connection_endpoint(int sockfd);
+
+/**
+ * Function: find_redis_endpoint
+ * Description: Returns the index of an endpoint, adding it when it is new.
+ * Parameters:
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ * Returns:
+ *   - Endpoint index, negative value if the endpoint list is full.
+ */
+int find_redis_endpoint(const char *addr, int port);
+
+/**
+ * Function: redis_cluster_enabled
+ * Description: Tells whether REDIS_CLUSTER is switched on.
+ * Returns:
+ *   - 1 in cluster mode, 0 otherwise.
+ */
+int redis_cluster_enabled(void);
+
+/**
+ * Function: redis_sharding_enabled
+ * Description: Tells whether keys are spread over several nodes, so that
+ *              multi-key commands must be split with fanout_redis_command.
+ * Returns:
+ *   - 1 when keys are sharded, 0 otherwise.
+ */
+int redis_sharding_enabled(void);
+
+/**
+ * Function: redis_endpoint_for_key
+ * Description: Returns the endpoint that owns a key.
+ * Parameters:
+ *   - key: Redis key (EBCDIC).
+ *   - len: Length of the key.
+ * Returns:
+ *   - Endpoint index, negative value when keys are not sharded.
+ */
+int redis_endpoint_for_key(const char *key, size_t len);
+
+/**
+ * Function: redis_hash_tag
+ * Description: Returns the part of a key that is hashed for routing: the
+ *              text between the first '{' and the next '}' when it is not
+ *              empty, else the whole key.
+ * Parameters:
+ *   - ascii: Redis key (ASCII).
+ *   - len: Length of the key.
+ *   - offset: Receives the offset of the hashed part.
+ * Returns:
+ *   - Length of the hashed part.
+ */
+size_t redis_hash_tag(const unsigned char *ascii, size_t len, size_t *offset);
+
+/**
+ * Function: redis_shards_enabled
+ * Description: Tells whether REDIS_SHARDS lists servers for client-side sharding.
+ * Returns:
+ *   - 1 when the consistent-hash ring has shards, 0 otherwise.
+ */
+int redis_shards_enabled(void);
+
+/**
+ * Function: redis_shard_for_key
+ * Description: Returns the shard owning a key on the consistent-hash ring.
+ * Parameters:
+ *   - key: Redis key (EBCDIC).
+ *   - len: Length of the key.
+ * Returns:
+ *   - Endpoint index, negative value when REDIS_SHARDS is empty.
+ */
+int redis_shard_for_key(const char *key, size_t len);
+
+/**
+ * Function: follow_redis_redirect
+ * Description: Follows -MOVED/-ASK replies by resending a command to the
+ *              node named in the reply. Other replies are left untouched.
+ * Parameters:
+ *   - cmd: Command that got the reply (ASCII).
+ *   - cmd_len: Length of the command.
+ *   - wait: Timeout of a blocking command (set_redis_wait), negative for
+ *     other commands.
+ *   - buf: Buffer holding the reply (ASCII); receives the final reply.
+ *   - size: Size of the buffer.
+ *   - len: Length of the reply in buf.
+ * Returns:
+ *   - Length of the final reply, 0 if the connection was closed,
+ *     negative value on failure.
+ */
+int follow_redis_redirect(const char *cmd, size_t cmd_len, double wait, char *buf, size_t size, int len);
+
+/**
+ * Function: fanout_redis_command
+ * Description: Runs a multi-key command (MGET, MSET, DEL, ...) over sharded
+ *              keys: the arguments are grouped by owner, each node gets its
+ *              sub-commands pipelined, all nodes work in parallel and the
+ *              replies are merged back into the order of the arguments.
+ * Parameters:
+ *   - name: Command name (EBCDIC).
+ *   - name_len: Length of the command name.
+ *   - step: Arguments per key (1 for MGET/DEL, 2 for MSET).
+ *   - argc: Number of arguments after the command name.
+ *   - argv: Arguments (EBCDIC).
+ *   - argl: Argument lengths.
+ *   - buf: Receives the merged reply (ASCII).
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Length of the reply, 0 if a connection was closed, -1 on receive
+ *     failure (errno set), -2 on connect failure, -3 on send failure,
+ *     -4 if the reply does not fit.
+ */
+int fanout_redis_command(const char *name, size_t name_len, int step, int argc,
+                         const char **argv, const size_t *argl, char *buf, size_t size);
+
+/**
+ * Function: format_redis_command
+ * Description: Builds a RESP command ("*<argc>\r\n$<len>\r\n<arg>\r\n...") in EBCDIC.
+ * Parameters:
+ *   - buf: Output buffer (EBCDIC).
+ *   - size: Size of the output buffer.
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Argument values (EBCDIC).
+ *   - argl: Argument lengths.
+ * Returns:
+ *   - Length of the command, negative value if it does not fit.
+ */
+int format_redis_command(char *buf, size_t size, int argc, const char **argv, const size_t *argl);
+
+/**
+ * Function: format_redis_template
+ * Description: Builds a RESP command in ASCII from a prebuilt ASCII header
+ *              (REDIS_TEMPLATE) and the variable arguments. Only the
+ *              arguments are translated.
+ * Parameters:
+ *   - buf: Output buffer (ASCII).
+ *   - size: Size of the output buffer.
+ *   - header: Command header (ASCII), e.g. "*2\r\n$3\r\nGET\r\n".
+ *   - header_len: Length of the header.
+ *   - argc: Number of arguments after the command name.
+ *   - argv: Argument values (EBCDIC).
+ *   - argl: Argument lengths.
+ * Returns:
+ *   - Length of the command, negative value if it does not fit or an
+ *     argument cannot be converted.
+ */
+int format_redis_template(char *buf, size_t size, const char *header, size_t header_len,
+                          int argc, const char **argv, const size_t *argl);
+
+/**
+ * Function: append_redis_argument
+ * Description: Appends one argument ("$<len>\r\n<arg>\r\n") to a command
+ *              built in ASCII, e.g. after format_redis_template.
+ * Parameters:
+ *   - buf: Command buffer (ASCII).
+ *   - size: Size of the command buffer.
+ *   - pos: Length of the command so far.
+ *   - arg: Argument value.
+ *   - len: Argument length.
+ *   - ascii: 1 if the argument is already ASCII (e.g., from
+ *     format_redis_double), 0 if it is EBCDIC and must be translated.
+ * Returns:
+ *   - New length of the command, negative value if it does not fit or the
+ *     argument cannot be converted.
+ */
+int append_redis_argument(char *buf, size_t size, int pos, const char *arg, size_t len, int ascii);
+
+/**
+ * Function: append_redis_header
+ * Description: Appends the "*<argc>\r\n" header of a command built in
+ *              ASCII argument by argument.
+ * Parameters:
+ *   - buf: Command buffer (ASCII).
+ *   - size: Size of the command buffer.
+ *   - pos: Length of the command so far, negative after a failure.
+ *   - argc: Number of arguments (command name included).
+ * Returns:
+ *   - New length, negative value if it does not fit.
+ */
+int append_redis_header(char *buf, size_t size, int pos, int argc);
+
+/**
+ * Function: next_redis_word
+ * Description: Reads the next word of a command written as text (e.g. the
+ *              commands of REDIS_TRANSACTION). Words are separated by
+ *              blanks; a word in double quotes may contain blanks and
+ *              semicolons, and "" stands for a double quote. A semicolon
+ *              or a line feed ends the command.
+ * Parameters:
+ *   - p: Position in the text (EBCDIC); advanced past the word.
+ *   - out: Receives the word (EBCDIC, null-terminated).
+ *   - len: Receives the length of the word.
+ * Returns:
+ *   - 1 for a word, 0 at the end of the command (p left on the
+ *     separator), -1 for an unterminated quote.
+ */
+int next_redis_word(const char **p, char *out, size_t *len);
+
+/**
+ * Function: split_redis_keys
+ * Description: Splits a blank-separated list of keys; a key in double
+ *              quotes may contain blanks.
+ * Parameters:
+ *   - text: The list (EBCDIC, null-terminated).
+ *   - words: Receives the keys (at least twice the length of text plus 2).
+ *   - max: Most keys accepted.
+ *   - argv: Receives a pointer to each key in words.
+ *   - argl: Receives the length of each key.
+ * Returns:
+ *   - Number of keys, -1 for an unterminated quote, -2 for more than max.
+ */
+int split_redis_keys(const char *text, char *words, int max, const char **argv, size_t *argl);
+
+/**
+ * Function: parse_redis_direction
+ * Description: Reads a list direction, LEFT or RIGHT in either case.
+ * Parameters:
+ *   - text: The direction (EBCDIC, null-terminated).
+ *   - left: Receives 1 for LEFT, 0 for RIGHT.
+ * Returns:
+ *   - 0 on success, -1 for anything else.
+ */
+int parse_redis_direction(const char *text, int *left);
+
+/**
+ * Function: split_redis_fields
+ * Description: Splits a comma-separated list of names; blanks around the
+ *              names are dropped.
+ * Parameters:
+ *   - text: The list (EBCDIC, null-terminated).
+ *   - max: Most names accepted.
+ *   - names: Receives the start of each name in text.
+ *   - lens: Receives the length of each name.
+ * Returns:
+ *   - Number of names, -1 if there are more than max or a name is empty.
+ */
+int split_redis_fields(const char *text, int max, const char **names, size_t *lens);
+
+/**
+ * Function: format_redis_double
+ * Description: Formats a double as the shortest ASCII text that reads back
+ *              as the same value ("3", "0.1", "1.5e+300", "inf", "-inf").
+ * Parameters:
+ *   - value: Value to format.
+ *   - out: Output buffer (ASCII), at least REDIS_DOUBLE_TEXT bytes; not
+ *     null-terminated.
+ * Returns:
+ *   - Number of bytes written.
+ */
+int format_redis_double(double value, char *out);
+
+/**
+ * Function: format_redis_integer
+ * Description: Formats a 64-bit integer as ASCII digits ("42", "-7"),
+ *              exact over the whole BIGINT range.
+ * Parameters:
+ *   - value: Value to format.
+ *   - out: Output buffer (ASCII), at least REDIS_DOUBLE_TEXT bytes; not
+ *     null-terminated.
+ * Returns:
+ *   - Number of bytes written.
+ */
+int format_redis_integer(long long value, char *out);
+
+/**
+ * Function: format_ebcdic_integer
+ * Description: Formats a 64-bit integer as EBCDIC digits, for numbers
+ *              passed where EBCDIC text is expected (e.g., the arguments
+ *              of eval_redis_script).
+ * Parameters:
+ *   - value: Value to format.
+ *   - out: Output buffer (EBCDIC), at least REDIS_DOUBLE_TEXT bytes;
+ *     null-terminated.
+ * Returns:
+ *   - Number of bytes written.
+ */
+int format_ebcdic_integer(long long value, char *out);
+
+/**
+ * Function: collect_redis_arguments
+ * Description: Builds the argument list of a generic command: the command
+ *              text split at blanks, then the arguments up to the last
+ *              non-NULL one.
+ * Parameters:
+ *   - command: Command text (EBCDIC, null-terminated).
+ *   - args: Arguments (EBCDIC, null-terminated).
+ *   - inds: Null indicators of the arguments.
+ *   - count: Number of arguments.
+ *   - argv: Receives the argument pointers (REDIS_MAX_ARGS entries).
+ *   - argl: Receives the argument lengths.
+ *   - key: Receives the index in argv of the first argument, -1 if none.
+ * Returns:
+ *   - Number of entries in argv, -1 if the command is blank, -2 if a NULL
+ *     argument precedes a non-NULL one, -3 if there are too many.
+ */
+int collect_redis_arguments(const char *command, const char **args, const SQLUDF_NULLIND *inds,
+                            int count, const char **argv, size_t *argl, int *key);
+
+/**
+ * Function: execute_redis_command
+ * Description: Sends a command on a pooled connection (routed by argv[key]
+ *              in cluster or sharded mode) and receives one complete reply.
+ *              On success the caller releases the connection.
+ * Parameters:
+ *   - sockfd: Receives the connection (-1 after a failure).
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Arguments (EBCDIC); argv[key] must be null-terminated.
+ *   - argl: Argument lengths.
+ *   - key: Index of the routing key in argv, -1 for none.
+ *   - buf: Receives the reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure (38901-38909).
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure (connection already released).
+ */
+int execute_redis_command(int *sockfd, int argc, const char **argv, const size_t *argl, int key,
+                          char *buf, size_t size, char *sqlstate, char *msgtext);
+
+/**
+ * Function: execute_redis_blocking
+ * Description: Runs a blocking command (BLPOP, BRPOP, BLMOVE) like
+ *              execute_redis_command, on a connection that waits for the
+ *              command's timeout instead of REDIS_RECV_TIMEOUT.
+ * Parameters:
+ *   - sockfd: Receives the connection (-1 after a failure).
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Arguments (EBCDIC); argv[key] must be null-terminated.
+ *   - argl: Argument lengths.
+ *   - key: Index of the routing key in argv, -1 for none.
+ *   - timeout: Timeout of the command in seconds, 0 to block without limit.
+ *   - buf: Receives the reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure (38901-38909).
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure (connection already released).
+ */
+int execute_redis_blocking(int *sockfd, int argc, const char **argv, const size_t *argl, int key,
+                           double timeout, char *buf, size_t size, char *sqlstate, char *msgtext);
+
+/**
+ * Function: format_ebcdic_timeout
+ * Description: Formats a timeout in seconds as EBCDIC text.
+ * Parameters:
+ *   - timeout: Timeout in seconds.
+ *   - out: Output buffer (EBCDIC), at least REDIS_DOUBLE_TEXT bytes.
+ * Returns:
+ *   - Number of bytes written (null-terminated, terminator excluded).
+ */
+int format_ebcdic_timeout(double timeout, char *out);
+
+/**
+ * Function: suspend_redis_call
+ * Description: Ends the call on a connection that the caller keeps across
+ *              UDF calls; the call is recorded and its arena given back.
+ * Parameters:
+ *   - sqlstate: SQLSTATE of the call.
+ */
+void suspend_redis_call(const char *sqlstate);
+
+/**
+ * Function: resume_redis_call
+ * Description: Starts a new call on a connection kept with
+ *              suspend_redis_call.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ */
+void resume_redis_call(int sockfd);
+
+/**
+ * Function: set_redis_wait
+ * Description: Lets a connection wait for the reply of a blocking command
+ *              (BLPOP, BRPOP, BLMOVE) for the server-side timeout plus
+ *              REDIS_RECV_TIMEOUT, or without limit for 0. The normal
+ *              receive timeout is restored on release.
+ * Parameters:
+ *   - sockfd: Socket file descriptor from connect_to_redis.
+ *   - timeout: Server-side timeout of the command in seconds, 0 for none.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int set_redis_wait(int sockfd, double timeout);
+
+/**
+ * Function: set_redis_password
+ * Description: Remembers a password accepted by REDIS_AUTH so that every
+ *              connection opened later in the job authenticates with it.
+ * Parameters:
+ *   - password: Password (EBCDIC, null-terminated).
+ */
+void set_redis_password(const char *password);
+
+/**
+ * Function: redis_arena_alloc
+ * Description: Hands out call-scoped memory from the arena of the current
+ *              thread; it stays valid until the call releases its last
+ *              connection (release_redis_connection).
+ * Parameters:
+ *   - size: Number of bytes.
+ * Returns:
+ *   - Memory aligned for any type, NULL if it cannot be allocated.
+ */
+void *redis_arena_alloc(size_t size);
+
+/**
+ * Function: redis_arena_begin
+ * Description: Counts a connection taken by the current thread.
+ */
+void redis_arena_begin(void);
+
+/**
+ * Function: redis_arena_end
+ * Description: Counts a released connection; the last one of a call resets
+ *              the arena.
+ * Parameters:
+ *   - connection: 1 if a connection was released, 0 for a call that ends
+ *     without one (e.g., after a fan-out).
+ */
+void redis_arena_end(int connection);
+
+/**
+ * Function: redis_arena_pin
+ * Description: Keeps the arena from being reset while connections are
+ *              taken and released in the middle of a call (fan-out, slot
+ *              map load).
+ */
+void redis_arena_pin(void);
+
+/**
+ * Function: redis_arena_unpin
+ * Description: Ends redis_arena_pin.
+ */
+void redis_arena_unpin(void);
+
+/**
+ * Function: redis_load_start
+ * Description: Starts a bulk load for the statement calling REDIS_LOAD or
+ *              REDIS_LOAD_HASH.
+ * Parameters:
+ *   - batch: Rows per batch, 0 for REDIS_LOAD_BATCH.
+ *   - connections: Connections when keys are not sharded, 0 for
+ *     REDIS_LOAD_CONNECTIONS.
+ * Returns:
+ *   - Handle of the load (> 0), -1 if out of memory, -2 if
+ *     REDIS_LOAD_SLOTS loads are already running.
+ */
+int redis_load_start(int batch, int connections);
+
+/**
+ * Function: redis_load_reserve
+ * Description: Picks the connection of a row's key and returns room at the
+ *              end of its batch for the row's commands. A full batch is
+ *              sent first.
+ * Parameters:
+ *   - handle: Handle from redis_load_start.
+ *   - key: Redis key (EBCDIC).
+ *   - key_len: Length of the key.
+ *   - size: Bytes needed by the row's commands.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Buffer of at least size bytes, NULL on failure.
+ */
+char *redis_load_reserve(int handle, const char *key, size_t key_len, size_t size,
+                         char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_load_commit
+ * Description: Queues the commands written into the buffer from
+ *              redis_load_reserve; the batch is sent when it is full.
+ * Parameters:
+ *   - handle: Handle from redis_load_start.
+ *   - len: Bytes written.
+ *   - commands: Number of commands written.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_load_commit(int handle, size_t len, int commands, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_load_finish
+ * Description: Sends the last batches, reads all replies, gives the
+ *              connections back and files the report of the load.
+ * Parameters:
+ *   - handle: Handle from redis_load_start.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_load_finish(int handle, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_load_report
+ * Description: Returns a running or finished load of the job: running
+ *              loads first, then finished ones, newest first.
+ * Parameters:
+ *   - index: Position in that order, from 0.
+ *   - report: Receives the report.
+ * Returns:
+ *   - 0 on success, -1 past the last load.
+ */
+int redis_load_report(int index, RedisLoadReport *report);
+
+/**
+ * Function: set_redis_write_behind
+ * Description: Switches write-behind on or off for the job. Switching it
+ *              off waits until the queue has been written.
+ * Parameters:
+ *   - on: 1 to queue writes, 0 to send them synchronously.
+ * Returns:
+ *   - The previous setting.
+ */
+int set_redis_write_behind(int on);
+
+/**
+ * Function: redis_write_behind_enabled
+ * Description: Tells whether REDIS_SET, REDIS_HSET, REDIS_HSET_MANY,
+ *              REDIS_INCRBY and REDIS_EXPIRE queue their commands instead of
+ *              sending them.
+ * Returns:
+ *   - 1 if write-behind is on, 0 otherwise.
+ */
+int redis_write_behind_enabled(void);
+
+/**
+ * Function: redis_write_behind_queue
+ * Description: Queues an encoded command for the flusher thread. May
+ *              wait for the flusher when the queue is full, so the caller
+ *              must not hold any other lock.
+ * Parameters:
+ *   - key: Redis key of the command (EBCDIC, null-terminated).
+ *   - cmd: Command (ASCII).
+ *   - len: Length of the command.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_write_behind_queue(const char *key, const char *cmd, size_t len,
+                             char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_write_behind_flush
+ * Description: Waits until everything queued has been written and
+ *              answered.
+ * Parameters:
+ *   - error: Receives the first error (EBCDIC, 71 bytes), empty if none.
+ * Returns:
+ *   - Number of commands that failed since the last flush.
+ */
+long long redis_write_behind_flush(char *error);
+
+/**
+ * Function: redis_write_behind_barrier
+ * Description: Makes a command wait for the writes the job queued before
+ *              it. Called when a connection is taken.
+ */
+void redis_write_behind_barrier(void);
+
+/**
+ * Function: redis_write_behind_wake
+ * Description: Wakes the flusher thread, starting it if needed, so that
+ *              it sets its timer for the coalesced counters.
+ */
+void redis_write_behind_wake(void);
+
+/**
+ * Function: set_redis_coalesce
+ * Description: Switches counter coalescing on or off for the job.
+ *              Switching it off queues the pending counters.
+ * Parameters:
+ *   - on: 1 to coalesce increments, 0 to send them.
+ * Returns:
+ *   - The previous setting, -1 if the table cannot be allocated.
+ */
+int set_redis_coalesce(int on);
+
+/**
+ * Function: redis_coalesce_enabled
+ * Description: Tells whether REDIS_INCR, REDIS_INCRBY, REDIS_DECRBY and
+ *              REDIS_HINCRBY add to the counter table instead of sending.
+ * Returns:
+ *   - 1 if coalescing is on, 0 otherwise.
+ */
+int redis_coalesce_enabled(void);
+
+/**
+ * Function: redis_coalesce_add
+ * Description: Adds an increment to the pending counter of a key or hash
+ *              field.
+ * Parameters:
+ *   - key: Redis key (EBCDIC, null-terminated).
+ *   - field: Hash field (EBCDIC, null-terminated), NULL for a string
+ *     counter.
+ *   - delta: Increment.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_coalesce_add(const char *key, const char *field, long long delta,
+                       char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_coalesce_pending
+ * Description: Tells whether counters are waiting in the table or are
+ *              being queued.
+ * Returns:
+ *   - Number of pending counters.
+ */
+int redis_coalesce_pending(void);
+
+/**
+ * Function: redis_coalesce_due
+ * Description: Tells how long until the oldest pending counter is
+ *              REDIS_COALESCE_MS old, for the flusher thread's timer.
+ *              Does not wait for the table: while another thread holds
+ *              it, the counters are not due yet.
+ * Returns:
+ *   - Milliseconds left, 0 if due now, -1 if nothing is pending.
+ */
+long redis_coalesce_due(void);
+
+/**
+ * Function: redis_coalesce_drain
+ * Description: Queues the pending counters for the write-behind flusher
+ *              as INCRBY and HINCRBY commands. Caller holds no lock.
+ * Parameters:
+ *   - wait: 1 to wait for a drain of another thread and drain after it,
+ *     0 to leave the counters to that drain.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Number of counters that could not be queued: 0 on success. They
+ *     stay pending.
+ */
+int redis_coalesce_drain(int wait, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_script_register
+ * Description: Adds a Lua script to the job's script registry and returns
+ *              its SHA1, the name EVALSHA runs it by. Registering the same
+ *              script again returns the same entry.
+ * Parameters:
+ *   - script: Script body (EBCDIC, or ASCII for the scripts compiled in).
+ *   - len: Length of the body.
+ *   - ascii: 1 if the body is already ASCII.
+ *   - sha: Receives the SHA1 (40 lowercase hex digits, ASCII,
+ *     null-terminated).
+ * Returns:
+ *   - 0 on success, -1 if the body cannot be converted or stored.
+ */
+int redis_script_register(const char *script, size_t len, int ascii, char *sha);
+
+/**
+ * Function: eval_redis_script
+ * Description: Runs a script by its SHA1 with EVALSHA on a connection the
+ *              caller holds. SCRIPT LOAD is pipelined in front of the
+ *              first EVALSHA on each endpoint; a -NOSCRIPT reply (after a
+ *              restart or SCRIPT FLUSH) loads the script and runs it again.
+ *              Scripts not in the registry are only run with EVALSHA.
+ * Parameters:
+ *   - sockfd: Connection (released by the caller, also after a failure).
+ *   - sha: SHA1 of the script (40 hex digits, ASCII).
+ *   - argc: Number of keys and arguments.
+ *   - argv: Keys, then arguments (EBCDIC).
+ *   - argl: Their lengths.
+ *   - keys: Number of entries of argv that are keys.
+ *   - buf: Receives the EVALSHA reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure (38902-38911).
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure.
+ */
+int eval_redis_script(int sockfd, const char *sha, int argc, const char **argv, const size_t *argl,
+                      int keys, char *buf, size_t size, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_pop_open
+ * Description: Pops up to count elements from the first non-empty list in
+ *              one round trip (a script using LPOP/RPOP with COUNT) and
+ *              keeps them in a table function's scratchpad. Fewer elements
+ *              are popped when they would not fit.
+ * Parameters:
+ *   - keyc: Number of lists (the first routes the call).
+ *   - keys: The lists (EBCDIC, null-terminated).
+ *   - keyl: Their lengths.
+ *   - left: 1 to pop from the head, 0 from the tail.
+ *   - count: Most elements to pop.
+ *   - area: Scratchpad data.
+ *   - size: Scratchpad length.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 0 on success (also when every list is empty), -1 on failure.
+ */
+int redis_pop_open(int keyc, const char **keys, const size_t *keyl, int left, long count, char *area,
+                   size_t size, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_pop_fetch
+ * Description: Returns the next element popped by redis_pop_open.
+ * Parameters:
+ *   - area: Scratchpad data.
+ *   - key: Receives the list popped from (EBCDIC), NULL if not wanted.
+ *   - position: Receives the 1-based position in popping order.
+ *   - value: Receives the element (EBCDIC).
+ *   - sqlstate: Receives "02000" after the last element, or the SQLSTATE
+ *     of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 0 for an element, 1 at the end, -1 on failure.
+ */
+int redis_pop_fetch(char *area, char *key, int *position, char *value, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_block_pop
+ * Description: Pops one element from the first non-empty list with BLPOP
+ *              or BRPOP, waiting up to timeout seconds for one to arrive.
+ * Parameters:
+ *   - keys: The lists, blank-separated (EBCDIC); the first routes the call.
+ *   - left: 1 for BLPOP (head), 0 for BRPOP (tail).
+ *   - timeout: Seconds to wait, 0 to wait without limit.
+ *   - key: Receives the list popped from (EBCDIC).
+ *   - value: Receives the element (EBCDIC).
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 1 for an element, 0 when the timeout expired, -1 on failure.
+ */
+int redis_block_pop(const char *keys, int left, double timeout, char *key, char *value, char *sqlstate,
+                    char *msgtext);
+
+/**
+ * Function: redis_write_many
+ * Description: Sends one variadic write (HSET, SADD, ZADD, LPUSH, RPUSH)
+ *              built from every argument at once, so that a whole row or
+ *              set of members costs one round trip.
+ * Parameters:
+ *   - argc: Number of arguments (command name and key included).
+ *   - argv: Command name, key, then the arguments (EBCDIC).
+ *   - argl: Their lengths.
+ *   - behind: 1 to queue the command when write-behind is on.
+ *   - result: Receives the integer reply.
+ *   - sqlstate: Receives the SQLSTATE of a failure; "38911" is an error
+ *     reply from Redis (e.g., WRONGTYPE).
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 1 when result was set, 0 when the command was queued, -1 on failure.
+ */
+int redis_write_many(int argc, const char **argv, const size_t *argl, int behind, long long *result,
+                     char *sqlstate, char *msgtext);
+
+/**
+ * Function: parse_redis_layout
+ * Description: Reads the layout of a cached row: column names and types
+ *              separated by commas, e.g. "ID INTEGER, BALANCE DECIMAL(9,2),
+ *              OPENED DATE, CHANGED TIMESTAMP, NAME VARCHAR". SMALLINT,
+ *              BIGINT and NUMERIC are read as INTEGER and DECIMAL, CHAR as
+ *              VARCHAR; lengths and precisions are ignored.
+ * Parameters:
+ *   - layout: The layout (EBCDIC, null-terminated).
+ *   - columns: Receives the columns (REDIS_ROW_COLUMNS entries).
+ * Returns:
+ *   - Number of columns, -1 for an unknown type or a malformed entry, -2
+ *     for more than REDIS_ROW_COLUMNS.
+ */
+int parse_redis_layout(const char *layout, RedisRowColumn *columns);
+
+/**
+ * Function: encode_redis_row
+ * Description: Encodes the values of a row by the types of its layout
+ *              (see REDIS_ROW_VERSION): numbers, dates and timestamps are
+ *              stored in binary instead of as text.
+ * Parameters:
+ *   - count: Number of columns.
+ *   - columns: The layout.
+ *   - values: Value of each column as text (EBCDIC, null-terminated).
+ *   - inds: Null indicator of each value.
+ *   - record: Receives the encoded row.
+ *   - size: Size of record.
+ *   - sqlstate: Receives the SQLSTATE of a failure ("38003" for a value
+ *     that does not read as its type, "38908" when record is too small).
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - Length of the encoded row, -1 on failure.
+ */
+int encode_redis_row(int count, const RedisRowColumn *columns, const char **values, const SQLUDF_NULLIND *inds,
+                     char *record, size_t size, char *sqlstate, char *msgtext);
+
+/**
+ * Function: redis_stats_begin
+ * Description: Marks that the current thread takes a connection; the first
+ *              one starts the timing of a call for REDIS_STATS.
+ */
+void redis_stats_begin(void);
+
+/**
+ * Function: redis_stats_abort
+ * Description: Undoes redis_stats_begin when no connection could be taken.
+ */
+void redis_stats_abort(void);
+
+/**
+ * Function: redis_stats_sent
+ * Description: Counts a command sent during the current call; the first
+ *              command names the call.
+ * Parameters:
+ *   - buf: Encoded command (ASCII).
+ *   - len: Length of the command.
+ */
+void redis_stats_sent(const char *buf, size_t len);
+
+/**
+ * Function: redis_stats_received
+ * Description: Counts replies received during the current call.
+ * Parameters:
+ *   - buf: Replies (ASCII).
+ *   - len: Number of bytes received.
+ */
+void redis_stats_received(const char *buf, size_t len);
+
+/**
+ * Function: redis_stats_end
+ * Description: Marks that the current thread released a connection; the
+ *              last release records the call.
+ * Parameters:
+ *   - sqlstate: SQLSTATE of the call.
+ */
+void redis_stats_end(const char *sqlstate);
+
+/**
+ * Function: redis_stats_connect
+ * Description: Records the opening of a new connection (TCP connect and
+ *              handshake) as the CONNECT command.
+ * Parameters:
+ *   - start: Time the connection attempt started.
+ *   - failed: Non-zero if the connection could not be opened.
+ */
+void redis_stats_connect(const struct timeval *start, int failed);
+
+/**
+ * Function: redis_recorder_add
+ * Description: Records one call in the flight recorder ring.
+ * Parameters:
+ *   - thread: Thread number within the job.
+ *   - start: Start of the call.
+ *   - us: Latency in microseconds.
+ *   - command: Beginning of the command (ASCII).
+ *   - command_len: Length of the command prefix.
+ *   - reply: Beginning of the reply (ASCII).
+ *   - reply_len: Length of the reply prefix.
+ *   - sent: Bytes sent.
+ *   - received: Bytes received.
+ *   - sqlstate: SQLSTATE of the call.
+ *   - error: errno of a failed call, 0 otherwise.
+ */
+void redis_recorder_add(int thread, const struct timeval *start, unsigned int us,
+                        const char *command, size_t command_len, const char *reply, size_t reply_len,
+                        long long sent, long long received, const char *sqlstate, int error);
+
+/**
+ * Function: redis_recorder_error
+ * Description: Dumps the flight recorder to REDIS_RECORDER_FILE after a
+ *              failed call (rate-limited to one dump per
+ *              REDIS_RECORDER_INTERVAL seconds).
+ * Parameters:
+ *   - sqlstate: SQLSTATE of the failed call.
+ */
+void redis_recorder_error(const char *sqlstate);
+
+/**
+ * Function: set_redis_profile_rate
+ * Description: Sets how often calls of the job are profiled by phase.
+ * Parameters:
+ *   - rate: 0 = off, N = every Nth call of each thread.
+ * Returns:
+ *   - Previous rate.
+ */
+int set_redis_profile_rate(int rate);
+
+/**
+ * Function: redis_probe_enter
+ * Description: Starts a timed region of a profiled call. Time since the
+ *              previous region is charged to ENCODE (before the first
+ *              reply) or PARSE (after it). Nested regions are not timed.
+ */
+void redis_probe_enter(void);
+
+/**
+ * Function: redis_probe_leave
+ * Description: Ends the timed region started by redis_probe_enter.
+ * Parameters:
+ *   - phase: Phase the region belongs to (REDIS_PHASE_*).
+ */
+void redis_probe_leave(int phase);
+
 /**
  * Function: Translate
  * Description: Translates a buffer using a conversion table.
@@ -181,7 +1507,10 @@ int Translate(uchar *ip, size_t ilen, uchar *op, uchar *table);
 
 /**
  * Function: extract_redis_payload
- * Description: Extracts the payload from a Redis server response.
+ * Description: Extracts the payload from a Redis server response. Bulk
+ *              payloads point into the response; status, integer and error
+ *              payloads are copied to the arena of the call and stay valid
+ *              until the connection is released (no free needed).
  * Parameters:
  *   - response: The response from the Redis server.
  *   - payload_out: Pointer to store the extracted payload.
@@ -190,6 +1519,35 @@ int Translate(uchar *ip, size_t ilen, uchar *op, uchar *table);
  *   - 0 on success, negative value on failure.
  */
 int extract_redis_payload(char *response, char **payload_out, size_t *length_out);
+
+/**
+ * Function: parse_redis_integer
+ * Description: Reads an integer reply (":<n>\r\n") straight from the ASCII
+ *              bytes received, without translation or copy.
+ * Parameters:
+ *   - reply: Received reply (ASCII).
+ *   - len: Length of the reply.
+ *   - value: Receives the integer.
+ * Returns:
+ *   - 0 on success, -2 for a nil reply, -1 for any other reply (e.g., an
+ *     error) or malformed data.
+ */
+int parse_redis_integer(const char *reply, size_t len, long long *value);
+
+/**
+ * Function: parse_redis_double
+ * Description: Reads a floating-point reply (a bulk string such as "3.5",
+ *              "-inf" or "1e+300", or an integer) straight from the ASCII
+ *              bytes received, without translation or copy.
+ * Parameters:
+ *   - reply: Received reply (ASCII).
+ *   - len: Length of the reply.
+ *   - value: Receives the value, correctly rounded.
+ * Returns:
+ *   - 0 on success, -2 for a nil reply, -1 for any other reply or text that
+ *     is not a number.
+ */
+int parse_redis_double(const char *reply, size_t len, double *value);
 /**
  * Function: initialize_conversion
  * Description: Initializes iconv conversion descriptors for EBCDIC/ASCII.
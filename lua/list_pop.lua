@@ -0,0 +1,40 @@
+-- redis400 list pop: up to COUNT elements of the first non-empty list
+--
+-- Used by REDIS_LPOP_N, REDIS_RPOP_N and REDIS_LMPOP (srcfile/redislmpo.c)
+-- through EVALSHA; it is compiled into the service program by
+-- generate_config.sh. The elements are popped with LPOP/RPOP and COUNT,
+-- but only as many as fit in the reply budget, so nothing is popped that
+-- the caller cannot hold.
+--
+-- KEYS: the lists, tried in order (like LMPOP).
+-- ARGV: direction (LEFT or RIGHT), count, budget (bytes of reply).
+-- Reply: {key, {element, ...}} in popping order, nil if all lists are
+--        empty.
+local left = ARGV[1] == 'LEFT'
+local budget = tonumber(ARGV[3])
+local count = math.min(tonumber(ARGV[2]), math.floor(budget / 16))
+
+for _, key in ipairs(KEYS) do
+  local batch
+  if left then
+    batch = redis.call('LRANGE', key, 0, count - 1)
+  else
+    batch = redis.call('LRANGE', key, -count, -1)
+  end
+  if #batch > 0 then
+    local size, take = 64 + #key, 0
+    for i = 1, #batch do
+      local element = left and batch[i] or batch[#batch + 1 - i]
+      size = size + #element + 16
+      if size > budget then
+        break
+      end
+      take = i
+    end
+    if take == 0 then
+      return redis.error_reply('ERR list pop: the next element does not fit in the reply budget')
+    end
+    return {key, redis.call(left and 'LPOP' or 'RPOP', key, take)}
+  end
+end
+return false
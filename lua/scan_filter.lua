@@ -0,0 +1,77 @@
+-- redis400 scan filter: one SCAN batch, filtered on the server
+--
+-- Used by REDIS_SCAN_FILTER (srcfile/redisscnf.c) through EVALSHA; it is
+-- compiled into the service program by generate_config.sh. Only keys whose
+-- value passes the predicate, and the fields asked for, leave the server.
+--
+-- ARGV: cursor, pattern, count, field ('' tests string values), op ('' for
+--       none, EQ, PREFIX or RANGE), value1, value2 (RANGE bounds, '' for
+--       open), budget (bytes of reply), then the fields to return ('*' for
+--       all; none returns the tested field).
+-- Reply: {next cursor, key, pairs, field, value, ..., key, pairs, ...}
+--        with a nil field for string keys and a nil value for a missing
+--        field. When a batch would not fit in the budget, the same cursor
+--        is scanned again with half the COUNT.
+local cursor, pattern, count = ARGV[1], ARGV[2], tonumber(ARGV[3])
+local field, op, value1, value2 = ARGV[4], ARGV[5], ARGV[6], ARGV[7]
+local budget = tonumber(ARGV[8])
+local low, high = tonumber(value1), tonumber(value2)
+
+local function passes(v)
+  if op == 'EQ' then
+    return v == value1
+  elseif op == 'PREFIX' then
+    return string.sub(v, 1, #value1) == value1
+  elseif op == 'RANGE' then
+    local n = tonumber(v)
+    return n ~= nil and (low == nil or n >= low) and (high == nil or n <= high)
+  end
+  return true
+end
+
+local function project(key, v)
+  if field == '' then
+    return {false, v}
+  elseif #ARGV == 8 then
+    return {field, v}
+  elseif ARGV[9] == '*' then
+    return redis.call('HGETALL', key)
+  end
+  local values = redis.call('HMGET', key, unpack(ARGV, 9))
+  local row = {}
+  for i = 9, #ARGV do
+    row[#row + 1] = ARGV[i]
+    row[#row + 1] = values[i - 8]
+  end
+  return row
+end
+
+while true do
+  local batch = redis.call('SCAN', cursor, 'MATCH', pattern, 'COUNT', count)
+  local out, size = {batch[1]}, 64
+  for _, key in ipairs(batch[2]) do
+    local v
+    if field == '' then
+      v = redis.pcall('GET', key)
+    else
+      v = redis.pcall('HGET', key, field)
+    end
+    -- Keys of another type give an error table, missing fields false
+    if type(v) == 'string' and passes(v) then
+      local row = project(key, v)
+      out[#out + 1] = key
+      out[#out + 1] = #row / 2
+      size = size + #key + 40
+      for i = 1, #row do
+        out[#out + 1] = row[i]
+        size = size + (row[i] and #row[i] or 0) + 16
+      end
+    end
+  end
+  if size <= budget then
+    return out
+  elseif count <= 1 then
+    return redis.error_reply('ERR scan filter: one key does not fit in the reply budget')
+  end
+  count = math.floor(count / 2)
+end
@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# Start (or stop) a local Sentinel setup for testing REDIS_SENTINELS:
+# one primary, one replica and three Sentinels watching "mymaster".
+# Point .env at the Sentinels:
+#   REDIS_SENTINELS=127.0.0.1:26379,127.0.0.1:26380,127.0.0.1:26381
+#   REDIS_MASTER_NAME=mymaster
+# Trigger a failover with:
+#   redis-cli -p 26379 SENTINEL FAILOVER mymaster
+#
+# Usage: ./sentinel_up.sh [start|stop] [primary_port]
+
+ACTION=${1:-start}
+PRIMARY_PORT=${2:-6380}
+REPLICA_PORT=$((PRIMARY_PORT + 1))
+SENTINEL_PORTS="26379 26380 26381"
+DIR=/tmp/redis400-sentinel
+
+if [ "$ACTION" == "stop" ]; then
+    for PORT in $SENTINEL_PORTS $PRIMARY_PORT $REPLICA_PORT; do
+        redis-cli -p $PORT SHUTDOWN NOSAVE >/dev/null 2>&1
+    done
+    rm -rf "$DIR"
+    echo "Sentinel setup stopped"
+    exit 0
+fi
+
+if ! command -v redis-server >/dev/null || ! command -v redis-cli >/dev/null; then
+    echo "Error: redis-server and redis-cli are required"
+    exit 1
+fi
+
+mkdir -p "$DIR"
+redis-server --port $PRIMARY_PORT --dir "$DIR" --save "" --daemonize yes \
+    --logfile "$DIR/$PRIMARY_PORT.log" || exit 1
+redis-server --port $REPLICA_PORT --dir "$DIR" --save "" --daemonize yes \
+    --replicaof 127.0.0.1 $PRIMARY_PORT --logfile "$DIR/$REPLICA_PORT.log" || exit 1
+
+for PORT in $SENTINEL_PORTS; do
+    cat > "$DIR/sentinel-$PORT.conf" << EOF
+port $PORT
+daemonize yes
+logfile "$DIR/sentinel-$PORT.log"
+sentinel monitor mymaster 127.0.0.1 $PRIMARY_PORT 2
+sentinel down-after-milliseconds mymaster 1000
+sentinel failover-timeout mymaster 5000
+EOF
+    redis-server "$DIR/sentinel-$PORT.conf" --sentinel || exit 1
+done
+
+for PORT in $SENTINEL_PORTS; do
+    until redis-cli -p $PORT SENTINEL GET-MASTER-ADDR-BY-NAME mymaster >/dev/null 2>&1; do sleep 0.1; done
+done
+echo "Primary on $PRIMARY_PORT, replica on $REPLICA_PORT, Sentinels on $SENTINEL_PORTS"
@@ -20,6 +20,9 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+#define REPLY_BUFFER 33000 // Size of each receive buffer
+
 /**********************************************************************/
 /* SQL External Function: APPEND */
 /**********************************************************************/
@@ -57,7 +60,7 @@ void SQL_API_FN appendRedisValue(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[33000], ebcdic_payload[33000];
+	char *ebcdic_send_buf, *ascii_send_buf, *recv_buf;
 	char ebcdic_key_len[10] = {0}, ebcdic_value_len[10] = {0};
 	int len, total_len = 0;
 
@@ -95,15 +98,27 @@ void SQL_API_FN appendRedisValue(
 	*resultInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
 		return;
 	}
 
+	// Call buffers come from the thread's arena and are given back on release
+	ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER + REPLY_BUFFER);
+	if (ebcdic_send_buf == NULL)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
+		*resultInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
+	recv_buf = ascii_send_buf + SEND_BUFFER;
+
 	// Format Redis APPEND command in EBCDIC
 	ebcdic_send_buf[0] = '\0';
 
@@ -174,29 +189,29 @@ void SQL_API_FN appendRedisValue(
 
 	// Convert EBCDIC APPEND command to ASCII before sending
 	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send APPEND command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis with detailed logging
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -210,7 +225,7 @@ void SQL_API_FN appendRedisValue(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -218,43 +233,29 @@ void SQL_API_FN appendRedisValue(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-	{
-		strncpy(sqlstate, "38907", 5);
-		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-	ebcdic_payload[total_len] = '\0';
-
-	// Extract Redis response
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+	// Parse the integer reply from the received bytes
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		// Parse the integer value from the payload (string length after append)
-		*result = atol(payload); // Convert the payload to a BIGINT
+		// Integer value of the reply (string length after append)
+		*result = number;
 		*resultInd = 0;
 	}
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		strncpy(msgtext, "Failed to extract payload from Redis response", 70);
 		*resultInd = -1;
 	}
-	//if (payload)
-	//	free(payload);
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(appendRedisValue, OS)
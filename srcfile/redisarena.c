@@ -0,0 +1,257 @@
+/******************************************************************************
+ * File: redisarena.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Per-thread arena for the call-scoped buffers of the
+ *              REDISILE service program.
+ *              A UDF takes its send and receive buffers from the arena of
+ *              its thread instead of the stack, and reply parsing takes its
+ *              copies from it instead of malloc. Allocation is a pointer
+ *              bump; everything is given back at once when the call
+ *              releases its last connection, and the blocks are kept for
+ *              the next call, so a thread in a steady state does not call
+ *              malloc at all.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/**********************************************************************/
+/* Arena Blocks */
+/**********************************************************************/
+
+#define ARENA_ALIGN 16 // Pointer alignment on IBM i
+
+typedef struct RedisArenaBlock
+{
+    struct RedisArenaBlock *next; // Block filled before this one
+    size_t size;                  // Usable bytes
+    size_t used;                  // Bytes handed out since the last reset
+} RedisArenaBlock;
+
+#define ARENA_HEADER ((sizeof(RedisArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+typedef struct
+{
+    RedisArenaBlock *block; // Block in use, earlier blocks chained behind it
+    size_t reserved;        // Usable bytes in all blocks
+    int held;               // Connections held by the call in progress
+    int pins;               // Fan-outs and slot map loads in progress
+} RedisArena;
+
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Function: free_blocks
+ * Description: Frees all blocks of an arena.
+ * Parameters:
+ *   - arena: Arena to empty.
+ */
+static void free_blocks(RedisArena *arena)
+{
+    RedisArenaBlock *block, *next;
+
+    for (block = arena->block; block != NULL; block = next)
+    {
+        next = block->next;
+        free(block);
+    }
+    arena->block = NULL;
+    arena->reserved = 0;
+}
+
+/**
+ * Function: free_arena
+ * Description: Thread-specific data destructor: frees the arena of an
+ *              ending thread.
+ * Parameters:
+ *   - data: Arena of the thread.
+ */
+static void free_arena(void *data)
+{
+    free_blocks((RedisArena *)data);
+    free(data);
+}
+
+/**
+ * Function: create_arena_key
+ * Description: Creates the thread-specific key of the arenas.
+ */
+static void create_arena_key(void)
+{
+    pthread_key_create(&arena_key, free_arena);
+}
+
+/**
+ * Function: thread_arena
+ * Description: Returns the arena of the current thread, creating it on
+ *              first use.
+ * Returns:
+ *   - Arena, NULL if it cannot be allocated.
+ */
+static RedisArena *thread_arena(void)
+{
+    RedisArena *arena;
+
+    pthread_once(&arena_once, create_arena_key);
+    arena = (RedisArena *)pthread_getspecific(arena_key);
+    if (arena != NULL)
+        return arena;
+
+    arena = calloc(1, sizeof(RedisArena));
+    if (arena != NULL)
+        pthread_setspecific(arena_key, arena);
+    return arena;
+}
+
+/**
+ * Function: add_block
+ * Description: Allocates a block and makes it the block in use.
+ * Parameters:
+ *   - arena: Arena to grow.
+ *   - size: Usable bytes of the block.
+ * Returns:
+ *   - New block, NULL if it cannot be allocated.
+ */
+static RedisArenaBlock *add_block(RedisArena *arena, size_t size)
+{
+    RedisArenaBlock *block = malloc(ARENA_HEADER + size);
+
+    if (block == NULL)
+        return NULL;
+    block->next = arena->block;
+    block->size = size;
+    block->used = 0;
+    arena->block = block;
+    arena->reserved += size;
+    return block;
+}
+
+/**
+ * Function: reset_arena
+ * Description: Gives back everything handed out. A call that needed more
+ *              than one block leaves a single block of the combined size
+ *              (up to REDIS_ARENA_KEEP), so the next call like it is served
+ *              without malloc.
+ * Parameters:
+ *   - arena: Arena to reset.
+ */
+static void reset_arena(RedisArena *arena)
+{
+    size_t size = arena->reserved;
+
+    if (arena->block == NULL)
+        return;
+    if (arena->block->next == NULL && size <= REDIS_ARENA_KEEP)
+    {
+        arena->block->used = 0;
+        return;
+    }
+    free_blocks(arena);
+    add_block(arena, size <= REDIS_ARENA_KEEP ? size : REDIS_ARENA_BLOCK);
+}
+
+/**********************************************************************/
+/* Allocation */
+/**********************************************************************/
+
+/**
+ * Function: redis_arena_alloc
+ * Description: Hands out memory that stays valid until the call releases
+ *              its last connection (release_redis_connection).
+ * Parameters:
+ *   - size: Number of bytes.
+ * Returns:
+ *   - Memory aligned for any type, NULL if it cannot be allocated.
+ */
+void *redis_arena_alloc(size_t size)
+{
+    RedisArena *arena = thread_arena();
+    RedisArenaBlock *block;
+    char *memory;
+
+    if (arena == NULL)
+        return NULL;
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    block = arena->block;
+    if (block == NULL || block->size - block->used < size)
+    {
+        block = add_block(arena, size > REDIS_ARENA_BLOCK ? size : REDIS_ARENA_BLOCK);
+        if (block == NULL)
+            return NULL;
+    }
+    memory = (char *)block + ARENA_HEADER + block->used;
+    block->used += size;
+    return memory;
+}
+
+/**********************************************************************/
+/* Call Scope */
+/**********************************************************************/
+
+/**
+ * Function: redis_arena_begin
+ * Description: Counts a connection taken by the current thread.
+ */
+void redis_arena_begin(void)
+{
+    RedisArena *arena = thread_arena();
+
+    if (arena != NULL)
+        arena->held++;
+}
+
+/**
+ * Function: redis_arena_end
+ * Description: Counts a released connection. When the thread holds none
+ *              any more and no fan-out is in progress, the call is over
+ *              and the arena is reset.
+ * Parameters:
+ *   - connection: 1 if a connection was released, 0 for a call that ends
+ *     without one (e.g., after a fan-out).
+ */
+void redis_arena_end(int connection)
+{
+    RedisArena *arena = thread_arena();
+
+    if (arena == NULL)
+        return;
+    if (connection && arena->held > 0)
+        arena->held--;
+    if (arena->held == 0 && arena->pins == 0)
+        reset_arena(arena);
+}
+
+/**
+ * Function: redis_arena_pin
+ * Description: Keeps the arena from being reset while a fan-out or a slot
+ *              map load takes and releases connections in the middle of
+ *              a call.
+ */
+void redis_arena_pin(void)
+{
+    RedisArena *arena = thread_arena();
+
+    if (arena != NULL)
+        arena->pins++;
+}
+
+/**
+ * Function: redis_arena_unpin
+ * Description: Ends redis_arena_pin. The arena is reset by the release
+ *              that ends the call, not here.
+ */
+void redis_arena_unpin(void)
+{
+    RedisArena *arena = thread_arena();
+
+    if (arena != NULL && arena->pins > 0)
+        arena->pins--;
+}
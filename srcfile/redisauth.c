@@ -4,7 +4,8 @@
  * Date: 2025-02-22
  * Description: Implementation of the Redis AUTH function for IBM i.
  *              This function authenticates with a Redis server using a password.
- *              Returns "OK" on successful authentication.
+ *              Returns "OK" on successful authentication. The password is
+ *              then reused by the handshake of every pooled connection.
  *              The function is designed to be used in an ILE environment and
  *              interacts with a Redis server via TCP/IP.
  * License: MIT (https://opensource.org/licenses/MIT)
@@ -138,24 +139,24 @@ void SQL_API_FN authRedis(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send AUTH command to Redis
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response from Redis
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -169,7 +170,7 @@ void SQL_API_FN authRedis(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -177,7 +178,7 @@ void SQL_API_FN authRedis(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
@@ -190,7 +191,7 @@ void SQL_API_FN authRedis(
         strcpy(sqlstate, "38907");
         strcpy(msgtext, "Failed to convert response to EBCDIC");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_payload[total_len] = '\0';
@@ -207,6 +208,10 @@ void SQL_API_FN authRedis(
             strncpy(value, payload, payload_length);
             value[payload_length] = '\0';
             *valueInd = 0;
+
+            // Authenticate every connection opened later in this job as well
+            if (ebcdic_payload[0] == 0x4E) // EBCDIC '+' simple string reply
+                set_redis_password(password);
         }
         else
         {
@@ -228,7 +233,7 @@ void SQL_API_FN authRedis(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(authRedis, OS)
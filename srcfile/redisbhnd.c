@@ -0,0 +1,631 @@
+/******************************************************************************
+ * File: redisbhnd.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Write-behind queue of the REDISILE service program and the
+ *              REDIS_WRITE_BEHIND function for IBM i.
+ *              With write-behind on, REDIS_SET, REDIS_HSET, REDIS_HSET_MANY,
+ *              REDIS_INCRBY and REDIS_EXPIRE do not wait for Redis: the
+ *              encoded command is appended to a queue of the job and the
+ *              function returns.
+ *              A flusher thread takes everything queued at once and writes
+ *              it to Redis as one pipeline per node, reading the replies
+ *              while the next commands are being queued. Error replies and
+ *              lost commands are counted and reported by REDIS_FLUSH.
+ *              Any other command of the job first waits until the queue
+ *              is empty, so the job always sees its own writes in order.
+ *              Coalesced counters (see rediscoal.c) are written through
+ *              the same queue; the flusher drains them once the oldest is
+ *              REDIS_COALESCE_MS old.
+ *              When the job cannot start threads, the queue is sent by
+ *              the caller that fills it and by REDIS_FLUSH.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define BEHIND_BUFFER 65536 // Initial size of a queue buffer
+#define BEHIND_REPLY 65536  // Replies read at once from a connection
+
+/**********************************************************************/
+/* Queue */
+/**********************************************************************/
+
+// Commands of one endpoint (ASCII, back to back)
+typedef struct
+{
+    char *buf;
+    size_t len;
+    size_t size;
+    int count;
+} BehindQueue;
+
+static BehindQueue filling[REDIS_MAX_ENDPOINTS]; // Appended to by the functions
+static BehindQueue sending[REDIS_MAX_ENDPOINTS]; // Being written by the sender
+static size_t queued_bytes = 0;                  // Bytes in filling[]
+static volatile int queued = 0;                  // Commands in filling[]
+static volatile int in_flight = 0;               // Commands in sending[]
+static int enabled = 0;                          // REDIS_WRITE_BEHIND('ON')
+static int flusher_state = 0;                    // 0 not started, 1 running, -1 no threads
+static int sender_active = 0;                    // 1 while a thread writes sending[]
+static pthread_t sender;                         // That thread
+static pthread_t flusher_thread;                 // The flusher, when flusher_state is 1
+static int counters_added = 0;                   // A counter table started filling
+static long long failed = 0;                     // Failed since the last REDIS_FLUSH
+static char first_error[71];                     // First of them (EBCDIC)
+static char reply_buf[BEHIND_REPLY];             // Replies, used by the sender only
+static pthread_mutex_t behind_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t behind_work = PTHREAD_COND_INITIALIZER; // Commands were queued
+static pthread_cond_t behind_done = PTHREAD_COND_INITIALIZER; // The queue was taken or written
+
+/**
+ * Function: note_failure
+ * Description: Counts commands that failed and keeps the first error.
+ * Parameters:
+ *   - count: Number of commands.
+ *   - text: Error text.
+ *   - len: Length of the text.
+ *   - ascii: 1 if the text is ASCII (an error reply), 0 if EBCDIC.
+ */
+static void note_failure(int count, const char *text, size_t len, int ascii)
+{
+    pthread_mutex_lock(&behind_lock);
+    failed += count;
+    if (first_error[0] == '\0')
+    {
+        if (len > sizeof(first_error) - 1)
+            len = sizeof(first_error) - 1;
+        if (!ascii)
+            memcpy(first_error, text, len);
+        else if (ConvertToEBCDIC((char *)text, len, first_error, sizeof(first_error) - 1) < 0)
+            len = 0;
+        first_error[len] = '\0';
+    }
+    pthread_mutex_unlock(&behind_lock);
+}
+
+/**
+ * Function: read_replies
+ * Description: Reads the replies of a pipeline and counts the error
+ *              replies among them.
+ * Parameters:
+ *   - sockfd: Connection the pipeline was written to.
+ *   - count: Number of replies.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Replies left unread: 0 on success.
+ */
+static int read_replies(int sockfd, int count, char *sqlstate, char *msgtext)
+{
+    RedisReplyItem item;
+    size_t len = 0, pos, item_pos;
+    long span = 0;
+    int got;
+
+    while (count > 0)
+    {
+        pos = 0;
+        while (count > 0 && (span = redis_reply_span(reply_buf, len, pos)) >= 0)
+        {
+            if (reply_buf[pos] == 0x2D) // ASCII '-' error reply
+            {
+                item_pos = pos;
+                if (redis_reply_item(reply_buf, len, &item_pos, &item) == 0)
+                    note_failure(1, item.data, item.len, 1);
+                else
+                    note_failure(1, "", 0, 1);
+            }
+            pos = (size_t)span;
+            count--;
+        }
+        if (count == 0)
+            break;
+        if (span == -2)
+        {
+            strncpy(sqlstate, "38909", 5);
+            strncpy(msgtext, "Failed to parse Redis response", 70);
+            return count;
+        }
+        memmove(reply_buf, reply_buf + pos, len - pos);
+        len -= pos;
+        if (len == BEHIND_REPLY)
+        {
+            strncpy(sqlstate, "38908", 5);
+            strncpy(msgtext, "Reply exceeds the write-behind reply buffer", 70);
+            return count;
+        }
+
+        got = recv_redis_stream(sockfd, reply_buf + len, BEHIND_REPLY - len);
+        if (got < 0)
+        {
+            strncpy(sqlstate, errno == EWOULDBLOCK || errno == EAGAIN ? "38904" : "38905", 5);
+            snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d", errno);
+            return count;
+        }
+        if (got == 0)
+        {
+            strncpy(sqlstate, "38906", 5);
+            strncpy(msgtext, "Connection closed by Redis", 70);
+            return count;
+        }
+        len += got;
+    }
+    return 0;
+}
+
+/**
+ * Function: write_queue
+ * Description: Writes the commands of one endpoint as a single pipeline
+ *              and reads their replies. Commands that cannot be written or
+ *              answered are counted as failed.
+ * Parameters:
+ *   - endpoint: Endpoint index.
+ *   - queue: Commands to write; emptied.
+ */
+static void write_queue(int endpoint, BehindQueue *queue)
+{
+    char sqlstate[6] = "00000", msgtext[71] = "";
+    int sockfd, lost;
+
+    if (connect_to_redis_endpoint(&sockfd, endpoint) != 0)
+    {
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        note_failure(queue->count, msgtext, strlen(msgtext), 0);
+    }
+    else
+    {
+        if (send_redis_command(sockfd, queue->buf, queue->len) < 0)
+        {
+            strcpy(sqlstate, "38903");
+            snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+            lost = queue->count;
+        }
+        else
+        {
+            lost = read_replies(sockfd, queue->count, sqlstate, msgtext);
+        }
+        if (lost > 0)
+            note_failure(lost, msgtext, strlen(msgtext), 0);
+        release_redis_connection(sockfd, sqlstate);
+    }
+    queue->len = 0;
+    queue->count = 0;
+}
+
+/**
+ * Function: write_queued
+ * Description: Takes everything queued and writes it to Redis. Only one
+ *              thread writes at a time. Caller holds behind_lock; it is
+ *              released while writing.
+ */
+static void write_queued(void)
+{
+    BehindQueue swap;
+    int i;
+
+    sender_active = 1;
+    sender = pthread_self();
+    for (i = 0; i < REDIS_MAX_ENDPOINTS; i++)
+    {
+        swap = sending[i];
+        sending[i] = filling[i];
+        filling[i] = swap;
+    }
+    in_flight = queued;
+    queued = 0;
+    queued_bytes = 0;
+    pthread_cond_broadcast(&behind_done); // Room in the queue again
+    pthread_mutex_unlock(&behind_lock);
+
+    for (i = 0; i < REDIS_MAX_ENDPOINTS; i++)
+    {
+        if (sending[i].count > 0)
+            write_queue(i, &sending[i]);
+    }
+
+    pthread_mutex_lock(&behind_lock);
+    in_flight = 0;
+    sender_active = 0;
+    pthread_cond_broadcast(&behind_done);
+}
+
+/**
+ * Function: write_queued_here
+ * Description: Writes the queue in the calling function, when there is no
+ *              flusher thread. The connections it takes and releases must
+ *              not end the call: its arena is pinned so the caller's
+ *              buffers (e.g., the command being queued) stay valid.
+ *              Caller holds behind_lock.
+ */
+static void write_queued_here(void)
+{
+    redis_arena_pin();
+    write_queued();
+    redis_arena_unpin();
+}
+
+/**
+ * Function: drain_counters
+ * Description: Queues the coalesced counters, counting those that could
+ *              not be queued as failed. Caller holds no lock.
+ * Parameters:
+ *   - wait: 1 to wait for a drain of another thread, 0 to leave the
+ *     counters to it.
+ */
+static void drain_counters(int wait)
+{
+    char sqlstate[6] = "00000", msgtext[71] = "";
+    int lost;
+
+    lost = redis_coalesce_drain(wait, sqlstate, msgtext);
+    if (lost > 0)
+        note_failure(lost, msgtext, strlen(msgtext), 0);
+}
+
+/**
+ * Function: on_flusher
+ * Description: Tells whether the calling thread is the flusher, which must
+ *              not wait for a queue that only it writes.
+ * Returns:
+ *   - 1 on the flusher thread, 0 otherwise.
+ */
+static int on_flusher(void)
+{
+    return flusher_state == 1 && pthread_equal(flusher_thread, pthread_self());
+}
+
+/**
+ * Function: flusher
+ * Description: Flusher thread: writes the queue whenever commands are
+ *              waiting in it, and queues the coalesced counters once the
+ *              oldest is REDIS_COALESCE_MS old.
+ * Parameters:
+ *   - arg: Not used.
+ * Returns:
+ *   - Never returns.
+ */
+static void *flusher(void *arg)
+{
+    struct timeval now;
+    struct timespec until;
+    long due;
+
+    for (;;)
+    {
+        // Counters of a job that stopped incrementing go out on time
+        due = redis_coalesce_due();
+        if (due == 0)
+        {
+            drain_counters(0);
+            due = redis_coalesce_due();
+        }
+
+        // Sleep until commands are queued, a counter table starts filling
+        // or the oldest counter is due
+        pthread_mutex_lock(&behind_lock);
+        if (queued == 0 && !counters_added && due < 0)
+        {
+            pthread_cond_wait(&behind_work, &behind_lock);
+        }
+        else if (queued == 0 && !counters_added)
+        {
+            gettimeofday(&now, NULL);
+            until.tv_sec = now.tv_sec + due / 1000;
+            until.tv_nsec = (now.tv_usec + due % 1000 * 1000L) * 1000L;
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&behind_work, &behind_lock, &until);
+        }
+        counters_added = 0;
+        if (queued > 0)
+            write_queued();
+        pthread_mutex_unlock(&behind_lock);
+    }
+    return NULL;
+}
+
+/**
+ * Function: start_flusher
+ * Description: Starts the flusher thread on first use. Caller holds
+ *              behind_lock.
+ */
+static void start_flusher(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (flusher_state != 0)
+        return;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // A job without multiple thread support sends the queue itself
+    flusher_state = pthread_create(&thread, &attr, flusher, NULL) == 0 ? 1 : -1;
+    flusher_thread = thread;
+    pthread_attr_destroy(&attr);
+}
+
+/**
+ * Function: wait_written
+ * Description: Waits until everything queued has been written and
+ *              answered. Caller holds behind_lock.
+ */
+static void wait_written(void)
+{
+    while (queued > 0 || in_flight > 0)
+    {
+        if (flusher_state != 1 && !sender_active)
+            write_queued_here();
+        else
+            pthread_cond_wait(&behind_done, &behind_lock);
+    }
+}
+
+/**
+ * Function: grow_queue
+ * Description: Makes room for a command in a queue buffer.
+ * Returns:
+ *   - 0 on success, -1 if out of memory.
+ */
+static int grow_queue(BehindQueue *queue, size_t len)
+{
+    size_t size;
+    char *buf;
+
+    if (queue->size - queue->len >= len)
+        return 0;
+    size = queue->size == 0 ? BEHIND_BUFFER : queue->size;
+    while (size - queue->len < len)
+        size *= 2;
+    buf = realloc(queue->buf, size);
+    if (buf == NULL)
+        return -1;
+    queue->buf = buf;
+    queue->size = size;
+    return 0;
+}
+
+/**********************************************************************/
+/* Write-Behind API */
+/**********************************************************************/
+
+/**
+ * Function: set_redis_write_behind
+ * Description: Switches write-behind on or off for the job. Switching it
+ *              off waits until the queue has been written.
+ * Parameters:
+ *   - on: 1 to queue writes, 0 to send them synchronously.
+ * Returns:
+ *   - The previous setting.
+ */
+int set_redis_write_behind(int on)
+{
+    int previous;
+
+    pthread_mutex_lock(&behind_lock);
+    previous = enabled;
+    enabled = on;
+    if (on)
+        start_flusher();
+    else
+        wait_written();
+    pthread_mutex_unlock(&behind_lock);
+    return previous;
+}
+
+/**
+ * Function: redis_write_behind_enabled
+ * Description: Tells whether writes are queued for the job.
+ * Returns:
+ *   - 1 if write-behind is on, 0 otherwise.
+ */
+int redis_write_behind_enabled(void)
+{
+    return enabled;
+}
+
+/**
+ * Function: redis_write_behind_queue
+ * Description: Queues an encoded command for the node owning its key. The
+ *              caller waits only when REDIS_WRITE_BEHIND_QUEUE bytes are
+ *              already queued, until the flusher has taken them. The
+ *              caller must not hold any other lock (e.g., coalesce_lock):
+ *              the flusher takes them between two writes.
+ * Parameters:
+ *   - key: Redis key of the command (EBCDIC, null-terminated).
+ *   - cmd: Command (ASCII).
+ *   - len: Length of the command.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_write_behind_queue(const char *key, const char *cmd, size_t len,
+                             char *sqlstate, char *msgtext)
+{
+    static size_t limit = 0;
+    int endpoint = redis_endpoint_for_key(key, strlen(key));
+    BehindQueue *queue;
+
+    if (endpoint < 0)
+        endpoint = 0; // The primary
+    if (limit == 0)
+        limit = (size_t)atol(REDIS_WRITE_BEHIND_QUEUE);
+
+    pthread_mutex_lock(&behind_lock);
+    start_flusher();
+    while (queued_bytes > 0 && queued_bytes + len > limit)
+    {
+        if ((flusher_state != 1 || on_flusher()) && !sender_active)
+            write_queued_here();
+        else
+            pthread_cond_wait(&behind_done, &behind_lock);
+    }
+    queue = &filling[endpoint];
+    if (grow_queue(queue, len) != 0)
+    {
+        pthread_mutex_unlock(&behind_lock);
+        strncpy(sqlstate, "38902", 5);
+        strncpy(msgtext, "Out of memory for the write-behind queue", 70);
+        return -1;
+    }
+    memcpy(queue->buf + queue->len, cmd, len);
+    queue->len += len;
+    queue->count++;
+    queued_bytes += len;
+    queued++;
+    if (queued == 1)
+        pthread_cond_signal(&behind_work);
+    pthread_mutex_unlock(&behind_lock);
+    return 0;
+}
+
+/**
+ * Function: redis_write_behind_flush
+ * Description: Waits until everything queued has been written and
+ *              answered, and returns the failures since the last flush.
+ * Parameters:
+ *   - error: Receives the first error (EBCDIC, 71 bytes), empty if none.
+ * Returns:
+ *   - Number of commands answered with an error or lost with their
+ *     connection since the last flush.
+ */
+long long redis_write_behind_flush(char *error)
+{
+    long long count;
+
+    // Coalesced counters go out with the queue; any left stay pending
+    drain_counters(1);
+    pthread_mutex_lock(&behind_lock);
+    wait_written();
+    count = failed;
+    strcpy(error, first_error);
+    failed = 0;
+    first_error[0] = '\0';
+    pthread_mutex_unlock(&behind_lock);
+    return count;
+}
+
+/**
+ * Function: redis_write_behind_barrier
+ * Description: Makes a command wait for the writes queued before it,
+ *              coalesced counters included. Does nothing when nothing is
+ *              pending, for the thread writing the queue or for the
+ *              flusher.
+ */
+void redis_write_behind_barrier(void)
+{
+    if (queued == 0 && in_flight == 0 && redis_coalesce_pending() == 0)
+        return;
+    pthread_mutex_lock(&behind_lock);
+    if ((sender_active && pthread_equal(sender, pthread_self())) || on_flusher())
+    {
+        pthread_mutex_unlock(&behind_lock);
+        return;
+    }
+    pthread_mutex_unlock(&behind_lock);
+
+    drain_counters(1);
+    pthread_mutex_lock(&behind_lock);
+    wait_written();
+    pthread_mutex_unlock(&behind_lock);
+}
+
+/**
+ * Function: redis_write_behind_wake
+ * Description: Wakes the flusher thread, starting it if needed, so that
+ *              it sets its timer for the coalesced counters.
+ */
+void redis_write_behind_wake(void)
+{
+    pthread_mutex_lock(&behind_lock);
+    start_flusher();
+    counters_added = 1;
+    pthread_cond_signal(&behind_work);
+    pthread_mutex_unlock(&behind_lock);
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: writeBehindRedis
+ * Description: SQL external function switching write-behind on or off for
+ *              the job. Switching it off waits for the queued writes.
+ * Parameters:
+ *   - mode: Input mode, 'ON' or 'OFF' (VARCHAR(3), EBCDIC).
+ *   - value: Output previous mode (VARCHAR(3), EBCDIC).
+ *   - modeInd: Null indicator for the input mode.
+ *   - valueInd: Null indicator for the output value.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN writeBehindRedis(
+    SQLUDF_VARCHAR *mode,     // Input: 'ON' or 'OFF' (EBCDIC)
+    SQLUDF_VARCHAR *value,    // Output: previous mode (EBCDIC)
+    SQLUDF_NULLIND *modeInd,  // Null indicator for input
+    SQLUDF_NULLIND *valueInd, // Null indicator for output
+    char *sqlstate,           // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,           // Fully qualified function name
+    char *specname,           // Specific name
+    char *msgtext,            // Error message text (up to 70 chars)
+    short *sqlcode,           // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
+{
+    int on;
+
+    // Check for NULL input mode
+    if (*modeInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input mode is NULL");
+        *valueInd = -1;
+        return;
+    }
+
+    if (strcmp(mode, "\xD6\xD5") == 0) // EBCDIC "ON"
+    {
+        on = 1;
+    }
+    else if (strcmp(mode, "\xD6\xC6\xC6") == 0) // EBCDIC "OFF"
+    {
+        on = 0;
+    }
+    else
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Mode must be ON or OFF");
+        *valueInd = -1;
+        return;
+    }
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+    if (set_redis_write_behind(on))
+        strcpy(value, "\xD6\xD5"); // EBCDIC "ON"
+    else
+        strcpy(value, "\xD6\xC6\xC6"); // EBCDIC "OFF"
+    *valueInd = 0;
+}
+
+#pragma linkage(writeBehindRedis, OS)
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * File: redisblmv.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the Redis BLMOVE function for IBM i.
+ *              Moves an element from one list to another, waiting for the
+ *              source to receive one if it is empty: the reliable-queue
+ *              pattern, where the element stays in a processing list until
+ *              the consumer removes it. Returns NULL on timeout.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define MOVE_VALUE 16370 // Length of the result
+
+/**********************************************************************/
+/* SQL External Function: BLMOVE */
+/**********************************************************************/
+
+/**
+ * Function: blmoveRedisList
+ * Description: SQL external function to move the element at one end of a
+ *              list to one end of another, waiting up to TIMEOUT seconds
+ *              for the source to receive an element.
+ * Parameters:
+ *   - source: Input list to take from (EBCDIC).
+ *   - destination: Input list to push to (EBCDIC). In cluster mode it
+ *     must be in the slot of source (e.g., with a {tag}).
+ *   - timeout: Input seconds to wait (fractions allowed), 0 for no limit.
+ *   - wherefrom: Input end of source, LEFT (the default) or RIGHT.
+ *   - whereto: Input end of destination, RIGHT (the default) or LEFT.
+ *   - value: Output element moved (EBCDIC); NULL on timeout.
+ *   - *Ind: Null indicators for the inputs and output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38911" is an error
+ *     reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (not used).
+ *   - nullind: Additional null indicators (not used).
+ */
+void SQL_API_FN blmoveRedisList(
+    SQLUDF_VARCHAR *source,           // Input: source list (EBCDIC)
+    SQLUDF_VARCHAR *destination,      // Input: destination list (EBCDIC)
+    SQLUDF_DOUBLE *timeout,           // Input: seconds to wait
+    SQLUDF_VARCHAR *wherefrom,        // Input: LEFT or RIGHT (EBCDIC)
+    SQLUDF_VARCHAR *whereto,          // Input: LEFT or RIGHT (EBCDIC)
+    SQLUDF_VARCHAR *value,            // Output: element moved (EBCDIC)
+    SQLUDF_NULLIND *sourceInd,        // Null indicators for inputs
+    SQLUDF_NULLIND *destinationInd,
+    SQLUDF_NULLIND *timeoutInd,
+    SQLUDF_NULLIND *wherefromInd,
+    SQLUDF_NULLIND *wheretoInd,
+    SQLUDF_NULLIND *valueInd,         // Null indicator for output
+    char *sqlstate,                   // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                   // Fully qualified function name
+    char *specname,                   // Specific name
+    char *msgtext,                    // Error message text (up to 70 chars)
+    short *sqlcode,                   // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)          // Additional null indicators for DB2SQL
+{
+    char reply[MOVE_VALUE + 64], timeout_text[REDIS_DOUBLE_TEXT];
+    const char *argv[6];
+    size_t argl[6], pos = 0;
+    RedisReplyItem item;
+    int sockfd, from_left = 1, to_left = 0, len;
+
+    *valueInd = -1;
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    if (*sourceInd < 0 || *destinationInd < 0 || *timeoutInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input source, destination or timeout is NULL");
+        return;
+    }
+    if (*timeout < 0.0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Input timeout must not be negative");
+        return;
+    }
+    if ((*wherefromInd >= 0 && parse_redis_direction(wherefrom, &from_left) != 0) ||
+        (*wheretoInd >= 0 && parse_redis_direction(whereto, &to_left) != 0))
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Input directions must be LEFT or RIGHT");
+        return;
+    }
+
+    // BLMOVE source destination LEFT|RIGHT LEFT|RIGHT timeout
+    argv[0] = "\xC2\xD3\xD4\xD6\xE5\xC5"; // EBCDIC "BLMOVE"
+    argl[0] = 6;
+    argv[1] = source;
+    argl[1] = strlen(source);
+    argv[2] = destination;
+    argl[2] = strlen(destination);
+    argv[3] = from_left ? "\xD3\xC5\xC6\xE3" : "\xD9\xC9\xC7\xC8\xE3"; // LEFT, RIGHT
+    argl[3] = from_left ? 4 : 5;
+    argv[4] = to_left ? "\xD3\xC5\xC6\xE3" : "\xD9\xC9\xC7\xC8\xE3";
+    argl[4] = to_left ? 4 : 5;
+    argv[5] = timeout_text;
+    argl[5] = format_ebcdic_timeout(*timeout, timeout_text);
+
+    len = execute_redis_blocking(&sockfd, 6, argv, argl, 1, *timeout, reply, sizeof(reply), sqlstate, msgtext);
+    if (len < 0)
+        return;
+
+    if (redis_reply_item(reply, len, &pos, &item) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+    }
+    else if (item.type == 0x2D) // ASCII '-' error reply (e.g., WRONGTYPE)
+    {
+        len = item.len < 70 ? (int)item.len : 70;
+        ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+        msgtext[len] = '\0';
+        strcpy(sqlstate, "38911");
+    }
+    else if (!item.nil) // Nil when the timeout expired
+    {
+        ConvertToEBCDIC((char *)item.data, item.len, value, MOVE_VALUE + 1);
+        value[item.len] = '\0';
+        *valueInd = 0;
+    }
+    release_redis_connection(sockfd, sqlstate);
+}
+
+#pragma linkage(blmoveRedisList, OS)
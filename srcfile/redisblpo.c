@@ -0,0 +1,207 @@
+/******************************************************************************
+ * File: redisblpo.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Blocking dequeue for IBM i: pops one element with BLPOP or
+ *              BRPOP, waiting on the connection until an element arrives
+ *              or the timeout expires, for the REDIS_BLPOP and REDIS_BRPOP
+ *              table functions, and the REDIS_BLPOP function itself. The
+ *              connection waits for the command's timeout instead of the
+ *              normal receive timeout (see execute_redis_blocking).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define BLOCK_KEY 255     // Length of the KEY column
+#define BLOCK_VALUE 16370 // Length of the VALUE column
+#define BLOCK_KEYS 64     // Lists of one call
+
+/**
+ * Function: redis_block_pop
+ * Description: Pops one element from the first non-empty list with BLPOP
+ *              or BRPOP, waiting up to timeout seconds for one to arrive.
+ * Parameters:
+ *   - keys: The lists, blank-separated, tried in order (EBCDIC). The first
+ *     routes the call in cluster or sharded mode; all must be in one slot.
+ *   - left: 1 for BLPOP (head), 0 for BRPOP (tail).
+ *   - timeout: Seconds to wait, 0 to wait without limit.
+ *   - key: Receives the list popped from (EBCDIC).
+ *   - value: Receives the element (EBCDIC).
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 1 for an element, 0 when the timeout expired, -1 on failure.
+ */
+int redis_block_pop(const char *keys, int left, double timeout, char *key, char *value, char *sqlstate,
+                    char *msgtext)
+{
+    char reply[BLOCK_KEY + BLOCK_VALUE + 64], timeout_text[REDIS_DOUBLE_TEXT], words[2 * 4096 + 2];
+    const char *argv[BLOCK_KEYS + 2];
+    size_t argl[BLOCK_KEYS + 2], pos = 0;
+    RedisReplyItem list, element;
+    int sockfd, keyc, len, rc = -1;
+
+    if (timeout < 0.0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Input timeout must not be negative");
+        return -1;
+    }
+
+    // BLPOP|BRPOP key [key ...] timeout
+    argv[0] = left ? "\xC2\xD3\xD7\xD6\xD7" : "\xC2\xD9\xD7\xD6\xD7"; // EBCDIC "BLPOP", "BRPOP"
+    argl[0] = 5;
+    keyc = split_redis_keys(strlen(keys) <= 4096 ? keys : "", words, BLOCK_KEYS, argv + 1, argl + 1);
+    if (keyc <= 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, keyc == 0 ? "Input keys are empty" : keyc == -1 ? "Unterminated quote in keys"
+                                                                        : "Too many keys");
+        return -1;
+    }
+    argv[keyc + 1] = timeout_text;
+    argl[keyc + 1] = format_ebcdic_timeout(timeout, timeout_text);
+
+    len = execute_redis_blocking(&sockfd, keyc + 2, argv, argl, 1, timeout, reply, sizeof(reply), sqlstate,
+                                 msgtext);
+    if (len < 0)
+        return -1;
+
+    if (redis_reply_item(reply, len, &pos, &list) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+    }
+    else if (list.type == 0x2D) // ASCII '-' error reply (e.g., WRONGTYPE)
+    {
+        len = list.len < 70 ? (int)list.len : 70;
+        ConvertToEBCDIC((char *)list.data, len, msgtext, 70);
+        msgtext[len] = '\0';
+        strcpy(sqlstate, "38911");
+    }
+    else if (list.nil) // The timeout expired
+    {
+        rc = 0;
+    }
+    else if (list.type != 0x2A || list.len != 2 || redis_reply_item(reply, len, &pos, &list) != 0 ||
+             list.nil || redis_reply_item(reply, len, &pos, &element) != 0 || element.nil)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+    }
+    else if (list.len > BLOCK_KEY || element.len > BLOCK_VALUE)
+    {
+        // Too long for the columns (the reply buffer is sized for them)
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Value exceeds maximum length");
+    }
+    else
+    {
+        ConvertToEBCDIC((char *)list.data, list.len, key, BLOCK_KEY + 1);
+        key[list.len] = '\0';
+        ConvertToEBCDIC((char *)element.data, element.len, value, BLOCK_VALUE + 1);
+        value[element.len] = '\0';
+        rc = 1;
+    }
+    release_redis_connection(sockfd, sqlstate);
+    return rc;
+}
+
+/**********************************************************************/
+/* SQL External Function: BLPOP */
+/**********************************************************************/
+
+/**
+ * Function: blpopRedis
+ * Description: SQL external table function to pop the first element of
+ *              the first non-empty list, waiting up to TIMEOUT seconds for
+ *              one to be pushed. Returns one row, or none on timeout.
+ * Parameters:
+ *   - keys: Input lists, blank-separated, tried in order (EBCDIC). In
+ *     cluster mode they must hash to one slot (e.g., with a {tag}).
+ *   - timeout: Input seconds to wait (fractions allowed), 0 for no limit.
+ *   - key: Output list the element was popped from (EBCDIC).
+ *   - value: Output element (EBCDIC).
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad remembering that the row was returned.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN blpopRedis(
+    SQLUDF_VARCHAR *keys,           // Input: lists (EBCDIC)
+    SQLUDF_DOUBLE *timeout,         // Input: seconds to wait
+    SQLUDF_VARCHAR *key,            // Output: list popped from (EBCDIC)
+    SQLUDF_VARCHAR *value,          // Output: element (EBCDIC)
+    SQLUDF_NULLIND *keysInd,        // Null indicators for inputs
+    SQLUDF_NULLIND *timeoutInd,
+    SQLUDF_NULLIND *keyInd,         // Null indicators for outputs
+    SQLUDF_NULLIND *valueInd,
+    char *sqlstate,                 // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                 // Fully qualified function name
+    char *specname,                 // Specific name
+    char *msgtext,                  // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,  // Whether the row was returned
+    SQLUDF_CALL_TYPE *calltype)     // Open, fetch or close
+{
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+        scratchpad->data[0] = 0; // Row not returned yet
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+    if (scratchpad->data[0])
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+    scratchpad->data[0] = 1;
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+    if (*keysInd < 0 || *timeoutInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input keys or timeout is NULL");
+        return;
+    }
+
+    // The wait happens on the first fetch; a timeout ends the table at once
+    switch (redis_block_pop(keys, 1, *timeout, key, value, sqlstate, msgtext))
+    {
+    case 1:
+        *keyInd = 0;
+        *valueInd = 0;
+        break;
+    case 0:
+        strcpy(sqlstate, "02000");
+        break;
+    }
+}
+
+#pragma linkage(blpopRedis, OS)
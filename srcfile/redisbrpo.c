@@ -0,0 +1,109 @@
+/******************************************************************************
+ * File: redisbrpo.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_BRPOP table function for IBM i.
+ *              Removes and returns the last element of the first non-empty
+ *              list, waiting for one to be pushed (see redisblpo.c).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+/**********************************************************************/
+/* SQL External Function: BRPOP */
+/**********************************************************************/
+
+/**
+ * Function: brpopRedis
+ * Description: SQL external table function to pop the last element of
+ *              the first non-empty list, waiting up to TIMEOUT seconds for
+ *              one to be pushed. Returns one row, or none on timeout.
+ * Parameters:
+ *   - keys: Input lists, blank-separated, tried in order (EBCDIC). In
+ *     cluster mode they must hash to one slot (e.g., with a {tag}).
+ *   - timeout: Input seconds to wait (fractions allowed), 0 for no limit.
+ *   - key: Output list the element was popped from (EBCDIC).
+ *   - value: Output element (EBCDIC).
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad remembering that the row was returned.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN brpopRedis(
+    SQLUDF_VARCHAR *keys,           // Input: lists (EBCDIC)
+    SQLUDF_DOUBLE *timeout,         // Input: seconds to wait
+    SQLUDF_VARCHAR *key,            // Output: list popped from (EBCDIC)
+    SQLUDF_VARCHAR *value,          // Output: element (EBCDIC)
+    SQLUDF_NULLIND *keysInd,        // Null indicators for inputs
+    SQLUDF_NULLIND *timeoutInd,
+    SQLUDF_NULLIND *keyInd,         // Null indicators for outputs
+    SQLUDF_NULLIND *valueInd,
+    char *sqlstate,                 // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                 // Fully qualified function name
+    char *specname,                 // Specific name
+    char *msgtext,                  // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,  // Whether the row was returned
+    SQLUDF_CALL_TYPE *calltype)     // Open, fetch or close
+{
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+        scratchpad->data[0] = 0; // Row not returned yet
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+    if (scratchpad->data[0])
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+    scratchpad->data[0] = 1;
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+    if (*keysInd < 0 || *timeoutInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input keys or timeout is NULL");
+        return;
+    }
+
+    // The wait happens on the first fetch; a timeout ends the table at once
+    switch (redis_block_pop(keys, 0, *timeout, key, value, sqlstate, msgtext))
+    {
+    case 1:
+        *keyInd = 0;
+        *valueInd = 0;
+        break;
+    case 0:
+        strcpy(sqlstate, "02000");
+        break;
+    }
+}
+
+#pragma linkage(brpopRedis, OS)
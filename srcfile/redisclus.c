@@ -0,0 +1,816 @@
+/******************************************************************************
+ * File: redisclus.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Redis Cluster support for the REDISILE service program.
+ *              Keys are mapped to one of 16384 hash slots (CRC16 of the key,
+ *              or of its {hash tag}), the slot owners are loaded with
+ *              CLUSTER SLOTS from the seed node (REDIS_IP), -MOVED/-ASK
+ *              redirections are followed, and multi-key commands are split
+ *              by owner and fanned out to all nodes in parallel. The fan-out
+ *              also serves client-side sharding (redisshrd.c).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+/**********************************************************************/
+/* Slot Map */
+/**********************************************************************/
+
+typedef struct
+{
+    int slot;         // Hash slot (cluster) or shard shared by the keys
+    int endpoint;     // Node owning the slot
+    int conn;         // Index into the fan-out connections
+    int keys;         // Number of keys in the group
+    char *cmd;        // Encoded sub-command (ASCII)
+    size_t cmd_len;   // Length of the sub-command
+    char *reply;      // Reply to the sub-command (ASCII)
+    long reply_len;   // Length of the reply
+    long cursor;      // Next array element while merging
+    char *redirected; // Buffer owning the reply after a redirection
+} RedisSlotGroup;
+
+typedef struct
+{
+    int endpoint; // Node index
+    int sockfd;   // Pooled connection, -1 if not connected
+    int groups;   // Sub-commands pipelined on the connection
+    char *buf;    // Replies (ASCII)
+    int len;      // Length of the replies
+} RedisFanoutConn;
+
+static unsigned short crc16_table[256];
+static pthread_once_t crc16_once = PTHREAD_ONCE_INIT;
+static short slot_owner[REDIS_CLUSTER_SLOTS]; // Endpoint per slot (0 = seed node)
+static int slots_loaded = 0;                 // CLUSTER SLOTS was read
+static int slots_stale = 0;                  // A MOVED reply was seen since
+static int cluster_mode = -1;                // REDIS_CLUSTER, parsed once
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Function: init_crc16_table
+ * Description: Builds the CRC16-CCITT (XMODEM) table used for key slots.
+ */
+static void init_crc16_table(void)
+{
+    unsigned short crc;
+    int i, bit;
+
+    for (i = 0; i < 256; i++)
+    {
+        crc = (unsigned short)(i << 8);
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x1021) : (unsigned short)(crc << 1);
+        crc16_table[i] = crc;
+    }
+}
+
+/**
+ * Function: crc16
+ * Description: Computes the CRC16 of a buffer as Redis Cluster does.
+ * Parameters:
+ *   - buf: Data (ASCII).
+ *   - len: Length of the data.
+ * Returns:
+ *   - CRC16 value.
+ */
+static unsigned short crc16(const unsigned char *buf, size_t len)
+{
+    unsigned short crc = 0;
+    size_t i;
+
+    pthread_once(&crc16_once, init_crc16_table);
+    for (i = 0; i < len; i++)
+        crc = (unsigned short)((crc << 8) ^ crc16_table[((crc >> 8) ^ buf[i]) & 0xFF]);
+    return crc;
+}
+
+/**
+ * Function: redis_hash_tag
+ * Description: Returns the part of a key that is hashed: the text between
+ *              the first '{' and the next '}' when it is not empty, else
+ *              the whole key.
+ * Parameters:
+ *   - ascii: Redis key (ASCII).
+ *   - len: Length of the key.
+ *   - offset: Receives the offset of the hashed part.
+ * Returns:
+ *   - Length of the hashed part.
+ */
+size_t redis_hash_tag(const unsigned char *ascii, size_t len, size_t *offset)
+{
+    size_t open, close;
+
+    for (open = 0; open < len && ascii[open] != 0x7B; open++) // ASCII '{'
+        ;
+    for (close = open + 1; close < len && ascii[close] != 0x7D; close++) // ASCII '}'
+        ;
+    if (open < len && close < len && close > open + 1)
+    {
+        *offset = open + 1;
+        return close - open - 1;
+    }
+    *offset = 0;
+    return len;
+}
+
+/**
+ * Function: redis_key_slot
+ * Description: Returns the hash slot of a key. When the key contains a
+ *              non-empty {hash tag}, only the tag is hashed so that related
+ *              keys land on the same node.
+ * Parameters:
+ *   - key: Redis key (EBCDIC).
+ *   - len: Length of the key.
+ * Returns:
+ *   - Slot number (0-16383).
+ */
+static int redis_key_slot(const char *key, size_t len)
+{
+    char small[256];
+    unsigned char *ascii = (unsigned char *)small;
+    size_t offset, hashed;
+    int slot;
+
+    // The server hashes the ASCII bytes, so the key is converted first
+    if (len > sizeof(small))
+    {
+        ascii = malloc(len);
+        if (ascii == NULL)
+            return 0;
+    }
+    ConvertToASCII((char *)key, len, (char *)ascii, len);
+
+    hashed = redis_hash_tag(ascii, len, &offset);
+    slot = crc16(ascii + offset, hashed) % REDIS_CLUSTER_SLOTS;
+
+    if (ascii != (unsigned char *)small)
+        free(ascii);
+    return slot;
+}
+
+/**
+ * Function: parse_ascii_number
+ * Description: Parses a RESP header number ("<digits>\r\n", ASCII) and
+ *              moves past its CRLF.
+ * Parameters:
+ *   - buf: Reply buffer (ASCII).
+ *   - len: Length of the reply.
+ *   - pos: Offset of the first digit; updated past the CRLF.
+ *   - value: Receives the number.
+ * Returns:
+ *   - 0 on success, negative value if the header is malformed.
+ */
+static int parse_ascii_number(const char *buf, size_t len, size_t *pos, long *value)
+{
+    size_t p = *pos;
+    long number = 0;
+    int negative = 0;
+
+    if (p < len && buf[p] == 0x2D) // ASCII '-'
+    {
+        negative = 1;
+        p++;
+    }
+    while (p < len && buf[p] >= 0x30 && buf[p] <= 0x39)
+        number = number * 10 + (buf[p++] - 0x30);
+    if (p + 1 >= len || buf[p] != 0x0D || buf[p + 1] != 0x0A)
+        return -1;
+    *value = negative ? -number : number;
+    *pos = p + 2;
+    return 0;
+}
+
+/**
+ * Function: native_address
+ * Description: Copies an address received from the server (ASCII) into the
+ *              job CCSID; an empty address means the seed node's host.
+ * Parameters:
+ *   - ascii: Address (ASCII, not null-terminated).
+ *   - len: Length of the address.
+ *   - out: Output buffer (null-terminated).
+ *   - size: Size of the output buffer.
+ * Returns:
+ *   - 0 on success, negative value if the address does not fit.
+ */
+static int native_address(const char *ascii, size_t len, char *out, size_t size)
+{
+    if (len == 0)
+    {
+        if (strlen(REDIS_SERVER_ADDR) >= size)
+            return -1;
+        strcpy(out, REDIS_SERVER_ADDR);
+        return 0;
+    }
+    if (len >= size)
+        return -1;
+#ifdef __OS400__
+    ConvertToEBCDIC((char *)ascii, len, out, size - 1);
+#else
+    memcpy(out, ascii, len);
+#endif
+    out[len] = '\0';
+    return 0;
+}
+
+/**
+ * Function: load_slot_map
+ * Description: Reads the slot owners with CLUSTER SLOTS from the seed node.
+ *              Slots that are not covered stay on the seed, which answers
+ *              with a redirection. Caller holds slot_lock.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int load_slot_map(void)
+{
+    // ASCII "*2\r\n$7\r\nCLUSTER\r\n$5\r\nSLOTS\r\n"
+    static const char cluster_slots[] =
+        "\x2A\x32\x0D\x0A\x24\x37\x0D\x0A\x43\x4C\x55\x53\x54\x45\x52\x0D\x0A"
+        "\x24\x35\x0D\x0A\x53\x4C\x4F\x54\x53\x0D\x0A";
+    char addr[64];
+    char *reply;
+    size_t pos;
+    long ranges, fields, start, end, node_fields, addr_len, port;
+    long next;
+    int sockfd, len, endpoint, i, j, rc = -1;
+
+    slots_loaded = 1;
+    slots_stale = 0;
+
+    reply = malloc(65536);
+    if (reply == NULL)
+        return -1;
+    redis_arena_pin(); // Runs inside the call that needed the map
+    if (connect_to_redis(&sockfd) != 0)
+    {
+        redis_arena_unpin();
+        free(reply);
+        return -1;
+    }
+    if (send_redis_command(sockfd, cluster_slots, sizeof(cluster_slots) - 1) < 0)
+    {
+        release_redis_connection(sockfd, "38903");
+        redis_arena_unpin();
+        free(reply);
+        return -1;
+    }
+    len = recv_redis_replies(sockfd, reply, 65536, 1);
+    release_redis_connection(sockfd, len > 0 ? "00000" : "38905");
+    redis_arena_unpin();
+
+    // *<ranges> of [start, end, [ip, port, id, ...] (master), replicas...]
+    pos = 1;
+    if (len <= 0 || reply[0] != 0x2A || parse_ascii_number(reply, len, &pos, &ranges) != 0)
+    {
+        free(reply);
+        return -1;
+    }
+    memset(slot_owner, 0, sizeof(slot_owner));
+    for (i = 0; i < ranges && pos < (size_t)len; i++)
+    {
+        if (reply[pos] != 0x2A)
+            break;
+        pos++;
+        if (parse_ascii_number(reply, len, &pos, &fields) != 0 || fields < 3)
+            break;
+        if (reply[pos] != 0x3A) // ASCII ':'
+            break;
+        pos++;
+        if (parse_ascii_number(reply, len, &pos, &start) != 0 || reply[pos] != 0x3A)
+            break;
+        pos++;
+        if (parse_ascii_number(reply, len, &pos, &end) != 0 || reply[pos] != 0x2A)
+            break;
+        pos++;
+        if (parse_ascii_number(reply, len, &pos, &node_fields) != 0 || node_fields < 2 ||
+            reply[pos] != 0x24) // ASCII '$'
+            break;
+        pos++;
+        if (parse_ascii_number(reply, len, &pos, &addr_len) != 0 || addr_len < 0 ||
+            pos + addr_len + 2 > (size_t)len)
+            break;
+        if (native_address(reply + pos, addr_len, addr, sizeof(addr)) != 0)
+            break;
+        pos += addr_len + 2;
+        if (reply[pos] != 0x3A)
+            break;
+        pos++;
+        if (parse_ascii_number(reply, len, &pos, &port) != 0)
+            break;
+
+        // Skip the node id and metadata, then the replicas
+        for (j = 2; j < node_fields; j++)
+        {
+            next = redis_reply_span(reply, len, pos);
+            if (next < 0)
+                break;
+            pos = next;
+        }
+        for (j = 3; j < fields; j++)
+        {
+            next = redis_reply_span(reply, len, pos);
+            if (next < 0)
+                break;
+            pos = next;
+        }
+
+        endpoint = find_redis_endpoint(addr, (int)port);
+        if (endpoint < 0 || start < 0 || end >= REDIS_CLUSTER_SLOTS)
+            continue;
+        for (j = start; j <= end; j++)
+            slot_owner[j] = (short)endpoint;
+        rc = 0;
+    }
+    free(reply);
+    return rc;
+}
+
+/**
+ * Function: slot_endpoint
+ * Description: Returns the node owning a slot, loading the slot map first
+ *              when it was never read or a MOVED reply made it stale.
+ * Parameters:
+ *   - slot: Hash slot.
+ * Returns:
+ *   - Endpoint index.
+ */
+static int slot_endpoint(int slot)
+{
+    int endpoint;
+
+    pthread_mutex_lock(&slot_lock);
+    if (!slots_loaded || slots_stale)
+        load_slot_map();
+    endpoint = slot_owner[slot];
+    pthread_mutex_unlock(&slot_lock);
+    return endpoint;
+}
+
+/**********************************************************************/
+/* Routing */
+/**********************************************************************/
+
+/**
+ * Function: redis_cluster_enabled
+ * Description: Tells whether REDIS_CLUSTER is switched on.
+ * Returns:
+ *   - 1 in cluster mode, 0 otherwise.
+ */
+int redis_cluster_enabled(void)
+{
+    if (cluster_mode < 0)
+        cluster_mode = atoi(REDIS_CLUSTER) != 0;
+    return cluster_mode;
+}
+
+/**
+ * Function: redis_sharding_enabled
+ * Description: Tells whether keys are spread over several nodes.
+ * Returns:
+ *   - 1 when keys are sharded, 0 otherwise.
+ */
+int redis_sharding_enabled(void)
+{
+    return redis_cluster_enabled() || redis_shards_enabled();
+}
+
+/**
+ * Function: redis_endpoint_for_key
+ * Description: Returns the endpoint that owns a key.
+ * Parameters:
+ *   - key: Redis key (EBCDIC).
+ *   - len: Length of the key.
+ * Returns:
+ *   - Endpoint index, negative value when keys are not sharded.
+ */
+int redis_endpoint_for_key(const char *key, size_t len)
+{
+    if (redis_cluster_enabled())
+        return slot_endpoint(redis_key_slot(key, len));
+    return redis_shard_for_key(key, len); // -1 without REDIS_SHARDS
+}
+
+/**
+ * Function: parse_redirect
+ * Description: Parses "-MOVED <slot> <ip>:<port>" or "-ASK <slot> <ip>:<port>".
+ * Parameters:
+ *   - buf: Error reply (ASCII).
+ *   - len: Length of the reply.
+ *   - asking: Receives 1 for ASK, 0 for MOVED.
+ *   - slot: Receives the slot.
+ *   - addr: Receives the address (job CCSID).
+ *   - addr_size: Size of addr.
+ *   - port: Receives the port.
+ * Returns:
+ *   - 0 on success, negative value if the reply is not a redirection.
+ */
+static int parse_redirect(const char *buf, int len, int *asking, int *slot,
+                          char *addr, size_t addr_size, int *port)
+{
+    int pos, colon, end;
+
+    if (len > 7 && memcmp(buf, "\x2D\x4D\x4F\x56\x45\x44\x20", 7) == 0) // ASCII "-MOVED "
+    {
+        *asking = 0;
+        pos = 7;
+    }
+    else if (len > 5 && memcmp(buf, "\x2D\x41\x53\x4B\x20", 5) == 0) // ASCII "-ASK "
+    {
+        *asking = 1;
+        pos = 5;
+    }
+    else
+        return -1;
+
+    *slot = 0;
+    while (pos < len && buf[pos] >= 0x30 && buf[pos] <= 0x39)
+        *slot = *slot * 10 + (buf[pos++] - 0x30);
+    if (pos >= len || buf[pos] != 0x20 || *slot >= REDIS_CLUSTER_SLOTS)
+        return -1;
+    pos++;
+
+    for (end = pos; end < len && buf[end] != 0x0D; end++)
+        ;
+    for (colon = end - 1; colon >= pos && buf[colon] != 0x3A; colon--) // ASCII ':'
+        ;
+    if (colon < pos || native_address(buf + pos, colon - pos, addr, addr_size) != 0)
+        return -1;
+
+    *port = 0;
+    for (pos = colon + 1; pos < end && buf[pos] >= 0x30 && buf[pos] <= 0x39; pos++)
+        *port = *port * 10 + (buf[pos] - 0x30);
+    return *port > 0 ? 0 : -1;
+}
+
+/**
+ * Function: follow_redis_redirect
+ * Description: Follows -MOVED/-ASK replies by resending a command to the
+ *              node named in the reply. MOVED also updates the slot map and
+ *              schedules a full reload; ASK is a one-off, preceded by ASKING.
+ * Parameters:
+ *   - cmd: Command that got the reply (ASCII).
+ *   - cmd_len: Length of the command.
+ *   - wait: Timeout of a blocking command (see set_redis_wait), negative
+ *     for other commands.
+ *   - buf: Buffer holding the reply (ASCII); receives the final reply.
+ *   - size: Size of the buffer.
+ *   - len: Length of the reply in buf.
+ * Returns:
+ *   - Length of the final reply, 0 if the connection was closed,
+ *     negative value on failure.
+ */
+int follow_redis_redirect(const char *cmd, size_t cmd_len, double wait, char *buf, size_t size, int len)
+{
+    static const char asking_cmd[] = "\x2A\x31\x0D\x0A\x24\x36\x0D\x0A\x41\x53\x4B\x49\x4E\x47\x0D\x0A"; // ASCII "*1\r\n$6\r\nASKING\r\n"
+    char addr[64];
+    int hop, asking, slot, port, endpoint, sockfd;
+    long span;
+
+    for (hop = 0; hop < REDIS_MAX_REDIRECTS && len > 0; hop++)
+    {
+        if (parse_redirect(buf, len, &asking, &slot, addr, sizeof(addr), &port) != 0)
+            break;
+        endpoint = find_redis_endpoint(addr, port);
+        if (endpoint < 0)
+            break;
+        if (!asking)
+        {
+            pthread_mutex_lock(&slot_lock);
+            slot_owner[slot] = (short)endpoint;
+            slots_stale = 1;
+            pthread_mutex_unlock(&slot_lock);
+        }
+
+        if (connect_to_redis_endpoint(&sockfd, endpoint) != 0)
+            return -1;
+        if ((wait >= 0.0 && set_redis_wait(sockfd, wait) != 0) ||
+            (asking && send_redis_command(sockfd, asking_cmd, sizeof(asking_cmd) - 1) < 0) ||
+            send_redis_command(sockfd, cmd, cmd_len) < 0)
+        {
+            release_redis_connection(sockfd, "38903");
+            return -1;
+        }
+        len = recv_redis_replies(sockfd, buf, size, asking ? 2 : 1);
+        release_redis_connection(sockfd, len > 0 ? "00000" : "38905");
+
+        // Drop the +OK of ASKING
+        if (len > 0 && asking)
+        {
+            span = redis_reply_span(buf, len, 0);
+            if (span <= 0 || span >= len)
+                return -1;
+            memmove(buf, buf + span, len - span);
+            len -= span;
+        }
+    }
+    return len;
+}
+
+/**********************************************************************/
+/* Multi-key Fan-out */
+/**********************************************************************/
+
+/**
+ * Function: build_group_command
+ * Description: Encodes the sub-command of one slot group (ASCII).
+ * Parameters:
+ *   - group: Slot group; receives cmd and cmd_len.
+ *   - index: Group index of each key.
+ *   - g: Index of the group.
+ *   - name, name_len, step, argc, argv, argl: As for fanout_redis_command.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int build_group_command(RedisSlotGroup *group, const int *index, int g,
+                               const char *name, size_t name_len, int step, int argc,
+                               const char **argv, const size_t *argl)
+{
+    const char **gargv;
+    size_t *gargl;
+    size_t size = 24 + name_len + 3;
+    char *ebcdic;
+    int n = 1, k, a, len;
+
+    gargv = malloc((group->keys * step + 1) * sizeof(char *));
+    gargl = malloc((group->keys * step + 1) * sizeof(size_t));
+    if (gargv == NULL || gargl == NULL)
+    {
+        free(gargv);
+        free(gargl);
+        return -1;
+    }
+    gargv[0] = name;
+    gargl[0] = name_len;
+    for (k = 0; k < argc / step; k++)
+    {
+        if (index[k] != g)
+            continue;
+        for (a = 0; a < step; a++)
+        {
+            gargv[n] = argv[k * step + a];
+            gargl[n] = argl[k * step + a];
+            size += 24 + gargl[n] + 2;
+            n++;
+        }
+    }
+
+    ebcdic = malloc(size);
+    group->cmd = malloc(size);
+    len = (ebcdic && group->cmd) ? format_redis_command(ebcdic, size, n, gargv, gargl) : -1;
+    if (len > 0)
+    {
+        ConvertToASCII(ebcdic, len, group->cmd, size);
+        group->cmd_len = len;
+    }
+    free(ebcdic);
+    free(gargv);
+    free(gargl);
+    return len > 0 ? 0 : -1;
+}
+
+/**
+ * Function: merge_replies
+ * Description: Merges the slot group replies into one reply (ASCII). Array
+ *              replies are interleaved back into the original key order;
+ *              status replies collapse to the first error or +OK.
+ * Parameters:
+ *   - groups: Slot groups with their replies.
+ *   - ngroups: Number of groups.
+ *   - index: Group index of each key.
+ *   - nkeys: Number of keys.
+ *   - buf: Output buffer (ASCII).
+ *   - size: Size of the output buffer.
+ * Returns:
+ *   - Length of the merged reply, -4 if it does not fit, -1 if malformed.
+ */
+static int merge_replies(RedisSlotGroup *groups, int ngroups, const int *index, int nkeys,
+                         char *buf, size_t size)
+{
+    size_t pos = 0, cursor;
+    long span;
+    int g, k, header;
+
+    // The first error wins; otherwise status replies are all alike
+    for (g = 0; g < ngroups && groups[g].reply[0] != 0x2D; g++) // ASCII '-'
+        ;
+    if (g == ngroups)
+        g = 0;
+    if (groups[g].reply[0] != 0x2A) // ASCII '*'
+    {
+        if ((size_t)groups[g].reply_len > size)
+            return -4;
+        memcpy(buf, groups[g].reply, groups[g].reply_len);
+        return (int)groups[g].reply_len;
+    }
+
+    // Skip each group's "*<n>\r\n" header
+    for (g = 0; g < ngroups; g++)
+    {
+        if (groups[g].reply[0] != 0x2A)
+            return -1;
+        for (cursor = 0; cursor < (size_t)groups[g].reply_len && groups[g].reply[cursor] != 0x0A; cursor++)
+            ;
+        groups[g].cursor = cursor + 1;
+    }
+
+    header = append_redis_header(buf, size, 0, nkeys);
+    if (header < 0)
+        return -4;
+    pos = (size_t)header;
+    for (k = 0; k < nkeys; k++)
+    {
+        g = index[k];
+        cursor = groups[g].cursor;
+        span = redis_reply_span(groups[g].reply, groups[g].reply_len, cursor);
+        if (span < 0)
+            return -1;
+        if (pos + (span - cursor) > size)
+            return -4;
+        memcpy(buf + pos, groups[g].reply + cursor, span - cursor);
+        pos += span - cursor;
+        groups[g].cursor = span;
+    }
+    return (int)pos;
+}
+
+/**
+ * Function: fanout_redis_command
+ * Description: Runs a multi-key command over sharded keys. The keys are
+ *              grouped by hash slot (cluster) or by shard (REDIS_SHARDS),
+ *              every node gets the sub-commands of
+ *              its slots pipelined on one connection, and the nodes are all
+ *              sent to before any reply is read so they work in parallel.
+ *              Redirected sub-commands are retried individually.
+ * Parameters:
+ *   - name: Command name (EBCDIC).
+ *   - name_len: Length of the command name.
+ *   - step: Arguments per key (1 for MGET/DEL, 2 for MSET).
+ *   - argc: Number of arguments after the command name.
+ *   - argv: Arguments (EBCDIC).
+ *   - argl: Argument lengths.
+ *   - buf: Receives the merged reply (ASCII).
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Length of the reply, 0 if a connection was closed, -1 on receive
+ *     failure (errno set), -2 on connect failure, -3 on send failure,
+ *     -4 if the reply does not fit.
+ */
+int fanout_redis_command(const char *name, size_t name_len, int step, int argc,
+                         const char **argv, const size_t *argl, char *buf, size_t size)
+{
+    RedisFanoutConn conns[REDIS_MAX_ENDPOINTS];
+    RedisSlotGroup *groups;
+    int *index;
+    int nkeys = argc / step, ngroups = 0, nconns = 0;
+    int cluster = redis_cluster_enabled();
+    int k, g, c, slot, saved_errno = 0, rc = 0;
+    long span, pos;
+
+    if (nkeys <= 0)
+        return -3;
+    groups = calloc(nkeys, sizeof(RedisSlotGroup));
+    index = malloc(nkeys * sizeof(int));
+    if (groups == NULL || index == NULL)
+    {
+        free(groups);
+        free(index);
+        return -3;
+    }
+
+    // Group the keys by slot and the groups by node
+    for (k = 0; k < nkeys; k++)
+    {
+        if (cluster)
+            slot = redis_key_slot(argv[k * step], argl[k * step]);
+        else
+            slot = redis_shard_for_key(argv[k * step], argl[k * step]); // One group per shard
+        for (g = 0; g < ngroups && groups[g].slot != slot; g++)
+            ;
+        if (g == ngroups)
+        {
+            groups[g].slot = slot;
+            groups[g].endpoint = cluster ? slot_endpoint(slot) : slot;
+            for (c = 0; c < nconns && conns[c].endpoint != groups[g].endpoint; c++)
+                ;
+            if (c == nconns)
+            {
+                conns[c].endpoint = groups[g].endpoint;
+                conns[c].sockfd = -1;
+                conns[c].groups = 0;
+                conns[c].buf = NULL;
+                conns[c].len = 0;
+                nconns++;
+            }
+            groups[g].conn = c;
+            conns[c].groups++;
+            ngroups++;
+        }
+        groups[g].keys++;
+        index[k] = g;
+    }
+
+    // The caller's arena memory (e.g., buf) outlives the releases below
+    redis_arena_pin();
+
+    // Send everything first so that the nodes work in parallel
+    for (g = 0; g < ngroups && rc == 0; g++)
+    {
+        c = groups[g].conn;
+        if (build_group_command(&groups[g], index, g, name, name_len, step, argc, argv, argl) != 0)
+            rc = -3;
+        else if (conns[c].sockfd < 0 && connect_to_redis_endpoint(&conns[c].sockfd, conns[c].endpoint) != 0)
+        {
+            conns[c].sockfd = -1;
+            rc = -2;
+        }
+        else if (send_redis_command(conns[c].sockfd, groups[g].cmd, groups[g].cmd_len) < 0)
+            rc = -3;
+    }
+
+    // Collect the pipelined replies of each node
+    for (c = 0; c < nconns && rc == 0; c++)
+    {
+        conns[c].buf = malloc(size);
+        if (conns[c].buf == NULL)
+        {
+            rc = -4;
+            break;
+        }
+        conns[c].len = recv_redis_replies(conns[c].sockfd, conns[c].buf, size, conns[c].groups);
+        if (conns[c].len <= 0)
+        {
+            saved_errno = errno;
+            rc = conns[c].len < 0 ? -1 : -5; // -5: closed, reported as 0 below
+            break;
+        }
+        pos = 0;
+        for (g = 0; g < ngroups; g++)
+        {
+            if (groups[g].conn != c)
+                continue;
+            span = redis_reply_span(conns[c].buf, conns[c].len, pos);
+            if (span < 0)
+            {
+                rc = -1;
+                break;
+            }
+            groups[g].reply = conns[c].buf + pos;
+            groups[g].reply_len = span - pos;
+            pos = span;
+        }
+    }
+
+    // Retry redirected groups (resharding in progress)
+    for (g = 0; g < ngroups && rc == 0; g++)
+    {
+        if (groups[g].reply[0] != 0x2D) // ASCII '-'
+            continue;
+        groups[g].redirected = malloc(size);
+        if (groups[g].redirected == NULL)
+        {
+            rc = -4;
+            break;
+        }
+        memcpy(groups[g].redirected, groups[g].reply, groups[g].reply_len);
+        groups[g].reply_len = follow_redis_redirect(groups[g].cmd, groups[g].cmd_len, -1.0,
+                                                    groups[g].redirected, size, groups[g].reply_len);
+        groups[g].reply = groups[g].redirected;
+        if (groups[g].reply_len <= 0)
+        {
+            saved_errno = errno;
+            rc = groups[g].reply_len < 0 ? -1 : -5;
+        }
+    }
+
+    if (rc == 0)
+        rc = merge_replies(groups, ngroups, index, nkeys, buf, size);
+    if (rc == -5)
+        rc = 0;
+
+    for (c = 0; c < nconns; c++)
+    {
+        release_redis_connection(conns[c].sockfd, rc > 0 ? "00000" : "38905");
+        free(conns[c].buf);
+    }
+    redis_arena_unpin();
+    for (g = 0; g < ngroups; g++)
+    {
+        free(groups[g].cmd);
+        free(groups[g].redirected);
+    }
+    free(groups);
+    free(index);
+    if (rc == -1 && saved_errno != 0)
+        errno = saved_errno;
+    return rc;
+}
@@ -0,0 +1,226 @@
+/******************************************************************************
+ * File: rediscmd.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the generic REDIS_COMMAND function for IBM i.
+ *              Runs any Redis command given as text plus up to ten
+ *              arguments, on the same pooled connection path as the
+ *              dedicated functions, and returns the reply as text.
+ *              Example: REDIS_COMMAND('HINCRBY', 'h', 'f', '5') -> "5"
+ *              Array replies are returned comma-separated like REDIS_MGET
+ *              (nil elements are empty); REDIS_COMMAND_TABLE returns them
+ *              as typed rows instead.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define COMMAND_ARGS 10     // ARG1 .. ARG10
+#define COMMAND_RESULT 16370 // Length of the VARCHAR result
+#define COMMAND_REPLY 32768  // Receive buffer
+
+/**********************************************************************/
+/* Helper: Render a reply as text */
+/**********************************************************************/
+
+/**
+ * Function: render_reply
+ * Description: Converts a reply to EBCDIC text. Nested arrays are flattened
+ *              and their elements joined with commas.
+ * Parameters:
+ *   - reply: Complete reply (ASCII).
+ *   - len: Length of the reply.
+ *   - out: Output buffer (EBCDIC), COMMAND_RESULT + 1 bytes.
+ *   - top: Receives the first value of the reply.
+ * Returns:
+ *   - Length of the text, -1 if it does not fit, -2 if the reply is malformed.
+ */
+static int render_reply(char *reply, size_t len, char *out, RedisReplyItem *top)
+{
+    RedisReplyItem item;
+    size_t pos = 0, used = 0;
+    int first = 1;
+
+    if (redis_reply_item(reply, len, &pos, top) != 0)
+        return -2;
+    if (top->type != 0x2A) // ASCII '*'
+    {
+        if (top->len > COMMAND_RESULT)
+            return -1;
+        if (top->data != NULL)
+            ConvertToEBCDIC((char *)top->data, top->len, out, COMMAND_RESULT);
+        out[top->len] = '\0';
+        return (int)top->len;
+    }
+
+    while (pos < len)
+    {
+        if (redis_reply_item(reply, len, &pos, &item) != 0)
+            return -2;
+        if (item.type == 0x2A)
+            continue; // Nested array: its elements follow
+        if (used + (first ? 0 : 1) + item.len > COMMAND_RESULT)
+            return -1;
+        if (!first)
+            out[used++] = 0x6B; // EBCDIC ','
+        if (item.data != NULL)
+            ConvertToEBCDIC((char *)item.data, item.len, out + used, COMMAND_RESULT - used);
+        used += item.len;
+        first = 0;
+    }
+    out[used] = '\0';
+    return (int)used;
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: commandRedis
+ * Description: SQL external function to run any Redis command.
+ * Parameters:
+ *   - command: Input command, e.g. "GETEX" or "OBJECT ENCODING" (EBCDIC).
+ *   - arg1 .. arg10: Input arguments (EBCDIC); trailing NULLs are left out.
+ *   - result: Output reply as text (EBCDIC).
+ *   - commandInd, arg1Ind .. arg10Ind: Null indicators for the inputs.
+ *   - resultInd: Null indicator for the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" for a nil or
+ *     empty reply, "38911" for an error reply from Redis.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN commandRedis(
+    SQLUDF_VARCHAR *command,    // Input: command (EBCDIC)
+    SQLUDF_VARCHAR *arg1,       // Input: arguments (EBCDIC)
+    SQLUDF_VARCHAR *arg2,
+    SQLUDF_VARCHAR *arg3,
+    SQLUDF_VARCHAR *arg4,
+    SQLUDF_VARCHAR *arg5,
+    SQLUDF_VARCHAR *arg6,
+    SQLUDF_VARCHAR *arg7,
+    SQLUDF_VARCHAR *arg8,
+    SQLUDF_VARCHAR *arg9,
+    SQLUDF_VARCHAR *arg10,
+    SQLUDF_VARCHAR *result,     // Output: reply as text (EBCDIC)
+    SQLUDF_NULLIND *commandInd, // Null indicators for inputs
+    SQLUDF_NULLIND *arg1Ind,
+    SQLUDF_NULLIND *arg2Ind,
+    SQLUDF_NULLIND *arg3Ind,
+    SQLUDF_NULLIND *arg4Ind,
+    SQLUDF_NULLIND *arg5Ind,
+    SQLUDF_NULLIND *arg6Ind,
+    SQLUDF_NULLIND *arg7Ind,
+    SQLUDF_NULLIND *arg8Ind,
+    SQLUDF_NULLIND *arg9Ind,
+    SQLUDF_NULLIND *arg10Ind,
+    SQLUDF_NULLIND *resultInd,  // Null indicator for output
+    char *sqlstate,             // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,             // Fully qualified function name
+    char *specname,             // Specific name
+    char *msgtext,              // Error message text (up to 70 chars)
+    short *sqlcode,             // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)    // Additional null indicators for DB2SQL
+{
+    const char *args[COMMAND_ARGS] = {arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8, arg9, arg10};
+    SQLUDF_NULLIND inds[COMMAND_ARGS] = {*arg1Ind, *arg2Ind, *arg3Ind, *arg4Ind, *arg5Ind,
+                                         *arg6Ind, *arg7Ind, *arg8Ind, *arg9Ind, *arg10Ind};
+    const char *argv[REDIS_MAX_ARGS];
+    size_t argl[REDIS_MAX_ARGS];
+    char reply[COMMAND_REPLY], error[71];
+    RedisReplyItem top;
+    int sockfd, argc, key, len;
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        *resultInd = -1;
+        return;
+    }
+#endif
+
+    // Check for NULL input
+    if (*commandInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input command is NULL");
+        *resultInd = -1;
+        return;
+    }
+
+    argc = collect_redis_arguments(command, args, inds, COMMAND_ARGS, argv, argl, &key);
+    if (argc < 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, argc == -1 ? "Input command is empty"
+                        : argc == -2 ? "NULL argument followed by a non-NULL argument"
+                                     : "Too many command words and arguments");
+        *resultInd = -1;
+        return;
+    }
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+
+    len = execute_redis_command(&sockfd, argc, argv, argl, key, reply, sizeof(reply), sqlstate, msgtext);
+    if (len < 0)
+    {
+        *resultInd = -1;
+        return;
+    }
+
+    len = render_reply(reply, len, result, &top);
+    if (len == -2)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+        *resultInd = -1;
+    }
+    else if (top.type == 0x2D) // ASCII '-' error reply
+    {
+        len = top.len < 70 ? top.len : 70;
+        ConvertToEBCDIC((char *)top.data, len, error, sizeof(error) - 1);
+        error[len] = '\0';
+        strcpy(sqlstate, "38911");
+        strcpy(msgtext, error);
+        *resultInd = -1;
+    }
+    else if (len == -1)
+    {
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Response exceeds maximum length");
+        *resultInd = -1;
+    }
+    else if (top.nil || (top.type == 0x2A && top.len == 0))
+    {
+        strncpy(sqlstate, "02000", 5);
+        strncpy(msgtext, "Nil or empty reply", 70);
+        *resultInd = -1;
+    }
+    else
+    {
+        *resultInd = 0;
+    }
+
+    release_redis_connection(sockfd, sqlstate);
+}
+
+#pragma linkage(commandRedis, OS)
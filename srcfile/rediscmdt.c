@@ -0,0 +1,226 @@
+/******************************************************************************
+ * File: rediscmdt.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_COMMAND_TABLE table function for
+ *              IBM i. Runs any Redis command like REDIS_COMMAND and returns
+ *              the reply as typed rows: one row per value, with its
+ *              position in the enclosing array, nesting level, RESP type,
+ *              text and integer value.
+ *              The command runs when the table is opened. The reply is
+ *              kept in the scratchpad, after a cursor of plain integers,
+ *              and each fetch decodes the next value from it.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define COMMAND_ARGS 10      // ARG1 .. ARG10
+#define COMMAND_VALUE 16370  // Length of the VALUE column
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: commandRedisTable
+ * Description: SQL external table function to run any Redis command and
+ *              return its reply as rows. A single value gives one row at
+ *              level 0; the elements of an array reply are rows at level 1,
+ *              a nested array gives a row of type "array" followed by its
+ *              elements one level deeper.
+ * Parameters:
+ *   - command: Input command, e.g. "ZMSCORE" or "OBJECT ENCODING" (EBCDIC).
+ *   - arg1 .. arg10: Input arguments (EBCDIC); trailing NULLs are left out.
+ *   - position: Output 1-based position in the enclosing array.
+ *   - level: Output nesting level.
+ *   - type: Output type: status, error, integer, string, array or nil
+ *     (VARCHAR(8), EBCDIC).
+ *   - value: Output text of the value (EBCDIC); NULL for arrays and nil.
+ *   - integerValue: Output value of integers, element count of arrays.
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the cursor and the reply.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN commandRedisTable(
+    SQLUDF_VARCHAR *command,         // Input: command (EBCDIC)
+    SQLUDF_VARCHAR *arg1,            // Input: arguments (EBCDIC)
+    SQLUDF_VARCHAR *arg2,
+    SQLUDF_VARCHAR *arg3,
+    SQLUDF_VARCHAR *arg4,
+    SQLUDF_VARCHAR *arg5,
+    SQLUDF_VARCHAR *arg6,
+    SQLUDF_VARCHAR *arg7,
+    SQLUDF_VARCHAR *arg8,
+    SQLUDF_VARCHAR *arg9,
+    SQLUDF_VARCHAR *arg10,
+    SQLUDF_INTEGER *position,        // Output: position in the enclosing array
+    SQLUDF_INTEGER *level,           // Output: nesting level
+    SQLUDF_VARCHAR *type,            // Output: RESP type (EBCDIC)
+    SQLUDF_VARCHAR *value,           // Output: text of the value (EBCDIC)
+    SQLUDF_BIGINT *integerValue,     // Output: integer value or element count
+    SQLUDF_NULLIND *commandInd,      // Null indicators for inputs
+    SQLUDF_NULLIND *arg1Ind,
+    SQLUDF_NULLIND *arg2Ind,
+    SQLUDF_NULLIND *arg3Ind,
+    SQLUDF_NULLIND *arg4Ind,
+    SQLUDF_NULLIND *arg5Ind,
+    SQLUDF_NULLIND *arg6Ind,
+    SQLUDF_NULLIND *arg7Ind,
+    SQLUDF_NULLIND *arg8Ind,
+    SQLUDF_NULLIND *arg9Ind,
+    SQLUDF_NULLIND *arg10Ind,
+    SQLUDF_NULLIND *positionInd,     // Null indicators for outputs
+    SQLUDF_NULLIND *levelInd,
+    SQLUDF_NULLIND *typeInd,
+    SQLUDF_NULLIND *valueInd,
+    SQLUDF_NULLIND *integerValueInd,
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,   // Cursor and reply between calls
+    SQLUDF_CALL_TYPE *calltype)      // Open, fetch or close
+{
+    const char *args[COMMAND_ARGS] = {arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8, arg9, arg10};
+    SQLUDF_NULLIND inds[COMMAND_ARGS] = {*arg1Ind, *arg2Ind, *arg3Ind, *arg4Ind, *arg5Ind,
+                                         *arg6Ind, *arg7Ind, *arg8Ind, *arg9Ind, *arg10Ind};
+    const char *argv[REDIS_MAX_ARGS];
+    size_t argl[REDIS_MAX_ARGS], pos;
+    char *reply = scratchpad->data + sizeof(RedisReplyCursor);
+    RedisReplyCursor cursor;
+    RedisReplyItem item;
+    int sockfd, argc, key, len, rc;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+#ifdef USE_ICONV
+        if (!initialized)
+        {
+            initialize_conversion();
+            initialized = 1;
+        }
+        if (errno != 0)
+        {
+            strcpy(sqlstate, "38999");
+            strcpy(msgtext, "iconv initialization failed");
+            return;
+        }
+#endif
+        // Check for NULL input
+        if (*commandInd < 0)
+        {
+            strcpy(sqlstate, "38001");
+            strcpy(msgtext, "Input command is NULL");
+            return;
+        }
+        argc = collect_redis_arguments(command, args, inds, COMMAND_ARGS, argv, argl, &key);
+        if (argc < 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, argc == -1 ? "Input command is empty"
+                            : argc == -2 ? "NULL argument followed by a non-NULL argument"
+                                         : "Too many command words and arguments");
+            return;
+        }
+
+        if (scratchpad->length < sizeof(RedisReplyCursor) + 1024)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Scratchpad too small: create the function with SCRATCHPAD 32767");
+            return;
+        }
+
+        // Receive straight into the scratchpad, behind the cursor
+        len = execute_redis_command(&sockfd, argc, argv, argl, key, reply,
+                                    scratchpad->length - sizeof(RedisReplyCursor), sqlstate, msgtext);
+        if (len < 0)
+            return;
+
+        memset(&cursor, 0, sizeof(cursor));
+        cursor.len = len;
+        pos = 0;
+        if (redis_reply_item(reply, len, &pos, &item) != 0)
+        {
+            strcpy(sqlstate, "38909");
+            strcpy(msgtext, "Failed to parse Redis response");
+        }
+        else if (item.type == 0x2D) // ASCII '-' error reply
+        {
+            len = item.len < 70 ? item.len : 70;
+            ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+            msgtext[len] = '\0';
+            strcpy(sqlstate, "38911");
+        }
+        else if (item.type == 0x2A && !item.nil) // ASCII '*': rows are the elements
+        {
+            cursor.pos = (int)pos;
+            cursor.depth = 1;
+            cursor.remaining[0] = (int)item.len;
+        }
+        release_redis_connection(sockfd, sqlstate);
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    memcpy(&cursor, scratchpad->data, sizeof(cursor));
+    rc = redis_reply_row(reply, &cursor, &item, position, level);
+    if (rc == 1)
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+    if (rc != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, rc == -2 ? "Reply nested too deeply" : "Failed to parse Redis response");
+        return;
+    }
+    if (item.type != 0x2A && item.len > COMMAND_VALUE)
+    {
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Value exceeds maximum length");
+        return;
+    }
+
+    strcpy(type, redis_reply_type(&item));
+    *positionInd = 0;
+    *levelInd = 0;
+    *typeInd = 0;
+
+    if (item.type == 0x2A || item.nil)
+    {
+        *valueInd = -1;
+    }
+    else
+    {
+        ConvertToEBCDIC((char *)item.data, item.len, value, COMMAND_VALUE);
+        value[item.len] = '\0';
+        *valueInd = 0;
+    }
+    *integerValueInd = -1;
+    if ((item.type == 0x3A || item.type == 0x2A) && !item.nil) // ASCII ':' / '*'
+    {
+        *integerValue = item.number;
+        *integerValueInd = 0;
+    }
+    memcpy(scratchpad->data, &cursor, sizeof(cursor));
+}
+
+#pragma linkage(commandRedisTable, OS)
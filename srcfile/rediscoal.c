@@ -0,0 +1,617 @@
+/******************************************************************************
+ * File: rediscoal.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Counter coalescing of the REDISILE service program and the
+ *              REDIS_COALESCE function for IBM i.
+ *              With coalescing on, REDIS_INCR, REDIS_INCRBY, REDIS_DECRBY
+ *              and REDIS_HINCRBY add their delta to a table of the job,
+ *              one entry per key (and hash field), instead of sending a
+ *              command. The table is drained into the write-behind queue
+ *              (see redisbhnd.c) as one INCRBY or HINCRBY per entry when
+ *              it holds REDIS_COALESCE_KEYS counters, when its oldest
+ *              delta is REDIS_COALESCE_MS old (the write-behind flusher
+ *              thread wakes for it), before any other command of the
+ *              job, and by REDIS_FLUSH. Increments commute, so the
+ *              totals in Redis are exact; only the number of commands
+ *              changes.
+ *              A drain swaps in a second, empty table and queues the
+ *              full one without holding the table lock, since a full
+ *              queue makes it wait for the flusher, which reads the table.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#define COALESCE_NAME 255      // Longest key or field kept
+#define COALESCE_MIN_KEYS 16   // Smallest table
+#define COALESCE_MAX_KEYS 1000000 // Largest table
+#define COALESCE_RETRY_MS 10   // Timer of the flusher while the table is busy
+
+/**********************************************************************/
+/* Counter Table */
+/**********************************************************************/
+
+// Pending delta of one key, or of one field of a hash
+typedef struct
+{
+    unsigned int hash;   // Hash of key and field
+    int name;            // Offset of "key\0field\0" in names
+    int key_len;         // Length of the key
+    int field_len;       // Length of the field, -1 for a string counter
+    long long delta;     // Sum of the increments
+} CoalesceEntry;
+
+static CoalesceEntry *entries = NULL; // In the order the counters appeared
+static volatile int entry_count = 0;
+static int entry_max = 0;             // REDIS_COALESCE_KEYS
+static int *slots = NULL;             // Open addressing: entry index + 1, 0 if free
+static int slot_mask = 0;
+static char *names = NULL;            // Keys and fields of the entries (EBCDIC)
+static size_t names_len = 0;
+static size_t names_size = 0;
+static CoalesceEntry *out_entries = NULL; // The table being queued by a drain
+static volatile int out_count = 0;
+static char *out_names = NULL;
+static size_t out_names_size = 0;
+static struct timeval oldest;         // When the first pending delta was added
+static long interval_ms = 0;          // REDIS_COALESCE_MS
+static int enabled = 0;               // REDIS_COALESCE('ON')
+static int draining = 0;              // 1 while a thread queues out_entries
+static pthread_t drainer;             // That thread
+static pthread_mutex_t coalesce_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t drain_done = PTHREAD_COND_INITIALIZER; // A drain finished
+
+/**
+ * Function: hash_name
+ * Description: FNV-1a hash of a key and a field.
+ */
+static unsigned int hash_name(const char *key, int key_len, const char *field, int field_len)
+{
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < key_len; i++)
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    hash = (hash ^ (field_len < 0 ? 0xFF : 0x00)) * 16777619u; // Strings and hashes apart
+    for (i = 0; i < field_len; i++)
+        hash = (hash ^ (unsigned char)field[i]) * 16777619u;
+    return hash;
+}
+
+/**
+ * Function: create_table
+ * Description: Allocates the table on first use. Both tables hold up to
+ *              twice REDIS_COALESCE_KEYS counters: the counters a drain
+ *              could not queue are put back into a table that may have
+ *              filled meanwhile. Caller holds coalesce_lock.
+ * Returns:
+ *   - 0 on success, -1 if out of memory.
+ */
+static int create_table(void)
+{
+    int keys, size;
+
+    if (entries != NULL)
+        return 0;
+    keys = atoi(REDIS_COALESCE_KEYS);
+    if (keys < COALESCE_MIN_KEYS)
+        keys = COALESCE_MIN_KEYS;
+    if (keys > COALESCE_MAX_KEYS)
+        keys = COALESCE_MAX_KEYS;
+    for (size = 4 * COALESCE_MIN_KEYS; size < 4 * keys; size *= 2)
+        ;
+    entries = malloc(2 * keys * sizeof(CoalesceEntry));
+    out_entries = malloc(2 * keys * sizeof(CoalesceEntry));
+    slots = calloc(size, sizeof(int));
+    if (entries == NULL || out_entries == NULL || slots == NULL)
+    {
+        free(entries);
+        free(out_entries);
+        free(slots);
+        entries = NULL;
+        out_entries = NULL;
+        slots = NULL;
+        return -1;
+    }
+    entry_max = keys;
+    slot_mask = size - 1;
+    interval_ms = atol(REDIS_COALESCE_MS);
+    return 0;
+}
+
+/**
+ * Function: find_entry
+ * Description: Looks up the counter of a key (and field). Caller holds
+ *              coalesce_lock.
+ * Parameters:
+ *   - slot: Receives the slot of the counter, or the free slot where it
+ *     would go.
+ * Returns:
+ *   - The counter, NULL if none is pending.
+ */
+static CoalesceEntry *find_entry(unsigned int hash, const char *key, int key_len,
+                                 const char *field, int field_len, int *slot)
+{
+    CoalesceEntry *entry;
+    int index;
+
+    for (*slot = hash & slot_mask; (index = slots[*slot]) != 0; *slot = (*slot + 1) & slot_mask)
+    {
+        entry = &entries[index - 1];
+        if (entry->hash == hash && entry->key_len == key_len && entry->field_len == field_len &&
+            memcmp(names + entry->name, key, key_len) == 0 &&
+            (field_len < 0 || memcmp(names + entry->name + key_len + 1, field, field_len) == 0))
+            return entry;
+    }
+    return NULL;
+}
+
+/**
+ * Function: insert_entry
+ * Description: Adds a counter in a free slot. Caller holds coalesce_lock.
+ * Returns:
+ *   - 0 on success, -1 if out of memory.
+ */
+static int insert_entry(int slot, unsigned int hash, const char *key, int key_len,
+                        const char *field, int field_len, long long delta)
+{
+    CoalesceEntry *entry;
+    size_t need = names_len + key_len + 1 + (field_len < 0 ? 0 : field_len) + 1;
+    char *grown;
+
+    if (need > names_size)
+    {
+        grown = realloc(names, need * 2);
+        if (grown == NULL)
+            return -1;
+        names = grown;
+        names_size = need * 2;
+    }
+    if (entry_count == 0)
+        gettimeofday(&oldest, NULL);
+    entry = &entries[entry_count];
+    entry->hash = hash;
+    entry->name = (int)names_len;
+    entry->key_len = key_len;
+    entry->field_len = field_len;
+    entry->delta = delta;
+    memcpy(names + names_len, key, key_len);
+    names[names_len + key_len] = '\0';
+    names_len += key_len + 1;
+    if (field_len >= 0)
+    {
+        memcpy(names + names_len, field, field_len);
+        names[names_len + field_len] = '\0';
+        names_len += field_len + 1;
+    }
+    slots[slot] = ++entry_count;
+    return 0;
+}
+
+/**
+ * Function: merge_entry
+ * Description: Puts back a counter a drain could not queue, adding it to
+ *              the increments made meanwhile. Caller holds coalesce_lock.
+ * Returns:
+ *   - 0 on success, -1 if out of memory.
+ */
+static int merge_entry(const CoalesceEntry *out)
+{
+    const char *key = out_names + out->name;
+    const char *field = key + out->key_len + 1;
+    CoalesceEntry *entry;
+    int slot;
+
+    entry = find_entry(out->hash, key, out->key_len, field, out->field_len, &slot);
+    if (entry != NULL &&
+        !(out->delta > 0 && entry->delta > LLONG_MAX - out->delta) &&
+        !(out->delta < 0 && entry->delta < LLONG_MIN - out->delta))
+    {
+        entry->delta += out->delta;
+        return 0;
+    }
+    // An overflowing sum stays a counter of its own, after the first
+    while (slots[slot] != 0)
+        slot = (slot + 1) & slot_mask;
+    return insert_entry(slot, out->hash, key, out->key_len, field, out->field_len, out->delta);
+}
+
+/**
+ * Function: drain_table
+ * Description: Queues one INCRBY or HINCRBY per pending counter for the
+ *              write-behind flusher. The table is taken under
+ *              coalesce_lock and queued without it, since queuing may wait
+ *              for the flusher; increments made meanwhile go to an empty
+ *              table. Counters that cannot be queued are put back.
+ *              Caller does not hold coalesce_lock.
+ * Parameters:
+ *   - wait: 1 to wait for a drain of another thread and drain after it,
+ *     0 to leave the counters to that drain.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Number of counters that could not be queued: 0 on success.
+ */
+static int drain_table(int wait, char *sqlstate, char *msgtext)
+{
+    char cmd[2 * COALESCE_NAME + 128], number[REDIS_DOUBLE_TEXT];
+    CoalesceEntry *entry, *swap_entries;
+    const char *key;
+    char *swap_names;
+    size_t swap_size;
+    int i, j, len, count, merged = 0;
+
+    pthread_mutex_lock(&coalesce_lock);
+    while (draining)
+    {
+        if (!wait)
+        {
+            pthread_mutex_unlock(&coalesce_lock);
+            return 0;
+        }
+        pthread_cond_wait(&drain_done, &coalesce_lock);
+    }
+    if (entry_count == 0)
+    {
+        pthread_mutex_unlock(&coalesce_lock);
+        return 0;
+    }
+
+    // Take the table; queuing can take a connection (cluster slot map),
+    // whose barrier must not drain again
+    swap_entries = out_entries;
+    out_entries = entries;
+    entries = swap_entries;
+    swap_names = out_names;
+    out_names = names;
+    names = swap_names;
+    swap_size = out_names_size;
+    out_names_size = names_size;
+    names_size = swap_size;
+    out_count = entry_count;
+    entry_count = 0;
+    names_len = 0;
+    memset(slots, 0, (slot_mask + 1) * sizeof(int));
+    draining = 1;
+    drainer = pthread_self();
+    count = out_count;
+    pthread_mutex_unlock(&coalesce_lock);
+
+    for (i = 0; i < count; i++)
+    {
+        entry = &out_entries[i];
+        key = out_names + entry->name;
+        if (entry->field_len < 0)
+        {
+            memcpy(cmd, REDIS_TEMPLATE_INCRBY, sizeof(REDIS_TEMPLATE_INCRBY) - 1);
+            len = sizeof(REDIS_TEMPLATE_INCRBY) - 1;
+            len = append_redis_argument(cmd, sizeof(cmd), len, key, entry->key_len, 0);
+        }
+        else
+        {
+            memcpy(cmd, REDIS_TEMPLATE_HINCRBY, sizeof(REDIS_TEMPLATE_HINCRBY) - 1);
+            len = sizeof(REDIS_TEMPLATE_HINCRBY) - 1;
+            len = append_redis_argument(cmd, sizeof(cmd), len, key, entry->key_len, 0);
+            len = append_redis_argument(cmd, sizeof(cmd), len, key + entry->key_len + 1, entry->field_len, 0);
+        }
+        len = append_redis_argument(cmd, sizeof(cmd), len, number, format_redis_integer(entry->delta, number), 1);
+        if (len < 0)
+        {
+            strncpy(sqlstate, "38902", 5);
+            strncpy(msgtext, "Failed to convert command to ASCII", 70);
+            break;
+        }
+        if (redis_write_behind_queue(key, cmd, len, sqlstate, msgtext) != 0)
+            break;
+    }
+
+    // Put back what could not be queued; it is retried after
+    // REDIS_COALESCE_MS like new counters
+    pthread_mutex_lock(&coalesce_lock);
+    for (j = i; j < count; j++)
+    {
+        if (merge_entry(&out_entries[j]) == 0)
+            merged = 1;
+    }
+    out_count = 0;
+    draining = 0;
+    pthread_cond_broadcast(&drain_done);
+    merged = merged && interval_ms > 0;
+    pthread_mutex_unlock(&coalesce_lock);
+
+    if (merged)
+        redis_write_behind_wake();
+    return count - i;
+}
+
+/**********************************************************************/
+/* Coalescing API */
+/**********************************************************************/
+
+/**
+ * Function: set_redis_coalesce
+ * Description: Switches counter coalescing on or off for the job.
+ *              Switching it off queues the pending counters.
+ * Parameters:
+ *   - on: 1 to coalesce increments, 0 to send them.
+ * Returns:
+ *   - The previous setting, -1 if the table cannot be allocated.
+ */
+int set_redis_coalesce(int on)
+{
+    char sqlstate[6], msgtext[71];
+    int previous;
+
+    pthread_mutex_lock(&coalesce_lock);
+    if (on && create_table() != 0)
+    {
+        pthread_mutex_unlock(&coalesce_lock);
+        return -1;
+    }
+    previous = enabled;
+    enabled = on;
+    pthread_mutex_unlock(&coalesce_lock);
+
+    if (!on)
+        drain_table(1, sqlstate, msgtext);
+    return previous;
+}
+
+/**
+ * Function: redis_coalesce_enabled
+ * Description: Tells whether increments are coalesced for the job.
+ * Returns:
+ *   - 1 if coalescing is on, 0 otherwise.
+ */
+int redis_coalesce_enabled(void)
+{
+    return enabled;
+}
+
+/**
+ * Function: redis_coalesce_add
+ * Description: Adds an increment to the pending counter of a key or hash
+ *              field. The table is drained first when it is full, when
+ *              the sum would overflow, or when the oldest delta is
+ *              REDIS_COALESCE_MS old.
+ * Parameters:
+ *   - key: Redis key (EBCDIC, null-terminated).
+ *   - field: Hash field (EBCDIC, null-terminated), NULL for a string
+ *     counter.
+ *   - delta: Increment.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_coalesce_add(const char *key, const char *field, long long delta,
+                       char *sqlstate, char *msgtext)
+{
+    CoalesceEntry *entry;
+    struct timeval now;
+    int key_len = (int)strlen(key), field_len = field != NULL ? (int)strlen(field) : -1;
+    int slot, due = 0, first;
+    unsigned int hash;
+
+    if (key_len > COALESCE_NAME)
+        key_len = COALESCE_NAME; // Truncate to match VARCHAR(255)
+    if (field_len > COALESCE_NAME)
+        field_len = COALESCE_NAME;
+    hash = hash_name(key, key_len, field, field_len);
+
+    pthread_mutex_lock(&coalesce_lock);
+    if (create_table() != 0)
+    {
+        pthread_mutex_unlock(&coalesce_lock);
+        strncpy(sqlstate, "38902", 5);
+        strncpy(msgtext, "Out of memory for the counter table", 70);
+        return -1;
+    }
+    if (entry_count > 0 && interval_ms > 0 && !draining)
+    {
+        gettimeofday(&now, NULL);
+        due = (now.tv_sec - oldest.tv_sec) * 1000L + (now.tv_usec - oldest.tv_usec) / 1000 >= interval_ms;
+    }
+    if (due)
+    {
+        pthread_mutex_unlock(&coalesce_lock);
+        if (drain_table(0, sqlstate, msgtext) != 0)
+            return -1;
+        pthread_mutex_lock(&coalesce_lock);
+    }
+
+    for (;;)
+    {
+        entry = find_entry(hash, key, key_len, field, field_len, &slot);
+        if (entry != NULL &&
+            !(delta > 0 && entry->delta > LLONG_MAX - delta) &&
+            !(delta < 0 && entry->delta < LLONG_MIN - delta))
+        {
+            entry->delta += delta;
+            pthread_mutex_unlock(&coalesce_lock);
+            return 0;
+        }
+        if (entry == NULL && entry_count < entry_max)
+            break;
+
+        // Full table or overflowing sum: send what is pending first
+        pthread_mutex_unlock(&coalesce_lock);
+        if (drain_table(1, sqlstate, msgtext) != 0)
+            return -1;
+        pthread_mutex_lock(&coalesce_lock);
+    }
+
+    // New counter
+    if (insert_entry(slot, hash, key, key_len, field, field_len, delta) != 0)
+    {
+        pthread_mutex_unlock(&coalesce_lock);
+        strncpy(sqlstate, "38902", 5);
+        strncpy(msgtext, "Out of memory for the counter table", 70);
+        return -1;
+    }
+    first = entry_count == 1 && interval_ms > 0;
+    pthread_mutex_unlock(&coalesce_lock);
+
+    // The first pending delta starts the flusher's REDIS_COALESCE_MS timer
+    if (first)
+        redis_write_behind_wake();
+    return 0;
+}
+
+/**
+ * Function: redis_coalesce_pending
+ * Description: Tells whether counters are waiting in the table or are
+ *              being queued by a drain.
+ * Returns:
+ *   - Number of pending counters.
+ */
+int redis_coalesce_pending(void)
+{
+    return entry_count + out_count;
+}
+
+/**
+ * Function: redis_coalesce_due
+ * Description: Tells how long until the oldest pending delta is
+ *              REDIS_COALESCE_MS old. Never waits for coalesce_lock: the
+ *              flusher calls it while a drain may be waiting for the
+ *              flusher to make room in the queue.
+ * Returns:
+ *   - Milliseconds left, 0 if the counters are due now, -1 if none is
+ *     pending or there is no interval. While the table is busy the
+ *     counters are not due: COALESCE_RETRY_MS is returned.
+ */
+long redis_coalesce_due(void)
+{
+    struct timeval now;
+    long left = -1;
+
+    if (entry_count == 0 || interval_ms <= 0)
+        return -1;
+    if (pthread_mutex_trylock(&coalesce_lock) != 0)
+        return COALESCE_RETRY_MS;
+    if (draining)
+    {
+        left = COALESCE_RETRY_MS; // The drain wakes the flusher if it puts counters back
+    }
+    else if (entry_count > 0)
+    {
+        gettimeofday(&now, NULL);
+        left = interval_ms - ((now.tv_sec - oldest.tv_sec) * 1000L + (now.tv_usec - oldest.tv_usec) / 1000);
+        if (left < 0)
+            left = 0;
+    }
+    pthread_mutex_unlock(&coalesce_lock);
+    return left;
+}
+
+/**
+ * Function: redis_coalesce_drain
+ * Description: Queues the pending counters for the write-behind flusher.
+ *              Does nothing when no counter is pending, or for the thread
+ *              already draining the table. Caller holds no lock.
+ * Parameters:
+ *   - wait: 1 to wait for a drain of another thread and drain after it,
+ *     0 to leave the counters to that drain.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Number of counters that could not be queued: 0 on success. They
+ *     stay pending.
+ */
+int redis_coalesce_drain(int wait, char *sqlstate, char *msgtext)
+{
+    if (redis_coalesce_pending() == 0 || (draining && pthread_equal(drainer, pthread_self())))
+        return 0;
+    return drain_table(wait, sqlstate, msgtext);
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: coalesceRedis
+ * Description: SQL external function switching counter coalescing on or
+ *              off for the job. Switching it off queues the pending
+ *              counters; REDIS_FLUSH waits for them to be written.
+ * Parameters:
+ *   - mode: Input mode, 'ON' or 'OFF' (VARCHAR(3), EBCDIC).
+ *   - value: Output previous mode (VARCHAR(3), EBCDIC).
+ *   - modeInd: Null indicator for the input mode.
+ *   - valueInd: Null indicator for the output value.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN coalesceRedis(
+    SQLUDF_VARCHAR *mode,     // Input: 'ON' or 'OFF' (EBCDIC)
+    SQLUDF_VARCHAR *value,    // Output: previous mode (EBCDIC)
+    SQLUDF_NULLIND *modeInd,  // Null indicator for input
+    SQLUDF_NULLIND *valueInd, // Null indicator for output
+    char *sqlstate,           // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,           // Fully qualified function name
+    char *specname,           // Specific name
+    char *msgtext,            // Error message text (up to 70 chars)
+    short *sqlcode,           // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
+{
+    int on, previous;
+
+    // Check for NULL input mode
+    if (*modeInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input mode is NULL");
+        *valueInd = -1;
+        return;
+    }
+
+    if (strcmp(mode, "\xD6\xD5") == 0) // EBCDIC "ON"
+    {
+        on = 1;
+    }
+    else if (strcmp(mode, "\xD6\xC6\xC6") == 0) // EBCDIC "OFF"
+    {
+        on = 0;
+    }
+    else
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Mode must be ON or OFF");
+        *valueInd = -1;
+        return;
+    }
+
+    previous = set_redis_coalesce(on);
+    if (previous < 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for the counter table");
+        *valueInd = -1;
+        return;
+    }
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+    if (previous)
+        strcpy(value, "\xD6\xD5"); // EBCDIC "ON"
+    else
+        strcpy(value, "\xD6\xC6\xC6"); // EBCDIC "OFF"
+    *valueInd = 0;
+}
+
+#pragma linkage(coalesceRedis, OS)
@@ -0,0 +1,783 @@
+/******************************************************************************
+ * File: rediscrow.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Row caching for IBM i: reads the layout of a row, encodes
+ *              its columns by type into one compact value (integers and
+ *              decimals as varints, dates and timestamps as fixed binary
+ *              numbers, text as is) and stores it with SET, for the
+ *              REDIS_CACHE_ROW function. REDIS_FETCH_ROW (redisfrow.c)
+ *              decodes it back to typed columns.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define ROW_SEND_BUFFER (REDIS_ROW_RECORD + 512) // Encoded row, key and TTL
+
+// Type names of a layout (EBCDIC, uppercase)
+static const struct
+{
+    const char *name;
+    int type;
+} layout_types[] = {
+    {"\xC9\xD5\xE3\xC5\xC7\xC5\xD9", REDIS_ROW_INTEGER},              // INTEGER
+    {"\xC9\xD5\xE3", REDIS_ROW_INTEGER},                              // INT
+    {"\xE2\xD4\xC1\xD3\xD3\xC9\xD5\xE3", REDIS_ROW_INTEGER},          // SMALLINT
+    {"\xC2\xC9\xC7\xC9\xD5\xE3", REDIS_ROW_INTEGER},                  // BIGINT
+    {"\xC4\xC5\xC3\xC9\xD4\xC1\xD3", REDIS_ROW_DECIMAL},              // DECIMAL
+    {"\xC4\xC5\xC3", REDIS_ROW_DECIMAL},                              // DEC
+    {"\xD5\xE4\xD4\xC5\xD9\xC9\xC3", REDIS_ROW_DECIMAL},              // NUMERIC
+    {"\xC4\xC1\xE3\xC5", REDIS_ROW_DATE},                             // DATE
+    {"\xE3\xC9\xD4\xC5\xE2\xE3\xC1\xD4\xD7", REDIS_ROW_TIMESTAMP},    // TIMESTAMP
+    {"\xE5\xC1\xD9\xC3\xC8\xC1\xD9", REDIS_ROW_VARCHAR},              // VARCHAR
+    {"\xC3\xC8\xC1\xD9", REDIS_ROW_VARCHAR}};                         // CHAR
+
+#define IS_DIGIT(c) ((uchar)(c) >= 0xF0 && (uchar)(c) <= 0xF9) // EBCDIC '0' .. '9'
+
+/**********************************************************************/
+/* Helper: Layout */
+/**********************************************************************/
+
+/**
+ * Function: read_layout_number
+ * Description: Reads an unsigned number of a layout, blanks around it
+ *              dropped.
+ * Returns:
+ *   - The number, -1 if there is none.
+ */
+static int read_layout_number(const char **p)
+{
+    int n = -1;
+
+    while (**p == 0x40) // EBCDIC ' '
+        (*p)++;
+    for (; IS_DIGIT(**p) && n < 10000; (*p)++)
+        n = (n < 0 ? 0 : n * 10) + ((uchar)**p - 0xF0);
+    while (**p == 0x40)
+        (*p)++;
+    return n;
+}
+
+int parse_redis_layout(const char *layout, RedisRowColumn *columns)
+{
+    const char *p = layout, *word;
+    char type[10];
+    size_t len, i;
+    int count = 0;
+
+    for (;;)
+    {
+        if (count == REDIS_ROW_COLUMNS)
+            return -2;
+        while (*p == 0x40) // EBCDIC ' '
+            p++;
+
+        // Name, then its type
+        for (word = p; *p != '\0' && *p != 0x40 && *p != 0x6B && *p != 0x4D; p++) // ' ', ',', '('
+            ;
+        columns[count].name = word;
+        columns[count].name_len = p - word;
+        while (*p == 0x40)
+            p++;
+        for (len = 0; *p != '\0' && *p != 0x40 && *p != 0x6B && *p != 0x4D; p++)
+        {
+            if (len == sizeof(type) - 1)
+                return -1;
+            type[len++] = *p | 0x40; // EBCDIC lowercase is uppercase minus 0x40
+        }
+        type[len] = '\0';
+        if (columns[count].name_len == 0 || len == 0)
+            return -1;
+        for (i = 0; i < sizeof(layout_types) / sizeof(layout_types[0]); i++)
+        {
+            if (strcmp(type, layout_types[i].name) == 0)
+                break;
+        }
+        if (i == sizeof(layout_types) / sizeof(layout_types[0]))
+            return -1;
+        columns[count].type = layout_types[i].type;
+        columns[count].scale = -1;
+
+        // (length) or (precision[, scale]); only the scale of a DECIMAL is kept
+        while (*p == 0x40)
+            p++;
+        if (*p == 0x4D) // EBCDIC '('
+        {
+            p++;
+            if (read_layout_number(&p) < 0)
+                return -1;
+            if (*p == 0x6B) // EBCDIC ','
+            {
+                p++;
+                columns[count].scale = read_layout_number(&p);
+                if (columns[count].scale < 0 || columns[count].scale > 31)
+                    return -1;
+                if (columns[count].type != REDIS_ROW_DECIMAL)
+                    columns[count].scale = -1;
+            }
+            if (*p++ != 0x5D) // EBCDIC ')'
+                return -1;
+            while (*p == 0x40)
+                p++;
+        }
+        count++;
+        if (*p == '\0')
+            return count;
+        if (*p++ != 0x6B)
+            return -1;
+    }
+}
+
+/**********************************************************************/
+/* Helper: Column Encoders */
+/**********************************************************************/
+
+/**
+ * Function: put_varint
+ * Description: Writes an unsigned number 7 bits per byte, low bits first,
+ *              the high bit set on all bytes but the last.
+ * Returns:
+ *   - Number of bytes written (1 to 10).
+ */
+static int put_varint(char *out, unsigned long long value)
+{
+    int n = 0;
+
+    while (value >= 0x80)
+    {
+        out[n++] = (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (char)value;
+    return n;
+}
+
+/**
+ * Function: read_number_text
+ * Description: Reads a number written as text ("-123.45", " 42 ", "0,5"):
+ *              blanks around it, a sign and one decimal point or comma.
+ * Parameters:
+ *   - text: The number (EBCDIC, null-terminated).
+ *   - negative: Receives 1 for a minus sign.
+ *   - digits: Receives the digits (0 to 9) without leading zeros.
+ *   - count: Receives the number of digits.
+ *   - fraction: Receives how many of them follow the point.
+ * Returns:
+ *   - 0 on success, -1 if the text is not a number or has more than 64
+ *     digits.
+ */
+static int read_number_text(const char *text, int *negative, char *digits, int *count, int *fraction)
+{
+    int seen = 0, point = 0;
+
+    *negative = 0;
+    *count = 0;
+    *fraction = 0;
+    while (*text == 0x40) // EBCDIC ' '
+        text++;
+    if (*text == 0x60 || *text == 0x4E) // EBCDIC '-', '+'
+        *negative = *text++ == 0x60;
+    for (;; text++)
+    {
+        if (IS_DIGIT(*text))
+        {
+            seen = 1;
+            if (*count == 0 && (uchar)*text == 0xF0 && !point)
+                continue; // Leading zero
+            if (*count == 64)
+                return -1;
+            digits[(*count)++] = (uchar)*text - 0xF0;
+            *fraction += point;
+        }
+        else if ((*text == 0x4B || *text == 0x6B) && !point) // EBCDIC '.', ','
+            point = 1;
+        else
+            break;
+    }
+    while (*text == 0x40)
+        text++;
+    return seen && *text == '\0' ? 0 : -1;
+}
+
+/**
+ * Function: encode_integer
+ * Description: Encodes an INTEGER column as a zigzag varint.
+ * Returns:
+ *   - Bytes written, -1 if the text is not an integer in the BIGINT range.
+ */
+static int encode_integer(const char *text, char *out)
+{
+    char digits[64];
+    unsigned long long value = 0, limit;
+    int negative, count, fraction, i;
+
+    if (read_number_text(text, &negative, digits, &count, &fraction) != 0)
+        return -1;
+    for (i = count - fraction; i < count; i++)
+    {
+        if (digits[i] != 0)
+            return -1; // "42.00" is accepted, "42.5" is not
+    }
+    limit = negative ? 9223372036854775808ULL : 9223372036854775807ULL;
+    for (i = 0; i < count - fraction; i++)
+    {
+        if (value > (limit - digits[i]) / 10)
+            return -1;
+        value = value * 10 + digits[i];
+    }
+    // Zigzag: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+    return put_varint(out, negative && value > 0 ? (value - 1) * 2 + 1 : value * 2);
+}
+
+/**
+ * Function: encode_decimal
+ * Description: Encodes a DECIMAL column: the scale, then the unscaled value
+ *              as a zigzag varint, or as packed digits when it has more
+ *              than 18 digits.
+ * Parameters:
+ *   - text: The value (EBCDIC).
+ *   - scale: Scale of the layout, -1 to keep the scale of the text.
+ *   - out: Receives the encoding (at most 19 bytes).
+ * Returns:
+ *   - Bytes written, -1 if the text is not a number, has more than 31
+ *     digits or more decimals than the scale.
+ */
+static int encode_decimal(const char *text, int scale, char *out)
+{
+    char digits[64 + 31];
+    unsigned long long value = 0;
+    int negative, count, fraction, n, i;
+
+    if (read_number_text(text, &negative, digits, &count, &fraction) != 0)
+        return -1;
+    if (scale < 0)
+        scale = fraction;
+    for (; fraction > scale; fraction--, count--)
+    {
+        if (digits[count - 1] != 0)
+            return -1; // Would be rounded
+    }
+    for (; fraction < scale; fraction++)
+        digits[count++] = 0;
+    for (i = 0; i < count && digits[i] == 0; i++)
+        ; // Zeros that led the fraction
+    memmove(digits, digits + i, count - i);
+    count -= i;
+    if (scale > 31 || count > 31)
+        return -1;
+
+    if (count <= 18)
+    {
+        out[0] = (char)scale;
+        for (i = 0; i < count; i++)
+            value = value * 10 + digits[i];
+        return 1 + put_varint(out + 1, negative && value > 0 ? (value - 1) * 2 + 1 : value * 2);
+    }
+
+    // Packed decimal: two digits per byte, the sign (C or D) in the last half byte
+    out[0] = (char)(scale | REDIS_ROW_PACKED);
+    n = count / 2 + 1;
+    out[1] = (char)n;
+    memset(out + 2, 0, n);
+    for (i = 0; i < count; i++)
+    {
+        int nibble = 2 * n - 1 - count + i; // Right-aligned before the sign
+        out[2 + nibble / 2] |= nibble % 2 ? digits[i] : digits[i] << 4;
+    }
+    out[1 + n] |= negative ? 0x0D : 0x0C;
+    return 2 + n;
+}
+
+/**
+ * Function: days_from_civil
+ * Description: Counts the days from 1970-01-01 to a date of the proleptic
+ *              Gregorian calendar.
+ * Returns:
+ *   - Number of days (negative before 1970).
+ */
+static long days_from_civil(int year, int month, int day)
+{
+    long era;
+    unsigned int yoe, doy, doe;
+
+    year -= month <= 2;
+    era = year / 400;
+    yoe = (unsigned int)(year - era * 400);
+    doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long)doe - 719468;
+}
+
+/**
+ * Function: read_text_number
+ * Description: Reads exactly width digits.
+ * Returns:
+ *   - The number, -1 if a character is not a digit.
+ */
+static int read_text_number(const char **p, int width)
+{
+    int n = 0;
+
+    for (; width > 0; width--, (*p)++)
+    {
+        if (!IS_DIGIT(**p))
+            return -1;
+        n = n * 10 + ((uchar)**p - 0xF0);
+    }
+    return n;
+}
+
+/**
+ * Function: read_date_text
+ * Description: Reads an ISO date (YYYY-MM-DD) at *p.
+ * Returns:
+ *   - Days since 0001-01-01, -1 if it is not a valid date.
+ */
+static long read_date_text(const char **p)
+{
+    static const int month_days[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int year, month, day;
+
+    while (**p == 0x40) // EBCDIC ' '
+        (*p)++;
+    year = read_text_number(p, 4);
+    if (year < 1 || *(*p)++ != 0x60) // EBCDIC '-'
+        return -1;
+    month = read_text_number(p, 2);
+    if (month < 1 || month > 12 || *(*p)++ != 0x60)
+        return -1;
+    day = read_text_number(p, 2);
+    if (day < 1 || day > month_days[month - 1] ||
+        (month == 2 && day == 29 && (year % 4 != 0 || (year % 100 == 0 && year % 400 != 0))))
+        return -1;
+    return days_from_civil(year, month, day) - days_from_civil(1, 1, 1);
+}
+
+/**
+ * Function: encode_date
+ * Description: Encodes a DATE column as 3 bytes of days since 0001-01-01.
+ * Returns:
+ *   - Bytes written, -1 if the text is not an ISO date.
+ */
+static int encode_date(const char *text, char *out)
+{
+    long days = read_date_text(&text);
+
+    while (*text == 0x40)
+        text++;
+    if (days < 0 || *text != '\0')
+        return -1;
+    out[0] = (char)(days >> 16);
+    out[1] = (char)(days >> 8);
+    out[2] = (char)days;
+    return 3;
+}
+
+/**
+ * Function: encode_timestamp
+ * Description: Encodes a TIMESTAMP column as 8 bytes of microseconds since
+ *              0001-01-01-00.00.00. Reads the Db2 form
+ *              (YYYY-MM-DD-HH.MM.SS.ffffff) and the ISO form
+ *              (YYYY-MM-DD HH:MM:SS.ffffff); digits past the microseconds
+ *              must be zeros.
+ * Returns:
+ *   - Bytes written, -1 if the text is not a timestamp.
+ */
+static int encode_timestamp(const char *text, char *out)
+{
+    long long micros;
+    long days = read_date_text(&text);
+    int hour, minute, second, i, digit;
+
+    if (days < 0 || (*text != 0x60 && *text != 0x40 && (uchar)*text != 0xE3)) // EBCDIC '-', ' ', 'T'
+        return -1;
+    text++;
+    hour = read_text_number(&text, 2);
+    if (hour < 0 || hour > 23 || (*text != 0x4B && *text != 0x7A)) // EBCDIC '.', ':'
+        return -1;
+    text++;
+    minute = read_text_number(&text, 2);
+    if (minute < 0 || minute > 59 || (*text != 0x4B && *text != 0x7A))
+        return -1;
+    text++;
+    second = read_text_number(&text, 2);
+    if (second < 0 || second > 59)
+        return -1;
+    micros = ((long long)days * 86400 + hour * 3600 + minute * 60 + second) * 1000000;
+    if (*text == 0x4B || *text == 0x6B) // EBCDIC '.', ','
+    {
+        for (text++, i = 0; IS_DIGIT(*text); text++, i++)
+        {
+            digit = (uchar)*text - 0xF0;
+            if (i >= 12 || (i >= 6 && digit != 0))
+                return -1;
+            if (i < 6)
+                micros += digit * (i == 0 ? 100000 : i == 1 ? 10000 : i == 2 ? 1000 : i == 3 ? 100 : i == 4 ? 10 : 1);
+        }
+    }
+    while (*text == 0x40)
+        text++;
+    if (*text != '\0')
+        return -1;
+    for (i = 0; i < 8; i++)
+        out[i] = (char)(micros >> (56 - 8 * i));
+    return 8;
+}
+
+int encode_redis_row(int count, const RedisRowColumn *columns, const char **values, const SQLUDF_NULLIND *inds,
+                     char *record, size_t size, char *sqlstate, char *msgtext)
+{
+    static const char *type_names[] = {"", "INTEGER", "DECIMAL", "DATE", "TIMESTAMP", "VARCHAR"};
+    size_t pos = 2, len;
+    int i, rc;
+
+    record[0] = REDIS_ROW_VERSION;
+    record[1] = (char)count;
+    for (i = 0; i < count; i++)
+    {
+        len = inds[i] < 0 ? 0 : strlen(values[i]);
+        if (pos + 1 + 20 + len > size) // Tag, longest fixed encoding or varint length, text
+        {
+            strcpy(sqlstate, "38908");
+            strcpy(msgtext, "Row exceeds maximum encoded length");
+            return -1;
+        }
+        if (inds[i] < 0)
+        {
+            record[pos++] = (char)(columns[i].type | REDIS_ROW_NULL);
+            continue;
+        }
+        record[pos++] = (char)columns[i].type;
+        switch (columns[i].type)
+        {
+        case REDIS_ROW_INTEGER:
+            rc = encode_integer(values[i], record + pos);
+            break;
+        case REDIS_ROW_DECIMAL:
+            rc = encode_decimal(values[i], columns[i].scale, record + pos);
+            break;
+        case REDIS_ROW_DATE:
+            rc = encode_date(values[i], record + pos);
+            break;
+        case REDIS_ROW_TIMESTAMP:
+            rc = encode_timestamp(values[i], record + pos);
+            break;
+        default: // Text is stored as ASCII, after its length
+            rc = put_varint(record + pos, len);
+            if (len > 0 && ConvertToASCII((char *)values[i], len, record + pos + rc, size - pos - rc) < 0)
+            {
+                strcpy(sqlstate, "38902");
+                strcpy(msgtext, "Failed to convert value to ASCII");
+                return -1;
+            }
+            rc += (int)len;
+            break;
+        }
+        if (rc < 0)
+        {
+            strcpy(sqlstate, "38003");
+            snprintf(msgtext, 70, "Value of column %d is not a valid %s", i + 1, type_names[columns[i].type]);
+            return -1;
+        }
+        pos += rc;
+    }
+    return (int)pos;
+}
+
+/**********************************************************************/
+/* SQL External Function: CACHE_ROW */
+/**********************************************************************/
+
+/**
+ * Function: cacheRowRedis
+ * Description: SQL external function to cache a row as one value: the
+ *              columns are encoded by the types of the layout and stored
+ *              with one SET, with an optional TTL. REDIS_FETCH_ROW reads
+ *              it back as typed columns.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - ttl: Input TTL in seconds, NULL for none.
+ *   - layout: Input column names and types, comma-separated (VARCHAR(4096),
+ *     EBCDIC), e.g. 'ID INTEGER, BALANCE DECIMAL(9,2), OPENED DATE'.
+ *   - col1 .. col40: Input column values as text (VARCHAR(4096), EBCDIC);
+ *     NULL is stored as NULL.
+ *   - result: Output length of the encoded row in bytes (INTEGER).
+ *   - *Ind: Null indicators for the inputs and the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38003" for a value
+ *     that does not read as its type.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (not used).
+ *   - nullind: Additional null indicators (not used).
+ */
+void SQL_API_FN cacheRowRedis(
+    SQLUDF_VARCHAR *key,             // Input: Redis key (EBCDIC)
+    SQLUDF_INTEGER *ttl,             // Input: TTL in seconds
+    SQLUDF_VARCHAR *layout,          // Input: column names and types (EBCDIC)
+    SQLUDF_VARCHAR *col1,            // Input: column values (EBCDIC)
+    SQLUDF_VARCHAR *col2,
+    SQLUDF_VARCHAR *col3,
+    SQLUDF_VARCHAR *col4,
+    SQLUDF_VARCHAR *col5,
+    SQLUDF_VARCHAR *col6,
+    SQLUDF_VARCHAR *col7,
+    SQLUDF_VARCHAR *col8,
+    SQLUDF_VARCHAR *col9,
+    SQLUDF_VARCHAR *col10,
+    SQLUDF_VARCHAR *col11,
+    SQLUDF_VARCHAR *col12,
+    SQLUDF_VARCHAR *col13,
+    SQLUDF_VARCHAR *col14,
+    SQLUDF_VARCHAR *col15,
+    SQLUDF_VARCHAR *col16,
+    SQLUDF_VARCHAR *col17,
+    SQLUDF_VARCHAR *col18,
+    SQLUDF_VARCHAR *col19,
+    SQLUDF_VARCHAR *col20,
+    SQLUDF_VARCHAR *col21,
+    SQLUDF_VARCHAR *col22,
+    SQLUDF_VARCHAR *col23,
+    SQLUDF_VARCHAR *col24,
+    SQLUDF_VARCHAR *col25,
+    SQLUDF_VARCHAR *col26,
+    SQLUDF_VARCHAR *col27,
+    SQLUDF_VARCHAR *col28,
+    SQLUDF_VARCHAR *col29,
+    SQLUDF_VARCHAR *col30,
+    SQLUDF_VARCHAR *col31,
+    SQLUDF_VARCHAR *col32,
+    SQLUDF_VARCHAR *col33,
+    SQLUDF_VARCHAR *col34,
+    SQLUDF_VARCHAR *col35,
+    SQLUDF_VARCHAR *col36,
+    SQLUDF_VARCHAR *col37,
+    SQLUDF_VARCHAR *col38,
+    SQLUDF_VARCHAR *col39,
+    SQLUDF_VARCHAR *col40,
+    SQLUDF_INTEGER *result,          // Output: length of the encoded row
+    SQLUDF_NULLIND *keyInd,          // Null indicators for inputs
+    SQLUDF_NULLIND *ttlInd,
+    SQLUDF_NULLIND *layoutInd,
+    SQLUDF_NULLIND *col1Ind,
+    SQLUDF_NULLIND *col2Ind,
+    SQLUDF_NULLIND *col3Ind,
+    SQLUDF_NULLIND *col4Ind,
+    SQLUDF_NULLIND *col5Ind,
+    SQLUDF_NULLIND *col6Ind,
+    SQLUDF_NULLIND *col7Ind,
+    SQLUDF_NULLIND *col8Ind,
+    SQLUDF_NULLIND *col9Ind,
+    SQLUDF_NULLIND *col10Ind,
+    SQLUDF_NULLIND *col11Ind,
+    SQLUDF_NULLIND *col12Ind,
+    SQLUDF_NULLIND *col13Ind,
+    SQLUDF_NULLIND *col14Ind,
+    SQLUDF_NULLIND *col15Ind,
+    SQLUDF_NULLIND *col16Ind,
+    SQLUDF_NULLIND *col17Ind,
+    SQLUDF_NULLIND *col18Ind,
+    SQLUDF_NULLIND *col19Ind,
+    SQLUDF_NULLIND *col20Ind,
+    SQLUDF_NULLIND *col21Ind,
+    SQLUDF_NULLIND *col22Ind,
+    SQLUDF_NULLIND *col23Ind,
+    SQLUDF_NULLIND *col24Ind,
+    SQLUDF_NULLIND *col25Ind,
+    SQLUDF_NULLIND *col26Ind,
+    SQLUDF_NULLIND *col27Ind,
+    SQLUDF_NULLIND *col28Ind,
+    SQLUDF_NULLIND *col29Ind,
+    SQLUDF_NULLIND *col30Ind,
+    SQLUDF_NULLIND *col31Ind,
+    SQLUDF_NULLIND *col32Ind,
+    SQLUDF_NULLIND *col33Ind,
+    SQLUDF_NULLIND *col34Ind,
+    SQLUDF_NULLIND *col35Ind,
+    SQLUDF_NULLIND *col36Ind,
+    SQLUDF_NULLIND *col37Ind,
+    SQLUDF_NULLIND *col38Ind,
+    SQLUDF_NULLIND *col39Ind,
+    SQLUDF_NULLIND *col40Ind,
+    SQLUDF_NULLIND *resultInd,       // Null indicator for output
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    short *sqlcode,                  // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)         // Additional null indicators for DB2SQL
+{
+    const char *values[REDIS_ROW_COLUMNS] = {col1, col2, col3, col4, col5, col6, col7, col8, col9, col10,
+                                             col11, col12, col13, col14, col15, col16, col17, col18, col19, col20,
+                                             col21, col22, col23, col24, col25, col26, col27, col28, col29, col30,
+                                             col31, col32, col33, col34, col35, col36, col37, col38, col39, col40};
+    SQLUDF_NULLIND inds[REDIS_ROW_COLUMNS] = {*col1Ind, *col2Ind, *col3Ind, *col4Ind, *col5Ind,
+                                              *col6Ind, *col7Ind, *col8Ind, *col9Ind, *col10Ind,
+                                              *col11Ind, *col12Ind, *col13Ind, *col14Ind, *col15Ind,
+                                              *col16Ind, *col17Ind, *col18Ind, *col19Ind, *col20Ind,
+                                              *col21Ind, *col22Ind, *col23Ind, *col24Ind, *col25Ind,
+                                              *col26Ind, *col27Ind, *col28Ind, *col29Ind, *col30Ind,
+                                              *col31Ind, *col32Ind, *col33Ind, *col34Ind, *col35Ind,
+                                              *col36Ind, *col37Ind, *col38Ind, *col39Ind, *col40Ind};
+    RedisRowColumn columns[REDIS_ROW_COLUMNS];
+    char reply[256], ttl_text[REDIS_DOUBLE_TEXT];
+    char *record, *cmd;
+    RedisReplyItem item;
+    size_t pos = 0;
+    int sockfd, count, record_len, len, i;
+
+    strcpy(sqlstate, "00000");
+    *resultInd = -1;
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    if (*keyInd < 0 || *layoutInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input key or layout is NULL");
+        return;
+    }
+    if (*ttlInd >= 0 && *ttl <= 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "TTL must be positive");
+        return;
+    }
+    count = parse_redis_layout(layout, columns);
+    if (count < 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, count == -2 ? "Layout must name 1 to 40 columns" : "Layout is malformed or names an unknown type");
+        return;
+    }
+    for (i = count; i < REDIS_ROW_COLUMNS; i++)
+    {
+        if (inds[i] >= 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "More values than columns in the layout");
+            return;
+        }
+    }
+
+    // Call buffers come from the thread's arena and are given back on release
+    record = redis_arena_alloc(REDIS_ROW_RECORD + ROW_SEND_BUFFER);
+    if (record == NULL)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for call buffers");
+        release_redis_connection(-1, sqlstate);
+        return;
+    }
+    cmd = record + REDIS_ROW_RECORD;
+    record_len = encode_redis_row(count, columns, values, inds, record, REDIS_ROW_RECORD, sqlstate, msgtext);
+    if (record_len < 0)
+    {
+        release_redis_connection(-1, sqlstate);
+        return;
+    }
+
+    // SET key row [EX ttl]; the row is binary and goes as is
+    len = append_redis_header(cmd, ROW_SEND_BUFFER, 0, *ttlInd >= 0 ? 5 : 3);
+    len = append_redis_argument(cmd, ROW_SEND_BUFFER, len, "\xE2\xC5\xE3", 3, 0); // EBCDIC "SET"
+    len = append_redis_argument(cmd, ROW_SEND_BUFFER, len, key, strlen(key), 0);
+    len = append_redis_argument(cmd, ROW_SEND_BUFFER, len, record, record_len, 1);
+    if (*ttlInd >= 0)
+    {
+        len = append_redis_argument(cmd, ROW_SEND_BUFFER, len, "\xC5\xE7", 2, 0); // EBCDIC "EX"
+        len = append_redis_argument(cmd, ROW_SEND_BUFFER, len, ttl_text, format_ebcdic_integer(*ttl, ttl_text), 0);
+    }
+    if (len < 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Failed to convert command to ASCII");
+        release_redis_connection(-1, sqlstate);
+        return;
+    }
+
+    // Write-behind mode: queue the command for the flusher and return
+    if (redis_write_behind_enabled())
+    {
+        if (redis_write_behind_queue(key, cmd, len, sqlstate, msgtext) == 0)
+        {
+            *result = record_len;
+            *resultInd = 0;
+        }
+        release_redis_connection(-1, sqlstate);
+        return;
+    }
+
+    if (connect_to_redis_key(&sockfd, key) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        release_redis_connection(-1, sqlstate);
+        return;
+    }
+    if (send_redis_command(sockfd, cmd, len) < 0)
+    {
+        strcpy(sqlstate, "38903");
+        snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    len = recv_redis_reply(sockfd, reply, sizeof(reply) - 1);
+    if (len < 0)
+    {
+        if (errno == EWOULDBLOCK || errno == EAGAIN)
+        {
+            strcpy(sqlstate, "38904");
+            snprintf(msgtext, 70, "Receive timeout from Redis: errno=%d, socket=%d", errno, sockfd);
+        }
+        else
+        {
+            strcpy(sqlstate, "38905");
+            snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
+        }
+    }
+    else if (len == 0)
+    {
+        strcpy(sqlstate, "38906");
+        snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
+    }
+    else if (redis_reply_item(reply, len, &pos, &item) != 0 || (item.type != 0x2B && item.type != 0x2D))
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+    }
+    else if (item.type == 0x2D) // ASCII '-' error reply
+    {
+        len = item.len < 70 ? (int)item.len : 70;
+        ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+        msgtext[len] = '\0';
+        strcpy(sqlstate, "38911");
+    }
+    else // ASCII '+OK'
+    {
+        *result = record_len;
+        *resultInd = 0;
+    }
+    release_redis_connection(sockfd, sqlstate);
+}
+
+#pragma linkage(cacheRowRedis, OS)
@@ -34,7 +34,7 @@ void SQL_API_FN dbsizeRedis(
     SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
 {
     int sockfd;
-    char ebcdic_send_buf[1024], ascii_send_buf[1024], recv_buf[1024], ebcdic_payload[1024];
+    char ebcdic_send_buf[1024], ascii_send_buf[1024], recv_buf[1024];
     int len, total_len = 0;
 
 #ifdef USE_ICONV
@@ -58,7 +58,7 @@ void SQL_API_FN dbsizeRedis(
     *valueInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_read(&sockfd) != 0)
     {
         strcpy(sqlstate, "38901");
         strcpy(msgtext, "Failed to connect to Redis");
@@ -81,30 +81,30 @@ void SQL_API_FN dbsizeRedis(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send command
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
     if (len < 0)
     {
         strcpy(sqlstate, errno == EWOULDBLOCK || errno == EAGAIN ? "38904" : "38905");
         strcpy(msgtext, "Failed to receive data from Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -112,30 +112,18 @@ void SQL_API_FN dbsizeRedis(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     total_len = len;
     recv_buf[total_len] = '\0';
 
-    // Convert response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-    {
-        strcpy(sqlstate, "38907");
-        strcpy(msgtext, "Failed to convert response to EBCDIC");
-        *valueInd = -1;
-        close(sockfd);
-        return;
-    }
-    ebcdic_payload[total_len] = '\0';
-
     // Extract response — DBSIZE returns an integer (:N\r\n)
-    char *payload = NULL;
-    size_t payload_length;
-    if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+    long long number;
+    if (parse_redis_integer(recv_buf, total_len, &number) == 0)
     {
-        *value = atol(payload);
+        *value = number;
         *valueInd = 0;
     }
     else
@@ -145,7 +133,7 @@ void SQL_API_FN dbsizeRedis(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(dbsizeRedis, OS)
@@ -4,7 +4,8 @@
  * Date: 2025-02-22
  * Description: Implementation of the Redis DECRBY function for IBM i.
  *              This function decrements the integer value of a key by a
- *              specified amount. Returns the new value after decrementing.
+ *              specified amount. Returns the new value after decrementing,
+ *              or NULL when the decrement is coalesced.
  * License: MIT (https://opensource.org/licenses/MIT)
  * Version: 1.0.0
  ******************************************************************************/
@@ -14,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #ifdef USE_ICONV
 #include <qtqiconv.h>
 #endif
@@ -37,7 +39,7 @@ void SQL_API_FN decrbyRedisValue(
 	SQLUDF_NULLIND *nullind)   // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[512], ascii_send_buf[512], recv_buf[1024], ebcdic_payload[1024];
+	char ebcdic_send_buf[512], ascii_send_buf[512], recv_buf[1024];
 	char ebcdic_key_len[10] = {0}, ebcdic_decr_len[10] = {0};
 	int len, total_len = 0;
 
@@ -72,8 +74,16 @@ void SQL_API_FN decrbyRedisValue(
 		return;
 	}
 
+	// Coalescing mode: add to the job's pending counter of the key
+	if (redis_coalesce_enabled() && *decrement != LLONG_MIN)
+	{
+		redis_coalesce_add(key, NULL, -*decrement, sqlstate, msgtext);
+		*resultInd = -1; // The new value is not known yet
+		return;
+	}
+
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
@@ -164,24 +174,24 @@ void SQL_API_FN decrbyRedisValue(
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send DECRBY command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -195,7 +205,7 @@ void SQL_API_FN decrbyRedisValue(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -203,30 +213,18 @@ void SQL_API_FN decrbyRedisValue(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-	{
-		strncpy(sqlstate, "38907", 5);
-		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-	ebcdic_payload[total_len] = '\0';
-
-	// Extract Redis response
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+	// Parse the integer reply from the received bytes
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		*result = atol(payload);
+		*result = number;
 		*resultInd = 0;
 	}
 	else
@@ -236,7 +234,7 @@ void SQL_API_FN decrbyRedisValue(
 		*resultInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(decrbyRedisValue, OS)
@@ -51,7 +51,7 @@ void SQL_API_FN delRedisKey(
     SQLUDF_NULLIND *nullind)   // Additional null indicators for DB2SQL
 {
     int sockfd;
-    char ebcdic_send_buf[512], ascii_send_buf[512], recv_buf[1024], ebcdic_payload[1024];
+    char ebcdic_send_buf[512], ascii_send_buf[512], recv_buf[1024];
     char ebcdic_len[10] = {0};
     int len, total_len = 0;
 
@@ -86,7 +86,7 @@ void SQL_API_FN delRedisKey(
     *resultInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_key(&sockfd, key) != 0)
     {
         strcpy(sqlstate, "38901");
         strcpy(msgtext, "Failed to connect to Redis");
@@ -137,24 +137,24 @@ void SQL_API_FN delRedisKey(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *resultInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send DEL command to Redis
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *resultInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response from Redis
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -168,7 +168,7 @@ void SQL_API_FN delRedisKey(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *resultInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -176,31 +176,18 @@ void SQL_API_FN delRedisKey(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *resultInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     total_len = len;
     recv_buf[total_len] = '\0';
 
-    // Convert ASCII response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
+    // Parse the integer reply from the received bytes
+    long long number;
+    if (parse_redis_integer(recv_buf, total_len, &number) == 0)
     {
-        strcpy(sqlstate, "38907");
-        strcpy(msgtext, "Failed to convert response to EBCDIC");
-        *resultInd = -1;
-        close(sockfd);
-        return;
-    }
-    ebcdic_payload[total_len] = '\0';
-
-    // Extract Redis response
-    char *payload = NULL;
-    size_t payload_length;
-    if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
-    {
-        // Parse the integer value from the payload
-        *result = atoi(payload); // Convert the payload to a SMALLINT (1 or 0)
+        *result = number;
         *resultInd = 0;
     }
     else
@@ -209,10 +196,8 @@ void SQL_API_FN delRedisKey(
         strcpy(msgtext, "Failed to extract payload from Redis response");
         *resultInd = -1;
     }
-    // if (payload)
-    //     free(payload);
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(delRedisKey, OS)
\ No newline at end of file
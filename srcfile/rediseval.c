@@ -0,0 +1,326 @@
+/******************************************************************************
+ * File: rediseval.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_EVAL table function for IBM i.
+ *              Runs a Lua script on the server and returns its reply as
+ *              typed rows, like REDIS_COMMAND_TABLE. The script is given
+ *              as its body or as the SHA1 returned by REDIS_SCRIPT_LOAD;
+ *              either way it is run with EVALSHA through the job's script
+ *              registry (see redisscpt.c), so the body crosses the network
+ *              once per endpoint rather than on every call.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define EVAL_VALUE 16370 // Length of the VALUE column
+#define EVAL_SHA 40      // Length of a SHA1 in hex
+
+/**
+ * Function: script_sha
+ * Description: Tells whether the SCRIPT input is a SHA1 rather than a
+ *              body, and converts it to lowercase ASCII.
+ * Parameters:
+ *   - script: SCRIPT input (EBCDIC).
+ *   - sha: Receives the SHA1 (ASCII, null-terminated).
+ * Returns:
+ *   - 1 for 40 hex digits, 0 otherwise.
+ */
+static int script_sha(const char *script, char *sha)
+{
+    unsigned char c;
+    int i;
+
+    for (i = 0; i < EVAL_SHA; i++)
+    {
+        c = (unsigned char)script[i];
+        if (c >= 0xF0 && c <= 0xF9) // EBCDIC '0'-'9'
+            sha[i] = (char)(0x30 + c - 0xF0);
+        else if ((c >= 0x81 && c <= 0x86) || (c >= 0xC1 && c <= 0xC6)) // EBCDIC 'a'-'f', 'A'-'F'
+            sha[i] = (char)(0x61 + (c & 0x0F) - 1);
+        else
+            return 0;
+    }
+    sha[EVAL_SHA] = '\0';
+    return script[EVAL_SHA] == '\0';
+}
+
+/**
+ * Function: split_words
+ * Description: Splits a list of keys or arguments into words. Blanks,
+ *              semicolons and line feeds separate them; double quotes
+ *              protect them, "" is a double quote.
+ * Parameters:
+ *   - text: The list (EBCDIC), NULL for none.
+ *   - out: Receives the words, each null-terminated (twice the length of
+ *     the text plus 2 bytes).
+ *   - argv: Receives the words, NULL to count them only.
+ *   - argl: Receives their lengths.
+ * Returns:
+ *   - Number of words, -1 for an unterminated quote.
+ */
+static int split_words(const char *text, char *out, const char **argv, size_t *argl)
+{
+    size_t len;
+    int count = 0, rc;
+
+    if (text == NULL)
+        return 0;
+    for (;;)
+    {
+        rc = next_redis_word(&text, out, &len);
+        if (rc < 0)
+            return -1;
+        if (rc == 0 && *text == '\0')
+            return count;
+        if (rc == 0)
+        {
+            text++; // Separator between words
+            continue;
+        }
+        if (argv != NULL)
+        {
+            argv[count] = out;
+            argl[count] = len;
+            out += len + 1;
+        }
+        count++;
+    }
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: evalRedis
+ * Description: SQL external table function to run a Lua script and return
+ *              its reply as rows: a single value gives one row at level 0,
+ *              the elements of an array (a Lua table) are rows at level 1,
+ *              nested arrays go one level deeper. The first key routes the
+ *              script in cluster or sharded mode.
+ * Parameters:
+ *   - script: Input Lua script, or the SHA1 of a loaded script (EBCDIC).
+ *   - keys: Input keys (KEYS[1] ...), blank-separated (EBCDIC); NULL for
+ *     none.
+ *   - args: Input arguments (ARGV[1] ...), blank-separated (EBCDIC); NULL
+ *     for none.
+ *   - position: Output 1-based position in the enclosing array.
+ *   - level: Output nesting level.
+ *   - type: Output type: status, error, integer, string, array or nil
+ *     (VARCHAR(8), EBCDIC).
+ *   - value: Output text of the value (EBCDIC); NULL for arrays and nil.
+ *   - integerValue: Output value of integers, element count of arrays.
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis (e.g., NOSCRIPT for a SHA1 the
+ *     server does not know, or a runtime error of the script).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the cursor and the reply.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN evalRedis(
+    SQLUDF_VARCHAR *script,          // Input: Lua script or SHA1 (EBCDIC)
+    SQLUDF_VARCHAR *keys,            // Input: keys (EBCDIC)
+    SQLUDF_VARCHAR *args,            // Input: arguments (EBCDIC)
+    SQLUDF_INTEGER *position,        // Output: position in the enclosing array
+    SQLUDF_INTEGER *level,           // Output: nesting level
+    SQLUDF_VARCHAR *type,            // Output: RESP type (EBCDIC)
+    SQLUDF_VARCHAR *value,           // Output: text of the value (EBCDIC)
+    SQLUDF_BIGINT *integerValue,     // Output: integer value or element count
+    SQLUDF_NULLIND *scriptInd,       // Null indicators for inputs
+    SQLUDF_NULLIND *keysInd,
+    SQLUDF_NULLIND *argsInd,
+    SQLUDF_NULLIND *positionInd,     // Null indicators for outputs
+    SQLUDF_NULLIND *levelInd,
+    SQLUDF_NULLIND *typeInd,
+    SQLUDF_NULLIND *valueInd,
+    SQLUDF_NULLIND *integerValueInd,
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,   // Cursor and reply between calls
+    SQLUDF_CALL_TYPE *calltype)      // Open, fetch or close
+{
+    char *reply = scratchpad->data + sizeof(RedisReplyCursor);
+    const char *key_text = *keysInd < 0 ? NULL : keys;
+    const char *arg_text = *argsInd < 0 ? NULL : args;
+    char sha[EVAL_SHA + 1], *words;
+    const char **argv;
+    size_t *argl, text_len, pos;
+    RedisReplyCursor cursor;
+    RedisReplyItem item;
+    int sockfd, key_count, argc, len, rc;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+#ifdef USE_ICONV
+        if (!initialized)
+        {
+            initialize_conversion();
+            initialized = 1;
+        }
+        if (errno != 0)
+        {
+            strcpy(sqlstate, "38999");
+            strcpy(msgtext, "iconv initialization failed");
+            return;
+        }
+#endif
+        // Check for NULL or empty input
+        if (*scriptInd < 0)
+        {
+            strcpy(sqlstate, "38001");
+            strcpy(msgtext, "Input script is NULL");
+            return;
+        }
+        if (script[0] == '\0')
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Input script is empty");
+            return;
+        }
+        if (scratchpad->length < sizeof(RedisReplyCursor) + 1024)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Scratchpad too small: create the function with SCRATCHPAD 32767");
+            return;
+        }
+
+        // A SHA1 runs a loaded script; a body is registered (once) and run by its SHA1
+        if (!script_sha(script, sha) && redis_script_register(script, strlen(script), 0, sha) != 0)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, "Out of memory for the script registry");
+            return;
+        }
+
+        // Keys, then arguments, as words in the call's arena
+        text_len = (key_text ? strlen(key_text) : 0) + (arg_text ? strlen(arg_text) : 0);
+        words = redis_arena_alloc(2 * text_len + 4);
+        key_count = words == NULL ? 0 : split_words(key_text, words, NULL, NULL);
+        argc = words == NULL ? 0 : split_words(arg_text, words, NULL, NULL);
+        if (key_count < 0 || argc < 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Unterminated quote in keys or arguments");
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+        argc += key_count;
+        argv = redis_arena_alloc((argc + 1) * (sizeof(char *) + sizeof(size_t)));
+        if (words == NULL || argv == NULL)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, "Out of memory building the command");
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+        argl = (size_t *)(argv + argc + 1);
+        split_words(key_text, words, argv, argl);
+        split_words(arg_text, key_count > 0 ? (char *)argv[key_count - 1] + argl[key_count - 1] + 1 : words,
+                    argv + key_count, argl + key_count);
+
+        if ((key_count > 0 ? connect_to_redis_key(&sockfd, argv[0]) : connect_to_redis(&sockfd)) != 0)
+        {
+            strcpy(sqlstate, "38901");
+            snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+
+        // Receive straight into the scratchpad, behind the cursor
+        len = eval_redis_script(sockfd, sha, argc, argv, argl, key_count, reply,
+                                scratchpad->length - sizeof(RedisReplyCursor), sqlstate, msgtext);
+        if (len < 0)
+        {
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
+
+        memset(&cursor, 0, sizeof(cursor));
+        cursor.len = len;
+        pos = 0;
+        if (redis_reply_item(reply, len, &pos, &item) != 0)
+        {
+            strcpy(sqlstate, "38909");
+            strcpy(msgtext, "Failed to parse Redis response");
+        }
+        else if (item.type == 0x2D) // ASCII '-' error reply
+        {
+            len = item.len < 70 ? item.len : 70;
+            ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+            msgtext[len] = '\0';
+            strcpy(sqlstate, "38911");
+        }
+        else if (item.type == 0x2A && !item.nil) // ASCII '*': rows are the elements
+        {
+            cursor.pos = (int)pos;
+            cursor.depth = 1;
+            cursor.remaining[0] = (int)item.len;
+        }
+        release_redis_connection(sockfd, sqlstate);
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    memcpy(&cursor, scratchpad->data, sizeof(cursor));
+    rc = redis_reply_row(reply, &cursor, &item, position, level);
+    if (rc == 1)
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+    if (rc != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, rc == -2 ? "Reply nested too deeply" : "Failed to parse Redis response");
+        return;
+    }
+    if (item.type != 0x2A && item.len > EVAL_VALUE)
+    {
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Value exceeds maximum length");
+        return;
+    }
+
+    strcpy(type, redis_reply_type(&item));
+    *positionInd = 0;
+    *levelInd = 0;
+    *typeInd = 0;
+
+    if (item.type == 0x2A || item.nil)
+    {
+        *valueInd = -1;
+    }
+    else
+    {
+        ConvertToEBCDIC((char *)item.data, item.len, value, EVAL_VALUE);
+        value[item.len] = '\0';
+        *valueInd = 0;
+    }
+    *integerValueInd = -1;
+    if ((item.type == 0x3A || item.type == 0x2A) && !item.nil) // ASCII ':' / '*'
+    {
+        *integerValue = item.number;
+        *integerValueInd = 0;
+    }
+    memcpy(scratchpad->data, &cursor, sizeof(cursor));
+}
+
+#pragma linkage(evalRedis, OS)
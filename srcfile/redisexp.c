@@ -5,7 +5,8 @@
  * Description: Implementation of the Redis EXPIRE function for IBM i.
  *              This function sets an expiration time (TTL) in seconds for a Redis key.
  *              The function is designed to be used in an ILE environment and
- *              interacts with a Redis server via TCP/IP.
+ *              interacts with a Redis server via TCP/IP. In write-behind
+ *              mode the command is queued and NULL is returned.
  * License: MIT (https://opensource.org/licenses/MIT)
  * Version: 1.0.0
  ******************************************************************************/
@@ -26,7 +27,7 @@ void SQL_API_FN expireRedisKey(
 	short *sqlcode, SQLUDF_NULLIND *nullind)
 {
 	int sockfd;
-	char ebcdic_send_buf[512], ascii_send_buf[512], recv_buf[1024], ebcdic_payload[1024];
+	char ebcdic_send_buf[512], ascii_send_buf[512], recv_buf[1024];
 	char ebcdic_key_len[10] = {0}, ebcdic_ttl_len[10] = {0};
 	int len, total_len = 0;
 
@@ -73,14 +74,6 @@ void SQL_API_FN expireRedisKey(
 		return;
 	}
 
-	if (connect_to_redis(&sockfd) != 0)
-	{
-		strncpy(sqlstate, "38901", 5);
-		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
-		*resultInd = -1;
-		return;
-	}
-
 	ebcdic_send_buf[0] = '\0';
 	int key_len = strlen(key);
 	if (key_len > 255)
@@ -154,28 +147,43 @@ void SQL_API_FN expireRedisKey(
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
 		return;
 	}
 
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	// Write-behind mode: queue the command for the flusher and return
+	if (redis_write_behind_enabled())
+	{
+		redis_write_behind_queue(key, ascii_send_buf, ebcdic_len_size, sqlstate, msgtext);
+		*resultInd = -1; // No reply to report yet
+		return;
+	}
+
+	if (connect_to_redis_key(&sockfd, key) != 0)
+	{
+		strncpy(sqlstate, "38901", 5);
+		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+		*resultInd = -1;
+		return;
+	}
+
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		strncpy(sqlstate, errno == EWOULDBLOCK || errno == EAGAIN ? "38904" : "38905", 5);
 		snprintf(msgtext, 70, "Receive %s from Redis: errno=%d",
 				 errno == EWOULDBLOCK || errno == EAGAIN ? "timeout" : "error", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	if (len == 0)
@@ -183,56 +191,37 @@ void SQL_API_FN expireRedisKey(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis");
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-	{
-		strncpy(sqlstate, "38907", 5);
-		snprintf(msgtext, 70, "Failed to convert response to EBCDIC, errno=%d", errno);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+	// Parse the integer reply from the received bytes
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		if (payload_length == 1)
+		if (number == 1 || number == 0)
 		{
-			if (payload[0] == '\xF1')
-				*result = 1;
-			else if (payload[0] == '\xF0')
-				*result = 0;
-			else
-			{
-				strncpy(sqlstate, "38908", 5);
-				snprintf(msgtext, 70, "Unexpected response: %.1s", payload);
-				*resultInd = -1;
-			}
+			*result = (SQLUDF_SMALLINT)number;
+			*resultInd = 0;
 		}
 		else
 		{
 			strncpy(sqlstate, "38908", 5);
-			snprintf(msgtext, 70, "Invalid response length: %d", (int)payload_length);
+			snprintf(msgtext, 70, "Unexpected response: %lld", number);
 			*resultInd = -1;
 		}
-		*resultInd = 0;
-		free(payload);
 	}
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 70, "Failed to extract payload: %.20s", ebcdic_payload);
+		strncpy(msgtext, "Failed to extract payload from Redis response", 70);
 		*resultInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(expireRedisKey, OS)
\ No newline at end of file
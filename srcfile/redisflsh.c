@@ -0,0 +1,61 @@
+/******************************************************************************
+ * File: redisflsh.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_FLUSH function for IBM i.
+ *              Waits until the writes queued in write-behind mode (see
+ *              REDIS_WRITE_BEHIND) have been written and answered, and
+ *              reports the ones that failed since the previous flush.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: flushRedisWrites
+ * Description: SQL external function waiting for the write-behind queue.
+ *              When commands failed, SQLSTATE 01H11 (a warning) is set and
+ *              the message text is the first error, so the count is still
+ *              returned.
+ * Parameters:
+ *   - value: Output number of commands answered with an error or lost
+ *     with their connection since the previous flush.
+ *   - valueInd: Null indicator for the output value.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN flushRedisWrites(
+    SQLUDF_BIGINT *value,     // Output: failed commands
+    SQLUDF_NULLIND *valueInd, // Null indicator for output
+    char *sqlstate,           // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,           // Fully qualified function name
+    char *specname,           // Specific name
+    char *msgtext,            // Error message text (up to 70 chars)
+    short *sqlcode,           // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
+{
+    char error[71];
+
+    strcpy(sqlstate, "00000");
+    *value = redis_write_behind_flush(error);
+    *valueInd = 0;
+    if (*value > 0)
+    {
+        strcpy(sqlstate, "01H11"); // Warning: the value is still returned
+        strcpy(msgtext, error);
+    }
+}
+
+#pragma linkage(flushRedisWrites, OS)
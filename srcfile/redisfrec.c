@@ -0,0 +1,310 @@
+/******************************************************************************
+ * File: redisfrec.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Flight recorder for the REDISILE service program and the
+ *              REDIS_FLIGHT_DUMP function that writes it out.
+ *              The last REDIS_RECORDER_SIZE calls of the job are kept in a
+ *              ring buffer: start time, thread, the beginning of the
+ *              command and of the reply, bytes on the wire, latency,
+ *              SQLSTATE and errno. Writers claim a slot with an atomic
+ *              increment, so recording takes no lock. When a call ends
+ *              with an error SQLSTATE the ring is appended to
+ *              REDIS_RECORDER_FILE (at most once per
+ *              REDIS_RECORDER_INTERVAL seconds), so the calls leading up
+ *              to a failure can be read without reproducing it.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/**********************************************************************/
+/* Ring Buffer */
+/**********************************************************************/
+
+#ifdef __OS400__
+#define RING_CLAIM(counter) __fetch_and_add((volatile int *)(counter), 1)
+#else
+#define RING_CLAIM(counter) __sync_fetch_and_add((counter), 1)
+#endif
+
+typedef struct
+{
+    volatile unsigned int seq;           // Claim number + 1, 0 while being written
+    int thread;                          // Thread number within the job
+    struct timeval start;                // Start of the call
+    unsigned int us;                     // Latency in microseconds
+    char command[REDIS_RECORDER_PREFIX]; // Beginning of the command (ASCII RESP)
+    char reply[REDIS_RECORDER_PREFIX];   // Beginning of the reply (ASCII RESP)
+    unsigned char command_len, reply_len;
+    char sqlstate[6];                    // SQLSTATE of the call (job CCSID)
+    int error;                           // errno when the call failed
+    long long sent, received;            // Bytes on the wire
+} RedisFlightEntry;
+
+static RedisFlightEntry ring[REDIS_RECORDER_SIZE];
+static volatile unsigned int ring_next = 0;      // Next claim number
+static time_t last_dump = 0;                     // Time of the last automatic dump
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Function: redis_recorder_add
+ * Description: Records one call in the ring, overwriting the oldest entry.
+ * Parameters:
+ *   - thread: Thread number within the job.
+ *   - start: Start of the call.
+ *   - us: Latency in microseconds.
+ *   - command: Beginning of the command (ASCII).
+ *   - command_len: Length of the command prefix.
+ *   - reply: Beginning of the reply (ASCII).
+ *   - reply_len: Length of the reply prefix.
+ *   - sent: Bytes sent.
+ *   - received: Bytes received.
+ *   - sqlstate: SQLSTATE of the call.
+ *   - error: errno of a failed call, 0 otherwise.
+ */
+void redis_recorder_add(int thread, const struct timeval *start, unsigned int us,
+                        const char *command, size_t command_len, const char *reply, size_t reply_len,
+                        long long sent, long long received, const char *sqlstate, int error)
+{
+    unsigned int claim = RING_CLAIM(&ring_next);
+    RedisFlightEntry *e = &ring[claim % REDIS_RECORDER_SIZE];
+
+    e->seq = 0;
+    e->thread = thread;
+    e->start = *start;
+    e->us = us;
+    e->command_len = command_len < REDIS_RECORDER_PREFIX ? command_len : REDIS_RECORDER_PREFIX;
+    memcpy(e->command, command, e->command_len);
+    e->reply_len = reply_len < REDIS_RECORDER_PREFIX ? reply_len : REDIS_RECORDER_PREFIX;
+    memcpy(e->reply, reply, e->reply_len);
+    memcpy(e->sqlstate, sqlstate, 5);
+    e->sqlstate[5] = '\0';
+    e->error = error;
+    e->sent = sent;
+    e->received = received;
+    e->seq = claim + 1;
+}
+
+/**********************************************************************/
+/* Dump */
+/**********************************************************************/
+
+/**
+ * Function: printable
+ * Description: Copies ASCII protocol text to the job CCSID, replacing
+ *              control characters with '.'.
+ * Parameters:
+ *   - ascii: Text (ASCII).
+ *   - len: Length of the text.
+ *   - out: Output buffer (job CCSID), at least len + 1 bytes.
+ */
+static void printable(const char *ascii, size_t len, char *out)
+{
+    char clean[REDIS_RECORDER_PREFIX];
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)ascii[i];
+        clean[i] = (c < 0x20 || c > 0x7E) ? 0x2E : c; // ASCII '.'
+    }
+#ifdef __OS400__
+    ConvertToEBCDIC(clean, len, out, len);
+#else
+    memcpy(out, clean, len);
+#endif
+    out[len] = '\0';
+}
+
+/**
+ * Function: render_command
+ * Description: Renders the RESP arguments of a command prefix as
+ *              "ARG1 ARG2 ...", marking a cut-off argument with "...".
+ * Parameters:
+ *   - buf: Command prefix (ASCII RESP).
+ *   - len: Length of the prefix.
+ *   - out: Output buffer (job CCSID), at least 2 * REDIS_RECORDER_PREFIX bytes.
+ */
+static void render_command(const char *buf, size_t len, char *out)
+{
+    char arg[REDIS_RECORDER_PREFIX + 1];
+    size_t pos = 0, arg_len, take;
+    int used = 0;
+
+    out[0] = '\0';
+    while (pos < len && buf[pos] != 0x0A) // Skip "*<argc>\r\n"
+        pos++;
+    pos++;
+    while (pos < len && buf[pos] == 0x24) // ASCII '$'
+    {
+        arg_len = 0;
+        for (pos++; pos < len && buf[pos] >= 0x30 && buf[pos] <= 0x39; pos++)
+            arg_len = arg_len * 10 + (buf[pos] - 0x30);
+        pos += 2; // "\r\n"
+        if (pos >= len)
+            break;
+        take = len - pos < arg_len ? len - pos : arg_len;
+        printable(buf + pos, take, arg);
+        used += sprintf(out + used, "%s%s%s", used > 0 ? " " : "", arg, take < arg_len ? "..." : "");
+        pos += arg_len + 2;
+    }
+}
+
+/**
+ * Function: write_ring
+ * Description: Appends the recorded calls, oldest first, to a file.
+ * Parameters:
+ *   - path: File to append to (job CCSID).
+ *   - reason: Header text (job CCSID).
+ * Returns:
+ *   - Number of calls written, negative value if the file cannot be opened.
+ */
+static int write_ring(const char *path, const char *reason)
+{
+    char when[32], command[2 * REDIS_RECORDER_PREFIX + 8], reply[REDIS_RECORDER_PREFIX + 1];
+    RedisFlightEntry e;
+    struct tm tm;
+    time_t now = time(NULL), secs;
+    unsigned int next = ring_next, claim, first;
+    size_t reply_len;
+    FILE *fp;
+    int written = 0;
+
+#ifdef __OS400__
+    fp = fopen(path, "a, o_ccsid=1208"); // UTF-8 stream file, readable from PASE and Linux
+#else
+    fp = fopen(path, "a");
+#endif
+    if (fp == NULL)
+        return -1;
+
+    localtime_r(&now, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(fp, "=== %s job %d: %s (last %d calls)\n", when, (int)getpid(), reason,
+            next < REDIS_RECORDER_SIZE ? (int)next : REDIS_RECORDER_SIZE);
+
+    first = next < REDIS_RECORDER_SIZE ? 0 : next - REDIS_RECORDER_SIZE;
+    for (claim = first; claim != next; claim++)
+    {
+        e = ring[claim % REDIS_RECORDER_SIZE]; // Copy: writers keep going
+        if (e.seq != claim + 1)
+            continue; // Being rewritten
+        secs = e.start.tv_sec;
+        localtime_r(&secs, &tm);
+        strftime(when, sizeof(when), "%H:%M:%S", &tm);
+        render_command(e.command, e.command_len, command);
+        if (command[0] == '\0')
+            strcpy(command, "(connect)"); // Failed before a command was sent
+        for (reply_len = 0; reply_len < e.reply_len && e.reply[reply_len] != 0x0D; reply_len++)
+            ; // First line of the reply
+        printable(e.reply, reply_len, reply);
+        fprintf(fp, "%s.%06ld T%d %s errno=%d %uus sent=%lld recv=%lld | %s | %s\n",
+                when, (long)e.start.tv_usec, e.thread, e.sqlstate, e.error, e.us,
+                e.sent, e.received, command, reply);
+        written++;
+    }
+    fclose(fp);
+    return written;
+}
+
+/**
+ * Function: redis_recorder_error
+ * Description: Dumps the ring to REDIS_RECORDER_FILE after a failed call,
+ *              at most once per REDIS_RECORDER_INTERVAL seconds. Calls
+ *              failing while another thread dumps are not held up.
+ * Parameters:
+ *   - sqlstate: SQLSTATE of the failed call.
+ */
+void redis_recorder_error(const char *sqlstate)
+{
+    char reason[32];
+    time_t now;
+
+    if (REDIS_RECORDER_FILE[0] == '\0')
+        return;
+    now = time(NULL);
+    if (now - last_dump < REDIS_RECORDER_INTERVAL || pthread_mutex_trylock(&dump_lock) != 0)
+        return;
+    if (now - last_dump >= REDIS_RECORDER_INTERVAL)
+    {
+        last_dump = now;
+        sprintf(reason, "SQLSTATE %.5s", sqlstate);
+        write_ring(REDIS_RECORDER_FILE, reason);
+    }
+    pthread_mutex_unlock(&dump_lock);
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: dumpRedisFlight
+ * Description: SQL external function to append the flight recorder to a
+ *              file on demand.
+ * Parameters:
+ *   - path: Input file path (VARCHAR(256), EBCDIC); NULL writes to
+ *     REDIS_RECORDER_FILE.
+ *   - count: Output number of calls written.
+ *   - pathInd: Null indicator for the input path.
+ *   - countInd: Null indicator for the output count.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN dumpRedisFlight(
+    SQLUDF_VARCHAR *path,     // Input: file path (EBCDIC)
+    SQLUDF_INTEGER *count,    // Output: calls written
+    SQLUDF_NULLIND *pathInd,  // Null indicator for input
+    SQLUDF_NULLIND *countInd, // Null indicator for output
+    char *sqlstate,           // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,           // Fully qualified function name
+    char *specname,           // Specific name
+    char *msgtext,            // Error message text (up to 70 chars)
+    short *sqlcode,           // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
+{
+    const char *target = *pathInd < 0 ? REDIS_RECORDER_FILE : path;
+    int written;
+
+    if (target[0] == '\0')
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "No path given and REDIS_RECORDER_FILE is empty");
+        *countInd = -1;
+        return;
+    }
+
+    pthread_mutex_lock(&dump_lock);
+    written = write_ring(target, "REDIS_FLIGHT_DUMP");
+    pthread_mutex_unlock(&dump_lock);
+    if (written < 0)
+    {
+        strcpy(sqlstate, "38910");
+        snprintf(msgtext, 70, "Failed to open dump file: errno=%d", errno);
+        *countInd = -1;
+        return;
+    }
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+    *count = written;
+    *countInd = 0;
+}
+
+#pragma linkage(dumpRedisFlight, OS)
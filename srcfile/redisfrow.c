@@ -0,0 +1,456 @@
+/******************************************************************************
+ * File: redisfrow.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the Redis FETCH_ROW table function for
+ *              IBM i. Reads a row cached by REDIS_CACHE_ROW with one GET
+ *              and decodes it back to typed columns, one row per column.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define ROW_NAME 128              // Length of the NAME column
+#define ROW_VALUE 4096            // Length of the VALUE column
+#define DAYS_BEFORE_1970 719162L  // Days from 0001-01-01 to 1970-01-01
+
+// Position of the table function in the row kept in its scratchpad, and
+// the column names of the layout, parsed once at open
+typedef struct
+{
+    int len;    // Length of the encoded row
+    int pos;    // Offset of the next column
+    int column; // Columns returned
+    int count;  // Columns of the row
+    int names;  // Columns named by the layout
+    short name_pos[REDIS_ROW_COLUMNS]; // Offset of each name in the layout
+    short name_len[REDIS_ROW_COLUMNS]; // Length of each name
+} RowCursor;
+
+/**********************************************************************/
+/* Helper: Column Decoders */
+/**********************************************************************/
+
+/**
+ * Function: get_varint
+ * Description: Reads a number written by put_varint (rediscrow.c).
+ * Returns:
+ *   - 0 on success, -1 if it runs past the end of the row.
+ */
+static int get_varint(const uchar *record, int len, int *pos, unsigned long long *value)
+{
+    int shift;
+
+    *value = 0;
+    for (shift = 0; shift < 64; shift += 7)
+    {
+        if (*pos >= len)
+            return -1;
+        *value |= (unsigned long long)(record[*pos] & 0x7F) << shift;
+        if (!(record[(*pos)++] & 0x80))
+            return 0;
+    }
+    return -1;
+}
+
+/**
+ * Function: put_digits
+ * Description: Writes a number as width EBCDIC digits, zero-padded.
+ * Returns:
+ *   - Pointer past the digits.
+ */
+static char *put_digits(char *out, long long value, int width)
+{
+    int i;
+
+    for (i = width - 1; i >= 0; i--, value /= 10)
+        out[i] = (char)(0xF0 + value % 10);
+    return out + width;
+}
+
+/**
+ * Function: format_decimal_text
+ * Description: Writes a decimal from its digits: "-123.45", "0.05", "7".
+ * Parameters:
+ *   - negative: 1 for a negative value.
+ *   - digits: The digits (0 to 9), without leading zeros.
+ *   - count: Number of digits.
+ *   - scale: How many of them follow the point.
+ *   - out: Receives the text (EBCDIC, null-terminated; at least 36 bytes).
+ * Returns:
+ *   - Length of the text.
+ */
+static int format_decimal_text(int negative, const char *digits, int count, int scale, char *out)
+{
+    int n = 0, i;
+
+    if (negative && count > 0)
+        out[n++] = 0x60; // EBCDIC '-'
+    if (count <= scale)
+        out[n++] = 0xF0; // EBCDIC '0' before the point
+    for (i = 0; i < count - scale; i++)
+        out[n++] = (char)(0xF0 + digits[i]);
+    if (scale > 0)
+    {
+        out[n++] = 0x4B; // EBCDIC '.'
+        for (i = count - scale; i < count; i++)
+            out[n++] = (char)(i < 0 ? 0xF0 : 0xF0 + digits[i]);
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/**
+ * Function: civil_from_days
+ * Description: Converts days from 1970-01-01 to a date of the proleptic
+ *              Gregorian calendar.
+ */
+static void civil_from_days(long days, int *year, int *month, int *day)
+{
+    long era;
+    unsigned int doe, yoe, doy, mp;
+
+    days += 719468;
+    era = days / 146097;
+    doe = (unsigned int)(days - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400) + (*month <= 2);
+}
+
+/**
+ * Function: format_date_text
+ * Description: Writes an ISO date (YYYY-MM-DD) from days since 0001-01-01.
+ * Returns:
+ *   - Pointer past the date.
+ */
+static char *format_date_text(long days, char *out)
+{
+    int year, month, day;
+
+    civil_from_days(days - DAYS_BEFORE_1970, &year, &month, &day);
+    out = put_digits(out, year, 4);
+    *out++ = 0x60; // EBCDIC '-'
+    out = put_digits(out, month, 2);
+    *out++ = 0x60;
+    return put_digits(out, day, 2);
+}
+
+/**********************************************************************/
+/* SQL External Function: FETCH_ROW */
+/**********************************************************************/
+
+/**
+ * Function: fetchRowRedis
+ * Description: SQL external table function returning the columns of a row
+ *              cached by REDIS_CACHE_ROW, one row per column, with the value
+ *              as text and in the typed column of its type. A missing key
+ *              returns no rows.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - layout: Input layout the row was cached with (VARCHAR(4096), EBCDIC),
+ *     for the NAME column; NULL to leave the names out.
+ *   - position: Output column number, from 1.
+ *   - name: Output column name from the layout (EBCDIC).
+ *   - type: Output INTEGER, DECIMAL, DATE, TIMESTAMP or VARCHAR (EBCDIC).
+ *   - value: Output value as text (EBCDIC); decimals keep their scale.
+ *   - integer_value: Output value of an INTEGER.
+ *   - number_value: Output value of an INTEGER or DECIMAL as a DOUBLE.
+ *   - date_value: Output value of a DATE.
+ *   - timestamp_value: Output value of a TIMESTAMP.
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38909" for a value that is not a cached row.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the encoded row and the position.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN fetchRowRedis(
+    SQLUDF_VARCHAR *key,              // Input: Redis key (EBCDIC)
+    SQLUDF_VARCHAR *layout,           // Input: column names and types (EBCDIC)
+    SQLUDF_INTEGER *position,         // Output: column number
+    SQLUDF_VARCHAR *name,             // Output: column name (EBCDIC)
+    SQLUDF_VARCHAR *type,             // Output: column type (EBCDIC)
+    SQLUDF_VARCHAR *value,            // Output: value as text (EBCDIC)
+    SQLUDF_BIGINT *integer_value,     // Output: value of an INTEGER
+    SQLUDF_DOUBLE *number_value,      // Output: value of a number
+    SQLUDF_DATE *date_value,          // Output: value of a DATE
+    SQLUDF_STAMP *timestamp_value,    // Output: value of a TIMESTAMP
+    SQLUDF_NULLIND *keyInd,           // Null indicators for inputs
+    SQLUDF_NULLIND *layoutInd,
+    SQLUDF_NULLIND *positionInd,      // Null indicators for outputs
+    SQLUDF_NULLIND *nameInd,
+    SQLUDF_NULLIND *typeInd,
+    SQLUDF_NULLIND *valueInd,
+    SQLUDF_NULLIND *integer_valueInd,
+    SQLUDF_NULLIND *number_valueInd,
+    SQLUDF_NULLIND *date_valueInd,
+    SQLUDF_NULLIND *timestamp_valueInd,
+    char *sqlstate,                   // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                   // Fully qualified function name
+    char *specname,                   // Specific name
+    char *msgtext,                    // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,    // Encoded row and position
+    SQLUDF_CALL_TYPE *calltype)       // Open, fetch or close
+{
+    static const char *type_names[] = {"", "\xC9\xD5\xE3\xC5\xC7\xC5\xD9", // INTEGER
+                                       "\xC4\xC5\xC3\xC9\xD4\xC1\xD3",     // DECIMAL
+                                       "\xC4\xC1\xE3\xC5",                 // DATE
+                                       "\xE3\xC9\xD4\xC5\xE2\xE3\xC1\xD4\xD7", // TIMESTAMP
+                                       "\xE5\xC1\xD9\xC3\xC8\xC1\xD9"};    // VARCHAR
+    uchar *record = (uchar *)scratchpad->data + sizeof(RowCursor);
+    RowCursor cursor;
+    RedisRowColumn columns[REDIS_ROW_COLUMNS];
+    RedisReplyItem item;
+    const char *argv[2];
+    size_t argl[2], pos = 0;
+    unsigned long long number;
+    long long micros;
+    char digits[32], *p;
+    double divisor;
+    int sockfd, len, tag, scale, count, i;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+        memset(&cursor, 0, sizeof(cursor));
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+#ifdef USE_ICONV
+        if (!initialized)
+        {
+            initialize_conversion();
+            initialized = 1;
+        }
+        if (errno != 0)
+        {
+            strcpy(sqlstate, "38999");
+            strcpy(msgtext, "iconv initialization failed");
+            return;
+        }
+#endif
+        if (*keyInd < 0)
+        {
+            strcpy(sqlstate, "38001");
+            strcpy(msgtext, "Input key is NULL");
+            return;
+        }
+        if (*layoutInd >= 0)
+        {
+            cursor.names = parse_redis_layout(layout, columns);
+            if (cursor.names < 0)
+            {
+                strcpy(sqlstate, "38003");
+                strcpy(msgtext, "Layout is malformed or names an unknown type");
+                return;
+            }
+            for (i = 0; i < cursor.names; i++)
+            {
+                cursor.name_pos[i] = (short)(columns[i].name - layout);
+                cursor.name_len[i] = (short)columns[i].name_len;
+            }
+        }
+
+        // GET key, the reply read straight into the scratchpad
+        argv[0] = "\xC7\xC5\xE3"; // EBCDIC "GET"
+        argl[0] = 3;
+        argv[1] = key;
+        argl[1] = strlen(key);
+        len = execute_redis_command(&sockfd, 2, argv, argl, 1, (char *)record,
+                                    scratchpad->length - sizeof(RowCursor), sqlstate, msgtext);
+        if (len < 0)
+            return;
+        if (redis_reply_item((char *)record, len, &pos, &item) != 0)
+        {
+            strcpy(sqlstate, "38909");
+            strcpy(msgtext, "Failed to parse Redis response");
+        }
+        else if (item.type == 0x2D) // ASCII '-' error reply (e.g., WRONGTYPE)
+        {
+            len = item.len < 70 ? (int)item.len : 70;
+            ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+            msgtext[len] = '\0';
+            strcpy(sqlstate, "38911");
+        }
+        else if (!item.nil) // A missing key returns no rows
+        {
+            if (item.type != 0x24 || item.len < 2 || item.len > REDIS_ROW_RECORD || // ASCII '$'
+                item.data[0] != REDIS_ROW_VERSION || (uchar)item.data[1] > REDIS_ROW_COLUMNS)
+            {
+                strcpy(sqlstate, "38909");
+                strcpy(msgtext, "Value is not a row cached by REDIS_CACHE_ROW");
+            }
+            else
+            {
+                cursor.len = (int)item.len;
+                cursor.pos = 2;
+                cursor.count = (uchar)item.data[1];
+                memmove(record, item.data, item.len);
+                memcpy(scratchpad->data, &cursor, sizeof(cursor));
+            }
+        }
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    memcpy(&cursor, scratchpad->data, sizeof(cursor));
+    if (cursor.column >= cursor.count || cursor.pos >= cursor.len)
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+    tag = record[cursor.pos++];
+    if ((tag & ~REDIS_ROW_NULL) < REDIS_ROW_INTEGER || (tag & ~REDIS_ROW_NULL) > REDIS_ROW_VARCHAR)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Cached row is malformed");
+        return;
+    }
+
+    *position = ++cursor.column;
+    *positionInd = 0;
+    strcpy(type, type_names[tag & ~REDIS_ROW_NULL]);
+    *typeInd = 0;
+    *nameInd = -1;
+    if (*layoutInd >= 0 && cursor.column <= cursor.names)
+    {
+        len = cursor.name_len[cursor.column - 1] < ROW_NAME ? cursor.name_len[cursor.column - 1] : ROW_NAME;
+        memcpy(name, layout + cursor.name_pos[cursor.column - 1], len);
+        name[len] = '\0';
+        *nameInd = 0;
+    }
+    *valueInd = -1;
+    *integer_valueInd = -1;
+    *number_valueInd = -1;
+    *date_valueInd = -1;
+    *timestamp_valueInd = -1;
+
+    switch (tag)
+    {
+    case REDIS_ROW_INTEGER:
+        if (get_varint(record, cursor.len, &cursor.pos, &number) != 0)
+            break;
+        *integer_value = (long long)(number >> 1) ^ -(long long)(number & 1); // Zigzag
+        format_ebcdic_integer(*integer_value, value);
+        *number_value = (double)*integer_value;
+        *valueInd = *integer_valueInd = *number_valueInd = 0;
+        break;
+    case REDIS_ROW_DECIMAL:
+        if (cursor.pos >= cursor.len)
+            break;
+        scale = record[cursor.pos++];
+        if (scale & REDIS_ROW_PACKED)
+        {
+            // Packed digits: two per byte, the sign in the last half byte
+            scale &= ~REDIS_ROW_PACKED;
+            if (cursor.pos >= cursor.len || record[cursor.pos] > 16 ||
+                cursor.pos + 1 + record[cursor.pos] > cursor.len)
+                break;
+            len = record[cursor.pos++];
+            for (count = 0, i = 0; i < 2 * len - 1; i++)
+            {
+                digits[count] = i % 2 ? record[cursor.pos + i / 2] & 0x0F : record[cursor.pos + i / 2] >> 4;
+                if (count > 0 || digits[count] != 0)
+                    count++;
+            }
+            i = (record[cursor.pos + len - 1] & 0x0F) == 0x0D;
+            cursor.pos += len;
+        }
+        else
+        {
+            if (get_varint(record, cursor.len, &cursor.pos, &number) != 0)
+                break;
+            i = number & 1;
+            number = i ? (number >> 1) + 1 : number >> 1; // Magnitude of the zigzag value
+            for (count = 0; number > 0; number /= 10)
+                digits[count++] = (char)(number % 10);
+            for (len = 0; len < count / 2; len++)
+            {
+                char digit = digits[len];
+                digits[len] = digits[count - 1 - len];
+                digits[count - 1 - len] = digit;
+            }
+        }
+        if (scale > 31)
+            break;
+        format_decimal_text(i, digits, count, scale, value);
+        for (*number_value = 0, len = 0; len < count; len++)
+            *number_value = *number_value * 10 + digits[len];
+        for (divisor = 1; scale > 0; scale--)
+            divisor *= 10;
+        *number_value = (i ? -*number_value : *number_value) / divisor;
+        *valueInd = *number_valueInd = 0;
+        break;
+    case REDIS_ROW_DATE:
+        if (cursor.pos + 3 > cursor.len)
+            break;
+        p = format_date_text((long)record[cursor.pos] << 16 | record[cursor.pos + 1] << 8 | record[cursor.pos + 2],
+                             value);
+        *p = '\0';
+        cursor.pos += 3;
+        strcpy(date_value, value);
+        *valueInd = *date_valueInd = 0;
+        break;
+    case REDIS_ROW_TIMESTAMP:
+        if (cursor.pos + 8 > cursor.len)
+            break;
+        for (micros = 0, i = 0; i < 8; i++)
+            micros = micros << 8 | record[cursor.pos++];
+        // Db2 form: YYYY-MM-DD-HH.MM.SS.ffffff
+        p = format_date_text((long)(micros / 86400000000LL), value);
+        micros %= 86400000000LL;
+        *p++ = 0x60; // EBCDIC '-'
+        p = put_digits(p, micros / 3600000000LL, 2);
+        *p++ = 0x4B; // EBCDIC '.'
+        p = put_digits(p, micros / 60000000 % 60, 2);
+        *p++ = 0x4B;
+        p = put_digits(p, micros / 1000000 % 60, 2);
+        *p++ = 0x4B;
+        p = put_digits(p, micros % 1000000, 6);
+        *p = '\0';
+        strcpy(timestamp_value, value);
+        *valueInd = *timestamp_valueInd = 0;
+        break;
+    case REDIS_ROW_VARCHAR:
+        if (get_varint(record, cursor.len, &cursor.pos, &number) != 0 || number > (unsigned long long)(cursor.len - cursor.pos))
+            break;
+        if (number > ROW_VALUE)
+        {
+            strcpy(sqlstate, "38908");
+            strcpy(msgtext, "Value exceeds maximum length");
+            return;
+        }
+        if (number > 0)
+            ConvertToEBCDIC((char *)record + cursor.pos, (size_t)number, value, ROW_VALUE + 1);
+        value[number] = '\0';
+        cursor.pos += (int)number;
+        *valueInd = 0;
+        break;
+    default: // NULL: the type only
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+        return;
+    }
+    if (*valueInd < 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Cached row is malformed");
+        return;
+    }
+    memcpy(scratchpad->data, &cursor, sizeof(cursor));
+}
+
+#pragma linkage(fetchRowRedis, OS)
@@ -51,8 +51,7 @@ void SQL_API_FN getRedisValue(
     SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
 {
     int sockfd;
-    char ebcdic_send_buf[1024], ascii_send_buf[1024], recv_buf[16370], ebcdic_payload[16370];
-    char ebcdic_len[10] = {0};
+    char ascii_send_buf[1024], recv_buf[16370], ebcdic_payload[16370];
     int len, total_len = 0;
 
 #ifdef USE_ICONV
@@ -86,7 +85,7 @@ void SQL_API_FN getRedisValue(
     *valueInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_read_key(&sockfd, key) != 0)
     {
         strcpy(sqlstate, "38901");
         strcpy(msgtext, "Failed to connect to Redis");
@@ -94,67 +93,33 @@ void SQL_API_FN getRedisValue(
         return;
     }
 
-    // Format Redis GET command in EBCDIC
-    ebcdic_send_buf[0] = '\0';
-    int key_len = strlen(key);
-
-    // Calculate and format key length in EBCDIC
-    if (key_len < 10)
-    {
-        ebcdic_len[0] = 0xF0 + key_len;
-        ebcdic_len[1] = '\0';
-    }
-    else
-    {
-        int i = 0, temp_len = key_len;
-        while (temp_len > 0)
-        {
-            ebcdic_len[i++] = 0xF0 + (temp_len % 10);
-            temp_len /= 10;
-        }
-        ebcdic_len[i] = '\0';
-        for (int j = 0; j < i / 2; j++)
-        {
-            char tmp = ebcdic_len[j];
-            ebcdic_len[j] = ebcdic_len[i - 1 - j];
-            ebcdic_len[i - 1 - j] = tmp;
-        }
-    }
-
-    // Build GET command in EBCDIC: "*2\r\n$3\r\nGET\r\n$<key_len>\r\n<key>\r\n"
-    strcat(ebcdic_send_buf, "\x5C\xF2\x0D\x25\x5B\xF3\x0D\x25\xC7\xC5\xE3\x0D\x25"); // EBCDIC "*2\r\n$3\r\nGET\r\n"
-    strcat(ebcdic_send_buf, "\x5B");
-    strcat(ebcdic_send_buf, ebcdic_len);
-    strcat(ebcdic_send_buf, "\x0D\x25");
-    strcat(ebcdic_send_buf, key);
-    strcat(ebcdic_send_buf, "\x0D\x25");
-
-    // Convert EBCDIC GET command to ASCII before sending
-    ascii_send_buf[0] = '\0';
-    size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-    if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+    // Build GET command in ASCII: prebuilt "*2\r\n$3\r\nGET\r\n" plus the key
+    const char *args[1] = {key};
+    size_t argl[1] = {strlen(key)};
+    int cmd_len = format_redis_template(ascii_send_buf, sizeof(ascii_send_buf), REDIS_TEMPLATE(GET),
+                                        1, args, argl);
+    if (cmd_len < 0)
     {
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
-    ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send GET command to Redis
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, cmd_len);
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response from Redis
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -168,7 +133,7 @@ void SQL_API_FN getRedisValue(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -176,7 +141,7 @@ void SQL_API_FN getRedisValue(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
@@ -189,7 +154,7 @@ void SQL_API_FN getRedisValue(
         strcpy(sqlstate, "38907");
         strcpy(msgtext, "Failed to convert response to EBCDIC");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_payload[total_len] = '\0';
@@ -232,10 +197,8 @@ void SQL_API_FN getRedisValue(
         strcpy(msgtext, "Failed to extract payload from Redis response");
         *valueInd = -1;
     }
-    //if (payload)
-    //    free(payload); // Free allocated memory
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(getRedisValue, OS)
\ No newline at end of file
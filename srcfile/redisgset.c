@@ -19,6 +19,9 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+#define REPLY_BUFFER 16370 // Size of each receive buffer
+
 /**********************************************************************/
 /* SQL External Function: GETSET                                      */
 /**********************************************************************/
@@ -55,7 +58,7 @@ void SQL_API_FN getsetRedisValue(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[16370], ebcdic_payload[16370];
+	char *ebcdic_send_buf, *ascii_send_buf, *recv_buf, *ebcdic_payload;
 	char ebcdic_key_len[10] = {0}, ebcdic_value_len[10] = {0};
 	int len, total_len = 0;
 
@@ -93,15 +96,28 @@ void SQL_API_FN getsetRedisValue(
 	*valueInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*valueInd = -1;
-		close(sockfd);
 		return;
 	}
 
+	// Call buffers come from the thread's arena and are given back on release
+	ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER + 2 * REPLY_BUFFER);
+	if (ebcdic_send_buf == NULL)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
+		*valueInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
+	recv_buf = ascii_send_buf + SEND_BUFFER;
+	ebcdic_payload = recv_buf + REPLY_BUFFER;
+
 	// Format Redis GETSET command in EBCDIC
 	ebcdic_send_buf[0] = '\0';
 
@@ -172,29 +188,29 @@ void SQL_API_FN getsetRedisValue(
 
 	// Convert EBCDIC GETSET command to ASCII before sending
 	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send GETSET command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -208,7 +224,7 @@ void SQL_API_FN getsetRedisValue(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -216,7 +232,7 @@ void SQL_API_FN getsetRedisValue(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
@@ -224,12 +240,12 @@ void SQL_API_FN getsetRedisValue(
 	recv_buf[total_len] = '\0';
 
 	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
+	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, REPLY_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38907", 5);
 		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ebcdic_payload[total_len] = '\0';
@@ -241,7 +257,7 @@ void SQL_API_FN getsetRedisValue(
 
 	if (extract_result == 0) // Success
 	{
-		if (payload_length < sizeof(ebcdic_payload))
+		if (payload_length < REPLY_BUFFER)
 		{ // Ensure no overflow
 			strncpy(value, payload, payload_length);
 			value[payload_length] = '\0';
@@ -263,11 +279,11 @@ void SQL_API_FN getsetRedisValue(
 	else // All other errors
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		snprintf(msgtext, 70, "Failed to extract payload from Redis reply: %.20s...", ebcdic_payload);
 		*valueInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(getsetRedisValue, OS)
@@ -55,7 +55,7 @@ void SQL_API_FN hexistsRedisField(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[1024], ascii_send_buf[1024], recv_buf[1024], ebcdic_payload[1024];
+	char ebcdic_send_buf[1024], ascii_send_buf[1024], recv_buf[1024];
 	char ebcdic_key_len[10] = {0}, ebcdic_field_len[10] = {0};
 	int len, total_len = 0;
 
@@ -93,12 +93,11 @@ void SQL_API_FN hexistsRedisField(
 	*resultInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_read_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
 		return;
 	}
 
@@ -177,24 +176,24 @@ void SQL_API_FN hexistsRedisField(
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send HEXISTS command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -208,7 +207,7 @@ void SQL_API_FN hexistsRedisField(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -216,41 +215,29 @@ void SQL_API_FN hexistsRedisField(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
+	// Parse the integer reply from the received bytes
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		strncpy(sqlstate, "38907", 5);
-		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-	ebcdic_payload[total_len] = '\0';
-
-	// Extract Redis response
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
-	{
-		// Parse the integer value from the payload (1=exists, 0=not exists)
-		*result = atol(payload);
+		// Integer value of the reply (1=exists, 0=not exists)
+		*result = number;
 		*resultInd = 0;
 	}
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		strncpy(msgtext, "Failed to extract payload from Redis response", 70);
 		*resultInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(hexistsRedisField, OS)
@@ -54,8 +54,7 @@ void SQL_API_FN hgetRedisValue(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[1024], ascii_send_buf[1024], recv_buf[16370], ebcdic_payload[16370];
-	char ebcdic_key_len[10] = {0}, ebcdic_field_len[10] = {0};
+	char ascii_send_buf[1024], recv_buf[16370], ebcdic_payload[16370];
 	int len, total_len = 0;
 
 #ifdef USE_ICONV
@@ -92,108 +91,47 @@ void SQL_API_FN hgetRedisValue(
 	*valueInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_read_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*valueInd = -1;
-		close(sockfd);
 		return;
 	}
 
-	// Format Redis HGET command in EBCDIC
-	ebcdic_send_buf[0] = '\0';
-
-	// Calculate and format key length in EBCDIC (up to 255 bytes)
-	int key_len = strlen(key);
+	// Build HGET command in ASCII: prebuilt "*3\r\n$4\r\nHGET\r\n" plus key and field
+	size_t key_len = strlen(key);
 	if (key_len > 255)
-		key_len = 255;
-	if (key_len < 10)
-	{
-		ebcdic_key_len[0] = 0xF0 + key_len;
-		ebcdic_key_len[1] = '\0';
-	}
-	else
-	{
-		int i = 0, temp_len = key_len;
-		while (temp_len > 0)
-		{
-			ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_key_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_key_len[j];
-			ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
-			ebcdic_key_len[i - 1 - j] = tmp;
-		}
-	}
-
-	// Calculate and format field length in EBCDIC (up to 255 bytes)
-	int field_len = strlen(field);
+		key_len = 255; // Truncate to match VARCHAR(255)
+	size_t field_len = strlen(field);
 	if (field_len > 255)
-		field_len = 255;
-	if (field_len < 10)
-	{
-		ebcdic_field_len[0] = 0xF0 + field_len;
-		ebcdic_field_len[1] = '\0';
-	}
-	else
-	{
-		int i = 0, temp_len = field_len;
-		while (temp_len > 0)
-		{
-			ebcdic_field_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_field_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_field_len[j];
-			ebcdic_field_len[j] = ebcdic_field_len[i - 1 - j];
-			ebcdic_field_len[i - 1 - j] = tmp;
-		}
-	}
-
-	// Build HGET command in EBCDIC:
-	// 	"*3\r\n$4\r\nHGET\r\n$<key_len>\r\n<key>\r\n$<field_len>\r\n<field>\r\n"
-	strcat(ebcdic_send_buf, "\x5C\xF3\x0D\x25\x5B\xF4\x0D\x25\xC8\xC7\xC5\xE3\x0D\x25"); // EBCDIC "*3\r\n$4\r\nHGET\r\n"
-	strcat(ebcdic_send_buf, "\x5B");
-	strcat(ebcdic_send_buf, ebcdic_key_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, key, key_len);
-	strcat(ebcdic_send_buf, "\x0D\x25\x5B");
-	strcat(ebcdic_send_buf, ebcdic_field_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, field, field_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-
-	// Convert EBCDIC HGET command to ASCII before sending
-	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+		field_len = 255; // Truncate to match VARCHAR(255)
+	const char *args[2] = {key, field};
+	size_t argl[2] = {key_len, field_len};
+	int cmd_len = format_redis_template(ascii_send_buf, sizeof(ascii_send_buf), REDIS_TEMPLATE(HGET),
+	                                    2, args, argl);
+	if (cmd_len < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
-	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send HGET command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, cmd_len);
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -207,7 +145,7 @@ void SQL_API_FN hgetRedisValue(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -215,7 +153,7 @@ void SQL_API_FN hgetRedisValue(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
@@ -228,7 +166,7 @@ void SQL_API_FN hgetRedisValue(
 		strncpy(sqlstate, "38907", 5);
 		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
 		*valueInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ebcdic_payload[total_len] = '\0';
@@ -262,11 +200,11 @@ void SQL_API_FN hgetRedisValue(
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		snprintf(msgtext, 70, "Failed to extract payload from Redis reply: %.20s...", ebcdic_payload);
 		*valueInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(hgetRedisValue, OS)
@@ -20,6 +20,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define REPLY_BUFFER 32000 // Size of each receive buffer
+
 /**********************************************************************/
 /* Helper: Parse RESP array for HGETALL                               */
 /**********************************************************************/
@@ -186,7 +188,7 @@ void SQL_API_FN hgetallRedis(
 {
     int sockfd;
     char ebcdic_send_buf[1024], ascii_send_buf[1024];
-    char recv_buf[32000], ebcdic_response[32000];
+    char *recv_buf, *ebcdic_response;
     char ebcdic_len[10] = {0};
     int len, total_len = 0;
 
@@ -220,7 +222,7 @@ void SQL_API_FN hgetallRedis(
     *valueInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_read_key(&sockfd, key) != 0)
     {
         strcpy(sqlstate, "38901");
         strcpy(msgtext, "Failed to connect to Redis");
@@ -228,6 +230,18 @@ void SQL_API_FN hgetallRedis(
         return;
     }
 
+    // Call buffers come from the thread's arena and are given back on release
+    recv_buf = redis_arena_alloc(2 * REPLY_BUFFER);
+    if (recv_buf == NULL)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for call buffers");
+        *valueInd = -1;
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    ebcdic_response = recv_buf + REPLY_BUFFER;
+
     // Format Redis HGETALL command in EBCDIC
     ebcdic_send_buf[0] = '\0';
     int key_len = strlen(key);
@@ -271,24 +285,24 @@ void SQL_API_FN hgetallRedis(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send HGETALL command to Redis
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response from Redis
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -302,7 +316,7 @@ void SQL_API_FN hgetallRedis(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -310,19 +324,19 @@ void SQL_API_FN hgetallRedis(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     total_len = len;
     recv_buf[total_len] = '\0';
 
     // Convert ASCII response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, sizeof(ebcdic_response) - 1) < 0)
+    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, REPLY_BUFFER - 1) < 0)
     {
         strcpy(sqlstate, "38907");
         strcpy(msgtext, "Failed to convert response to EBCDIC");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_response[total_len] = '\0';
@@ -348,7 +362,7 @@ void SQL_API_FN hgetallRedis(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(hgetallRedis, OS)
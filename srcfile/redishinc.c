@@ -0,0 +1,202 @@
+/******************************************************************************
+ * File: redishinc.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the Redis HINCRBY function for IBM i.
+ *              This function increments the integer value of a hash field
+ *              by a specified amount. Returns the new value, or NULL when
+ *              the increment is coalesced (see REDIS_COALESCE).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+/**********************************************************************/
+/* SQL External Function: HINCRBY */
+/**********************************************************************/
+
+/**
+ * Function: hincrbyRedisValue
+ * Description: SQL external function to increment a field of a Redis hash.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - field: Input hash field name (VARCHAR(255), EBCDIC).
+ *   - increment: Input increment (BIGINT).
+ *   - result: Output new value of the field (BIGINT); NULL in coalescing
+ *     mode.
+ *   - keyInd: Null indicator for the key.
+ *   - fieldInd: Null indicator for the field.
+ *   - incrInd: Null indicator for the increment.
+ *   - resultInd: Null indicator for the output result.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38911" for an error
+ *     reply from Redis (e.g., the field does not hold an integer).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN hincrbyRedisValue(
+	SQLUDF_VARCHAR *key,	   // Input: Redis key (VARCHAR(255), EBCDIC)
+	SQLUDF_VARCHAR *field,	   // Input: Hash field name (VARCHAR(255), EBCDIC)
+	SQLUDF_BIGINT *increment,  // Input: Increment amount (BIGINT)
+	SQLUDF_BIGINT *result,	   // Output: New value after increment (BIGINT)
+	SQLUDF_NULLIND *keyInd,	   // Null indicator for key
+	SQLUDF_NULLIND *fieldInd,  // Null indicator for field
+	SQLUDF_NULLIND *incrInd,   // Null indicator for increment
+	SQLUDF_NULLIND *resultInd, // Null indicator for output result
+	char *sqlstate,			   // SQLSTATE (5 chars, e.g., "00000")
+	char *funcname,			   // Fully qualified function name
+	char *specname,			   // Specific name
+	char *msgtext,			   // Error message text (up to 70 chars)
+	short *sqlcode,			   // SQLCODE (optional, not used here)
+	SQLUDF_NULLIND *nullind)   // Additional null indicators for DB2SQL
+{
+	int sockfd;
+	char ascii_send_buf[1024], recv_buf[1024], number_text[REDIS_DOUBLE_TEXT];
+	int len, total_len = 0;
+
+#ifdef USE_ICONV
+	if (!initialized)
+	{
+		initialize_conversion();
+		initialized = 1;
+	}
+	if (errno != 0)
+	{
+		strcpy(sqlstate, "38999");
+		strcpy(msgtext, "iconv initialization failed");
+		*resultInd = -1;
+		return;
+	}
+#endif
+
+	// Initialize SQLSTATE to success
+	strncpy(sqlstate, "00000", 5);
+	sqlstate[5] = '\0';
+	msgtext[0] = '\0';
+	*result = 0;
+	*resultInd = 0;
+
+	// Check for NULL inputs
+	if (*keyInd < 0 || *fieldInd < 0 || *incrInd < 0)
+	{
+		strncpy(sqlstate, "38001", 5);
+		strncpy(msgtext, "Input key, field, or increment is NULL", 70);
+		*resultInd = -1;
+		return;
+	}
+
+	// Coalescing mode: add to the job's pending counter of the field
+	if (redis_coalesce_enabled())
+	{
+		redis_coalesce_add(key, field, *increment, sqlstate, msgtext);
+		*resultInd = -1; // The new value is not known yet
+		return;
+	}
+
+	// Build HINCRBY command in ASCII: prebuilt "*4\r\n$7\r\nHINCRBY\r\n" plus key, field and increment
+	size_t key_len = strlen(key);
+	if (key_len > 255)
+		key_len = 255; // Truncate to match VARCHAR(255)
+	size_t field_len = strlen(field);
+	if (field_len > 255)
+		field_len = 255; // Truncate to match VARCHAR(255)
+	const char *args[2] = {key, field};
+	size_t argl[2] = {key_len, field_len};
+	int cmd_len = format_redis_template(ascii_send_buf, sizeof(ascii_send_buf), REDIS_TEMPLATE(HINCRBY),
+	                                    2, args, argl);
+	cmd_len = append_redis_argument(ascii_send_buf, sizeof(ascii_send_buf), cmd_len, number_text,
+	                                format_redis_integer(*increment, number_text), 1);
+	if (cmd_len < 0)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Failed to convert command to ASCII", 70);
+		*resultInd = -1;
+		return;
+	}
+
+	// Connect to Redis
+	if (connect_to_redis_key(&sockfd, key) != 0)
+	{
+		strncpy(sqlstate, "38901", 5);
+		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+		*resultInd = -1;
+		return;
+	}
+
+	// Send HINCRBY command to Redis
+	len = send_redis_command(sockfd, ascii_send_buf, cmd_len);
+	if (len < 0)
+	{
+		strncpy(sqlstate, "38903", 5);
+		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+		*resultInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+
+	// Receive response from Redis
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
+	if (len < 0)
+	{
+		if (errno == EWOULDBLOCK || errno == EAGAIN)
+		{
+			strncpy(sqlstate, "38904", 5);
+			snprintf(msgtext, 70, "Receive timeout from Redis: errno=%d, socket=%d", errno, sockfd);
+		}
+		else
+		{
+			strncpy(sqlstate, "38905", 5);
+			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
+		}
+		*resultInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	else if (len == 0)
+	{
+		strncpy(sqlstate, "38906", 5);
+		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
+		*resultInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	total_len = len;
+
+	// Parse the integer reply from the received bytes
+	long long number;
+	RedisReplyItem item;
+	size_t pos = 0;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
+	{
+		*result = number;
+		*resultInd = 0;
+	}
+	else if (recv_buf[0] == 0x2D && redis_reply_item(recv_buf, total_len, &pos, &item) == 0) // ASCII '-'
+	{
+		len = item.len < 70 ? (int)item.len : 70;
+		ConvertToEBCDIC((char *)item.data, len, msgtext, 71);
+		msgtext[len] = '\0';
+		strncpy(sqlstate, "38911", 5);
+		*resultInd = -1;
+	}
+	else
+	{
+		strncpy(sqlstate, "38909", 5);
+		strncpy(msgtext, "Failed to extract payload from Redis response", 70);
+		*resultInd = -1;
+	}
+
+	release_redis_connection(sockfd, sqlstate);
+}
+
+#pragma linkage(hincrbyRedisValue, OS)
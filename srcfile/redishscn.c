@@ -22,6 +22,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define REPLY_BUFFER 32000 // Size of each receive buffer
+
 /**********************************************************************/
 /* Helper: Convert integer to EBCDIC string                            */
 /**********************************************************************/
@@ -259,7 +261,7 @@ void SQL_API_FN hscanRedisHash(
 {
     int sockfd;
     char ebcdic_send_buf[2048], ascii_send_buf[2048];
-    char recv_buf[32000], ebcdic_response[32000];
+    char *recv_buf, *ebcdic_response;
     char ebcdic_key_len[10] = {0};
     char ebcdic_cursor_len[10] = {0};
     char ebcdic_pat_len[10] = {0};
@@ -297,7 +299,7 @@ void SQL_API_FN hscanRedisHash(
     *valueInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_read_key(&sockfd, key) != 0)
     {
         strcpy(sqlstate, "38901");
         strcpy(msgtext, "Failed to connect to Redis");
@@ -305,6 +307,18 @@ void SQL_API_FN hscanRedisHash(
         return;
     }
 
+    // Call buffers come from the thread's arena and are given back on release
+    recv_buf = redis_arena_alloc(2 * REPLY_BUFFER);
+    if (recv_buf == NULL)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for call buffers");
+        *valueInd = -1;
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    ebcdic_response = recv_buf + REPLY_BUFFER;
+
     // Format key length in EBCDIC
     ebcdic_send_buf[0] = '\0';
     int key_len = strlen(key);
@@ -388,7 +402,7 @@ void SQL_API_FN hscanRedisHash(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to format COUNT parameter");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
@@ -448,24 +462,24 @@ void SQL_API_FN hscanRedisHash(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send command
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -479,7 +493,7 @@ void SQL_API_FN hscanRedisHash(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -487,19 +501,19 @@ void SQL_API_FN hscanRedisHash(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     total_len = len;
     recv_buf[total_len] = '\0';
 
     // Convert response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, sizeof(ebcdic_response) - 1) < 0)
+    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, REPLY_BUFFER - 1) < 0)
     {
         strcpy(sqlstate, "38907");
         strcpy(msgtext, "Failed to convert response to EBCDIC");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_response[total_len] = '\0';
@@ -518,7 +532,7 @@ void SQL_API_FN hscanRedisHash(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(hscanRedisHash, OS)
@@ -19,6 +19,9 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+#define REPLY_BUFFER 33000 // Size of each receive buffer
+
 /**********************************************************************/
 /* SQL External Function: HSET */
 /**********************************************************************/
@@ -30,7 +33,8 @@
  *   - key: Input Redis key (VARCHAR(255), EBCDIC).
  *   - field: Input hash field name (VARCHAR(255), EBCDIC).
  *   - value: Input hash field value (VARCHAR(16370), EBCDIC).
- *   - result: Output number of fields added (BIGINT, 1=new, 0=updated).
+ *   - result: Output number of fields added (BIGINT, 1=new, 0=updated);
+ *     NULL in write-behind mode.
  *   - keyInd: Null indicator for the key.
  *   - fieldInd: Null indicator for the field.
  *   - valueInd: Null indicator for the value.
@@ -59,7 +63,7 @@ void SQL_API_FN hsetRedisValue(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[33000], ebcdic_payload[33000];
+	char *ebcdic_send_buf, *ascii_send_buf, *recv_buf;
 	char ebcdic_key_len[10] = {0}, ebcdic_field_len[10] = {0}, ebcdic_value_len[10] = {0};
 	int len, total_len = 0;
 
@@ -96,15 +100,18 @@ void SQL_API_FN hsetRedisValue(
 	*result = 0;
 	*resultInd = 0;
 
-	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	// Call buffers come from the thread's arena and are given back on release
+	ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER + REPLY_BUFFER);
+	if (ebcdic_send_buf == NULL)
 	{
-		strncpy(sqlstate, "38901", 5);
-		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(-1, sqlstate);
 		return;
 	}
+	ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
+	recv_buf = ascii_send_buf + SEND_BUFFER;
 
 	// Format Redis HSET command in EBCDIC
 	ebcdic_send_buf[0] = '\0';
@@ -206,29 +213,48 @@ void SQL_API_FN hsetRedisValue(
 
 	// Convert EBCDIC HSET command to ASCII before sending
 	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(-1, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
+	// Write-behind mode: queue the command for the flusher and return
+	if (redis_write_behind_enabled())
+	{
+		redis_write_behind_queue(key, ascii_send_buf, ebcdic_len_size, sqlstate, msgtext);
+		*resultInd = -1; // No reply to report yet
+		release_redis_connection(-1, sqlstate);
+		return;
+	}
+
+	// Connect to Redis
+	if (connect_to_redis_key(&sockfd, key) != 0)
+	{
+		strncpy(sqlstate, "38901", 5);
+		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+		*resultInd = -1;
+		release_redis_connection(-1, sqlstate);
+		return;
+	}
+
 	// Send HSET command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -242,7 +268,7 @@ void SQL_API_FN hsetRedisValue(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -250,41 +276,29 @@ void SQL_API_FN hsetRedisValue(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-	{
-		strncpy(sqlstate, "38907", 5);
-		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-	ebcdic_payload[total_len] = '\0';
-
-	// Extract Redis response
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+	// Parse the integer reply from the received bytes
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		// Parse the integer value from the payload (1=new field, 0=updated existing)
-		*result = atol(payload);
+		// Integer value of the reply (1=new field, 0=updated existing)
+		*result = number;
 		*resultInd = 0;
 	}
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		strncpy(msgtext, "Failed to extract payload from Redis response", 70);
 		*resultInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(hsetRedisValue, OS)
@@ -0,0 +1,339 @@
+/******************************************************************************
+ * File: redishsetm.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Variadic writes for IBM i: sends HSET, SADD, ZADD, LPUSH or
+ *              RPUSH with every field, member or value of the call in one
+ *              command, for the REDIS_..._MANY functions, and the
+ *              REDIS_HSET_MANY function itself. Caching a row as a hash
+ *              costs one round trip instead of one per column.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+/**
+ * Function: redis_write_many
+ * Description: Sends one variadic write built from every argument at once.
+ *              The command is built straight to ASCII in the call arena.
+ * Parameters:
+ *   - argc: Number of arguments (command name and key included).
+ *   - argv: Command name, key (null-terminated; it routes the call), then
+ *     the arguments (EBCDIC).
+ *   - argl: Their lengths.
+ *   - behind: 1 to queue the command when write-behind is on.
+ *   - result: Receives the integer reply.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 1 when result was set, 0 when the command was queued, -1 on failure.
+ */
+int redis_write_many(int argc, const char **argv, const size_t *argl, int behind, long long *result,
+                     char *sqlstate, char *msgtext)
+{
+    char reply[1024];
+    char *cmd;
+    size_t size = 23, pos = 0;
+    RedisReplyItem item;
+    int sockfd, len, i, rc = -1;
+
+    // Call buffer comes from the thread's arena and is given back on release
+    for (i = 0; i < argc; i++)
+        size += argl[i] + 28; // "$<len>\r\n<arg>\r\n"
+    cmd = redis_arena_alloc(size);
+    if (cmd == NULL)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for call buffers");
+        release_redis_connection(-1, sqlstate);
+        return -1;
+    }
+    len = append_redis_header(cmd, size, 0, argc);
+    for (i = 0; i < argc; i++)
+        len = append_redis_argument(cmd, size, len, argv[i], argl[i], 0);
+    if (len < 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Failed to convert command to ASCII");
+        release_redis_connection(-1, sqlstate);
+        return -1;
+    }
+
+    // Write-behind mode: queue the command for the flusher and return
+    if (behind && redis_write_behind_enabled())
+    {
+        rc = redis_write_behind_queue(argv[1], cmd, len, sqlstate, msgtext) == 0 ? 0 : -1;
+        release_redis_connection(-1, sqlstate);
+        return rc;
+    }
+
+    if (connect_to_redis_key(&sockfd, argv[1]) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        release_redis_connection(-1, sqlstate);
+        return -1;
+    }
+    if (send_redis_command(sockfd, cmd, len) < 0)
+    {
+        strcpy(sqlstate, "38903");
+        snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+        release_redis_connection(sockfd, sqlstate);
+        return -1;
+    }
+    len = recv_redis_reply(sockfd, reply, sizeof(reply) - 1);
+    if (len < 0)
+    {
+        if (errno == EWOULDBLOCK || errno == EAGAIN)
+        {
+            strcpy(sqlstate, "38904");
+            snprintf(msgtext, 70, "Receive timeout from Redis: errno=%d, socket=%d", errno, sockfd);
+        }
+        else
+        {
+            strcpy(sqlstate, "38905");
+            snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
+        }
+    }
+    else if (len == 0)
+    {
+        strcpy(sqlstate, "38906");
+        snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
+    }
+    else if (redis_reply_item(reply, len, &pos, &item) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+    }
+    else if (item.type == 0x2D) // ASCII '-' error reply (e.g., WRONGTYPE)
+    {
+        len = item.len < 70 ? (int)item.len : 70;
+        ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+        msgtext[len] = '\0';
+        strcpy(sqlstate, "38911");
+    }
+    else if (parse_redis_integer(reply, len, result) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to extract payload from Redis response");
+    }
+    else
+    {
+        rc = 1;
+    }
+    release_redis_connection(sockfd, sqlstate);
+    return rc;
+}
+
+/**********************************************************************/
+/* SQL External Function: HSET_MANY */
+/**********************************************************************/
+
+/**
+ * Function: hsetManyRedis
+ * Description: SQL external function to set many fields of a hash with one
+ *              HSET, e.g. every column of a row. NULL values leave their
+ *              field out; when every value is NULL nothing is sent.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - fields: Input comma-separated field names, one per value
+ *     (VARCHAR(4096), EBCDIC).
+ *   - value1 .. value40: Input values (VARCHAR(4096), EBCDIC).
+ *   - result: Output number of fields added (BIGINT, updated fields are not
+ *     counted); NULL in write-behind mode.
+ *   - *Ind: Null indicators for the inputs and the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38911" is an error
+ *     reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (not used).
+ *   - nullind: Additional null indicators (not used).
+ */
+void SQL_API_FN hsetManyRedis(
+    SQLUDF_VARCHAR *key,             // Input: Redis key (EBCDIC)
+    SQLUDF_VARCHAR *fields,          // Input: field names (EBCDIC)
+    SQLUDF_VARCHAR *value1,          // Input: values (EBCDIC)
+    SQLUDF_VARCHAR *value2,
+    SQLUDF_VARCHAR *value3,
+    SQLUDF_VARCHAR *value4,
+    SQLUDF_VARCHAR *value5,
+    SQLUDF_VARCHAR *value6,
+    SQLUDF_VARCHAR *value7,
+    SQLUDF_VARCHAR *value8,
+    SQLUDF_VARCHAR *value9,
+    SQLUDF_VARCHAR *value10,
+    SQLUDF_VARCHAR *value11,
+    SQLUDF_VARCHAR *value12,
+    SQLUDF_VARCHAR *value13,
+    SQLUDF_VARCHAR *value14,
+    SQLUDF_VARCHAR *value15,
+    SQLUDF_VARCHAR *value16,
+    SQLUDF_VARCHAR *value17,
+    SQLUDF_VARCHAR *value18,
+    SQLUDF_VARCHAR *value19,
+    SQLUDF_VARCHAR *value20,
+    SQLUDF_VARCHAR *value21,
+    SQLUDF_VARCHAR *value22,
+    SQLUDF_VARCHAR *value23,
+    SQLUDF_VARCHAR *value24,
+    SQLUDF_VARCHAR *value25,
+    SQLUDF_VARCHAR *value26,
+    SQLUDF_VARCHAR *value27,
+    SQLUDF_VARCHAR *value28,
+    SQLUDF_VARCHAR *value29,
+    SQLUDF_VARCHAR *value30,
+    SQLUDF_VARCHAR *value31,
+    SQLUDF_VARCHAR *value32,
+    SQLUDF_VARCHAR *value33,
+    SQLUDF_VARCHAR *value34,
+    SQLUDF_VARCHAR *value35,
+    SQLUDF_VARCHAR *value36,
+    SQLUDF_VARCHAR *value37,
+    SQLUDF_VARCHAR *value38,
+    SQLUDF_VARCHAR *value39,
+    SQLUDF_VARCHAR *value40,
+    SQLUDF_BIGINT *result,           // Output: fields added
+    SQLUDF_NULLIND *keyInd,          // Null indicators for inputs
+    SQLUDF_NULLIND *fieldsInd,
+    SQLUDF_NULLIND *value1Ind,
+    SQLUDF_NULLIND *value2Ind,
+    SQLUDF_NULLIND *value3Ind,
+    SQLUDF_NULLIND *value4Ind,
+    SQLUDF_NULLIND *value5Ind,
+    SQLUDF_NULLIND *value6Ind,
+    SQLUDF_NULLIND *value7Ind,
+    SQLUDF_NULLIND *value8Ind,
+    SQLUDF_NULLIND *value9Ind,
+    SQLUDF_NULLIND *value10Ind,
+    SQLUDF_NULLIND *value11Ind,
+    SQLUDF_NULLIND *value12Ind,
+    SQLUDF_NULLIND *value13Ind,
+    SQLUDF_NULLIND *value14Ind,
+    SQLUDF_NULLIND *value15Ind,
+    SQLUDF_NULLIND *value16Ind,
+    SQLUDF_NULLIND *value17Ind,
+    SQLUDF_NULLIND *value18Ind,
+    SQLUDF_NULLIND *value19Ind,
+    SQLUDF_NULLIND *value20Ind,
+    SQLUDF_NULLIND *value21Ind,
+    SQLUDF_NULLIND *value22Ind,
+    SQLUDF_NULLIND *value23Ind,
+    SQLUDF_NULLIND *value24Ind,
+    SQLUDF_NULLIND *value25Ind,
+    SQLUDF_NULLIND *value26Ind,
+    SQLUDF_NULLIND *value27Ind,
+    SQLUDF_NULLIND *value28Ind,
+    SQLUDF_NULLIND *value29Ind,
+    SQLUDF_NULLIND *value30Ind,
+    SQLUDF_NULLIND *value31Ind,
+    SQLUDF_NULLIND *value32Ind,
+    SQLUDF_NULLIND *value33Ind,
+    SQLUDF_NULLIND *value34Ind,
+    SQLUDF_NULLIND *value35Ind,
+    SQLUDF_NULLIND *value36Ind,
+    SQLUDF_NULLIND *value37Ind,
+    SQLUDF_NULLIND *value38Ind,
+    SQLUDF_NULLIND *value39Ind,
+    SQLUDF_NULLIND *value40Ind,
+    SQLUDF_NULLIND *resultInd,       // Null indicator for output
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    short *sqlcode,                  // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)         // Additional null indicators for DB2SQL
+{
+    const char *values[REDIS_MANY_VALUES] = {value1, value2, value3, value4, value5, value6,
+                                             value7, value8, value9, value10, value11, value12,
+                                             value13, value14, value15, value16, value17, value18,
+                                             value19, value20, value21, value22, value23, value24,
+                                             value25, value26, value27, value28, value29, value30,
+                                             value31, value32, value33, value34, value35, value36,
+                                             value37, value38, value39, value40};
+    SQLUDF_NULLIND inds[REDIS_MANY_VALUES] = {*value1Ind, *value2Ind, *value3Ind, *value4Ind, *value5Ind,
+                                              *value6Ind, *value7Ind, *value8Ind, *value9Ind, *value10Ind,
+                                              *value11Ind, *value12Ind, *value13Ind, *value14Ind, *value15Ind,
+                                              *value16Ind, *value17Ind, *value18Ind, *value19Ind, *value20Ind,
+                                              *value21Ind, *value22Ind, *value23Ind, *value24Ind, *value25Ind,
+                                              *value26Ind, *value27Ind, *value28Ind, *value29Ind, *value30Ind,
+                                              *value31Ind, *value32Ind, *value33Ind, *value34Ind, *value35Ind,
+                                              *value36Ind, *value37Ind, *value38Ind, *value39Ind, *value40Ind};
+    const char *argv[2 * REDIS_MANY_VALUES + 2], *names[REDIS_MANY_VALUES];
+    size_t argl[2 * REDIS_MANY_VALUES + 2], lens[REDIS_MANY_VALUES];
+    long long number;
+    int count, argc = 2, i;
+
+    strcpy(sqlstate, "00000");
+    *resultInd = -1;
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    if (*keyInd < 0 || *fieldsInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input key or field list is NULL");
+        return;
+    }
+    count = split_redis_fields(fields, REDIS_MANY_VALUES, names, lens);
+    if (count < 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Field list must name 1 to 40 fields");
+        return;
+    }
+
+    // HSET key field value [field value ...]
+    argv[0] = "\xC8\xE2\xC5\xE3"; // EBCDIC "HSET"
+    argl[0] = 4;
+    argv[1] = key;
+    argl[1] = strlen(key);
+    for (i = 0; i < REDIS_MANY_VALUES; i++)
+    {
+        if (inds[i] < 0)
+            continue; // NULL leaves the field out
+        if (i >= count)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "More values than fields in the field list");
+            return;
+        }
+        argv[argc] = names[i];
+        argl[argc++] = lens[i];
+        argv[argc] = values[i];
+        argl[argc++] = strlen(values[i]);
+    }
+    if (argc == 2)
+    {
+        *result = 0; // Nothing to write
+        *resultInd = 0;
+        return;
+    }
+
+    if (redis_write_many(argc, argv, argl, 1, &number, sqlstate, msgtext) == 1)
+    {
+        *result = number;
+        *resultInd = 0;
+    }
+}
+
+#pragma linkage(hsetManyRedis, OS)
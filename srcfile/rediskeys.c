@@ -20,6 +20,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define REPLY_BUFFER 32000 // Size of each receive buffer
+
 /**********************************************************************/
 /* Helper: Parse RESP array for KEYS                                   */
 /**********************************************************************/
@@ -123,7 +125,7 @@ void SQL_API_FN keysRedisPattern(
 {
     int sockfd;
     char ebcdic_send_buf[1024], ascii_send_buf[1024];
-    char recv_buf[32000], ebcdic_response[32000];
+    char *recv_buf, *ebcdic_response;
     char ebcdic_pat_len[10] = {0};
     int len, total_len = 0;
 
@@ -157,7 +159,7 @@ void SQL_API_FN keysRedisPattern(
     *valueInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_read(&sockfd) != 0)
     {
         strcpy(sqlstate, "38901");
         strcpy(msgtext, "Failed to connect to Redis");
@@ -165,6 +167,18 @@ void SQL_API_FN keysRedisPattern(
         return;
     }
 
+    // Call buffers come from the thread's arena and are given back on release
+    recv_buf = redis_arena_alloc(2 * REPLY_BUFFER);
+    if (recv_buf == NULL)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for call buffers");
+        *valueInd = -1;
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    ebcdic_response = recv_buf + REPLY_BUFFER;
+
     // Format pattern length in EBCDIC
     ebcdic_send_buf[0] = '\0';
     int pat_len = strlen(pattern);
@@ -207,24 +221,24 @@ void SQL_API_FN keysRedisPattern(
         strcpy(sqlstate, "38902");
         strcpy(msgtext, "Failed to convert command to ASCII");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send command
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strcpy(sqlstate, "38903");
         strcpy(msgtext, "Failed to send command to Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -238,7 +252,7 @@ void SQL_API_FN keysRedisPattern(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -246,19 +260,19 @@ void SQL_API_FN keysRedisPattern(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     total_len = len;
     recv_buf[total_len] = '\0';
 
     // Convert response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, sizeof(ebcdic_response) - 1) < 0)
+    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, REPLY_BUFFER - 1) < 0)
     {
         strcpy(sqlstate, "38907");
         strcpy(msgtext, "Failed to convert response to EBCDIC");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_response[total_len] = '\0';
@@ -284,7 +298,7 @@ void SQL_API_FN keysRedisPattern(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(keysRedisPattern, OS)
@@ -0,0 +1,252 @@
+/******************************************************************************
+ * File: redisldh.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_LOAD_HASH function for IBM i.
+ *              Bulk loads rows into hashes through the loader of
+ *              redisload.c: the columns named in FIELDS are written with
+ *              one HSET per row, followed by EXPIRE when a TTL is given.
+ *              Example:
+ *                SELECT SUM(REDIS_LOAD_HASH('cust:' || ID, 'name,city',
+ *                                           NAME, CITY))
+ *                  FROM CUSTOMERS
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define HASH_VALUES 8       // VALUE1 .. VALUE8
+#define HASH_VALUE 4096     // Length of a VALUE column
+
+/**********************************************************************/
+/* Helper: Command header */
+/**********************************************************************/
+
+/**
+ * Function: append_array_header
+ * Description: Writes "*<count>\r\n" (ASCII).
+ * Returns:
+ *   - New length of the command.
+ */
+static int append_array_header(char *buf, int pos, int count)
+{
+    buf[pos++] = 0x2A; // ASCII '*'
+    pos += format_redis_double(count, buf + pos);
+    buf[pos++] = 0x0D;
+    buf[pos++] = 0x0A;
+    return pos;
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: loadRedisHash
+ * Description: SQL external function writing one row of a bulk load into
+ *              a hash. NULL values leave their field out; a row without
+ *              any value is skipped. Error replies are counted in the load
+ *              report instead of failing the statement. The final call of
+ *              the statement completes the load.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - fields: Input comma-separated field names, one per value
+ *     (VARCHAR(1024), EBCDIC).
+ *   - value1 .. value8: Input values (VARCHAR(4096), EBCDIC).
+ *   - ttl: Input TTL in seconds, NULL for none.
+ *   - batch: Input rows per batch, NULL for REDIS_LOAD_BATCH.
+ *   - connections: Input connections, NULL for REDIS_LOAD_CONNECTIONS.
+ *   - queued: Output 1 when the row was queued, 0 when it was skipped.
+ *   - *Ind: Null indicators for the inputs and the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the handle of the load.
+ *   - calltype: First, normal or final call.
+ */
+void SQL_API_FN loadRedisHash(
+    SQLUDF_VARCHAR *key,             // Input: Redis key (EBCDIC)
+    SQLUDF_VARCHAR *fields,          // Input: field names (EBCDIC)
+    SQLUDF_VARCHAR *value1,          // Input: values (EBCDIC)
+    SQLUDF_VARCHAR *value2,
+    SQLUDF_VARCHAR *value3,
+    SQLUDF_VARCHAR *value4,
+    SQLUDF_VARCHAR *value5,
+    SQLUDF_VARCHAR *value6,
+    SQLUDF_VARCHAR *value7,
+    SQLUDF_VARCHAR *value8,
+    SQLUDF_INTEGER *ttl,             // Input: TTL in seconds
+    SQLUDF_INTEGER *batch,           // Input: rows per batch
+    SQLUDF_INTEGER *connections,     // Input: connections
+    SQLUDF_INTEGER *queued,          // Output: 1 when the row was queued
+    SQLUDF_NULLIND *keyInd,          // Null indicators for inputs
+    SQLUDF_NULLIND *fieldsInd,
+    SQLUDF_NULLIND *value1Ind,
+    SQLUDF_NULLIND *value2Ind,
+    SQLUDF_NULLIND *value3Ind,
+    SQLUDF_NULLIND *value4Ind,
+    SQLUDF_NULLIND *value5Ind,
+    SQLUDF_NULLIND *value6Ind,
+    SQLUDF_NULLIND *value7Ind,
+    SQLUDF_NULLIND *value8Ind,
+    SQLUDF_NULLIND *ttlInd,
+    SQLUDF_NULLIND *batchInd,
+    SQLUDF_NULLIND *connectionsInd,
+    SQLUDF_NULLIND *queuedInd,       // Null indicator for output
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,   // Handle of the load between calls
+    SQLUDF_CALL_TYPE *calltype)      // First, normal or final call
+{
+    const char *values[HASH_VALUES] = {value1, value2, value3, value4, value5, value6, value7, value8};
+    SQLUDF_NULLIND inds[HASH_VALUES] = {*value1Ind, *value2Ind, *value3Ind, *value4Ind,
+                                        *value5Ind, *value6Ind, *value7Ind, *value8Ind};
+    const char *names[HASH_VALUES];
+    size_t lens[HASH_VALUES], value_lens[HASH_VALUES], key_len;
+    char ttl_text[REDIS_DOUBLE_TEXT];
+    char *buf;
+    int handle, count, pairs, size, len, i;
+
+    strcpy(sqlstate, "00000");
+    *queuedInd = -1;
+    memcpy(&handle, scratchpad->data, sizeof(handle));
+    if (*calltype == SQLUDF_FINAL_CALL)
+    {
+        redis_load_finish(handle, sqlstate, msgtext);
+        handle = 0;
+        memcpy(scratchpad->data, &handle, sizeof(handle));
+        return;
+    }
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    // Check for NULL input
+    if (*keyInd < 0 || *fieldsInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input key or field list is NULL");
+        return;
+    }
+    if (*ttlInd >= 0 && *ttl <= 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "TTL must be positive");
+        return;
+    }
+    count = split_redis_fields(fields, HASH_VALUES, names, lens);
+    if (count < 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Field list must name 1 to 8 fields");
+        return;
+    }
+    for (i = count; i < HASH_VALUES; i++)
+    {
+        if (inds[i] >= 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "More values than fields in the field list");
+            return;
+        }
+    }
+
+    // The first row starts the load of the statement
+    if (handle <= 0)
+    {
+        if ((*batchInd >= 0 && (*batch < 1 || *batch > REDIS_LOAD_MAX_BATCH)) ||
+            (*connectionsInd >= 0 && (*connections < 1 || *connections > REDIS_MAX_ENDPOINTS)))
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Batch must be 1 to 100000 and connections 1 to 16");
+            return;
+        }
+        handle = redis_load_start(*batchInd >= 0 ? *batch : 0, *connectionsInd >= 0 ? *connections : 0);
+        if (handle < 0)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, handle == -2 ? "Too many loads running in this job" : "Out of memory for the load");
+            return;
+        }
+        memcpy(scratchpad->data, &handle, sizeof(handle));
+    }
+
+    key_len = strlen(key);
+    if (key_len > 255)
+        key_len = 255; // Truncate to match VARCHAR(255)
+    size = (int)key_len * 2 + 256;
+    pairs = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (inds[i] < 0)
+            continue;
+        value_lens[i] = strlen(values[i]);
+        if (value_lens[i] > HASH_VALUE)
+            value_lens[i] = HASH_VALUE; // Truncate to match VARCHAR(4096)
+        size += (int)(lens[i] + value_lens[i]) + 64;
+        pairs++;
+    }
+    if (pairs == 0)
+    {
+        *queued = 0; // Nothing to write for this row
+        *queuedInd = 0;
+        return;
+    }
+
+    // "HSET key field value ..." and "EXPIRE key ttl", written straight into the batch
+    buf = redis_load_reserve(handle, key, key_len, size, sqlstate, msgtext);
+    if (buf == NULL)
+        return;
+    len = append_array_header(buf, 0, 2 + 2 * pairs);
+    len = append_redis_argument(buf, size, len, "\xC8\xE2\xC5\xE3", 4, 0); // EBCDIC "HSET"
+    len = append_redis_argument(buf, size, len, key, key_len, 0);
+    for (i = 0; i < count; i++)
+    {
+        if (inds[i] < 0)
+            continue;
+        len = append_redis_argument(buf, size, len, names[i], lens[i], 0);
+        len = append_redis_argument(buf, size, len, values[i], value_lens[i], 0);
+    }
+    if (*ttlInd >= 0 && len >= 0)
+    {
+        memcpy(buf + len, REDIS_TEMPLATE_EXPIRE, sizeof(REDIS_TEMPLATE_EXPIRE) - 1); // Room counted in size
+        len += sizeof(REDIS_TEMPLATE_EXPIRE) - 1;
+        len = append_redis_argument(buf, size, len, key, key_len, 0);
+        len = append_redis_argument(buf, size, len, ttl_text, format_redis_double(*ttl, ttl_text), 1);
+    }
+    if (len < 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Failed to convert command to ASCII");
+        return;
+    }
+    if (redis_load_commit(handle, len, *ttlInd >= 0 ? 2 : 1, sqlstate, msgtext) != 0)
+        return;
+
+    *queued = 1;
+    *queuedInd = 0;
+}
+
+#pragma linkage(loadRedisHash, OS)
@@ -0,0 +1,129 @@
+/******************************************************************************
+ * File: redisldr.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_LOAD_REPORT table function for
+ *              IBM i. Returns one row per bulk load of the job
+ *              (REDIS_LOAD, REDIS_LOAD_HASH): the running ones with their
+ *              progress, then the last REDIS_LOAD_HISTORY finished ones,
+ *              newest first, with rows/s and failures.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: loadReportRedis
+ * Description: SQL external table function returning the bulk loads of the
+ *              job. The scratchpad keeps the position of the next load.
+ * Parameters:
+ *   - loadId: Output load number in the job.
+ *   - status: Output "running", "done" or "failed" (VARCHAR(8), EBCDIC).
+ *   - rows: Output rows queued.
+ *   - commands: Output commands sent or queued.
+ *   - failed: Output commands answered with an error or lost with their
+ *     connection.
+ *   - batches: Output batches sent.
+ *   - connections: Output connections opened.
+ *   - seconds: Output duration (so far, while running).
+ *   - rowsPerSecond: Output rows per second.
+ *   - firstError: Output first error (VARCHAR(70), EBCDIC); NULL if none.
+ *   - *Ind: Null indicators for the output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the cursor.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN loadReportRedis(
+    SQLUDF_BIGINT *loadId,             // Output: load number
+    SQLUDF_VARCHAR *status,            // Output: status (EBCDIC)
+    SQLUDF_BIGINT *rows,               // Output: rows queued
+    SQLUDF_BIGINT *commands,           // Output: commands
+    SQLUDF_BIGINT *failed,             // Output: failed commands
+    SQLUDF_BIGINT *batches,            // Output: batches sent
+    SQLUDF_INTEGER *connections,       // Output: connections opened
+    SQLUDF_DOUBLE *seconds,            // Output: duration
+    SQLUDF_DOUBLE *rowsPerSecond,      // Output: rows per second
+    SQLUDF_VARCHAR *firstError,        // Output: first error (EBCDIC)
+    SQLUDF_NULLIND *loadIdInd,         // Null indicators for outputs
+    SQLUDF_NULLIND *statusInd,
+    SQLUDF_NULLIND *rowsInd,
+    SQLUDF_NULLIND *commandsInd,
+    SQLUDF_NULLIND *failedInd,
+    SQLUDF_NULLIND *batchesInd,
+    SQLUDF_NULLIND *connectionsInd,
+    SQLUDF_NULLIND *secondsInd,
+    SQLUDF_NULLIND *rowsPerSecondInd,
+    SQLUDF_NULLIND *firstErrorInd,
+    char *sqlstate,                    // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                    // Fully qualified function name
+    char *specname,                    // Specific name
+    char *msgtext,                     // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,     // Cursor between calls
+    SQLUDF_CALL_TYPE *calltype)        // Open, fetch or close
+{
+    RedisLoadReport report;
+    int cursor;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+        cursor = 0;
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    memcpy(&cursor, scratchpad->data, sizeof(cursor));
+    if (redis_load_report(cursor, &report) != 0)
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+
+    *loadId = report.id;
+    strcpy(status, report.status == REDIS_LOAD_RUNNING ? "running"
+                   : report.status == REDIS_LOAD_DONE  ? "done"
+                                                       : "failed");
+    *rows = report.rows;
+    *commands = report.commands;
+    *failed = report.failed;
+    *batches = report.batches;
+    *connections = report.connections;
+    *seconds = report.seconds;
+    *rowsPerSecond = report.seconds > 0 ? report.rows / report.seconds : 0;
+    *loadIdInd = 0;
+    *statusInd = 0;
+    *rowsInd = 0;
+    *commandsInd = 0;
+    *failedInd = 0;
+    *batchesInd = 0;
+    *connectionsInd = 0;
+    *secondsInd = 0;
+    *rowsPerSecondInd = 0;
+    if (report.error[0] == '\0')
+    {
+        *firstErrorInd = -1;
+    }
+    else
+    {
+        strcpy(firstError, report.error);
+        *firstErrorInd = 0;
+    }
+
+    cursor++;
+    memcpy(scratchpad->data, &cursor, sizeof(cursor));
+}
+
+#pragma linkage(loadReportRedis, OS)
@@ -0,0 +1,320 @@
+/******************************************************************************
+ * File: redislmpo.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Batch dequeue for IBM i: pops up to N elements of a list in
+ *              one round trip, for the REDIS_LPOP_N, REDIS_RPOP_N and
+ *              REDIS_LMPOP table functions, and the REDIS_LMPOP function
+ *              itself. The pop is a Lua script (lua/list_pop.lua, run
+ *              through the job's script registry) that uses LPOP/RPOP with
+ *              COUNT, limited to what fits in the scratchpad, so an element
+ *              is never popped without being returned.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define POP_KEY 255      // Length of the KEY column
+#define POP_VALUE 16370  // Length of the VALUE column
+#define POP_KEYS 64      // Lists of one REDIS_LMPOP call
+#define POP_SLACK 256    // Scratchpad kept free of the reply budget
+
+// Rows left of a pop, kept in the scratchpad ahead of the reply
+typedef struct
+{
+    int pos;       // Offset of the next element in the reply
+    int len;       // Length of the reply
+    int remaining; // Elements not returned yet
+    int position;  // Position of the last element returned
+    int key_pos;   // Offset and length of the list popped from
+    int key_len;
+} PopCursor;
+
+/**
+ * Function: redis_pop_open
+ * Description: Pops up to count elements from the first non-empty list in
+ *              one round trip and keeps them in the scratchpad area for
+ *              redis_pop_fetch. Fewer elements are popped when they would
+ *              not fit in the area.
+ * Parameters:
+ *   - keyc: Number of lists (the first routes the call in cluster or
+ *     sharded mode; all must be in one slot).
+ *   - keys: The lists (EBCDIC, null-terminated).
+ *   - keyl: Their lengths.
+ *   - left: 1 to pop from the head, 0 from the tail.
+ *   - count: Most elements to pop.
+ *   - area: Scratchpad data.
+ *   - size: Scratchpad length.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 0 on success (also when every list is empty), -1 on failure.
+ */
+int redis_pop_open(int keyc, const char **keys, const size_t *keyl, int left, long count, char *area,
+                   size_t size, char *sqlstate, char *msgtext)
+{
+    char *reply = area + sizeof(PopCursor);
+    char sha[41], count_text[REDIS_DOUBLE_TEXT], budget[REDIS_DOUBLE_TEXT];
+    const char *argv[POP_KEYS + 3];
+    size_t argl[POP_KEYS + 3], pos = 0;
+    RedisReplyItem item;
+    PopCursor cursor;
+    int sockfd, len;
+
+    if (size < sizeof(PopCursor) + 4 * POP_SLACK)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Scratchpad too small: create the function with SCRATCHPAD 32767");
+        return -1;
+    }
+    if (redis_script_register(REDIS_SCRIPT_LIST_POP, strlen(REDIS_SCRIPT_LIST_POP), 1, sha) != 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for the script registry");
+        return -1;
+    }
+    size -= sizeof(PopCursor);
+
+    // KEYS are the lists; ARGV the direction, count and reply budget
+    memcpy(argv, keys, keyc * sizeof(char *));
+    memcpy(argl, keyl, keyc * sizeof(size_t));
+    argv[keyc] = left ? "\xD3\xC5\xC6\xE3" : "\xD9\xC9\xC7\xC8\xE3"; // LEFT, RIGHT
+    argl[keyc] = left ? 4 : 5;
+    argv[keyc + 1] = count_text;
+    argl[keyc + 1] = format_ebcdic_integer(count, count_text);
+    argv[keyc + 2] = budget;
+    argl[keyc + 2] = format_ebcdic_integer((long long)(size - POP_SLACK), budget);
+
+    if (connect_to_redis_key(&sockfd, keys[0]) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        return -1;
+    }
+    len = eval_redis_script(sockfd, sha, keyc + 3, argv, argl, keyc, reply, size, sqlstate, msgtext);
+    if (len < 0)
+    {
+        release_redis_connection(sockfd, sqlstate);
+        return -1;
+    }
+
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.len = len;
+    if (redis_reply_item(reply, len, &pos, &item) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+    }
+    else if (item.type == 0x2D) // ASCII '-' error reply (e.g., WRONGTYPE)
+    {
+        len = item.len < 70 ? (int)item.len : 70;
+        ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+        msgtext[len] = '\0';
+        strcpy(sqlstate, "38911");
+    }
+    else if (!item.nil) // {key, {element, ...}}; nil when every list is empty
+    {
+        if (item.type != 0x2A || item.len != 2 || redis_reply_item(reply, len, &pos, &item) != 0 ||
+            item.nil || item.len > POP_KEY)
+        {
+            strcpy(sqlstate, "38909");
+            strcpy(msgtext, "Failed to parse Redis response");
+        }
+        else
+        {
+            cursor.key_pos = (int)(item.data - reply);
+            cursor.key_len = (int)item.len;
+            if (redis_reply_item(reply, len, &pos, &item) != 0 || item.type != 0x2A)
+            {
+                strcpy(sqlstate, "38909");
+                strcpy(msgtext, "Failed to parse Redis response");
+            }
+            else
+            {
+                cursor.pos = (int)pos;
+                cursor.remaining = item.nil ? 0 : (int)item.len;
+            }
+        }
+    }
+    release_redis_connection(sockfd, sqlstate);
+    if (strcmp(sqlstate, "00000") != 0)
+        return -1;
+    memcpy(area, &cursor, sizeof(cursor));
+    return 0;
+}
+
+/**
+ * Function: redis_pop_fetch
+ * Description: Returns the next element popped by redis_pop_open.
+ * Parameters:
+ *   - area: Scratchpad data.
+ *   - key: Receives the list the element was popped from (EBCDIC), NULL
+ *     if not wanted.
+ *   - position: Receives the 1-based position in popping order.
+ *   - value: Receives the element (EBCDIC).
+ *   - sqlstate: Receives "02000" after the last element, or the SQLSTATE
+ *     of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 0 for an element, 1 at the end, -1 on failure.
+ */
+int redis_pop_fetch(char *area, char *key, int *position, char *value, char *sqlstate, char *msgtext)
+{
+    char *reply = area + sizeof(PopCursor);
+    RedisReplyItem item;
+    PopCursor cursor;
+    size_t pos;
+
+    memcpy(&cursor, area, sizeof(cursor));
+    if (cursor.remaining == 0)
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return 1;
+    }
+    pos = cursor.pos;
+    if (redis_reply_item(reply, cursor.len, &pos, &item) != 0 || item.nil)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+        return -1;
+    }
+    if (item.len > POP_VALUE)
+    {
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Value exceeds maximum length");
+        return -1;
+    }
+    if (key != NULL)
+    {
+        ConvertToEBCDIC(reply + cursor.key_pos, cursor.key_len, key, POP_KEY + 1);
+        key[cursor.key_len] = '\0';
+    }
+    ConvertToEBCDIC((char *)item.data, item.len, value, POP_VALUE + 1);
+    value[item.len] = '\0';
+    *position = ++cursor.position;
+    cursor.pos = (int)pos;
+    cursor.remaining--;
+    memcpy(area, &cursor, sizeof(cursor));
+    return 0;
+}
+
+/**********************************************************************/
+/* SQL External Function: LMPOP */
+/**********************************************************************/
+
+/**
+ * Function: lmpopRedis
+ * Description: SQL external table function to pop up to N elements from
+ *              the first non-empty list of several, like LMPOP, in one
+ *              round trip. Each element is a row.
+ * Parameters:
+ *   - keys: Input lists, blank-separated, tried in order (EBCDIC). In
+ *     cluster mode they must hash to one slot (e.g., with a {tag}).
+ *   - count: Input most elements to pop (NULL for 1).
+ *   - direction: Input LEFT (head, the default) or RIGHT (tail).
+ *   - key: Output list the elements were popped from (EBCDIC).
+ *   - position: Output 1-based position in popping order.
+ *   - value: Output element (EBCDIC).
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the popped elements.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN lmpopRedis(
+    SQLUDF_VARCHAR *keys,           // Input: lists (EBCDIC)
+    SQLUDF_INTEGER *count,          // Input: most elements to pop
+    SQLUDF_VARCHAR *direction,      // Input: LEFT or RIGHT (EBCDIC)
+    SQLUDF_VARCHAR *key,            // Output: list popped from (EBCDIC)
+    SQLUDF_INTEGER *position,       // Output: position in popping order
+    SQLUDF_VARCHAR *value,          // Output: element (EBCDIC)
+    SQLUDF_NULLIND *keysInd,        // Null indicators for inputs
+    SQLUDF_NULLIND *countInd,
+    SQLUDF_NULLIND *directionInd,
+    SQLUDF_NULLIND *keyInd,         // Null indicators for outputs
+    SQLUDF_NULLIND *positionInd,
+    SQLUDF_NULLIND *valueInd,
+    char *sqlstate,                 // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                 // Fully qualified function name
+    char *specname,                 // Specific name
+    char *msgtext,                  // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,  // Popped elements between calls
+    SQLUDF_CALL_TYPE *calltype)     // Open, fetch or close
+{
+    char words[2 * 4096 + 2];
+    const char *argv[POP_KEYS];
+    size_t argl[POP_KEYS];
+    int keyc, left = 1;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+#ifdef USE_ICONV
+        if (!initialized)
+        {
+            initialize_conversion();
+            initialized = 1;
+        }
+        if (errno != 0)
+        {
+            strcpy(sqlstate, "38999");
+            strcpy(msgtext, "iconv initialization failed");
+            return;
+        }
+#endif
+        if (*keysInd < 0)
+        {
+            strcpy(sqlstate, "38001");
+            strcpy(msgtext, "Input keys are NULL");
+            return;
+        }
+        if (*countInd >= 0 && *count < 1)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Input count must be positive");
+            return;
+        }
+        if (*directionInd >= 0 && parse_redis_direction(direction, &left) != 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Input direction must be LEFT or RIGHT");
+            return;
+        }
+
+        // The lists, blank-separated words
+        keyc = split_redis_keys(strlen(keys) <= 4096 ? keys : "", words, POP_KEYS, argv, argl);
+        if (keyc <= 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, keyc == 0 ? "Input keys are empty" : keyc == -1 ? "Unterminated quote in keys"
+                                                                            : "Too many keys");
+            return;
+        }
+
+        redis_pop_open(keyc, argv, argl, left, *countInd < 0 ? 1 : *count, scratchpad->data,
+                       scratchpad->length, sqlstate, msgtext);
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    if (redis_pop_fetch(scratchpad->data, key, position, value, sqlstate, msgtext) == 0)
+    {
+        *keyInd = 0;
+        *positionInd = 0;
+        *valueInd = 0;
+    }
+}
+
+#pragma linkage(lmpopRedis, OS)
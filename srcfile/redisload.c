@@ -0,0 +1,778 @@
+/******************************************************************************
+ * File: redisload.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Bulk loader of the REDISILE service program and the
+ *              REDIS_LOAD function for IBM i.
+ *              Db2 cannot pass a table to an external function, so a load
+ *              streams the rows of a query through a scalar function:
+ *                SELECT SUM(REDIS_LOAD('cust:' || ID, NAME, 3600))
+ *                  FROM CUSTOMERS
+ *              The function is created with SCRATCHPAD and FINAL CALL, so
+ *              every row of the statement reaches the same load. A row is
+ *              only appended to the batch of its connection; a full batch
+ *              is sent in one write and its replies are read when the
+ *              connection has REDIS_LOAD_WINDOW batches in flight, so
+ *              Redis works on one batch while the next one is built. Keys
+ *              are spread over several connections by hash (or over the
+ *              nodes that own them when keys are sharded). The final call
+ *              sends what is left, reads the remaining replies and files
+ *              the report returned by REDIS_LOAD_REPORT.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <pthread.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define LOAD_LANES REDIS_MAX_ENDPOINTS // Connections of one load
+#define LOAD_BATCH_BUFFER 65536        // Initial size of a batch buffer
+#define LOAD_REPLY_BUFFER 65536        // Replies read at once from a connection
+
+/**********************************************************************/
+/* Loads */
+/**********************************************************************/
+
+/**
+ * One connection of a load. Batches are built in buf; the number of
+ * commands of each batch in flight is kept in window[] until its replies
+ * have been read.
+ */
+typedef struct
+{
+    int sockfd;                         // Connection, -1 until the first batch
+    int endpoint;                       // Endpoint of the keys, -1 for the primary
+    char *buf;                          // Batch being built (ASCII)
+    size_t len;                         // Bytes in the batch
+    size_t size;                        // Size of buf
+    int rows;                           // Rows in the batch
+    int queued;                         // Commands in the batch
+    int window[REDIS_LOAD_MAX_WINDOW];  // Commands of the batches in flight
+    int head;                           // Oldest batch in flight
+    int inflight;                       // Batches in flight
+    long pending;                       // Replies not read yet
+    char *reply;                        // Start of an incomplete reply (ASCII)
+    size_t reply_len;                   // Bytes of the incomplete reply
+} LoadLane;
+
+typedef struct
+{
+    int batch;                 // Rows per batch
+    int window;                // Batches in flight per connection
+    int connections;           // Connections when keys are not sharded
+    int sharded;               // 1 when lanes follow the nodes owning the keys
+    int lane_count;            // Lanes in use
+    LoadLane lanes[LOAD_LANES];
+    LoadLane *reserved;        // Lane of the row being written
+    struct timeval start;      // First row
+    RedisLoadReport report;    // Counters, read by REDIS_LOAD_REPORT
+} RedisLoader;
+
+static RedisLoader *loaders[REDIS_LOAD_SLOTS];
+static RedisLoadReport history[REDIS_LOAD_HISTORY]; // Finished loads, a ring
+static int history_count = 0;
+static long long load_count = 0;
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Function: elapsed_seconds
+ * Description: Returns the seconds since a start time.
+ */
+static double elapsed_seconds(const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/**
+ * Function: note_error
+ * Description: Remembers the first error of a load and marks it failed.
+ * Parameters:
+ *   - loader: Load.
+ *   - text: Error text.
+ *   - len: Length of the text.
+ *   - ascii: 1 for an error reply (ASCII), 0 for a message (EBCDIC).
+ */
+static void note_error(RedisLoader *loader, const char *text, size_t len, int ascii)
+{
+    RedisLoadReport *report = &loader->report;
+
+    pthread_mutex_lock(&load_lock);
+    if (report->error[0] == '\0')
+    {
+        if (len > sizeof(report->error) - 1)
+            len = sizeof(report->error) - 1;
+        if (!ascii)
+            memcpy(report->error, text, len);
+        else if (ConvertToEBCDIC((char *)text, len, report->error, sizeof(report->error) - 1) < 0)
+            len = 0;
+        report->error[len] = '\0';
+    }
+    report->status = REDIS_LOAD_FAILED;
+    pthread_mutex_unlock(&load_lock);
+}
+
+/**
+ * Function: loader_for
+ * Description: Returns the load of a handle.
+ */
+static RedisLoader *loader_for(int handle)
+{
+    if (handle < 1 || handle > REDIS_LOAD_SLOTS)
+        return NULL;
+    return loaders[handle - 1];
+}
+
+/**********************************************************************/
+/* Lanes */
+/**********************************************************************/
+
+/**
+ * Function: lose_lane
+ * Description: Gives up a connection after a failure. The commands queued
+ *              or in flight on it count as failed.
+ * Parameters:
+ *   - loader: Load.
+ *   - lane: Lane whose connection failed.
+ *   - sqlstate: SQLSTATE of the failure.
+ *   - msgtext: Message text of the failure.
+ */
+static void lose_lane(RedisLoader *loader, LoadLane *lane, const char *sqlstate, const char *msgtext)
+{
+    if (lane->sockfd >= 0)
+        release_redis_connection(lane->sockfd, sqlstate);
+    lane->sockfd = -1;
+    loader->report.failed += lane->pending + lane->queued;
+    lane->pending = 0;
+    lane->head = 0;
+    lane->inflight = 0;
+    lane->len = 0;
+    lane->rows = 0;
+    lane->queued = 0;
+    lane->reply_len = 0;
+    note_error(loader, msgtext, strlen(msgtext), 0);
+}
+
+/**
+ * Function: enter_lane
+ * Description: Starts a call on the connection of a lane, opening it on
+ *              first use.
+ * Returns:
+ *   - 0 on success, -1 on failure (sqlstate and msgtext set).
+ */
+static int enter_lane(RedisLoader *loader, LoadLane *lane, char *sqlstate, char *msgtext)
+{
+    int rc;
+
+    if (lane->sockfd >= 0)
+    {
+        resume_redis_call(lane->sockfd);
+        return 0;
+    }
+    if (lane->endpoint < 0)
+        rc = connect_to_redis(&lane->sockfd);
+    else
+        rc = connect_to_redis_endpoint(&lane->sockfd, lane->endpoint);
+    if (rc != 0)
+    {
+        lane->sockfd = -1;
+        strncpy(sqlstate, "38901", 5);
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        lose_lane(loader, lane, sqlstate, msgtext);
+        return -1;
+    }
+    loader->report.connections++;
+    return 0;
+}
+
+/**
+ * Function: drain_lane
+ * Description: Reads replies until at most target are still outstanding.
+ *              Error replies are counted as failed commands.
+ * Parameters:
+ *   - loader: Load.
+ *   - lane: Lane, inside a call (enter_lane).
+ *   - target: Replies that may stay outstanding.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure (connection already given up).
+ */
+static int drain_lane(RedisLoader *loader, LoadLane *lane, long target, char *sqlstate, char *msgtext)
+{
+    RedisReplyItem item;
+    size_t pos;
+    long span;
+    int len;
+
+    while (lane->pending > target)
+    {
+        // Count the complete replies received so far
+        pos = 0;
+        span = 0;
+        while (lane->pending > target && (span = redis_reply_span(lane->reply, lane->reply_len, pos)) >= 0)
+        {
+            if (lane->reply[pos] == 0x2D) // ASCII '-' error reply
+            {
+                size_t item_pos = pos;
+                loader->report.failed++;
+                if (redis_reply_item(lane->reply, lane->reply_len, &item_pos, &item) == 0)
+                    note_error(loader, item.data, item.len, 1);
+            }
+            pos = (size_t)span;
+            lane->pending--;
+            if (--lane->window[lane->head] == 0)
+            {
+                lane->head = (lane->head + 1) % REDIS_LOAD_MAX_WINDOW;
+                lane->inflight--;
+            }
+        }
+        if (span == -2)
+        {
+            strncpy(sqlstate, "38909", 5);
+            strncpy(msgtext, "Failed to parse Redis response", 70);
+            lose_lane(loader, lane, sqlstate, msgtext);
+            return -1;
+        }
+        memmove(lane->reply, lane->reply + pos, lane->reply_len - pos);
+        lane->reply_len -= pos;
+        if (lane->pending <= target)
+            break;
+        if (lane->reply_len == LOAD_REPLY_BUFFER)
+        {
+            strncpy(sqlstate, "38908", 5);
+            strncpy(msgtext, "Reply exceeds the load reply buffer", 70);
+            lose_lane(loader, lane, sqlstate, msgtext);
+            return -1;
+        }
+
+        len = recv_redis_stream(lane->sockfd, lane->reply + lane->reply_len,
+                                LOAD_REPLY_BUFFER - lane->reply_len);
+        if (len < 0)
+        {
+            if (errno == EWOULDBLOCK || errno == EAGAIN)
+            {
+                strncpy(sqlstate, "38904", 5);
+                snprintf(msgtext, 70, "Receive timeout from Redis: errno=%d", errno);
+            }
+            else
+            {
+                strncpy(sqlstate, "38905", 5);
+                snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d", errno);
+            }
+            lose_lane(loader, lane, sqlstate, msgtext);
+            return -1;
+        }
+        if (len == 0)
+        {
+            strncpy(sqlstate, "38906", 5);
+            strncpy(msgtext, "Connection closed by Redis", 70);
+            lose_lane(loader, lane, sqlstate, msgtext);
+            return -1;
+        }
+        lane->reply_len += len;
+    }
+    return 0;
+}
+
+/**
+ * Function: flush_lane
+ * Description: Sends the batch of a lane in one write. When more than the
+ *              window of batches is in flight, the replies of the oldest
+ *              ones are read.
+ * Returns:
+ *   - 0 on success, -1 on failure (sqlstate and msgtext set).
+ */
+static int flush_lane(RedisLoader *loader, LoadLane *lane, char *sqlstate, char *msgtext)
+{
+    if (lane->queued == 0)
+        return 0;
+    if (enter_lane(loader, lane, sqlstate, msgtext) != 0)
+        return -1;
+
+    if (send_redis_command(lane->sockfd, lane->buf, lane->len) < 0)
+    {
+        strncpy(sqlstate, "38903", 5);
+        snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+        lose_lane(loader, lane, sqlstate, msgtext);
+        return -1;
+    }
+    lane->window[(lane->head + lane->inflight) % REDIS_LOAD_MAX_WINDOW] = lane->queued;
+    lane->inflight++;
+    lane->pending += lane->queued;
+    loader->report.batches++;
+    lane->len = 0;
+    lane->rows = 0;
+    lane->queued = 0;
+
+    while (lane->inflight > loader->window)
+    {
+        if (drain_lane(loader, lane, lane->pending - lane->window[lane->head], sqlstate, msgtext) != 0)
+            return -1;
+    }
+
+    // The connection stays with the load until its final call
+    suspend_redis_call(sqlstate);
+    return 0;
+}
+
+/**
+ * Function: lane_for_key
+ * Description: Returns the lane of a key: the node owning it when keys are
+ *              sharded, otherwise one of the load's connections by hash.
+ * Returns:
+ *   - Lane, NULL if out of memory.
+ */
+static LoadLane *lane_for_key(RedisLoader *loader, const char *key, size_t key_len)
+{
+    LoadLane *lane;
+    unsigned int hash = 2166136261u; // FNV-1a
+    int endpoint = -1, i;
+    size_t k;
+
+    if (loader->sharded)
+    {
+        endpoint = redis_endpoint_for_key(key, key_len);
+        for (i = 0; i < loader->lane_count && loader->lanes[i].endpoint != endpoint; i++)
+            ;
+    }
+    else
+    {
+        for (k = 0; k < key_len; k++)
+            hash = (hash ^ (unsigned char)key[k]) * 16777619u;
+        i = (int)(hash % (unsigned int)loader->connections);
+    }
+    if (i >= LOAD_LANES)
+        return NULL;
+
+    lane = &loader->lanes[i];
+    if (lane->buf == NULL)
+    {
+        lane->buf = malloc(LOAD_BATCH_BUFFER);
+        lane->reply = malloc(LOAD_REPLY_BUFFER);
+        if (lane->buf == NULL || lane->reply == NULL)
+        {
+            free(lane->buf);
+            free(lane->reply);
+            lane->buf = NULL;
+            lane->reply = NULL;
+            return NULL;
+        }
+        lane->size = LOAD_BATCH_BUFFER;
+        lane->endpoint = endpoint;
+        lane->sockfd = -1;
+        if (i >= loader->lane_count)
+            loader->lane_count = i + 1;
+    }
+    return lane;
+}
+
+/**********************************************************************/
+/* Loader Interface */
+/**********************************************************************/
+
+/**
+ * Function: redis_load_start
+ * Description: Starts a bulk load in a free slot of the job.
+ * Parameters:
+ *   - batch: Rows per batch, 0 for REDIS_LOAD_BATCH.
+ *   - connections: Connections when keys are not sharded, 0 for
+ *     REDIS_LOAD_CONNECTIONS.
+ * Returns:
+ *   - Handle of the load (> 0), -1 if out of memory, -2 if all slots are
+ *     in use.
+ */
+int redis_load_start(int batch, int connections)
+{
+    RedisLoader *loader;
+    int slot, i;
+
+    loader = calloc(1, sizeof(RedisLoader));
+    if (loader == NULL)
+        return -1;
+    loader->batch = batch > 0 ? batch : atoi(REDIS_LOAD_BATCH);
+    loader->window = atoi(REDIS_LOAD_WINDOW);
+    loader->connections = connections > 0 ? connections : atoi(REDIS_LOAD_CONNECTIONS);
+    if (loader->batch < 1 || loader->batch > REDIS_LOAD_MAX_BATCH)
+        loader->batch = 500;
+    if (loader->window < 1 || loader->window >= REDIS_LOAD_MAX_WINDOW)
+        loader->window = 4;
+    if (loader->connections < 1 || loader->connections > LOAD_LANES)
+        loader->connections = 4;
+    loader->sharded = redis_sharding_enabled();
+    for (i = 0; i < LOAD_LANES; i++)
+        loader->lanes[i].sockfd = -1;
+    gettimeofday(&loader->start, NULL);
+
+    pthread_mutex_lock(&load_lock);
+    for (slot = 0; slot < REDIS_LOAD_SLOTS && loaders[slot] != NULL; slot++)
+        ;
+    if (slot == REDIS_LOAD_SLOTS)
+    {
+        pthread_mutex_unlock(&load_lock);
+        free(loader);
+        return -2;
+    }
+    loader->report.id = ++load_count;
+    loader->report.status = REDIS_LOAD_RUNNING;
+    loaders[slot] = loader;
+    pthread_mutex_unlock(&load_lock);
+    return slot + 1;
+}
+
+/**
+ * Function: redis_load_reserve
+ * Description: Returns room for a row at the end of the batch of its key's
+ *              lane. A batch without room is sent first; a row larger than
+ *              an empty batch buffer grows it.
+ * Parameters:
+ *   - handle: Handle from redis_load_start.
+ *   - key: Redis key (EBCDIC).
+ *   - key_len: Length of the key.
+ *   - size: Bytes needed by the row's commands.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Buffer of at least size bytes, NULL on failure.
+ */
+char *redis_load_reserve(int handle, const char *key, size_t key_len, size_t size,
+                         char *sqlstate, char *msgtext)
+{
+    RedisLoader *loader = loader_for(handle);
+    LoadLane *lane;
+    char *grown;
+
+    if (loader == NULL)
+    {
+        strncpy(sqlstate, "38003", 5);
+        strncpy(msgtext, "No load in progress for this statement", 70);
+        return NULL;
+    }
+    lane = lane_for_key(loader, key, key_len);
+    if (lane == NULL)
+    {
+        strncpy(sqlstate, "38902", 5);
+        strncpy(msgtext, "Out of memory for load buffers", 70);
+        return NULL;
+    }
+
+    if (lane->len + size > lane->size && flush_lane(loader, lane, sqlstate, msgtext) != 0)
+        return NULL;
+    if (size > lane->size)
+    {
+        grown = realloc(lane->buf, size);
+        if (grown == NULL)
+        {
+            strncpy(sqlstate, "38902", 5);
+            strncpy(msgtext, "Out of memory for load buffers", 70);
+            return NULL;
+        }
+        lane->buf = grown;
+        lane->size = size;
+    }
+    loader->reserved = lane;
+    return lane->buf + lane->len;
+}
+
+/**
+ * Function: redis_load_commit
+ * Description: Adds the row written after redis_load_reserve to its batch
+ *              and sends the batch when it holds the batch size of rows.
+ * Parameters:
+ *   - handle: Handle from redis_load_start.
+ *   - len: Bytes written.
+ *   - commands: Number of commands written.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_load_commit(int handle, size_t len, int commands, char *sqlstate, char *msgtext)
+{
+    RedisLoader *loader = loader_for(handle);
+    LoadLane *lane;
+
+    if (loader == NULL || loader->reserved == NULL)
+    {
+        strncpy(sqlstate, "38003", 5);
+        strncpy(msgtext, "No row reserved for this load", 70);
+        return -1;
+    }
+    lane = loader->reserved;
+    loader->reserved = NULL;
+    lane->len += len;
+    lane->rows++;
+    lane->queued += commands;
+    loader->report.rows++;
+    loader->report.commands += commands;
+    if (lane->rows >= loader->batch)
+        return flush_lane(loader, lane, sqlstate, msgtext);
+    return 0;
+}
+
+/**
+ * Function: redis_load_finish
+ * Description: Sends the last batch of every lane, reads all outstanding
+ *              replies, gives the connections back and files the report.
+ *              Every lane is finished even after one of them failed.
+ * Parameters:
+ *   - handle: Handle from redis_load_start.
+ *   - sqlstate: Receives the SQLSTATE of the first failure.
+ *   - msgtext: Receives the message text of the first failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+int redis_load_finish(int handle, char *sqlstate, char *msgtext)
+{
+    RedisLoader *loader = loader_for(handle);
+    LoadLane *lane;
+    char state[6], message[71];
+    int i, rc = 0;
+
+    if (loader == NULL)
+        return 0;
+
+    // Send every batch before waiting, so the nodes work in parallel
+    for (i = 0; i < loader->lane_count; i++)
+    {
+        strcpy(state, "00000");
+        if (flush_lane(loader, &loader->lanes[i], state, message) != 0 && rc == 0)
+        {
+            memcpy(sqlstate, state, 5);
+            strcpy(msgtext, message);
+            rc = -1;
+        }
+    }
+    for (i = 0; i < loader->lane_count; i++)
+    {
+        lane = &loader->lanes[i];
+        strcpy(state, "00000");
+        if (lane->sockfd >= 0 && enter_lane(loader, lane, state, message) == 0 &&
+            drain_lane(loader, lane, 0, state, message) == 0)
+        {
+            release_redis_connection(lane->sockfd, state);
+            lane->sockfd = -1;
+        }
+        else if (state[0] != '0' && rc == 0)
+        {
+            memcpy(sqlstate, state, 5);
+            strcpy(msgtext, message);
+            rc = -1;
+        }
+        free(lane->buf);
+        free(lane->reply);
+    }
+
+    // File the report and free the slot
+    pthread_mutex_lock(&load_lock);
+    loader->report.seconds = elapsed_seconds(&loader->start);
+    if (loader->report.status == REDIS_LOAD_RUNNING)
+        loader->report.status = REDIS_LOAD_DONE;
+    history[history_count % REDIS_LOAD_HISTORY] = loader->report;
+    history_count++;
+    loaders[handle - 1] = NULL;
+    pthread_mutex_unlock(&load_lock);
+    free(loader);
+    return rc;
+}
+
+/**
+ * Function: redis_load_report
+ * Description: Returns a load of the job: the running ones first (with
+ *              their time so far), then the finished ones, newest first.
+ * Parameters:
+ *   - index: Position in that order, from 0.
+ *   - report: Receives the report.
+ * Returns:
+ *   - 0 on success, -1 past the last load.
+ */
+int redis_load_report(int index, RedisLoadReport *report)
+{
+    int slot, kept;
+
+    pthread_mutex_lock(&load_lock);
+    for (slot = 0; slot < REDIS_LOAD_SLOTS; slot++)
+    {
+        if (loaders[slot] == NULL || index-- > 0)
+            continue;
+        *report = loaders[slot]->report;
+        report->seconds = elapsed_seconds(&loaders[slot]->start);
+        pthread_mutex_unlock(&load_lock);
+        return 0;
+    }
+    kept = history_count < REDIS_LOAD_HISTORY ? history_count : REDIS_LOAD_HISTORY;
+    if (index >= kept)
+    {
+        pthread_mutex_unlock(&load_lock);
+        return -1;
+    }
+    *report = history[(history_count - 1 - index) % REDIS_LOAD_HISTORY];
+    pthread_mutex_unlock(&load_lock);
+    return 0;
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: loadRedis
+ * Description: SQL external function writing one row of a bulk load with
+ *              SET (or SETEX when a TTL is given). The row is queued and
+ *              sent with its batch; error replies are counted in the load
+ *              report instead of failing the statement. The final call of
+ *              the statement completes the load.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - value: Input value (VARCHAR(16370), EBCDIC).
+ *   - ttl: Input TTL in seconds, NULL for none.
+ *   - batch: Input rows per batch, NULL for REDIS_LOAD_BATCH; read on the
+ *     first row.
+ *   - connections: Input connections, NULL for REDIS_LOAD_CONNECTIONS;
+ *     read on the first row.
+ *   - queued: Output 1 when the row was queued.
+ *   - *Ind: Null indicators for the inputs and the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the handle of the load.
+ *   - calltype: First, normal or final call.
+ */
+void SQL_API_FN loadRedis(
+    SQLUDF_VARCHAR *key,             // Input: Redis key (EBCDIC)
+    SQLUDF_VARCHAR *value,           // Input: value (EBCDIC)
+    SQLUDF_INTEGER *ttl,             // Input: TTL in seconds
+    SQLUDF_INTEGER *batch,           // Input: rows per batch
+    SQLUDF_INTEGER *connections,     // Input: connections
+    SQLUDF_INTEGER *queued,          // Output: 1 when the row was queued
+    SQLUDF_NULLIND *keyInd,          // Null indicators for inputs
+    SQLUDF_NULLIND *valueInd,
+    SQLUDF_NULLIND *ttlInd,
+    SQLUDF_NULLIND *batchInd,
+    SQLUDF_NULLIND *connectionsInd,
+    SQLUDF_NULLIND *queuedInd,       // Null indicator for output
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,   // Handle of the load between calls
+    SQLUDF_CALL_TYPE *calltype)      // First, normal or final call
+{
+    char ttl_text[REDIS_DOUBLE_TEXT];
+    const char *args[2];
+    size_t argl[2], key_len, value_len;
+    char *buf;
+    int handle, size, len;
+
+    strcpy(sqlstate, "00000");
+    *queuedInd = -1;
+    memcpy(&handle, scratchpad->data, sizeof(handle));
+    if (*calltype == SQLUDF_FINAL_CALL)
+    {
+        redis_load_finish(handle, sqlstate, msgtext);
+        handle = 0;
+        memcpy(scratchpad->data, &handle, sizeof(handle));
+        return;
+    }
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    // Check for NULL input
+    if (*keyInd < 0 || *valueInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input key or value is NULL");
+        return;
+    }
+    if (*ttlInd >= 0 && *ttl <= 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "TTL must be positive");
+        return;
+    }
+
+    // The first row starts the load of the statement
+    if (handle <= 0)
+    {
+        if ((*batchInd >= 0 && (*batch < 1 || *batch > REDIS_LOAD_MAX_BATCH)) ||
+            (*connectionsInd >= 0 && (*connections < 1 || *connections > REDIS_MAX_ENDPOINTS)))
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Batch must be 1 to 100000 and connections 1 to 16");
+            return;
+        }
+        handle = redis_load_start(*batchInd >= 0 ? *batch : 0, *connectionsInd >= 0 ? *connections : 0);
+        if (handle < 0)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, handle == -2 ? "Too many loads running in this job" : "Out of memory for the load");
+            return;
+        }
+        memcpy(scratchpad->data, &handle, sizeof(handle));
+    }
+
+    key_len = strlen(key);
+    if (key_len > 255)
+        key_len = 255; // Truncate to match VARCHAR(255)
+    value_len = strlen(value);
+    if (value_len > 16370)
+        value_len = 16370; // Truncate to match VARCHAR(16370)
+
+    // "SET key value" or "SETEX key ttl value", written straight into the batch
+    size = (int)(key_len + value_len) + 160;
+    buf = redis_load_reserve(handle, key, key_len, size, sqlstate, msgtext);
+    if (buf == NULL)
+        return;
+    args[0] = key;
+    argl[0] = key_len;
+    args[1] = value;
+    argl[1] = value_len;
+    if (*ttlInd < 0)
+    {
+        len = format_redis_template(buf, size, REDIS_TEMPLATE(SET), 2, args, argl);
+    }
+    else
+    {
+        len = format_redis_template(buf, size, REDIS_TEMPLATE(SETEX), 1, args, argl);
+        len = append_redis_argument(buf, size, len, ttl_text, format_redis_double(*ttl, ttl_text), 1);
+        len = append_redis_argument(buf, size, len, value, value_len, 0);
+    }
+    if (len < 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Failed to convert command to ASCII");
+        return;
+    }
+    if (redis_load_commit(handle, len, 1, sqlstate, msgtext) != 0)
+        return;
+
+    *queued = 1;
+    *queuedInd = 0;
+}
+
+#pragma linkage(loadRedis, OS)
@@ -0,0 +1,105 @@
+/******************************************************************************
+ * File: redislpon.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_LPOP_N table function for IBM i.
+ *              Removes and returns up to N elements from the head of a
+ *              Redis list in one round trip (see redislmpo.c).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+/**********************************************************************/
+/* SQL External Function: LPOP with COUNT */
+/**********************************************************************/
+
+/**
+ * Function: lpopNRedisList
+ * Description: SQL external table function to pop up to N elements from
+ *              the head of a list; each element is a row, in popping
+ *              order. An empty or missing list gives no rows.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - count: Input most elements to pop.
+ *   - position: Output 1-based position in popping order.
+ *   - value: Output element (EBCDIC).
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the popped elements.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN lpopNRedisList(
+    SQLUDF_VARCHAR *key,            // Input: Redis key (EBCDIC)
+    SQLUDF_INTEGER *count,          // Input: most elements to pop
+    SQLUDF_INTEGER *position,       // Output: position in popping order
+    SQLUDF_VARCHAR *value,          // Output: element (EBCDIC)
+    SQLUDF_NULLIND *keyInd,         // Null indicators for inputs
+    SQLUDF_NULLIND *countInd,
+    SQLUDF_NULLIND *positionInd,    // Null indicators for outputs
+    SQLUDF_NULLIND *valueInd,
+    char *sqlstate,                 // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                 // Fully qualified function name
+    char *specname,                 // Specific name
+    char *msgtext,                  // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,  // Popped elements between calls
+    SQLUDF_CALL_TYPE *calltype)     // Open, fetch or close
+{
+    size_t key_len;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+#ifdef USE_ICONV
+        if (!initialized)
+        {
+            initialize_conversion();
+            initialized = 1;
+        }
+        if (errno != 0)
+        {
+            strcpy(sqlstate, "38999");
+            strcpy(msgtext, "iconv initialization failed");
+            return;
+        }
+#endif
+        if (*keyInd < 0 || *countInd < 0)
+        {
+            strcpy(sqlstate, "38001");
+            strcpy(msgtext, "Input key or count is NULL");
+            return;
+        }
+        if (*count < 1)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Input count must be positive");
+            return;
+        }
+        key_len = strlen(key);
+        redis_pop_open(1, (const char **)&key, &key_len, 1, *count, scratchpad->data, scratchpad->length,
+                       sqlstate, msgtext);
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    if (redis_pop_fetch(scratchpad->data, NULL, position, value, sqlstate, msgtext) == 0)
+    {
+        *positionInd = 0;
+        *valueInd = 0;
+    }
+}
+
+#pragma linkage(lpopNRedisList, OS)
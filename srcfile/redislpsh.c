@@ -18,6 +18,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+
 /**********************************************************************/
 /* SQL External Function: LPUSH */
 /**********************************************************************/
@@ -37,7 +39,8 @@ void SQL_API_FN lpushRedisList(
 	SQLUDF_NULLIND *nullind)
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[1024], ebcdic_payload[1024];
+	char *ebcdic_send_buf, *ascii_send_buf;
+	char recv_buf[1024];
 	char ebcdic_key_len[10] = {0}, ebcdic_value_len[10] = {0};
 	int len, total_len = 0;
 
@@ -74,15 +77,26 @@ void SQL_API_FN lpushRedisList(
 	*resultInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
 		return;
 	}
 
+	// Call buffers come from the thread's arena and are given back on release
+	ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER);
+	if (ebcdic_send_buf == NULL)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
+		*resultInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
+
 	ebcdic_send_buf[0] = '\0';
 
 	// Format key length in EBCDIC
@@ -151,35 +165,35 @@ void SQL_API_FN lpushRedisList(
 
 	// Convert to ASCII
 	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send command
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		strncpy(sqlstate, errno == EWOULDBLOCK || errno == EAGAIN ? "38904" : "38905", 5);
 		snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -187,30 +201,18 @@ void SQL_API_FN lpushRedisList(
 		strncpy(sqlstate, "38906", 5);
 		strncpy(msgtext, "Connection closed by Redis", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	// Convert response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-	{
-		strncpy(sqlstate, "38907", 5);
-		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-	ebcdic_payload[total_len] = '\0';
-
 	// Extract response (integer: list length)
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		*result = atol(payload);
+		*result = number;
 		*resultInd = 0;
 	}
 	else
@@ -220,7 +222,7 @@ void SQL_API_FN lpushRedisList(
 		*resultInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(lpushRedisList, OS)
@@ -0,0 +1,201 @@
+/******************************************************************************
+ * File: redislpshm.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the Redis LPUSH_MANY function for IBM i.
+ *              Pushes many values onto the head of a Redis list with one LPUSH
+ *              command. Returns the length of the list after the push.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+/**********************************************************************/
+/* SQL External Function: LPUSH_MANY */
+/**********************************************************************/
+
+/**
+ * Function: lpushManyRedis
+ * Description: SQL external function to push many values onto the head of a
+ *              list with one LPUSH; each goes in front of the previous one, so
+ *              VALUE40 ends up first. NULL values are left out.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - value1 .. value40: Input values (VARCHAR(4096), EBCDIC).
+ *   - result: Output length of the list (BIGINT); NULL when every value is
+ *     NULL and nothing was sent.
+ *   - *Ind: Null indicators for the inputs and the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38911" is an error
+ *     reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (not used).
+ *   - nullind: Additional null indicators (not used).
+ */
+void SQL_API_FN lpushManyRedis(
+    SQLUDF_VARCHAR *key,             // Input: Redis key (EBCDIC)
+    SQLUDF_VARCHAR *value1,          // Input: values (EBCDIC)
+    SQLUDF_VARCHAR *value2,
+    SQLUDF_VARCHAR *value3,
+    SQLUDF_VARCHAR *value4,
+    SQLUDF_VARCHAR *value5,
+    SQLUDF_VARCHAR *value6,
+    SQLUDF_VARCHAR *value7,
+    SQLUDF_VARCHAR *value8,
+    SQLUDF_VARCHAR *value9,
+    SQLUDF_VARCHAR *value10,
+    SQLUDF_VARCHAR *value11,
+    SQLUDF_VARCHAR *value12,
+    SQLUDF_VARCHAR *value13,
+    SQLUDF_VARCHAR *value14,
+    SQLUDF_VARCHAR *value15,
+    SQLUDF_VARCHAR *value16,
+    SQLUDF_VARCHAR *value17,
+    SQLUDF_VARCHAR *value18,
+    SQLUDF_VARCHAR *value19,
+    SQLUDF_VARCHAR *value20,
+    SQLUDF_VARCHAR *value21,
+    SQLUDF_VARCHAR *value22,
+    SQLUDF_VARCHAR *value23,
+    SQLUDF_VARCHAR *value24,
+    SQLUDF_VARCHAR *value25,
+    SQLUDF_VARCHAR *value26,
+    SQLUDF_VARCHAR *value27,
+    SQLUDF_VARCHAR *value28,
+    SQLUDF_VARCHAR *value29,
+    SQLUDF_VARCHAR *value30,
+    SQLUDF_VARCHAR *value31,
+    SQLUDF_VARCHAR *value32,
+    SQLUDF_VARCHAR *value33,
+    SQLUDF_VARCHAR *value34,
+    SQLUDF_VARCHAR *value35,
+    SQLUDF_VARCHAR *value36,
+    SQLUDF_VARCHAR *value37,
+    SQLUDF_VARCHAR *value38,
+    SQLUDF_VARCHAR *value39,
+    SQLUDF_VARCHAR *value40,
+    SQLUDF_BIGINT *result,           // Output: length of the list
+    SQLUDF_NULLIND *keyInd,          // Null indicators for inputs
+    SQLUDF_NULLIND *value1Ind,
+    SQLUDF_NULLIND *value2Ind,
+    SQLUDF_NULLIND *value3Ind,
+    SQLUDF_NULLIND *value4Ind,
+    SQLUDF_NULLIND *value5Ind,
+    SQLUDF_NULLIND *value6Ind,
+    SQLUDF_NULLIND *value7Ind,
+    SQLUDF_NULLIND *value8Ind,
+    SQLUDF_NULLIND *value9Ind,
+    SQLUDF_NULLIND *value10Ind,
+    SQLUDF_NULLIND *value11Ind,
+    SQLUDF_NULLIND *value12Ind,
+    SQLUDF_NULLIND *value13Ind,
+    SQLUDF_NULLIND *value14Ind,
+    SQLUDF_NULLIND *value15Ind,
+    SQLUDF_NULLIND *value16Ind,
+    SQLUDF_NULLIND *value17Ind,
+    SQLUDF_NULLIND *value18Ind,
+    SQLUDF_NULLIND *value19Ind,
+    SQLUDF_NULLIND *value20Ind,
+    SQLUDF_NULLIND *value21Ind,
+    SQLUDF_NULLIND *value22Ind,
+    SQLUDF_NULLIND *value23Ind,
+    SQLUDF_NULLIND *value24Ind,
+    SQLUDF_NULLIND *value25Ind,
+    SQLUDF_NULLIND *value26Ind,
+    SQLUDF_NULLIND *value27Ind,
+    SQLUDF_NULLIND *value28Ind,
+    SQLUDF_NULLIND *value29Ind,
+    SQLUDF_NULLIND *value30Ind,
+    SQLUDF_NULLIND *value31Ind,
+    SQLUDF_NULLIND *value32Ind,
+    SQLUDF_NULLIND *value33Ind,
+    SQLUDF_NULLIND *value34Ind,
+    SQLUDF_NULLIND *value35Ind,
+    SQLUDF_NULLIND *value36Ind,
+    SQLUDF_NULLIND *value37Ind,
+    SQLUDF_NULLIND *value38Ind,
+    SQLUDF_NULLIND *value39Ind,
+    SQLUDF_NULLIND *value40Ind,
+    SQLUDF_NULLIND *resultInd,       // Null indicator for output
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    short *sqlcode,                  // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)         // Additional null indicators for DB2SQL
+{
+    const char *values[REDIS_MANY_VALUES] = {value1, value2, value3, value4, value5, value6,
+                                             value7, value8, value9, value10, value11, value12,
+                                             value13, value14, value15, value16, value17, value18,
+                                             value19, value20, value21, value22, value23, value24,
+                                             value25, value26, value27, value28, value29, value30,
+                                             value31, value32, value33, value34, value35, value36,
+                                             value37, value38, value39, value40};
+    SQLUDF_NULLIND inds[REDIS_MANY_VALUES] = {*value1Ind, *value2Ind, *value3Ind, *value4Ind, *value5Ind,
+                                              *value6Ind, *value7Ind, *value8Ind, *value9Ind, *value10Ind,
+                                              *value11Ind, *value12Ind, *value13Ind, *value14Ind, *value15Ind,
+                                              *value16Ind, *value17Ind, *value18Ind, *value19Ind, *value20Ind,
+                                              *value21Ind, *value22Ind, *value23Ind, *value24Ind, *value25Ind,
+                                              *value26Ind, *value27Ind, *value28Ind, *value29Ind, *value30Ind,
+                                              *value31Ind, *value32Ind, *value33Ind, *value34Ind, *value35Ind,
+                                              *value36Ind, *value37Ind, *value38Ind, *value39Ind, *value40Ind};
+    const char *argv[REDIS_MANY_VALUES + 2];
+    size_t argl[REDIS_MANY_VALUES + 2];
+    long long number;
+    int argc = 2, i;
+
+    strcpy(sqlstate, "00000");
+    *resultInd = -1;
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    if (*keyInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input key is NULL");
+        return;
+    }
+
+    // LPUSH key value [value ...]
+    argv[0] = "\xD3\xD7\xE4\xE2\xC8"; // EBCDIC "LPUSH"
+    argl[0] = 5;
+    argv[1] = key;
+    argl[1] = strlen(key);
+    for (i = 0; i < REDIS_MANY_VALUES; i++)
+    {
+        if (inds[i] < 0)
+            continue; // NULL is left out
+        argv[argc] = values[i];
+        argl[argc++] = strlen(values[i]);
+    }
+    if (argc == 2)
+        return; // Nothing to write: the length is not known, NULL
+
+    if (redis_write_many(argc, argv, argl, 0, &number, sqlstate, msgtext) == 1)
+    {
+        *result = number;
+        *resultInd = 0;
+    }
+}
+
+#pragma linkage(lpushManyRedis, OS)
@@ -19,6 +19,9 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+#define REPLY_BUFFER 32000 // Size of each receive buffer
+
 /**********************************************************************/
 /* Helper: Parse RESP array for MGET (handles nil bulk strings)       */
 /**********************************************************************/
@@ -134,8 +137,8 @@ void SQL_API_FN mgetRedisValues(
     SQLUDF_NULLIND *nullind)
 {
     int sockfd;
-    char ebcdic_send_buf[33000], ascii_send_buf[33000];
-    char recv_buf[32000], ebcdic_response[32000];
+    char *ebcdic_send_buf, *ascii_send_buf;
+    char *recv_buf, *ebcdic_response;
     int len, total_len = 0;
 
 #ifdef USE_ICONV
@@ -170,7 +173,7 @@ void SQL_API_FN mgetRedisValues(
     // Parse comma-separated keys to count them and store pointers
     // EBCDIC comma = 0x6B
     char *key_ptrs[256];  // Max 256 keys
-    int key_lens[256];
+    size_t key_lens[256];
     int key_count = 0;
     char *start = keys;
     char *p = keys;
@@ -202,111 +205,159 @@ void SQL_API_FN mgetRedisValues(
         return;
     }
 
-    // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    // Call buffers come from the thread's arena and are given back on release
+    ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER + 2 * REPLY_BUFFER);
+    if (ebcdic_send_buf == NULL)
     {
-        strcpy(sqlstate, "38901");
-        strcpy(msgtext, "Failed to connect to Redis");
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for call buffers");
         *valueInd = -1;
         return;
     }
+    ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
+    recv_buf = ascii_send_buf + SEND_BUFFER;
+    ebcdic_response = recv_buf + REPLY_BUFFER;
 
-    // Build RESP command: *<N+1>\r\n$4\r\nMGET\r\n then for each key: $<keylen>\r\n<key>\r\n
-    ebcdic_send_buf[0] = '\0';
-
-    // Format N+1 (total args = key_count + 1 for MGET command)
-    int total_args = key_count + 1;
-    char ebcdic_total[10] = {0};
-    if (total_args < 10)
-    {
-        ebcdic_total[0] = 0xF0 + total_args;
-        ebcdic_total[1] = '\0';
-    }
-    else
+    if (redis_sharding_enabled())
     {
-        int i = 0, temp_len = total_args;
-        while (temp_len > 0)
+        // Keys may live on different nodes: split by hash slot and fan out
+        sockfd = -1;
+        len = fanout_redis_command("\xD4\xC7\xC5\xE3", 4, 1, key_count, (const char **)key_ptrs, key_lens,
+                                   recv_buf, REPLY_BUFFER - 1); // EBCDIC "MGET"
+        if (len == -2)
+        {
+            strcpy(sqlstate, "38901");
+            strcpy(msgtext, "Failed to connect to Redis");
+            *valueInd = -1;
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+        else if (len == -3)
         {
-            ebcdic_total[i++] = 0xF0 + (temp_len % 10);
-            temp_len /= 10;
+            strcpy(sqlstate, "38903");
+            strcpy(msgtext, "Failed to send command to Redis");
+            *valueInd = -1;
+            release_redis_connection(-1, sqlstate);
+            return;
         }
-        ebcdic_total[i] = '\0';
-        for (int j = 0; j < i / 2; j++)
+        else if (len == -4)
         {
-            char tmp = ebcdic_total[j];
-            ebcdic_total[j] = ebcdic_total[i - 1 - j];
-            ebcdic_total[i - 1 - j] = tmp;
+            strcpy(sqlstate, "38908");
+            strcpy(msgtext, "Response exceeds maximum length");
+            *valueInd = -1;
+            release_redis_connection(-1, sqlstate);
+            return;
         }
     }
-
-    // *<N+1>\r\n
-    strcat(ebcdic_send_buf, "\x5C");           // *
-    strcat(ebcdic_send_buf, ebcdic_total);
-    strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-    // $4\r\nMGET\r\n
-    strcat(ebcdic_send_buf, "\x5B\xF4\x0D\x25\xD4\xC7\xC5\xE3\x0D\x25"); // $4\r\nMGET\r\n
-
-    // For each key: $<keylen>\r\n<key>\r\n
-    int k;
-    for (k = 0; k < key_count; k++)
+    else
     {
-        char ebcdic_key_len[10] = {0};
-        int kl = key_lens[k];
+        // Connect to Redis
+        if (connect_to_redis_read(&sockfd) != 0)
+        {
+            strcpy(sqlstate, "38901");
+            strcpy(msgtext, "Failed to connect to Redis");
+            *valueInd = -1;
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
 
-        if (kl < 10)
+        // Build RESP command: *<N+1>\r\n$4\r\nMGET\r\n then for each key: $<keylen>\r\n<key>\r\n
+        ebcdic_send_buf[0] = '\0';
+
+        // Format N+1 (total args = key_count + 1 for MGET command)
+        int total_args = key_count + 1;
+        char ebcdic_total[10] = {0};
+        if (total_args < 10)
         {
-            ebcdic_key_len[0] = 0xF0 + kl;
-            ebcdic_key_len[1] = '\0';
+            ebcdic_total[0] = 0xF0 + total_args;
+            ebcdic_total[1] = '\0';
         }
         else
         {
-            int i = 0, temp_len = kl;
+            int i = 0, temp_len = total_args;
             while (temp_len > 0)
             {
-                ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
+                ebcdic_total[i++] = 0xF0 + (temp_len % 10);
                 temp_len /= 10;
             }
-            ebcdic_key_len[i] = '\0';
+            ebcdic_total[i] = '\0';
             for (int j = 0; j < i / 2; j++)
             {
-                char tmp = ebcdic_key_len[j];
-                ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
-                ebcdic_key_len[i - 1 - j] = tmp;
+                char tmp = ebcdic_total[j];
+                ebcdic_total[j] = ebcdic_total[i - 1 - j];
+                ebcdic_total[i - 1 - j] = tmp;
             }
         }
 
-        strcat(ebcdic_send_buf, "\x5B");           // $
-        strcat(ebcdic_send_buf, ebcdic_key_len);
-        strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-        strncat(ebcdic_send_buf, key_ptrs[k], kl);
+        // *<N+1>\r\n
+        strcat(ebcdic_send_buf, "\x5C");           // *
+        strcat(ebcdic_send_buf, ebcdic_total);
         strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-    }
+        // $4\r\nMGET\r\n
+        strcat(ebcdic_send_buf, "\x5B\xF4\x0D\x25\xD4\xC7\xC5\xE3\x0D\x25"); // $4\r\nMGET\r\n
 
-    // Convert to ASCII
-    size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-    if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
-    {
-        strcpy(sqlstate, "38902");
-        strcpy(msgtext, "Failed to convert command to ASCII");
-        *valueInd = -1;
-        close(sockfd);
-        return;
-    }
-    ascii_send_buf[ebcdic_len_size] = '\0';
+        // For each key: $<keylen>\r\n<key>\r\n
+        int k;
+        for (k = 0; k < key_count; k++)
+        {
+            char ebcdic_key_len[10] = {0};
+            int kl = key_lens[k];
 
-    // Send command
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
-    if (len < 0)
-    {
-        strcpy(sqlstate, "38903");
-        strcpy(msgtext, "Failed to send command to Redis");
-        *valueInd = -1;
-        close(sockfd);
-        return;
-    }
+            if (kl < 10)
+            {
+                ebcdic_key_len[0] = 0xF0 + kl;
+                ebcdic_key_len[1] = '\0';
+            }
+            else
+            {
+                int i = 0, temp_len = kl;
+                while (temp_len > 0)
+                {
+                    ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
+                    temp_len /= 10;
+                }
+                ebcdic_key_len[i] = '\0';
+                for (int j = 0; j < i / 2; j++)
+                {
+                    char tmp = ebcdic_key_len[j];
+                    ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
+                    ebcdic_key_len[i - 1 - j] = tmp;
+                }
+            }
+
+            strcat(ebcdic_send_buf, "\x5B");           // $
+            strcat(ebcdic_send_buf, ebcdic_key_len);
+            strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
+            strncat(ebcdic_send_buf, key_ptrs[k], kl);
+            strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
+        }
+
+        // Convert to ASCII
+        size_t ebcdic_len_size = strlen(ebcdic_send_buf);
+        if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, "Failed to convert command to ASCII");
+            *valueInd = -1;
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
+        ascii_send_buf[ebcdic_len_size] = '\0';
 
-    // Receive response
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+        // Send command
+        len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
+        if (len < 0)
+        {
+            strcpy(sqlstate, "38903");
+            strcpy(msgtext, "Failed to send command to Redis");
+            *valueInd = -1;
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
+
+        // Receive response
+        len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
+    }
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -320,7 +371,7 @@ void SQL_API_FN mgetRedisValues(
             strcpy(msgtext, "Failed to receive data from Redis");
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -328,19 +379,19 @@ void SQL_API_FN mgetRedisValues(
         strcpy(sqlstate, "38906");
         strcpy(msgtext, "Connection closed by Redis");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     total_len = len;
     recv_buf[total_len] = '\0';
 
     // Convert response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, sizeof(ebcdic_response) - 1) < 0)
+    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, REPLY_BUFFER - 1) < 0)
     {
         strcpy(sqlstate, "38907");
         strcpy(msgtext, "Failed to convert response to EBCDIC");
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_response[total_len] = '\0';
@@ -366,7 +417,7 @@ void SQL_API_FN mgetRedisValues(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(mgetRedisValues, OS)
@@ -19,6 +19,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+
 /**********************************************************************/
 /* SQL External Function: MSET                                        */
 /**********************************************************************/
@@ -36,7 +38,7 @@ void SQL_API_FN msetRedisValues(
     SQLUDF_NULLIND *nullind)
 {
     int sockfd;
-    char ebcdic_send_buf[33000], ascii_send_buf[33000];
+    char *ebcdic_send_buf, *ascii_send_buf;
     char recv_buf[1024], ebcdic_payload[1024];
     int len, total_len = 0;
 
@@ -139,140 +141,184 @@ void SQL_API_FN msetRedisValues(
         vlens[k] = pair_lens[k] - klens[k] - 1;
     }
 
-    // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
-    {
-        strncpy(sqlstate, "38901", 5);
-        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
-        *responseInd = -1;
-        close(sockfd);
-        return;
-    }
-
-    // Build RESP command: *<2N+1>\r\n$4\r\nMSET\r\n then for each pair: $<klen>\r\n<key>\r\n$<vlen>\r\n<value>\r\n
-    ebcdic_send_buf[0] = '\0';
-
-    // Format 2*N+1 (total args = 2*pair_count + 1 for MSET command)
-    int total_args = 2 * pair_count + 1;
-    char ebcdic_total[10] = {0};
-    if (total_args < 10)
+    if (redis_sharding_enabled())
     {
-        ebcdic_total[0] = 0xF0 + total_args;
-        ebcdic_total[1] = '\0';
+        // Keys may live on different nodes: split by hash slot and fan out
+        const char *fan_argv[512];
+        size_t fan_argl[512];
+        for (k = 0; k < pair_count; k++)
+        {
+            fan_argv[2 * k] = keys[k];
+            fan_argl[2 * k] = klens[k];
+            fan_argv[2 * k + 1] = vals[k];
+            fan_argl[2 * k + 1] = vlens[k];
+        }
+        sockfd = -1;
+        len = fanout_redis_command("\xD4\xE2\xC5\xE3", 4, 2, 2 * pair_count, fan_argv, fan_argl,
+                                   recv_buf, sizeof(recv_buf) - 1); // EBCDIC "MSET"
+        if (len == -2)
+        {
+            strncpy(sqlstate, "38901", 5);
+            snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+            *responseInd = -1;
+            return;
+        }
+        else if (len == -3 || len == -4)
+        {
+            strncpy(sqlstate, "38903", 5);
+            snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+            *responseInd = -1;
+            return;
+        }
     }
     else
     {
-        int i = 0, temp_len = total_args;
-        while (temp_len > 0)
+        // Connect to Redis
+        if (connect_to_redis(&sockfd) != 0)
         {
-            ebcdic_total[i++] = 0xF0 + (temp_len % 10);
-            temp_len /= 10;
+            strncpy(sqlstate, "38901", 5);
+            snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+            *responseInd = -1;
+            return;
         }
-        ebcdic_total[i] = '\0';
-        for (int j = 0; j < i / 2; j++)
+
+        // Call buffers come from the thread's arena and are given back on release
+        ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER);
+        if (ebcdic_send_buf == NULL)
         {
-            char tmp = ebcdic_total[j];
-            ebcdic_total[j] = ebcdic_total[i - 1 - j];
-            ebcdic_total[i - 1 - j] = tmp;
+            strncpy(sqlstate, "38902", 5);
+            strncpy(msgtext, "Out of memory for call buffers", 70);
+            *responseInd = -1;
+            release_redis_connection(sockfd, sqlstate);
+            return;
         }
-    }
+        ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
 
-    // *<2N+1>\r\n
-    strcat(ebcdic_send_buf, "\x5C");           // *
-    strcat(ebcdic_send_buf, ebcdic_total);
-    strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-    // $4\r\nMSET\r\n
-    strcat(ebcdic_send_buf, "\x5B\xF4\x0D\x25\xD4\xE2\xC5\xE3\x0D\x25"); // $4\r\nMSET\r\n
+        // Build RESP command: *<2N+1>\r\n$4\r\nMSET\r\n then for each pair: $<klen>\r\n<key>\r\n$<vlen>\r\n<value>\r\n
+        ebcdic_send_buf[0] = '\0';
 
-    // For each pair: $<klen>\r\n<key>\r\n$<vlen>\r\n<value>\r\n
-    for (k = 0; k < pair_count; k++)
-    {
-        // Format key length
-        char ebcdic_key_len[10] = {0};
-        int kl = klens[k];
-        if (kl < 10)
+        // Format 2*N+1 (total args = 2*pair_count + 1 for MSET command)
+        int total_args = 2 * pair_count + 1;
+        char ebcdic_total[10] = {0};
+        if (total_args < 10)
         {
-            ebcdic_key_len[0] = 0xF0 + kl;
-            ebcdic_key_len[1] = '\0';
+            ebcdic_total[0] = 0xF0 + total_args;
+            ebcdic_total[1] = '\0';
         }
         else
         {
-            int i = 0, temp_len = kl;
+            int i = 0, temp_len = total_args;
             while (temp_len > 0)
             {
-                ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
+                ebcdic_total[i++] = 0xF0 + (temp_len % 10);
                 temp_len /= 10;
             }
-            ebcdic_key_len[i] = '\0';
+            ebcdic_total[i] = '\0';
             for (int j = 0; j < i / 2; j++)
             {
-                char tmp = ebcdic_key_len[j];
-                ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
-                ebcdic_key_len[i - 1 - j] = tmp;
+                char tmp = ebcdic_total[j];
+                ebcdic_total[j] = ebcdic_total[i - 1 - j];
+                ebcdic_total[i - 1 - j] = tmp;
             }
         }
 
-        // Format value length
-        char ebcdic_val_len[10] = {0};
-        int vl = vlens[k];
-        if (vl < 10)
-        {
-            ebcdic_val_len[0] = 0xF0 + vl;
-            ebcdic_val_len[1] = '\0';
-        }
-        else
+        // *<2N+1>\r\n
+        strcat(ebcdic_send_buf, "\x5C");           // *
+        strcat(ebcdic_send_buf, ebcdic_total);
+        strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
+        // $4\r\nMSET\r\n
+        strcat(ebcdic_send_buf, "\x5B\xF4\x0D\x25\xD4\xE2\xC5\xE3\x0D\x25"); // $4\r\nMSET\r\n
+
+        // For each pair: $<klen>\r\n<key>\r\n$<vlen>\r\n<value>\r\n
+        for (k = 0; k < pair_count; k++)
         {
-            int i = 0, temp_len = vl;
-            while (temp_len > 0)
+            // Format key length
+            char ebcdic_key_len[10] = {0};
+            int kl = klens[k];
+            if (kl < 10)
             {
-                ebcdic_val_len[i++] = 0xF0 + (temp_len % 10);
-                temp_len /= 10;
+                ebcdic_key_len[0] = 0xF0 + kl;
+                ebcdic_key_len[1] = '\0';
             }
-            ebcdic_val_len[i] = '\0';
-            for (int j = 0; j < i / 2; j++)
+            else
+            {
+                int i = 0, temp_len = kl;
+                while (temp_len > 0)
+                {
+                    ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
+                    temp_len /= 10;
+                }
+                ebcdic_key_len[i] = '\0';
+                for (int j = 0; j < i / 2; j++)
+                {
+                    char tmp = ebcdic_key_len[j];
+                    ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
+                    ebcdic_key_len[i - 1 - j] = tmp;
+                }
+            }
+
+            // Format value length
+            char ebcdic_val_len[10] = {0};
+            int vl = vlens[k];
+            if (vl < 10)
+            {
+                ebcdic_val_len[0] = 0xF0 + vl;
+                ebcdic_val_len[1] = '\0';
+            }
+            else
             {
-                char tmp = ebcdic_val_len[j];
-                ebcdic_val_len[j] = ebcdic_val_len[i - 1 - j];
-                ebcdic_val_len[i - 1 - j] = tmp;
+                int i = 0, temp_len = vl;
+                while (temp_len > 0)
+                {
+                    ebcdic_val_len[i++] = 0xF0 + (temp_len % 10);
+                    temp_len /= 10;
+                }
+                ebcdic_val_len[i] = '\0';
+                for (int j = 0; j < i / 2; j++)
+                {
+                    char tmp = ebcdic_val_len[j];
+                    ebcdic_val_len[j] = ebcdic_val_len[i - 1 - j];
+                    ebcdic_val_len[i - 1 - j] = tmp;
+                }
             }
+
+            strcat(ebcdic_send_buf, "\x5B");           // $
+            strcat(ebcdic_send_buf, ebcdic_key_len);
+            strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
+            strncat(ebcdic_send_buf, keys[k], kl);
+            strcat(ebcdic_send_buf, "\x0D\x25\x5B");   // \r\n$
+            strcat(ebcdic_send_buf, ebcdic_val_len);
+            strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
+            strncat(ebcdic_send_buf, vals[k], vl);
+            strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
         }
 
-        strcat(ebcdic_send_buf, "\x5B");           // $
-        strcat(ebcdic_send_buf, ebcdic_key_len);
-        strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-        strncat(ebcdic_send_buf, keys[k], kl);
-        strcat(ebcdic_send_buf, "\x0D\x25\x5B");   // \r\n$
-        strcat(ebcdic_send_buf, ebcdic_val_len);
-        strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-        strncat(ebcdic_send_buf, vals[k], vl);
-        strcat(ebcdic_send_buf, "\x0D\x25");       // \r\n
-    }
+        // Convert EBCDIC command to ASCII before sending
+        size_t ebcdic_len_size = strlen(ebcdic_send_buf);
+        if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
+        {
+            strncpy(sqlstate, "38902", 5);
+            strncpy(msgtext, "Failed to convert command to ASCII", 70);
+            *responseInd = -1;
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
+        ascii_send_buf[ebcdic_len_size] = '\0';
 
-    // Convert EBCDIC command to ASCII before sending
-    size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-    if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
-    {
-        strncpy(sqlstate, "38902", 5);
-        strncpy(msgtext, "Failed to convert command to ASCII", 70);
-        *responseInd = -1;
-        close(sockfd);
-        return;
-    }
-    ascii_send_buf[ebcdic_len_size] = '\0';
+        // Send MSET command to Redis
+        len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
+        if (len < 0)
+        {
+            strncpy(sqlstate, "38903", 5);
+            snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+            *responseInd = -1;
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
 
-    // Send MSET command to Redis
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
-    if (len < 0)
-    {
-        strncpy(sqlstate, "38903", 5);
-        snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
-        *responseInd = -1;
-        close(sockfd);
-        return;
+        // Receive response from Redis
+        len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
     }
-
-    // Receive response from Redis
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -286,7 +332,7 @@ void SQL_API_FN msetRedisValues(
             snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
         }
         *responseInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -294,7 +340,7 @@ void SQL_API_FN msetRedisValues(
         strncpy(sqlstate, "38906", 5);
         snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
         *responseInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
@@ -307,7 +353,7 @@ void SQL_API_FN msetRedisValues(
         strncpy(sqlstate, "38907", 5);
         strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
         *responseInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_payload[total_len] = '\0';
@@ -333,11 +379,11 @@ void SQL_API_FN msetRedisValues(
     else
     {
         strncpy(sqlstate, "38909", 5);
-        snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+        snprintf(msgtext, 70, "Failed to extract payload from Redis reply: %.20s...", ebcdic_payload);
         *responseInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(msetRedisValues, OS)
@@ -0,0 +1,1391 @@
+/******************************************************************************
+ * File: redisperf.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: End-to-end round-trip benchmark for the REDISILE UDFs.
+ *              Calls the SQL entry points (getRedisValue, setRedisValue,
+ *              mgetRedisValues, scanRedisKeys, ...) directly, so every
+ *              operation pays for command building, conversion, the socket
+ *              round trip and reply parsing, exactly like a SQL call minus
+ *              the Db2 invocation overhead.
+ *
+ *              For each command, value size and concurrency level it
+ *              reports ops/s and p50/p90/p99/p99.9 latency, as a table or
+ *              as CSV/JSON lines for regression tracking. On Linux it
+ *              also counts the malloc/calloc/realloc calls made per
+ *              operation (the UDF path should make none after warm-up).
+ *
+ *              With -W it runs YCSB-style mixed workloads instead (presets
+ *              A-F plus counter, queue and leaderboard patterns) for a fixed
+ *              duration and reports per-operation latency histograms.
+ *
+ *              IBM i:  gmake perf, then CALL REDIS400/REDISPERF PARM('-f' 'csv')
+ *              Linux:  gmake perf-linux, then ./redisperf -f json
+ *              The server is the one configured in .env (REDIS_IP/REDIS_PORT).
+ *              Keys are written under the "perf:" prefix.
+ *
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+/**********************************************************************/
+/* UDF Entry Points (exported by REDISILE) */
+/**********************************************************************/
+
+#define UDF_TAIL char *sqlstate, char *funcname, char *specname, char *msgtext, \
+                 short *sqlcode, SQLUDF_NULLIND *nullind
+
+void SQL_API_FN getRedisValue(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *value,
+                              SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN setRedisValue(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *value, SQLUDF_VARCHAR *response,
+                              SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd,
+                              SQLUDF_NULLIND *responseInd, UDF_TAIL);
+void SQL_API_FN mgetRedisValues(SQLUDF_VARCHAR *keys, SQLUDF_VARCHAR *value,
+                                SQLUDF_NULLIND *keysInd, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN msetRedisValues(SQLUDF_VARCHAR *kvpairs, SQLUDF_VARCHAR *response,
+                                SQLUDF_NULLIND *kvpairsInd, SQLUDF_NULLIND *responseInd, UDF_TAIL);
+void SQL_API_FN hsetRedisValue(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *field, SQLUDF_VARCHAR *value,
+                               SQLUDF_BIGINT *result, SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *fieldInd,
+                               SQLUDF_NULLIND *valueInd, SQLUDF_NULLIND *resultInd, UDF_TAIL);
+void SQL_API_FN hgetRedisValue(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *field, SQLUDF_VARCHAR *value,
+                               SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *fieldInd,
+                               SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN lpushRedisList(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *value, SQLUDF_BIGINT *result,
+                               SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd,
+                               SQLUDF_NULLIND *resultInd, UDF_TAIL);
+void SQL_API_FN rpopRedisList(SQLUDF_VARCHAR *key, SQLUDF_VARCHAR *value,
+                              SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN incrbyRedisValue(SQLUDF_VARCHAR *key, SQLUDF_BIGINT *increment, SQLUDF_BIGINT *result,
+                                 SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *incrInd,
+                                 SQLUDF_NULLIND *resultInd, UDF_TAIL);
+void SQL_API_FN zrangeRedisSSet(SQLUDF_VARCHAR *key, SQLUDF_INTEGER *start, SQLUDF_INTEGER *stop,
+                                SQLUDF_VARCHAR *value, SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *startInd,
+                                SQLUDF_NULLIND *stopInd, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN incrRedisValue(SQLUDF_VARCHAR *key, SQLUDF_BIGINT *value,
+                               SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN zaddRedisSortedSet(SQLUDF_VARCHAR *key, SQLUDF_DOUBLE *score, SQLUDF_VARCHAR *member,
+                                   SQLUDF_BIGINT *result, SQLUDF_NULLIND *keyInd, SQLUDF_NULLIND *scoreInd,
+                                   SQLUDF_NULLIND *memberInd, SQLUDF_NULLIND *resultInd, UDF_TAIL);
+void SQL_API_FN scanRedisKeys(SQLUDF_VARCHAR *cursor, SQLUDF_VARCHAR *pattern, SQLUDF_INTEGER *count,
+                              SQLUDF_VARCHAR *value, SQLUDF_NULLIND *cursorInd, SQLUDF_NULLIND *patternInd,
+                              SQLUDF_NULLIND *countInd, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+void SQL_API_FN pingRedis(SQLUDF_VARCHAR *value, SQLUDF_NULLIND *valueInd, UDF_TAIL);
+
+/**********************************************************************/
+/* Allocation Counter (glibc only) */
+/**********************************************************************/
+
+#ifdef __GLIBC__
+// The benchmark is linked with the UDF sources, so these definitions take
+// the place of the C library's for the whole program and count the calls
+// each thread makes.
+#define PERF_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread long perf_allocs;
+
+void *malloc(size_t size)
+{
+    perf_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    perf_allocs++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    perf_allocs++;
+    return __libc_realloc(ptr, size);
+}
+#else
+#define PERF_COUNT_ALLOCS 0
+static long perf_allocs; // Not counted: stays 0
+#endif
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+#define PERF_MAX_VALUE 16370 // VARCHAR(16370) limit of the UDF parameters
+#define PERF_BATCH 10        // Keys per MGET/MSET call
+#define PERF_MAX_LEVELS 16   // Entries in the -s and -c lists
+
+typedef struct
+{
+    int id;            // Thread number (0..concurrency-1)
+    int concurrency;   // Threads in this run
+    long ops;          // Timed operations per thread
+    long warmup;       // Untimed operations per thread
+    long keyspace;     // Distinct keys touched
+    size_t size;       // Value size in bytes
+    const struct PerfCommand *command;
+    unsigned int *latency; // Microseconds per timed operation
+    long errors;
+    long allocs;           // Allocations made by timed operations
+    char error_state[6];
+    char error_text[71];
+
+    // Inputs (job CCSID), rebuilt before every call
+    char key[64];
+    char field[32];
+    char value[PERF_MAX_VALUE + 1];
+    char batch[PERF_MAX_VALUE + 1];
+    SQLUDF_DOUBLE score;
+    SQLUDF_BIGINT increment;
+    SQLUDF_INTEGER range[2];
+
+    // UDF outputs and SQL status
+    char output[PERF_MAX_VALUE + 1];
+    SQLUDF_BIGINT number;
+    SQLUDF_NULLIND in_ind[4];
+    SQLUDF_NULLIND out_ind;
+    char sqlstate[6];
+    char funcname[140];
+    char specname[129];
+    char msgtext[71];
+    short sqlcode;
+    SQLUDF_NULLIND nullind;
+
+    // Workload mode (-W)
+    const struct PerfWorkload *workload;
+    struct PerfHistogram *histogram; // One per workload operation
+    unsigned long long random;       // xorshift64* state
+    size_t value_len;                // Current terminator position in value
+} PerfThread;
+
+typedef struct PerfCommand
+{
+    const char *name;
+    int sized;                               // 1 = runs once per value size
+    int batch;                               // Values carried per call
+    void (*prepare)(PerfThread *t, long n);  // Builds the inputs (not timed)
+    void (*call)(PerfThread *t);             // Calls the UDF (timed)
+} PerfCommand;
+
+/**********************************************************************/
+/* Input Helpers */
+/**********************************************************************/
+
+/**
+ * Function: to_job_ccsid
+ * Description: Copies a native string into a UDF input buffer. On IBM i the
+ *              driver already runs in the job CCSID; on Linux the UDFs expect
+ *              EBCDIC, so the string is translated.
+ */
+static void to_job_ccsid(const char *native, size_t len, char *out)
+{
+#ifdef __OS400__
+    memcpy(out, native, len);
+#else
+    ConvertToEBCDIC((char *)native, len, out, len);
+#endif
+    out[len] = '\0';
+}
+
+static void make_key(PerfThread *t, const char *prefix, long n)
+{
+    char native[64];
+    int len = sprintf(native, "%s%ld", prefix, n);
+    to_job_ccsid(native, len, t->key);
+}
+
+static long key_number(PerfThread *t, long n)
+{
+    return (n * t->concurrency + t->id) % t->keyspace;
+}
+
+/**********************************************************************/
+/* Commands */
+/**********************************************************************/
+
+static void prepare_string(PerfThread *t, long n)
+{
+    make_key(t, "perf:key:", key_number(t, n));
+}
+
+static void prepare_hash(PerfThread *t, long n)
+{
+    make_key(t, "perf:hash:", key_number(t, n));
+}
+
+static void prepare_list(PerfThread *t, long n)
+{
+    make_key(t, "perf:list:", t->id);
+}
+
+static void prepare_counter(PerfThread *t, long n)
+{
+    make_key(t, "perf:counter:", t->id);
+}
+
+static void prepare_zset(PerfThread *t, long n)
+{
+    char native[32];
+    int len = sprintf(native, "m%ld", key_number(t, n));
+    to_job_ccsid("perf:zset", 9, t->key);
+    to_job_ccsid(native, len, t->value);
+    t->score = (double)n;
+}
+
+static void prepare_none(PerfThread *t, long n)
+{
+}
+
+/**
+ * Function: build_batch
+ * Description: Builds "k1,k2,..." (MGET) or "k1=v,k2=v,..." (MSET) for
+ *              count consecutive keys.
+ */
+static void build_batch(PerfThread *t, const char *prefix, long first, int count, int with_values)
+{
+    char native[PERF_MAX_VALUE + 1];
+    size_t pos = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (i > 0)
+            native[pos++] = ',';
+        pos += sprintf(native + pos, "%s%ld", prefix, (first + i) % t->keyspace);
+        if (with_values)
+        {
+            native[pos++] = '=';
+            memset(native + pos, 'x', t->size);
+            pos += t->size;
+        }
+    }
+    to_job_ccsid(native, pos, t->batch);
+}
+
+static void prepare_mget(PerfThread *t, long n)
+{
+    build_batch(t, "perf:key:", key_number(t, n), PERF_BATCH, 0);
+}
+
+static void prepare_mset(PerfThread *t, long n)
+{
+    build_batch(t, "perf:key:", key_number(t, n), PERF_BATCH, 1);
+}
+
+#define STATUS t->sqlstate, t->funcname, t->specname, t->msgtext, &t->sqlcode, &t->nullind
+
+static void call_set(PerfThread *t)
+{
+    setRedisValue(t->key, t->value, t->output, &t->in_ind[0], &t->in_ind[1], &t->out_ind, STATUS);
+}
+
+static void call_get(PerfThread *t)
+{
+    getRedisValue(t->key, t->output, &t->in_ind[0], &t->out_ind, STATUS);
+}
+
+static void call_mset(PerfThread *t)
+{
+    msetRedisValues(t->batch, t->output, &t->in_ind[0], &t->out_ind, STATUS);
+}
+
+static void call_mget(PerfThread *t)
+{
+    mgetRedisValues(t->batch, t->output, &t->in_ind[0], &t->out_ind, STATUS);
+}
+
+static void call_hset(PerfThread *t)
+{
+    hsetRedisValue(t->key, t->field, t->value, &t->number,
+                   &t->in_ind[0], &t->in_ind[1], &t->in_ind[2], &t->out_ind, STATUS);
+}
+
+static void call_hget(PerfThread *t)
+{
+    hgetRedisValue(t->key, t->field, t->output, &t->in_ind[0], &t->in_ind[1], &t->out_ind, STATUS);
+}
+
+static void call_lpush(PerfThread *t)
+{
+    lpushRedisList(t->key, t->value, &t->number, &t->in_ind[0], &t->in_ind[1], &t->out_ind, STATUS);
+}
+
+static void call_rpop(PerfThread *t)
+{
+    rpopRedisList(t->key, t->output, &t->in_ind[0], &t->out_ind, STATUS);
+}
+
+static void call_incr(PerfThread *t)
+{
+    incrRedisValue(t->key, &t->number, &t->in_ind[0], &t->out_ind, STATUS);
+}
+
+static void call_incrby(PerfThread *t)
+{
+    incrbyRedisValue(t->key, &t->increment, &t->number, &t->in_ind[0], &t->in_ind[1], &t->out_ind, STATUS);
+}
+
+static void call_zrange(PerfThread *t)
+{
+    zrangeRedisSSet(t->key, &t->range[0], &t->range[1], t->output,
+                    &t->in_ind[0], &t->in_ind[1], &t->in_ind[2], &t->out_ind, STATUS);
+}
+
+static void call_zadd(PerfThread *t)
+{
+    zaddRedisSortedSet(t->key, &t->score, t->value, &t->number,
+                       &t->in_ind[0], &t->in_ind[1], &t->in_ind[2], &t->out_ind, STATUS);
+}
+
+static void call_scan(PerfThread *t)
+{
+    char cursor[2], pattern[16];
+    SQLUDF_INTEGER count = 100;
+
+    to_job_ccsid("0", 1, cursor);
+    to_job_ccsid("perf:key:*", 10, pattern);
+    scanRedisKeys(cursor, pattern, &count, t->output,
+                  &t->in_ind[0], &t->in_ind[1], &t->in_ind[2], &t->out_ind, STATUS);
+}
+
+static void call_ping(PerfThread *t)
+{
+    pingRedis(t->output, &t->out_ind, STATUS);
+}
+
+// Default order matters: get/mget/hget read what set/mset/hset wrote,
+// rpop drains what lpush pushed.
+static const PerfCommand commands[] = {
+    {"set", 1, 1, prepare_string, call_set},
+    {"get", 1, 1, prepare_string, call_get},
+    {"mset", 1, PERF_BATCH, prepare_mset, call_mset},
+    {"mget", 1, PERF_BATCH, prepare_mget, call_mget},
+    {"hset", 1, 1, prepare_hash, call_hset},
+    {"hget", 1, 1, prepare_hash, call_hget},
+    {"lpush", 1, 1, prepare_list, call_lpush},
+    {"rpop", 1, 1, prepare_list, call_rpop},
+    {"incr", 0, 1, prepare_counter, call_incr},
+    {"zadd", 0, 1, prepare_zset, call_zadd},
+    {"scan", 0, 1, prepare_none, call_scan},
+    {"ping", 0, 1, prepare_none, call_ping},
+};
+#define COMMAND_COUNT (int)(sizeof(commands) / sizeof(commands[0]))
+
+/**********************************************************************/
+/* Runner */
+/**********************************************************************/
+
+static unsigned int elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (unsigned int)((end->tv_sec - start->tv_sec) * 1000000L + (end->tv_usec - start->tv_usec));
+}
+
+static void *perf_thread(void *arg)
+{
+    PerfThread *t = (PerfThread *)arg;
+    const PerfCommand *cmd = t->command;
+    struct timeval start, end;
+    long n, allocs;
+
+    for (n = -t->warmup; n < t->ops; n++)
+    {
+        cmd->prepare(t, n < 0 ? -n : n);
+        allocs = perf_allocs;
+        gettimeofday(&start, NULL);
+        cmd->call(t);
+        gettimeofday(&end, NULL);
+        if (n < 0)
+            continue;
+
+        t->allocs += perf_allocs - allocs;
+        t->latency[n] = elapsed_us(&start, &end);
+        // 02000 (nil) is a successful round trip, e.g. RPOP on an empty list
+        if (strcmp(t->sqlstate, "00000") != 0 && strcmp(t->sqlstate, "02000") != 0)
+        {
+            if (t->errors++ == 0)
+            {
+                memcpy(t->error_state, t->sqlstate, 6);
+                snprintf(t->error_text, sizeof(t->error_text), "%.70s", t->msgtext);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    unsigned int la = *(const unsigned int *)a, lb = *(const unsigned int *)b;
+    return la < lb ? -1 : la > lb;
+}
+
+static unsigned int percentile(unsigned int *sorted, long count, double p)
+{
+    long rank = (long)(p * count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+typedef enum
+{
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} PerfFormat;
+
+/**
+ * Function: run_level
+ * Description: Runs one command at one value size and concurrency level and
+ *              prints its result row.
+ * Returns:
+ *   - 0 on success, -1 when memory or threads are not available.
+ */
+static int run_level(const PerfCommand *cmd, size_t size, int concurrency, long ops, long warmup,
+                     long keyspace, PerfFormat format)
+{
+    PerfThread *threads;
+    pthread_t *ids;
+    unsigned int *latency;
+    struct timeval start, end;
+    long total = ops * concurrency, errors = 0, allocs = 0;
+    double seconds, per_op;
+    int i, started;
+
+    threads = calloc(concurrency, sizeof(PerfThread));
+    ids = calloc(concurrency, sizeof(pthread_t));
+    latency = malloc(total * sizeof(unsigned int));
+    if (threads == NULL || ids == NULL || latency == NULL)
+    {
+        fprintf(stderr, "Out of memory for %d threads x %ld ops\n", concurrency, ops);
+        free(threads);
+        free(ids);
+        free(latency);
+        return -1;
+    }
+
+    for (i = 0; i < concurrency; i++)
+    {
+        char native[PERF_MAX_VALUE];
+        PerfThread *t = &threads[i];
+
+        t->id = i;
+        t->concurrency = concurrency;
+        t->ops = ops;
+        t->warmup = warmup;
+        t->keyspace = keyspace;
+        t->size = size;
+        t->command = cmd;
+        t->latency = latency + (long)i * ops;
+        memset(native, 'x', size);
+        to_job_ccsid(native, size, t->value);
+        to_job_ccsid("f", 1, t->field);
+    }
+
+    gettimeofday(&start, NULL);
+    for (started = 0; started < concurrency; started++)
+    {
+        if (pthread_create(&ids[started], NULL, perf_thread, &threads[started]) != 0)
+        {
+            fprintf(stderr, "pthread_create failed (errno=%d)\n", errno);
+            break;
+        }
+    }
+    for (i = 0; i < started; i++)
+        pthread_join(ids[i], NULL);
+    gettimeofday(&end, NULL);
+
+    if (started == concurrency)
+    {
+        seconds = elapsed_us(&start, &end) / 1000000.0;
+        for (i = 0; i < concurrency; i++)
+        {
+            if (threads[i].errors > 0 && errors == 0)
+                fprintf(stderr, "%s: SQLSTATE %s %s\n", cmd->name, threads[i].error_state,
+                        threads[i].error_text);
+            errors += threads[i].errors;
+            allocs += threads[i].allocs;
+        }
+        qsort(latency, total, sizeof(unsigned int), compare_latency);
+        per_op = PERF_COUNT_ALLOCS ? (double)allocs / total : -1.0; // -1: not counted
+
+        if (format == FORMAT_CSV)
+            printf("%s,%d,%d,%ld,%ld,%.3f,%.0f,%u,%u,%u,%u,%u,%.2f\n",
+                   cmd->name, (int)size, concurrency, total, errors, seconds, total / seconds,
+                   percentile(latency, total, 0.50), percentile(latency, total, 0.90),
+                   percentile(latency, total, 0.99), percentile(latency, total, 0.999),
+                   latency[total - 1], per_op);
+        else if (format == FORMAT_JSON)
+            printf("{\"command\":\"%s\",\"size\":%d,\"concurrency\":%d,\"ops\":%ld,\"errors\":%ld,"
+                   "\"seconds\":%.3f,\"ops_per_sec\":%.0f,\"p50_us\":%u,\"p90_us\":%u,"
+                   "\"p99_us\":%u,\"p999_us\":%u,\"max_us\":%u,\"allocs_per_op\":%.2f}\n",
+                   cmd->name, (int)size, concurrency, total, errors, seconds, total / seconds,
+                   percentile(latency, total, 0.50), percentile(latency, total, 0.90),
+                   percentile(latency, total, 0.99), percentile(latency, total, 0.999),
+                   latency[total - 1], per_op);
+        else
+            printf("%-6s %6d %5d %8ld %6ld %10.0f %8u %8u %8u %8u %8u %7.2f\n",
+                   cmd->name, (int)size, concurrency, total, errors, total / seconds,
+                   percentile(latency, total, 0.50), percentile(latency, total, 0.90),
+                   percentile(latency, total, 0.99), percentile(latency, total, 0.999),
+                   latency[total - 1], per_op);
+        fflush(stdout);
+    }
+
+    free(threads);
+    free(ids);
+    free(latency);
+    return started == concurrency ? 0 : -1;
+}
+
+/**********************************************************************/
+/* Workload Mode (-W) */
+/**********************************************************************/
+
+typedef enum
+{
+    OP_READ,   // GET of an existing record
+    OP_UPDATE, // SET of an existing record
+    OP_INSERT, // SET of a new record (extends the keyspace)
+    OP_SCAN,   // MGET of 1-10 consecutive records (short range read)
+    OP_RMW,    // GET then SET of the same record, timed together
+    OP_INCRBY, // INCRBY of a counter
+    OP_LPUSH,  // LPUSH onto one of PERF_QUEUES queues
+    OP_RPOP,   // RPOP from one of PERF_QUEUES queues
+    OP_ZADD,   // ZADD of a player score to the leaderboard
+    OP_ZRANGE, // ZRANGE of the first 10 leaderboard entries
+    OP_COUNT
+} PerfOp;
+
+static const char *op_names[OP_COUNT] = {
+    "read", "update", "insert", "scan", "rmw", "incrby", "lpush", "rpop", "zadd", "zrange"};
+
+typedef enum
+{
+    DIST_UNIFORM,
+    DIST_ZIPFIAN, // YCSB scrambled zipfian (theta 0.99)
+    DIST_LATEST   // Zipfian over the most recently inserted records
+} PerfDist;
+
+static const char *dist_names[] = {"uniform", "zipfian", "latest"};
+
+typedef struct PerfWorkload
+{
+    const char *name;
+    const char *description;
+    const char *prefix; // Key prefix of the records
+    PerfDist dist;
+    int load;         // 1 = records are written before the run
+    PerfOp op[2];
+    int share[2];     // Percent of the operations (sum 100)
+} PerfWorkload;
+
+// YCSB core workloads A-F (workload E reads short key ranges with MGET, since
+// keys have no order in Redis) and the access patterns seen in production.
+static const PerfWorkload workloads[] = {
+    {"a", "update heavy", "perf:rec:", DIST_ZIPFIAN, 1, {OP_READ, OP_UPDATE}, {50, 50}},
+    {"b", "read mostly", "perf:rec:", DIST_ZIPFIAN, 1, {OP_READ, OP_UPDATE}, {95, 5}},
+    {"c", "read only", "perf:rec:", DIST_ZIPFIAN, 1, {OP_READ, OP_UPDATE}, {100, 0}},
+    {"d", "read latest", "perf:rec:", DIST_LATEST, 1, {OP_READ, OP_INSERT}, {95, 5}},
+    {"e", "short ranges", "perf:rec:", DIST_ZIPFIAN, 1, {OP_SCAN, OP_INSERT}, {95, 5}},
+    {"f", "read-modify-write", "perf:rec:", DIST_ZIPFIAN, 1, {OP_READ, OP_RMW}, {50, 50}},
+    {"counter", "INCRBY heavy counters", "perf:ctr:", DIST_ZIPFIAN, 0, {OP_INCRBY, OP_READ}, {90, 10}},
+    {"queue", "LPUSH/RPOP work queues", "perf:queue:", DIST_UNIFORM, 0, {OP_LPUSH, OP_RPOP}, {50, 50}},
+    {"leaderboard", "ZADD/ZRANGE leaderboard", "perf:board", DIST_ZIPFIAN, 0, {OP_ZADD, OP_ZRANGE}, {70, 30}},
+};
+#define WORKLOAD_COUNT (int)(sizeof(workloads) / sizeof(workloads[0]))
+
+#define PERF_QUEUES 8 // Queues used by the queue workload
+
+/**
+ * Histogram with 16 linear sub-buckets per power of two (HDR-style, about
+ * 6% resolution) from 1 microsecond to over an hour.
+ */
+#define HIST_SUB 16
+#define HIST_BUCKETS (HIST_SUB * 29)
+
+typedef struct PerfHistogram
+{
+    long count;
+    long errors;
+    unsigned int max;
+    long bucket[HIST_BUCKETS];
+} PerfHistogram;
+
+static int hist_index(unsigned int us)
+{
+    int bits = 0;
+    unsigned int v = us;
+
+    if (us < HIST_SUB)
+        return (int)us;
+    while (v >>= 1)
+        bits++;
+    // bits >= 4: keep the top five bits of the value
+    return (bits - 3) * HIST_SUB + (int)(us >> (bits - 4)) - HIST_SUB;
+}
+
+static unsigned int hist_upper(int index)
+{
+    int shift;
+
+    if (index < HIST_SUB)
+        return (unsigned int)index;
+    shift = index / HIST_SUB - 1;
+    return ((unsigned int)(index % HIST_SUB + HIST_SUB + 1) << shift) - 1;
+}
+
+static void hist_record(PerfHistogram *h, unsigned int us, int error)
+{
+    int index = hist_index(us);
+
+    h->bucket[index < HIST_BUCKETS ? index : HIST_BUCKETS - 1]++;
+    h->count++;
+    if (error)
+        h->errors++;
+    if (us > h->max)
+        h->max = us;
+}
+
+static void hist_merge(PerfHistogram *into, const PerfHistogram *from)
+{
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+        into->bucket[i] += from->bucket[i];
+    into->count += from->count;
+    into->errors += from->errors;
+    if (from->max > into->max)
+        into->max = from->max;
+}
+
+static unsigned int hist_percentile(const PerfHistogram *h, double p)
+{
+    long rank = (long)(p * h->count + 0.999999), seen = 0;
+    unsigned int upper;
+    int i;
+
+    if (rank < 1)
+        rank = 1;
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += h->bucket[i];
+        if (seen >= rank)
+        {
+            upper = hist_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * Function: hist_coarse
+ * Description: Folds the histogram into power-of-two buckets for printing.
+ *              coarse[i] counts latencies below 2^(i+1) microseconds.
+ * Returns:
+ *   - Number of coarse buckets up to the last non-empty one.
+ */
+static int hist_coarse(const PerfHistogram *h, long *coarse)
+{
+    int i, bucket, used = 0;
+
+    memset(coarse, 0, 32 * sizeof(long));
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        if (h->bucket[i] == 0)
+            continue;
+        for (bucket = 0; bucket < 31 && hist_upper(i) >= (2u << bucket); bucket++)
+            ;
+        coarse[bucket] += h->bucket[i];
+        if (bucket + 1 > used)
+            used = bucket + 1;
+    }
+    return used;
+}
+
+/**
+ * YCSB zipfian generator (Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases"), theta 0.99.
+ */
+typedef struct
+{
+    long items;
+    double theta, zetan, alpha, eta, half_pow;
+} PerfZipf;
+
+static void zipf_init(PerfZipf *z, long items)
+{
+    double zeta2 = 1.0 + pow(0.5, 0.99);
+    long i;
+
+    z->items = items;
+    z->theta = 0.99;
+    z->zetan = 0.0;
+    for (i = 1; i <= items; i++)
+        z->zetan += 1.0 / pow((double)i, z->theta);
+    z->alpha = 1.0 / (1.0 - z->theta);
+    z->eta = (1.0 - pow(2.0 / items, 1.0 - z->theta)) / (1.0 - zeta2 / z->zetan);
+    z->half_pow = 1.0 + pow(0.5, z->theta);
+}
+
+static long zipf_next(const PerfZipf *z, double u)
+{
+    double uz = u * z->zetan;
+    long rank;
+
+    if (uz < 1.0)
+        return 0;
+    if (uz < z->half_pow)
+        return 1;
+    rank = (long)(z->items * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return rank < z->items ? rank : z->items - 1;
+}
+
+// Shared run state
+static PerfZipf key_zipf, size_zipf;
+static volatile int perf_stop = 0;
+static long insert_next = 0; // Next record number for OP_INSERT
+static pthread_mutex_t insert_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct
+{
+    size_t min, max;
+    PerfDist dist; // DIST_UNIFORM or DIST_ZIPFIAN (small values most frequent)
+} PerfSizes;
+
+static PerfSizes value_sizes = {100, 100, DIST_UNIFORM};
+
+/**
+ * Function: batch_limit
+ * Description: Records per MGET/MSET so that the values of the largest
+ *              size still fit in one VARCHAR(16370).
+ */
+static int batch_limit(void)
+{
+    int limit = (int)(16000 / (value_sizes.max + 32));
+    return limit < 1 ? 1 : limit > PERF_BATCH ? PERF_BATCH : limit;
+}
+
+static unsigned long long next_random(PerfThread *t)
+{
+    unsigned long long x = t->random;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    t->random = x;
+    return x * 2685821657736338717ULL;
+}
+
+static double random_unit(PerfThread *t)
+{
+    return (double)(next_random(t) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Function: next_key
+ * Description: Picks the record number for a read/update/scan according to
+ *              the workload's key distribution.
+ */
+static long next_key(PerfThread *t)
+{
+    long records, rank;
+    unsigned long long h;
+    int i;
+
+    pthread_mutex_lock(&insert_lock);
+    records = insert_next;
+    pthread_mutex_unlock(&insert_lock);
+
+    switch (t->workload->dist)
+    {
+    case DIST_ZIPFIAN:
+        // Scramble the rank (FNV-1a) so the hot records are spread out
+        rank = zipf_next(&key_zipf, random_unit(t));
+        h = 14695981039346656037ULL;
+        for (i = 0; i < 8; i++)
+        {
+            h ^= (unsigned long long)(rank >> (i * 8)) & 0xFF;
+            h *= 1099511628211ULL;
+        }
+        return (long)(h % (unsigned long long)t->keyspace);
+    case DIST_LATEST:
+        rank = zipf_next(&key_zipf, random_unit(t));
+        return rank < records ? records - 1 - rank : 0;
+    default:
+        return (long)(next_random(t) % (unsigned long long)records);
+    }
+}
+
+/**
+ * Function: next_size
+ * Description: Sets the value length for the next write (value_sizes).
+ */
+static void next_size(PerfThread *t)
+{
+    size_t size = value_sizes.min;
+
+    if (value_sizes.max > value_sizes.min)
+    {
+        if (value_sizes.dist == DIST_ZIPFIAN)
+            size += zipf_next(&size_zipf, random_unit(t));
+        else
+            size += next_random(t) % (value_sizes.max - value_sizes.min + 1);
+    }
+    t->value[t->value_len] = t->value[0];
+    t->value[size] = '\0';
+    t->value_len = size;
+}
+
+static int call_failed(PerfThread *t)
+{
+    return strcmp(t->sqlstate, "00000") != 0 && strcmp(t->sqlstate, "02000") != 0;
+}
+
+/**
+ * Function: run_op
+ * Description: Builds the inputs of one workload operation, then calls the
+ *              UDF(s) and records the latency.
+ */
+static void run_op(PerfThread *t, PerfOp op, int timed)
+{
+    const char *prefix = t->workload->prefix;
+    struct timeval start, end;
+    char native[32];
+    long key = 0;
+    int len, failed;
+
+    switch (op)
+    {
+    case OP_INSERT:
+        pthread_mutex_lock(&insert_lock);
+        key = insert_next++;
+        pthread_mutex_unlock(&insert_lock);
+        make_key(t, prefix, key);
+        next_size(t);
+        break;
+    case OP_SCAN:
+        build_batch(t, prefix, next_key(t), 1 + (int)(next_random(t) % batch_limit()), 0);
+        break;
+    case OP_LPUSH:
+    case OP_RPOP:
+        make_key(t, prefix, (long)(next_random(t) % PERF_QUEUES));
+        next_size(t);
+        break;
+    case OP_ZADD:
+        len = sprintf(native, "player%ld", next_key(t));
+        to_job_ccsid(prefix, strlen(prefix), t->key);
+        to_job_ccsid(native, len, t->field);
+        t->score = (double)(next_random(t) % 1000000);
+        break;
+    case OP_ZRANGE:
+        to_job_ccsid(prefix, strlen(prefix), t->key);
+        t->range[0] = 0;
+        t->range[1] = 9;
+        break;
+    default:
+        make_key(t, prefix, next_key(t));
+        next_size(t);
+        t->increment = 1;
+        break;
+    }
+
+    gettimeofday(&start, NULL);
+    switch (op)
+    {
+    case OP_READ:
+        call_get(t);
+        break;
+    case OP_UPDATE:
+    case OP_INSERT:
+        call_set(t);
+        break;
+    case OP_SCAN:
+        call_mget(t);
+        break;
+    case OP_RMW:
+        call_get(t);
+        if (!call_failed(t))
+            call_set(t);
+        break;
+    case OP_INCRBY:
+        call_incrby(t);
+        break;
+    case OP_LPUSH:
+        call_lpush(t);
+        break;
+    case OP_RPOP:
+        call_rpop(t);
+        break;
+    case OP_ZADD:
+        zaddRedisSortedSet(t->key, &t->score, t->field, &t->number,
+                           &t->in_ind[0], &t->in_ind[1], &t->in_ind[2], &t->out_ind, STATUS);
+        break;
+    case OP_ZRANGE:
+        call_zrange(t);
+        break;
+    default:
+        break;
+    }
+    gettimeofday(&end, NULL);
+
+    failed = call_failed(t);
+    if (failed && t->errors++ == 0)
+    {
+        memcpy(t->error_state, t->sqlstate, 6);
+        snprintf(t->error_text, sizeof(t->error_text), "%.70s", t->msgtext);
+    }
+    if (timed)
+        hist_record(&t->histogram[op], elapsed_us(&start, &end), failed);
+}
+
+static void *workload_thread(void *arg)
+{
+    PerfThread *t = (PerfThread *)arg;
+    const PerfWorkload *w = t->workload;
+    long n;
+
+    for (n = 0; !perf_stop; n++)
+    {
+        PerfOp op = (int)(next_random(t) % 100) < w->share[0] ? w->op[0] : w->op[1];
+        run_op(t, op, n >= t->warmup);
+    }
+    return NULL;
+}
+
+/**
+ * Function: load_records
+ * Description: Writes the initial records of a workload with MSET batches.
+ * Returns:
+ *   - 0 on success, -1 when a batch fails.
+ */
+static int load_records(const PerfWorkload *w, long keyspace)
+{
+    PerfThread *t = calloc(1, sizeof(PerfThread));
+    struct timeval start, end;
+    long first;
+    int rc = 0, count = batch_limit();
+
+    if (t == NULL)
+        return -1;
+    t->keyspace = keyspace;
+    t->random = 1;
+    gettimeofday(&start, NULL);
+    for (first = 0; first < keyspace && rc == 0; first += count)
+    {
+        t->size = value_sizes.min;
+        build_batch(t, w->prefix, first, first + count <= keyspace ? count : (int)(keyspace - first), 1);
+        call_mset(t);
+        if (call_failed(t))
+        {
+            fprintf(stderr, "load: SQLSTATE %s %s\n", t->sqlstate, t->msgtext);
+            rc = -1;
+        }
+    }
+    gettimeofday(&end, NULL);
+    if (rc == 0)
+        fprintf(stderr, "Loaded %ld records in %.1f s\n", keyspace, elapsed_us(&start, &end) / 1000000.0);
+    free(t);
+    return rc;
+}
+
+static void print_op(const PerfWorkload *w, int concurrency, double seconds, const char *name,
+                     const PerfHistogram *h, PerfFormat format)
+{
+    long coarse[32];
+    int used, i;
+
+    if (format == FORMAT_CSV)
+    {
+        printf("%s,%d,%.3f,%s,%ld,%ld,%.0f,%u,%u,%u,%u,%u\n", w->name, concurrency, seconds, name,
+               h->count, h->errors, h->count / seconds, hist_percentile(h, 0.50), hist_percentile(h, 0.90),
+               hist_percentile(h, 0.99), hist_percentile(h, 0.999), h->max);
+        return;
+    }
+
+    used = hist_coarse(h, coarse);
+    if (format == FORMAT_JSON)
+    {
+        printf("{\"workload\":\"%s\",\"concurrency\":%d,\"seconds\":%.3f,\"op\":\"%s\",\"count\":%ld,"
+               "\"errors\":%ld,\"ops_per_sec\":%.0f,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,"
+               "\"p999_us\":%u,\"max_us\":%u,\"histogram\":[",
+               w->name, concurrency, seconds, name, h->count, h->errors, h->count / seconds,
+               hist_percentile(h, 0.50), hist_percentile(h, 0.90), hist_percentile(h, 0.99),
+               hist_percentile(h, 0.999), h->max);
+        for (i = 0; i < used; i++)
+            printf("%s[%u,%ld]", i > 0 ? "," : "", 2u << i, coarse[i]);
+        printf("]}\n");
+        return;
+    }
+
+    printf("  %-7s %9ld %6ld %10.0f %8u %8u %8u %8u %8u\n", name, h->count, h->errors,
+           h->count / seconds, hist_percentile(h, 0.50), hist_percentile(h, 0.90),
+           hist_percentile(h, 0.99), hist_percentile(h, 0.999), h->max);
+    if (strcmp(name, "total") == 0)
+        return;
+    printf("          ");
+    for (i = 0; i < used; i++)
+    {
+        if (coarse[i] > 0)
+            printf(" <%u:%ld", 2u << i, coarse[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * Function: run_workload
+ * Description: Runs a workload for a fixed duration with the given number
+ *              of threads and prints per-operation throughput, latency
+ *              percentiles and histograms.
+ * Returns:
+ *   - 0 on success, -1 when memory or threads are not available.
+ */
+static int run_workload(const PerfWorkload *w, int concurrency, int duration, long warmup,
+                        long keyspace, PerfFormat format)
+{
+    PerfThread *threads;
+    PerfHistogram *histograms, total;
+    PerfHistogram merged[OP_COUNT];
+    pthread_t *ids;
+    struct timeval start, end;
+    double seconds;
+    int i, k, started;
+
+    threads = calloc(concurrency, sizeof(PerfThread));
+    histograms = calloc((size_t)concurrency * OP_COUNT, sizeof(PerfHistogram));
+    ids = calloc(concurrency, sizeof(pthread_t));
+    if (threads == NULL || histograms == NULL || ids == NULL)
+    {
+        fprintf(stderr, "Out of memory for %d threads\n", concurrency);
+        free(threads);
+        free(histograms);
+        free(ids);
+        return -1;
+    }
+
+    for (i = 0; i < concurrency; i++)
+    {
+        char native[PERF_MAX_VALUE];
+        PerfThread *t = &threads[i];
+
+        t->id = i;
+        t->concurrency = concurrency;
+        t->warmup = warmup;
+        t->keyspace = keyspace;
+        t->workload = w;
+        t->histogram = histograms + (size_t)i * OP_COUNT;
+        t->random = 0x9E3779B97F4A7C15ULL * (i + 1);
+        memset(native, 'x', value_sizes.max);
+        to_job_ccsid(native, value_sizes.max, t->value);
+        t->value_len = value_sizes.max;
+    }
+
+    perf_stop = 0;
+    gettimeofday(&start, NULL);
+    for (started = 0; started < concurrency; started++)
+    {
+        if (pthread_create(&ids[started], NULL, workload_thread, &threads[started]) != 0)
+        {
+            fprintf(stderr, "pthread_create failed (errno=%d)\n", errno);
+            break;
+        }
+    }
+    if (started == concurrency)
+        sleep(duration);
+    perf_stop = 1;
+    for (i = 0; i < started; i++)
+        pthread_join(ids[i], NULL);
+    gettimeofday(&end, NULL);
+
+    if (started == concurrency)
+    {
+        seconds = elapsed_us(&start, &end) / 1000000.0;
+        memset(merged, 0, sizeof(merged));
+        memset(&total, 0, sizeof(total));
+        for (i = 0; i < concurrency; i++)
+        {
+            if (threads[i].errors > 0)
+                fprintf(stderr, "%s: SQLSTATE %s %s\n", w->name, threads[i].error_state,
+                        threads[i].error_text);
+            for (k = 0; k < OP_COUNT; k++)
+                hist_merge(&merged[k], &threads[i].histogram[k]);
+        }
+
+        if (format == FORMAT_TEXT)
+            printf("workload %s (%s, %s), %d threads, %.1f s\n"
+                   "  %-7s %9s %6s %10s %8s %8s %8s %8s %8s\n",
+                   w->name, w->description, dist_names[w->dist], concurrency, seconds,
+                   "op", "count", "errors", "ops/s", "p50", "p90", "p99", "p99.9", "max");
+        for (k = 0; k < OP_COUNT; k++)
+        {
+            if (merged[k].count == 0)
+                continue;
+            hist_merge(&total, &merged[k]);
+            print_op(w, concurrency, seconds, op_names[k], &merged[k], format);
+        }
+        print_op(w, concurrency, seconds, "total", &total, format);
+        fflush(stdout);
+    }
+
+    free(threads);
+    free(histograms);
+    free(ids);
+    return started == concurrency ? 0 : -1;
+}
+
+/**********************************************************************/
+/* Main */
+/**********************************************************************/
+
+static int parse_list(const char *arg, long *out, long min, long max)
+{
+    int count = 0;
+    char *end;
+
+    while (*arg != '\0' && count < PERF_MAX_LEVELS)
+    {
+        out[count] = strtol(arg, &end, 10);
+        if (end == arg || out[count] < min || out[count] > max)
+            return -1;
+        count++;
+        arg = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+            return -1;
+    }
+    return count;
+}
+
+static int name_selected(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+    const char *found = list;
+
+    while ((found = strstr(found, name)) != NULL)
+    {
+        if ((found == list || found[-1] == ',') && (found[len] == ',' || found[len] == '\0'))
+            return 1;
+        found += len;
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    int w;
+
+    printf("Usage: redisperf [-t commands] [-s sizes] [-c concurrency] [-n ops] [-w warmup]\n"
+           "                 [-k keyspace] [-f text|csv|json]\n"
+           "       redisperf -W workloads [-d seconds] [-D distribution] [-r percent]\n"
+           "                 [-s min[-max]] [-v uniform|zipfian] [-c concurrency] [-w warmup]\n"
+           "                 [-k records] [-f text|csv|json]\n"
+           "  -t  Comma-separated commands (default: all):\n"
+           "      set,get,mset,mget,hset,hget,lpush,rpop,incr,zadd,scan,ping\n"
+           "  -s  Value sizes in bytes (default: 16,256,4096; workloads: 100)\n"
+           "  -c  Concurrent threads (default: 1,4,8)\n"
+           "  -n  Timed operations per thread (default: 5000)\n"
+           "  -w  Untimed warm-up operations per thread (default: 100)\n"
+           "  -k  Distinct keys (default: 1000)\n"
+           "  -f  Output format (default: text)\n"
+           "  -W  Comma-separated workloads (or \"all\"), run for -d seconds (default: 10):\n");
+    for (w = 0; w < WORKLOAD_COUNT; w++)
+        printf("      %-12s %s %d%%/%s %d%%, %s\n", workloads[w].name, op_names[workloads[w].op[0]],
+               workloads[w].share[0], op_names[workloads[w].op[1]], workloads[w].share[1],
+               dist_names[workloads[w].dist]);
+    printf("  -D  Key distribution: uniform, zipfian or latest (default: per workload)\n"
+           "  -r  Percent of the first operation, e.g. reads (default: per workload)\n"
+           "  -v  Value size distribution between min and max (default: uniform)\n"
+           "Latencies are in microseconds. Server: %s:%s (from .env)\n",
+           REDIS_IP, REDIS_PORT);
+}
+
+static int parse_dist(const char *arg)
+{
+    int d;
+
+    for (d = 0; d < (int)(sizeof(dist_names) / sizeof(dist_names[0])); d++)
+    {
+        if (strcmp(arg, dist_names[d]) == 0)
+            return d;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    long sizes[PERF_MAX_LEVELS] = {16, 256, 4096}, levels[PERF_MAX_LEVELS] = {1, 4, 8};
+    int size_count = 3, level_count = 3;
+    long ops = 5000, warmup = 100, keyspace = 1000;
+    const char *selected = NULL, *selected_workloads = NULL, *size_arg = NULL;
+    int duration = 10, dist = -1, share = -1, matched = 0;
+    PerfFormat format = FORMAT_TEXT;
+    int c, s, l, i, rc = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            usage();
+            return 0;
+        }
+        if (value == NULL || argv[i][0] != '-' || argv[i][2] != '\0')
+        {
+            usage();
+            return 1;
+        }
+        switch (argv[i][1])
+        {
+        case 't':
+            selected = value;
+            break;
+        case 's':
+            size_arg = value;
+            break;
+        case 'c':
+            level_count = parse_list(value, levels, 1, 1024);
+            break;
+        case 'n':
+            ops = atol(value);
+            break;
+        case 'w':
+            warmup = atol(value);
+            break;
+        case 'k':
+            keyspace = atol(value);
+            break;
+        case 'f':
+            format = strcmp(value, "csv") == 0 ? FORMAT_CSV : strcmp(value, "json") == 0 ? FORMAT_JSON : FORMAT_TEXT;
+            break;
+        case 'W':
+            selected_workloads = value;
+            break;
+        case 'd':
+            duration = atoi(value);
+            break;
+        case 'D':
+            if ((dist = parse_dist(value)) < 0)
+                level_count = -1;
+            break;
+        case 'r':
+            share = atoi(value);
+            break;
+        case 'v':
+            value_sizes.dist = strcmp(value, "zipfian") == 0 ? DIST_ZIPFIAN : DIST_UNIFORM;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+        i++;
+    }
+
+    if (selected_workloads != NULL)
+    {
+        // Workload mode: -s is one size or a min-max range
+        if (size_arg != NULL)
+        {
+            char *end;
+            value_sizes.min = value_sizes.max = strtol(size_arg, &end, 10);
+            if (*end == '-')
+                value_sizes.max = strtol(end + 1, &end, 10);
+            if (*end != '\0')
+                value_sizes.min = 0;
+        }
+        if (level_count <= 0 || duration <= 0 || warmup < 0 || keyspace <= 0 || share > 100 ||
+            value_sizes.min < 1 || value_sizes.max < value_sizes.min || value_sizes.max > 16000)
+        {
+            usage();
+            return 1;
+        }
+        zipf_init(&key_zipf, keyspace);
+        if (value_sizes.max > value_sizes.min)
+            zipf_init(&size_zipf, (long)(value_sizes.max - value_sizes.min + 1));
+
+        if (format == FORMAT_CSV)
+            printf("workload,concurrency,seconds,op,count,errors,ops_per_sec,p50_us,p90_us,p99_us,p999_us,max_us\n");
+        for (c = 0; c < WORKLOAD_COUNT; c++)
+        {
+            PerfWorkload w = workloads[c];
+
+            if (strcmp(selected_workloads, "all") != 0 && !name_selected(selected_workloads, w.name))
+                continue;
+            matched++;
+            if (dist >= 0)
+                w.dist = (PerfDist)dist;
+            if (share >= 0)
+            {
+                w.share[0] = share;
+                w.share[1] = 100 - share;
+            }
+            for (l = 0; l < level_count; l++)
+            {
+                insert_next = keyspace;
+                if (w.load && load_records(&w, keyspace) != 0)
+                {
+                    rc = 1;
+                    break;
+                }
+                if (run_workload(&w, (int)levels[l], duration, warmup, keyspace, format) != 0)
+                    rc = 1;
+            }
+        }
+        if (matched == 0)
+        {
+            fprintf(stderr, "No workload named %s\n", selected_workloads);
+            rc = 1;
+        }
+        return rc;
+    }
+
+    if (size_arg != NULL)
+        size_count = parse_list(size_arg, sizes, 1, PERF_MAX_VALUE - 1);
+    if (size_count <= 0 || level_count <= 0 || ops <= 0 || warmup < 0 || keyspace <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    if (format == FORMAT_CSV)
+        printf("command,size,concurrency,ops,errors,seconds,ops_per_sec,p50_us,p90_us,p99_us,p999_us,max_us,allocs_per_op\n");
+    else if (format == FORMAT_TEXT)
+        printf("%-6s %6s %5s %8s %6s %10s %8s %8s %8s %8s %8s %7s\n", "cmd", "size", "conc", "ops",
+               "errors", "ops/s", "p50", "p90", "p99", "p99.9", "max", "allocs");
+
+    for (c = 0; c < COMMAND_COUNT; c++)
+    {
+        const PerfCommand *cmd = &commands[c];
+
+        if (selected != NULL && !name_selected(selected, cmd->name))
+            continue;
+
+        for (s = 0; s < (cmd->sized ? size_count : 1); s++)
+        {
+            size_t size = cmd->sized ? (size_t)sizes[s] : 0;
+
+            // MGET/MSET carry the whole batch in one VARCHAR(16370)
+            if (cmd->batch * (size + 24) > PERF_MAX_VALUE)
+                continue;
+            for (l = 0; l < level_count; l++)
+            {
+                if (run_level(cmd, size, (int)levels[l], ops, warmup, keyspace, format) != 0)
+                    rc = 1;
+            }
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * File: redisprof.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_PROFILE function for IBM i.
+ *              Switches phase profiling on or off for the current job:
+ *              every Nth call of each thread is split into connect,
+ *              encode, translate, send, wait and parse time, reported
+ *              per command by REDIS_STATS.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: profileRedis
+ * Description: SQL external function to set the phase profiling rate.
+ * Parameters:
+ *   - rate: Input rate: 0 = off, 1 = every call, N = every Nth call.
+ *   - previous: Output previous rate.
+ *   - rateInd: Null indicator for the input rate.
+ *   - previousInd: Null indicator for the output rate.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN profileRedis(
+    SQLUDF_INTEGER *rate,        // Input: sampling rate
+    SQLUDF_INTEGER *previous,    // Output: previous sampling rate
+    SQLUDF_NULLIND *rateInd,     // Null indicator for input
+    SQLUDF_NULLIND *previousInd, // Null indicator for output
+    char *sqlstate,              // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,              // Fully qualified function name
+    char *specname,              // Specific name
+    char *msgtext,               // Error message text (up to 70 chars)
+    short *sqlcode,              // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)     // Additional null indicators for DB2SQL
+{
+    // Check for NULL input rate
+    if (*rateInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input rate is NULL");
+        *previousInd = -1;
+        return;
+    }
+
+    if (*rate < 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Rate must be 0 (off) or a positive number");
+        *previousInd = -1;
+        return;
+    }
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+    *previous = set_redis_profile_rate(*rate);
+    *previousInd = 0;
+}
+
+#pragma linkage(profileRedis, OS)
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * File: redisrout.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_ROUTE_READS function for IBM i.
+ *              Switches where read-only UDFs (GET, HGET, LRANGE, SMEMBERS,
+ *              ZRANGE, SCAN, ...) send their commands for the current job:
+ *              to the replicas in REDIS_REPLICAS or to the primary.
+ *              Routing reads to the primary gives read-your-writes
+ *              consistency for a section of work.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: routeRedisReads
+ * Description: SQL external function to select the read routing mode.
+ * Parameters:
+ *   - mode: Input mode, 'PRIMARY' or 'REPLICA' (VARCHAR(10), EBCDIC).
+ *   - value: Output previous mode (VARCHAR(10), EBCDIC).
+ *   - modeInd: Null indicator for the input mode.
+ *   - valueInd: Null indicator for the output value.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000").
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN routeRedisReads(
+    SQLUDF_VARCHAR *mode,     // Input: 'PRIMARY' or 'REPLICA' (EBCDIC)
+    SQLUDF_VARCHAR *value,    // Output: previous mode (EBCDIC)
+    SQLUDF_NULLIND *modeInd,  // Null indicator for input
+    SQLUDF_NULLIND *valueInd, // Null indicator for output
+    char *sqlstate,           // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,           // Fully qualified function name
+    char *specname,           // Specific name
+    char *msgtext,            // Error message text (up to 70 chars)
+    short *sqlcode,           // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)  // Additional null indicators for DB2SQL
+{
+    int primary;
+
+    // Check for NULL input mode
+    if (*modeInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input mode is NULL");
+        *valueInd = -1;
+        return;
+    }
+
+    if (strcmp(mode, "\xD7\xD9\xC9\xD4\xC1\xD9\xE8") == 0) // EBCDIC "PRIMARY"
+    {
+        primary = 1;
+    }
+    else if (strcmp(mode, "\xD9\xC5\xD7\xD3\xC9\xC3\xC1") == 0) // EBCDIC "REPLICA"
+    {
+        primary = 0;
+    }
+    else
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Mode must be PRIMARY or REPLICA");
+        *valueInd = -1;
+        return;
+    }
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+    if (set_redis_read_mode(primary))
+        strcpy(value, "\xD7\xD9\xC9\xD4\xC1\xD9\xE8"); // EBCDIC "PRIMARY"
+    else
+        strcpy(value, "\xD9\xC5\xD7\xD3\xC9\xC3\xC1"); // EBCDIC "REPLICA"
+    *valueInd = 0;
+}
+
+#pragma linkage(routeRedisReads, OS)
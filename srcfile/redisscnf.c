@@ -0,0 +1,386 @@
+/******************************************************************************
+ * File: redisscnf.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_SCAN_FILTER table function for
+ *              IBM i. Scans the key space like REDIS_SCAN, but each batch
+ *              is filtered on the server by a Lua script (lua/scan_filter.lua,
+ *              run through the job's script registry): only the keys whose
+ *              string value or hash field passes the predicate, and the
+ *              fields asked for, are sent back. Each key/field pair is a row.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define FILTER_KEY 255      // Length of the KEY and FIELD columns
+#define FILTER_VALUE 16370  // Length of the VALUE column
+#define FILTER_COUNT 100    // SCAN COUNT when CNT is NULL
+#define FILTER_SLACK 256    // Scratchpad kept free of the reply budget
+#define FILTER_FIXED 8      // Arguments before the projected fields
+#define FILTER_FIELDS 64    // Projected fields
+#define FILTER_PROJECT 1024 // Length of the PROJECT input
+
+// Scan position kept in the scratchpad, followed by the current batch
+typedef struct
+{
+    char cursor[24]; // Next SCAN cursor (EBCDIC)
+    int done;        // 1 once Redis returned cursor 0
+    int pos;         // Offset of the next entry in the batch
+    int len;         // Length of the batch
+    int key_pos;     // Offset and length of the key being returned
+    int key_len;
+    int pairs;       // Field/value pairs left for that key
+} FilterCursor;
+
+/**
+ * Function: filter_op
+ * Description: Matches the OP input, in either case, against the
+ *              predicates the script knows.
+ * Parameters:
+ *   - op: OP input (EBCDIC).
+ * Returns:
+ *   - The predicate name in uppercase EBCDIC, NULL if unknown.
+ */
+static const char *filter_op(const char *op)
+{
+    static const char *ops[] = {
+        "\xC5\xD8",                 // EQ
+        "\xD7\xD9\xC5\xC6\xC9\xE7", // PREFIX
+        "\xD9\xC1\xD5\xC7\xC5",     // RANGE
+    };
+    size_t i, j;
+
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+    {
+        for (j = 0; ops[i][j] != '\0' && ((unsigned char)op[j] | 0x40) == (unsigned char)ops[i][j]; j++)
+            ;
+        if (ops[i][j] == '\0' && op[j] == '\0')
+            return ops[i];
+    }
+    return NULL;
+}
+
+/**
+ * Function: run_filter_batch
+ * Description: Runs the scan filter script for the next SCAN batch and
+ *              leaves its reply behind the cursor in the scratchpad. The
+ *              reply budget is the room left in the scratchpad; the script
+ *              halves its COUNT until a batch fits.
+ * Parameters:
+ *   - state: Scan position; its cursor is advanced.
+ *   - reply: Receives the batch (ASCII).
+ *   - size: Size of the reply area.
+ *   - argv, argl: Script arguments; the cursor, count and budget are
+ *     filled in here.
+ *   - argc: Number of arguments.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message of a failure.
+ * Returns:
+ *   - 0 on success, -1 on failure.
+ */
+static int run_filter_batch(FilterCursor *state, char *reply, size_t size, const char **argv,
+                            size_t *argl, int argc, char *sqlstate, char *msgtext)
+{
+    char sha[41], budget[REDIS_DOUBLE_TEXT];
+    RedisReplyItem item;
+    size_t pos = 0;
+    int sockfd, len;
+
+    // Registering is a lookup once the script is in the registry
+    if (redis_script_register(REDIS_SCRIPT_SCAN_FILTER, strlen(REDIS_SCRIPT_SCAN_FILTER), 1, sha) != 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for the script registry");
+        return -1;
+    }
+    argv[0] = state->cursor;
+    argl[0] = strlen(state->cursor);
+    argv[7] = budget;
+    argl[7] = format_ebcdic_integer((long long)(size - FILTER_SLACK), budget);
+
+    // The key space of the primary, like REDIS_SCAN
+    if (connect_to_redis(&sockfd) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        return -1;
+    }
+    len = eval_redis_script(sockfd, sha, argc, argv, argl, 0, reply, size, sqlstate, msgtext);
+    release_redis_connection(sockfd, sqlstate);
+    if (len < 0)
+        return -1;
+
+    if (redis_reply_item(reply, len, &pos, &item) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+        return -1;
+    }
+    if (item.type == 0x2D) // ASCII '-' error reply
+    {
+        len = item.len < 70 ? (int)item.len : 70;
+        ConvertToEBCDIC((char *)item.data, len, msgtext, 70);
+        msgtext[len] = '\0';
+        strcpy(sqlstate, "38911");
+        return -1;
+    }
+    if (item.type != 0x2A || item.nil || item.len < 1 ||
+        redis_reply_item(reply, len, &pos, &item) != 0 || item.nil || item.len >= sizeof(state->cursor))
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+        return -1;
+    }
+
+    // The next cursor, then the matches
+    ConvertToEBCDIC((char *)item.data, item.len, state->cursor, sizeof(state->cursor));
+    state->cursor[item.len] = '\0';
+    state->done = item.len == 1 && item.data[0] == 0x30; // ASCII '0'
+    state->pos = (int)pos;
+    state->len = len;
+    state->pairs = 0;
+    return 0;
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: scanFilterRedis
+ * Description: SQL external table function to scan the keys matching a
+ *              pattern and return those whose value passes a predicate,
+ *              evaluated by Redis over each SCAN batch. With a field, hash
+ *              keys are tested on that field; without one, string keys are
+ *              tested on their value. Keys of other types never match.
+ *              The rows are the projected fields of each matching key.
+ * Parameters:
+ *   - pattern: Input MATCH pattern (EBCDIC).
+ *   - field: Input hash field to test (EBCDIC); NULL tests string values.
+ *   - op: Input predicate: EQ, PREFIX or RANGE (numeric, inclusive); NULL
+ *     for none (every key of the type).
+ *   - value1: Input value for EQ and PREFIX, lower bound for RANGE (NULL
+ *     for open).
+ *   - value2: Input upper bound for RANGE (NULL for open).
+ *   - project: Input fields to return for hash keys, blank-separated, '*'
+ *     for all; NULL returns the tested field.
+ *   - count: Input SCAN COUNT per batch (NULL for 100).
+ *   - key: Output key (EBCDIC).
+ *   - outField: Output field (EBCDIC); NULL for string keys.
+ *   - value: Output value (EBCDIC); NULL for a projected field that is
+ *     missing.
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply from Redis (e.g., a single key that does
+ *     not fit in the scratchpad).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the scan position and the batch.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN scanFilterRedis(
+    SQLUDF_VARCHAR *pattern,        // Input: MATCH pattern (EBCDIC)
+    SQLUDF_VARCHAR *field,          // Input: hash field to test (EBCDIC)
+    SQLUDF_VARCHAR *op,             // Input: EQ, PREFIX or RANGE (EBCDIC)
+    SQLUDF_VARCHAR *value1,         // Input: value or lower bound (EBCDIC)
+    SQLUDF_VARCHAR *value2,         // Input: upper bound (EBCDIC)
+    SQLUDF_VARCHAR *project,        // Input: fields to return (EBCDIC)
+    SQLUDF_INTEGER *count,          // Input: SCAN COUNT per batch
+    SQLUDF_VARCHAR *key,            // Output: key (EBCDIC)
+    SQLUDF_VARCHAR *outField,       // Output: field (EBCDIC)
+    SQLUDF_VARCHAR *value,          // Output: value (EBCDIC)
+    SQLUDF_NULLIND *patternInd,     // Null indicators for inputs
+    SQLUDF_NULLIND *fieldInd,
+    SQLUDF_NULLIND *opInd,
+    SQLUDF_NULLIND *value1Ind,
+    SQLUDF_NULLIND *value2Ind,
+    SQLUDF_NULLIND *projectInd,
+    SQLUDF_NULLIND *countInd,
+    SQLUDF_NULLIND *keyInd,         // Null indicators for outputs
+    SQLUDF_NULLIND *outFieldInd,
+    SQLUDF_NULLIND *valueInd,
+    char *sqlstate,                 // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                 // Fully qualified function name
+    char *specname,                 // Specific name
+    char *msgtext,                  // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,  // Scan position and batch between calls
+    SQLUDF_CALL_TYPE *calltype)     // Open, fetch or close
+{
+    char *reply = scratchpad->data + sizeof(FilterCursor);
+    size_t size = scratchpad->length - sizeof(FilterCursor);
+    char count_text[REDIS_DOUBLE_TEXT], words[2 * FILTER_PROJECT + 2], *word = words;
+    const char *predicate = NULL, *text;
+    const char *argv[FILTER_FIXED + FILTER_FIELDS];
+    size_t argl[FILTER_FIXED + FILTER_FIELDS], len;
+    FilterCursor state;
+    RedisReplyItem item, data;
+    size_t pos;
+    int argc = FILTER_FIXED, rc;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype != SQLUDF_TF_OPEN && *calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    // The script arguments, checked at open and rebuilt for each batch
+    if (*patternInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input pattern is NULL");
+        return;
+    }
+    if (*opInd >= 0 && (predicate = filter_op(op)) == NULL)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Unknown predicate: use EQ, PREFIX or RANGE");
+        return;
+    }
+    if (predicate != NULL && *value1Ind < 0 && (predicate[0] != '\xD9' || *value2Ind < 0)) // RANGE
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input value is NULL");
+        return;
+    }
+    if (*countInd >= 0 && *count < 1)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Input count must be positive");
+        return;
+    }
+    if (scratchpad->length < sizeof(FilterCursor) + 4 * FILTER_SLACK)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Scratchpad too small: create the function with SCRATCHPAD 32767");
+        return;
+    }
+    argv[1] = pattern;
+    argl[1] = strlen(pattern);
+    argv[2] = count_text;
+    argl[2] = format_ebcdic_integer(*countInd < 0 ? FILTER_COUNT : *count, count_text);
+    argv[3] = *fieldInd < 0 ? "" : field;
+    argv[4] = predicate == NULL ? "" : predicate;
+    argv[5] = predicate == NULL || *value1Ind < 0 ? "" : value1;
+    argv[6] = predicate == NULL || *value2Ind < 0 ? "" : value2;
+    for (rc = 1; rc < 7; rc++)
+        argl[rc] = strlen(argv[rc]);
+
+    // Projected fields of hash keys, blank-separated words
+    text = *fieldInd < 0 || *projectInd < 0 || strlen(project) > FILTER_PROJECT ? NULL : project;
+    while (text != NULL)
+    {
+        rc = next_redis_word(&text, word, &len);
+        if (rc < 0 || (rc > 0 && argc == FILTER_FIXED + FILTER_FIELDS))
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, rc < 0 ? "Unterminated quote in the projection" : "Too many projected fields");
+            return;
+        }
+        if (rc == 0 && *text == '\0')
+            break;
+        if (rc == 0)
+        {
+            text++; // Separator between fields
+            continue;
+        }
+        argv[argc] = word;
+        argl[argc++] = len;
+        word += len + 1;
+    }
+
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+        memset(&state, 0, sizeof(state));
+        state.cursor[0] = '\xF0'; // EBCDIC '0': start of the key space
+        if (run_filter_batch(&state, reply, size, argv, argl, argc, sqlstate, msgtext) == 0)
+            memcpy(scratchpad->data, &state, sizeof(state));
+        return;
+    }
+
+    memcpy(&state, scratchpad->data, sizeof(state));
+    while (state.pairs == 0)
+    {
+        if (state.pos >= state.len && state.done)
+        {
+            strcpy(sqlstate, "02000"); // End of table
+            return;
+        }
+        if (state.pos >= state.len)
+        {
+            // Batch used up (or without matches): filter the next one
+            if (run_filter_batch(&state, reply, size, argv, argl, argc, sqlstate, msgtext) != 0)
+                return;
+            continue;
+        }
+        pos = state.pos;
+        if (redis_reply_item(reply, state.len, &pos, &item) != 0 || item.nil ||
+            redis_reply_item(reply, state.len, &pos, &data) != 0 || data.type != 0x3A || data.number < 1)
+        {
+            strcpy(sqlstate, "38909");
+            strcpy(msgtext, "Failed to parse Redis response");
+            return;
+        }
+        state.key_pos = (int)(item.data - reply);
+        state.key_len = (int)item.len;
+        state.pairs = (int)data.number;
+        state.pos = (int)pos;
+    }
+
+    // One field/value pair of the current key
+    pos = state.pos;
+    if (redis_reply_item(reply, state.len, &pos, &item) != 0 ||
+        redis_reply_item(reply, state.len, &pos, &data) != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, "Failed to parse Redis response");
+        return;
+    }
+    if (state.key_len > FILTER_KEY || item.len > FILTER_KEY || data.len > FILTER_VALUE)
+    {
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Value exceeds maximum length");
+        return;
+    }
+    ConvertToEBCDIC(reply + state.key_pos, state.key_len, key, FILTER_KEY + 1);
+    key[state.key_len] = '\0';
+    *keyInd = 0;
+    *outFieldInd = item.nil ? -1 : 0;
+    if (!item.nil)
+    {
+        ConvertToEBCDIC((char *)item.data, item.len, outField, FILTER_KEY + 1);
+        outField[item.len] = '\0';
+    }
+    *valueInd = data.nil ? -1 : 0;
+    if (!data.nil)
+    {
+        ConvertToEBCDIC((char *)data.data, data.len, value, FILTER_VALUE + 1);
+        value[data.len] = '\0';
+    }
+    state.pos = (int)pos;
+    state.pairs--;
+    memcpy(scratchpad->data, &state, sizeof(state));
+}
+
+#pragma linkage(scanFilterRedis, OS)
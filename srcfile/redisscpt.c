@@ -0,0 +1,548 @@
+/******************************************************************************
+ * File: redisscpt.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Lua script registry of the REDISILE service program and the
+ *              REDIS_SCRIPT_LOAD function for IBM i.
+ *              A script is sent to Redis once per endpoint and then run by
+ *              its SHA1 with EVALSHA, so repeated calls carry 40 bytes
+ *              instead of the body. The registry keeps the body of every
+ *              script of the job and a bit per endpoint telling where it
+ *              is known to be loaded: the first EVALSHA on an endpoint has
+ *              SCRIPT LOAD pipelined in front of it (one round trip), and
+ *              a -NOSCRIPT reply (server restart, failover, SCRIPT FLUSH)
+ *              clears the bit, loads the script and runs it again.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define SCRIPT_SLOTS 64     // Scripts kept per job
+#define SCRIPT_SHA 40       // Length of a SHA1 in hex
+
+/**********************************************************************/
+/* SHA1 */
+/**********************************************************************/
+
+#define ROTATE(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/**
+ * Function: sha1_block
+ * Description: Adds one 64-byte block to the SHA1 state (FIPS 180-4).
+ */
+static void sha1_block(unsigned int *state, const unsigned char *block)
+{
+    unsigned int w[80], a, b, c, d, e, f, k, t;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = (unsigned int)block[4 * i] << 24 | (unsigned int)block[4 * i + 1] << 16 |
+               (unsigned int)block[4 * i + 2] << 8 | block[4 * i + 3];
+    for (; i < 80; i++)
+        w[i] = ROTATE(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    for (i = 0; i < 80; i++)
+    {
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        t = ROTATE(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROTATE(b, 30);
+        b = a;
+        a = t;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+/**
+ * Function: sha1_hex
+ * Description: Computes the SHA1 of a script the way Redis names it: over
+ *              the bytes sent (ASCII), as 40 lowercase hex digits.
+ * Parameters:
+ *   - data: Script body (ASCII).
+ *   - len: Length of the body.
+ *   - sha: Receives the digest (ASCII, null-terminated).
+ */
+static void sha1_hex(const char *data, size_t len, char *sha)
+{
+    unsigned int state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    unsigned char block[64];
+    size_t done = 0, rest;
+    int i;
+
+    for (; done + 64 <= len; done += 64)
+        sha1_block(state, (const unsigned char *)data + done);
+
+    // Last block: the rest, 0x80, zeros and the length in bits
+    rest = len - done;
+    memset(block, 0, sizeof(block));
+    memcpy(block, data + done, rest);
+    block[rest] = 0x80;
+    if (rest >= 56)
+    {
+        sha1_block(state, block);
+        memset(block, 0, sizeof(block));
+    }
+    for (i = 0; i < 8; i++)
+        block[63 - i] = (unsigned char)(((unsigned long long)len * 8) >> (8 * i));
+    sha1_block(state, block);
+
+    for (i = 0; i < 40; i++)
+    {
+        unsigned int nibble = (state[i / 8] >> (28 - 4 * (i % 8))) & 0x0F;
+        sha[i] = (char)(nibble < 10 ? 0x30 + nibble : 0x61 + nibble - 10); // ASCII '0'-'9', 'a'-'f'
+    }
+    sha[SCRIPT_SHA] = '\0';
+}
+
+/**********************************************************************/
+/* Script Registry */
+/**********************************************************************/
+
+typedef struct
+{
+    char sha[SCRIPT_SHA + 1]; // SHA1 (ASCII), empty when the slot is free
+    char *body;               // Script body (ASCII)
+    size_t len;               // Length of the body
+    unsigned int loaded;      // Bit per endpoint where SCRIPT LOAD succeeded
+} RedisScript;
+
+static RedisScript scripts[SCRIPT_SLOTS];
+static int script_next = 0; // Slot replaced when the registry is full
+static pthread_mutex_t script_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Function: find_script
+ * Description: Looks a script up by SHA1. Caller holds script_lock.
+ * Returns:
+ *   - The entry, NULL if the script is not registered.
+ */
+static RedisScript *find_script(const char *sha)
+{
+    int i;
+
+    for (i = 0; i < SCRIPT_SLOTS; i++)
+    {
+        if (scripts[i].body != NULL && memcmp(scripts[i].sha, sha, SCRIPT_SHA) == 0)
+            return &scripts[i];
+    }
+    return NULL;
+}
+
+/**
+ * Function: redis_script_register
+ * Description: Adds a Lua script to the job's script registry and returns
+ *              its SHA1. When all slots are taken the oldest registration
+ *              is replaced; its SHA1 keeps working through EVALSHA for as
+ *              long as Redis has the script.
+ * Parameters:
+ *   - script: Script body (EBCDIC, or ASCII for the scripts compiled in).
+ *   - len: Length of the body.
+ *   - ascii: 1 if the body is already ASCII.
+ *   - sha: Receives the SHA1 (40 lowercase hex digits, ASCII,
+ *     null-terminated).
+ * Returns:
+ *   - 0 on success, -1 if the body cannot be converted or stored.
+ */
+int redis_script_register(const char *script, size_t len, int ascii, char *sha)
+{
+    RedisScript *entry;
+    char *body = malloc(len + 1);
+
+    if (body == NULL || (!ascii && ConvertToASCII((char *)script, len, body, len + 1) != 0))
+    {
+        free(body);
+        return -1;
+    }
+    if (ascii)
+        memcpy(body, script, len);
+    sha1_hex(body, len, sha);
+
+    pthread_mutex_lock(&script_lock);
+    if (find_script(sha) != NULL)
+    {
+        pthread_mutex_unlock(&script_lock);
+        free(body); // Already registered
+        return 0;
+    }
+    entry = &scripts[script_next];
+    script_next = (script_next + 1) % SCRIPT_SLOTS;
+    free(entry->body);
+    memcpy(entry->sha, sha, SCRIPT_SHA + 1);
+    entry->body = body;
+    entry->len = len;
+    entry->loaded = 0;
+    pthread_mutex_unlock(&script_lock);
+    return 0;
+}
+
+/**
+ * Function: set_script_loaded
+ * Description: Records whether an endpoint has a script.
+ */
+static void set_script_loaded(const char *sha, int endpoint, int loaded)
+{
+    RedisScript *entry;
+
+    if (endpoint < 0 || endpoint >= REDIS_MAX_ENDPOINTS)
+        return;
+    pthread_mutex_lock(&script_lock);
+    entry = find_script(sha);
+    if (entry != NULL && loaded)
+        entry->loaded |= 1u << endpoint;
+    else if (entry != NULL)
+        entry->loaded &= ~(1u << endpoint);
+    pthread_mutex_unlock(&script_lock);
+}
+
+/**********************************************************************/
+/* Script Execution */
+/**********************************************************************/
+
+/**
+ * Function: build_script_command
+ * Description: Encodes SCRIPT LOAD (when the endpoint may not have the
+ *              script) and EVALSHA in the call's arena, where they stay
+ *              until the connection is released.
+ * Parameters:
+ *   - sha: SHA1 of the script (ASCII).
+ *   - endpoint: Endpoint of the connection, -1 if unknown.
+ *   - reload: 1 to send SCRIPT LOAD even if the endpoint has the script.
+ *   - eval: 1 to add EVALSHA, 0 for SCRIPT LOAD alone.
+ *   - argc, argv, argl, keys: Keys and arguments of EVALSHA (EBCDIC).
+ *   - len: Receives the length of the commands.
+ *   - load: Receives 1 if SCRIPT LOAD was added, -1 if the script is
+ *     not registered.
+ * Returns:
+ *   - The commands (ASCII), NULL if out of memory or not convertible.
+ */
+static char *build_script_command(const char *sha, int endpoint, int reload, int eval, int argc,
+                                  const char **argv, const size_t *argl, int keys, int *len, int *load)
+{
+    char digits[REDIS_DOUBLE_TEXT];
+    RedisScript *entry;
+    size_t size = 160;
+    char *buf = NULL;
+    int pos = 0, i;
+
+    for (i = 0; i < argc; i++)
+        size += argl[i] + 30; // "$" + 20 digits + CRLF, value, CRLF and slack
+
+    pthread_mutex_lock(&script_lock);
+    entry = find_script(sha);
+    *load = entry == NULL ? -1
+            : reload || endpoint < 0 || endpoint >= REDIS_MAX_ENDPOINTS || !(entry->loaded & (1u << endpoint));
+    if (*load == 1)
+        size += entry->len + 90;
+    buf = redis_arena_alloc(size);
+    if (buf != NULL && *load == 1)
+    {
+        memcpy(buf, REDIS_TEMPLATE_SCRIPT, sizeof(REDIS_TEMPLATE_SCRIPT) - 1);
+        pos = sizeof(REDIS_TEMPLATE_SCRIPT) - 1;
+        pos = append_redis_argument(buf, size, pos, "\xD3\xD6\xC1\xC4", 4, 0); // EBCDIC "LOAD"
+        pos = append_redis_argument(buf, size, pos, entry->body, entry->len, 1);
+    }
+    pthread_mutex_unlock(&script_lock);
+    if (buf == NULL)
+        return NULL;
+
+    if (eval)
+    {
+        pos = append_redis_header(buf, size, pos, argc + 3);
+        pos = append_redis_argument(buf, size, pos, "\xC5\xE5\xC1\xD3\xE2\xC8\xC1", 7, 0); // EBCDIC "EVALSHA"
+        pos = append_redis_argument(buf, size, pos, sha, SCRIPT_SHA, 1);
+        pos = append_redis_argument(buf, size, pos, digits, format_redis_integer(keys, digits), 1);
+        for (i = 0; i < argc && pos >= 0; i++)
+            pos = append_redis_argument(buf, size, pos, argv[i], argl[i], 0);
+    }
+    *len = pos;
+    return pos < 0 ? NULL : buf;
+}
+
+/**
+ * Function: error_message
+ * Description: Copies the text of an error reply to msgtext.
+ */
+static void error_message(const char *reply, size_t len, char *msgtext)
+{
+    RedisReplyItem item;
+    size_t pos = 0;
+    int n;
+
+    if (redis_reply_item(reply, len, &pos, &item) != 0)
+    {
+        strcpy(msgtext, "Failed to parse Redis response");
+        return;
+    }
+    n = item.len < 70 ? (int)item.len : 70;
+    ConvertToEBCDIC((char *)item.data, n, msgtext, 70);
+    msgtext[n] = '\0';
+}
+
+/**
+ * Function: run_script
+ * Description: Sends SCRIPT LOAD and/or EVALSHA on a held connection and
+ *              leaves the EVALSHA reply alone in buf.
+ * Parameters:
+ *   - eval: 1 to run the script, 0 to load it only.
+ *   - Others: As for eval_redis_script.
+ * Returns:
+ *   - Length of the EVALSHA reply (0 when loading only), -1 on failure.
+ */
+static int run_script(int sockfd, const char *sha, int eval, int argc, const char **argv,
+                      const size_t *argl, int keys, char *buf, size_t size, char *sqlstate,
+                      char *msgtext)
+{
+    int endpoint = redis_connection_endpoint(sockfd);
+    int attempt, cmd_len, load, len, i;
+    long span, first;
+    char *cmd;
+
+    for (attempt = 0;; attempt++)
+    {
+        cmd = build_script_command(sha, endpoint, attempt > 0 || !eval, eval, argc, argv, argl, keys, &cmd_len, &load);
+        if (cmd == NULL)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, "Failed to convert command to ASCII");
+            return -1;
+        }
+        if (!eval && load < 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Script is not registered");
+            return -1;
+        }
+        if (send_redis_command(sockfd, cmd, cmd_len) < 0)
+        {
+            strcpy(sqlstate, "38903");
+            strcpy(msgtext, "Failed to send command to Redis");
+            return -1;
+        }
+
+        len = recv_redis_replies(sockfd, buf, size - 1, (load == 1) + eval);
+        if (len < 0)
+        {
+            if (errno == EWOULDBLOCK || errno == EAGAIN)
+            {
+                strcpy(sqlstate, "38904");
+                strcpy(msgtext, "Receive timeout from Redis");
+            }
+            else
+            {
+                strcpy(sqlstate, "38905");
+                strcpy(msgtext, "Failed to receive data from Redis");
+            }
+            return -1;
+        }
+        if (len == 0)
+        {
+            strcpy(sqlstate, "38906");
+            strcpy(msgtext, "Connection closed by Redis");
+            return -1;
+        }
+        span = first = 0;
+        for (i = 0; i < (load == 1) + eval && span >= 0; i++)
+        {
+            span = redis_reply_span(buf, len, (size_t)span);
+            if (i == 0)
+                first = span;
+        }
+        if (span < 0)
+        {
+            strcpy(sqlstate, (size_t)len >= size - 1 ? "38908" : "38909");
+            strcpy(msgtext, (size_t)len >= size - 1 ? "Response exceeds maximum length"
+                                                    : "Failed to parse Redis response");
+            return -1;
+        }
+
+        // The SCRIPT LOAD reply: an error means the script does not compile
+        if (load == 1)
+        {
+            if (buf[0] == 0x2D) // ASCII '-'
+            {
+                error_message(buf, len, msgtext);
+                strcpy(sqlstate, "38911");
+                return -1;
+            }
+            set_script_loaded(sha, endpoint, 1);
+            memmove(buf, buf + first, len - first);
+            len -= (int)first;
+        }
+        buf[len] = '\0';
+
+        // -NOSCRIPT: the endpoint lost the script, load it and run again
+        if (eval && load == 0 && attempt == 0 && len > 9 &&
+            memcmp(buf, "\x2D\x4E\x4F\x53\x43\x52\x49\x50\x54", 9) == 0) // ASCII "-NOSCRIPT"
+        {
+            set_script_loaded(sha, endpoint, 0);
+            continue;
+        }
+        return len;
+    }
+}
+
+/**
+ * Function: eval_redis_script
+ * Description: Runs a script by its SHA1 with EVALSHA on a connection the
+ *              caller holds, loading it first where needed. The reply of
+ *              EVALSHA is returned as received, error replies included.
+ * Parameters:
+ *   - sockfd: Connection (released by the caller, also after a failure).
+ *   - sha: SHA1 of the script (40 hex digits, ASCII).
+ *   - argc: Number of keys and arguments.
+ *   - argv: Keys, then arguments (EBCDIC).
+ *   - argl: Their lengths.
+ *   - keys: Number of entries of argv that are keys.
+ *   - buf: Receives the EVALSHA reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure (38902-38911).
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure.
+ */
+int eval_redis_script(int sockfd, const char *sha, int argc, const char **argv, const size_t *argl,
+                      int keys, char *buf, size_t size, char *sqlstate, char *msgtext)
+{
+    return run_script(sockfd, sha, 1, argc, argv, argl, keys, buf, size, sqlstate, msgtext);
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: scriptLoadRedis
+ * Description: SQL external function registering a Lua script for the job
+ *              and loading it into Redis. The returned SHA1 can be passed
+ *              to REDIS_EVAL instead of the body.
+ * Parameters:
+ *   - script: Input Lua script (VARCHAR(16370), EBCDIC).
+ *   - value: Output SHA1 of the script (VARCHAR(40), EBCDIC).
+ *   - scriptInd: Null indicator for the input script.
+ *   - valueInd: Null indicator for the output value.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38911" with the
+ *     compiler message when the script does not compile.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN scriptLoadRedis(
+    SQLUDF_VARCHAR *script,    // Input: Lua script (EBCDIC)
+    SQLUDF_VARCHAR *value,     // Output: SHA1 of the script (EBCDIC)
+    SQLUDF_NULLIND *scriptInd, // Null indicator for input
+    SQLUDF_NULLIND *valueInd,  // Null indicator for output
+    char *sqlstate,            // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,            // Fully qualified function name
+    char *specname,            // Specific name
+    char *msgtext,             // Error message text (up to 70 chars)
+    short *sqlcode,            // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)   // Additional null indicators for DB2SQL
+{
+    char sha[SCRIPT_SHA + 1], recv_buf[1024];
+    size_t len;
+    int sockfd;
+
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        *valueInd = -1;
+        return;
+    }
+#endif
+
+    // Initialize SQLSTATE to success
+    strcpy(sqlstate, "00000");
+    msgtext[0] = '\0';
+    *valueInd = -1;
+
+    // Check for NULL or empty input
+    if (*scriptInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input script is NULL");
+        return;
+    }
+    len = strlen(script);
+    if (len == 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Input script is empty");
+        return;
+    }
+
+    if (redis_script_register(script, len, 0, sha) != 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory for the script registry");
+        return;
+    }
+
+    // Load it on the primary now, so a script that does not compile fails here
+    if (connect_to_redis(&sockfd) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+        return;
+    }
+    if (run_script(sockfd, sha, 0, 0, NULL, NULL, 0, recv_buf, sizeof(recv_buf), sqlstate, msgtext) < 0)
+    {
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    release_redis_connection(sockfd, sqlstate);
+
+    ConvertToEBCDIC(sha, SCRIPT_SHA, value, SCRIPT_SHA + 1);
+    value[SCRIPT_SHA] = '\0';
+    *valueInd = 0;
+}
+
+#pragma linkage(scriptLoadRedis, OS)
@@ -0,0 +1,556 @@
+/******************************************************************************
+ * File: redissent.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Redis Sentinel support for the REDISILE service program.
+ *              When REDIS_SENTINELS is set, the primary (and, unless
+ *              REDIS_REPLICAS is given, the replicas) of REDIS_MASTER_NAME
+ *              are resolved from the first Sentinel that answers and
+ *              cached. A subscription to +switch-master on that Sentinel
+ *              is checked before every connection is handed out, so a
+ *              failover moves all new calls to the new primary at once.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/**********************************************************************/
+/* Sentinel State */
+/**********************************************************************/
+
+typedef struct
+{
+    char addr[64]; // IPv4 address (job CCSID)
+    int port;      // TCP port
+} RedisSentinelNode;
+
+static int subscription_fd = -1;          // Socket subscribed to +switch-master
+static char subscription_buf[4096];       // Unparsed subscription data (ASCII)
+static size_t subscription_len = 0;
+static int resolved = 0;                  // The primary was resolved at least once
+static struct timeval last_attempt;       // Last time the Sentinels were queried
+static RedisSentinelNode known_replicas[REDIS_MAX_ENDPOINTS];
+static int known_replica_count = 0;
+static pthread_mutex_t sentinel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Function: sentinel_command
+ * Description: Encodes "SENTINEL <subcommand> <master name>" or another
+ *              command taking the master name / channel (ASCII).
+ * Parameters:
+ *   - buf: Output buffer (ASCII).
+ *   - size: Size of the output buffer.
+ *   - argc: Number of fixed arguments (EBCDIC) before the last one.
+ *   - argv: Fixed arguments (EBCDIC).
+ *   - argl: Lengths of the fixed arguments.
+ *   - last: Last argument (job CCSID, null-terminated).
+ * Returns:
+ *   - Length of the command, negative value on failure.
+ */
+static int sentinel_command(char *buf, size_t size, int argc, const char **argv, const size_t *argl,
+                            const char *last)
+{
+    char ebcdic[512], name[128];
+    const char *args[4];
+    size_t lens[4];
+    int i, len;
+
+    if (argc > 3 || strlen(last) >= sizeof(name))
+        return -1;
+    for (i = 0; i < argc; i++)
+    {
+        args[i] = argv[i];
+        lens[i] = argl[i];
+    }
+#ifdef __OS400__
+    strcpy(name, last);
+#else
+    ConvertToEBCDIC((char *)last, strlen(last), name, sizeof(name) - 1);
+#endif
+    args[argc] = name;
+    lens[argc] = strlen(last);
+
+    len = format_redis_command(ebcdic, sizeof(ebcdic), argc + 1, args, lens);
+    if (len < 0 || (size_t)len >= size)
+        return -1;
+    ConvertToASCII(ebcdic, len, buf, size);
+    return len;
+}
+
+/**
+ * Function: receive_reply
+ * Description: Receives one complete reply from a Sentinel. Sentinel
+ *              connections are not pooled: a reply that is malformed or
+ *              does not fit is a failure, and the caller closes the
+ *              socket.
+ * Parameters:
+ *   - sockfd: Connection to the Sentinel.
+ *   - buf: Buffer to receive the reply (ASCII).
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Length of the reply, negative value on failure or if the
+ *     connection was closed.
+ */
+static int receive_reply(int sockfd, char *buf, size_t size)
+{
+    size_t total = 0;
+    long span;
+    int len;
+
+    while (total < size)
+    {
+        len = recv_redis_stream(sockfd, buf + total, size - total);
+        if (len <= 0)
+            return -1;
+        total += len;
+        span = redis_reply_span(buf, total, 0);
+        if (span >= 0)
+            return (int)span;
+        if (span == -2)
+            return -1;
+    }
+    return -1;
+}
+
+/**
+ * Function: read_bulk
+ * Description: Reads a bulk string ("$<len>\r\n<data>\r\n", ASCII).
+ * Parameters:
+ *   - buf: Reply buffer (ASCII).
+ *   - len: Length of the reply.
+ *   - pos: Offset of the '$'; updated past the string.
+ *   - data: Receives a pointer to the data.
+ *   - data_len: Receives the length of the data.
+ * Returns:
+ *   - 0 on success, negative value if malformed or nil.
+ */
+static int read_bulk(const char *buf, size_t len, size_t *pos, const char **data, size_t *data_len)
+{
+    size_t p = *pos, n = 0;
+
+    if (p >= len || buf[p] != 0x24) // ASCII '$'
+        return -1;
+    for (p++; p < len && buf[p] >= 0x30 && buf[p] <= 0x39; p++)
+        n = n * 10 + (buf[p] - 0x30);
+    if (p + 2 + n + 2 > len || buf[p] != 0x0D)
+        return -1;
+    *data = buf + p + 2;
+    *data_len = n;
+    *pos = p + 2 + n + 2;
+    return 0;
+}
+
+/**
+ * Function: read_array_header
+ * Description: Reads an array header ("*<count>\r\n", ASCII).
+ * Parameters:
+ *   - buf: Reply buffer (ASCII).
+ *   - len: Length of the reply.
+ *   - pos: Offset of the '*'; updated past the header.
+ * Returns:
+ *   - Element count, negative value if malformed or nil.
+ */
+static long read_array_header(const char *buf, size_t len, size_t *pos)
+{
+    size_t p = *pos;
+    long n = 0;
+
+    if (p >= len || buf[p] != 0x2A) // ASCII '*'
+        return -1;
+    for (p++; p < len && buf[p] >= 0x30 && buf[p] <= 0x39; p++)
+        n = n * 10 + (buf[p] - 0x30);
+    if (p + 1 >= len || buf[p] != 0x0D)
+        return -1;
+    *pos = p + 2;
+    return n;
+}
+
+/**
+ * Function: ascii_to_native
+ * Description: Copies an ASCII field into a null-terminated job CCSID string.
+ * Returns:
+ *   - 0 on success, negative value if it does not fit.
+ */
+static int ascii_to_native(const char *ascii, size_t len, char *out, size_t size)
+{
+    if (len >= size)
+        return -1;
+#ifdef __OS400__
+    ConvertToEBCDIC((char *)ascii, len, out, size - 1);
+#else
+    memcpy(out, ascii, len);
+#endif
+    out[len] = '\0';
+    return 0;
+}
+
+/**
+ * Function: ascii_number
+ * Description: Parses ASCII digits.
+ */
+static int ascii_number(const char *ascii, size_t len)
+{
+    int n = 0;
+    size_t i;
+
+    for (i = 0; i < len && ascii[i] >= 0x30 && ascii[i] <= 0x39; i++)
+        n = n * 10 + (ascii[i] - 0x30);
+    return n;
+}
+
+/**
+ * Function: contains
+ * Description: Tells whether an ASCII field contains a token.
+ */
+static int contains(const char *field, size_t len, const char *token, size_t token_len)
+{
+    size_t i;
+
+    for (i = 0; i + token_len <= len; i++)
+    {
+        if (memcmp(field + i, token, token_len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**********************************************************************/
+/* Sentinel Queries */
+/**********************************************************************/
+
+/**
+ * Function: query_primary
+ * Description: Asks a Sentinel for the primary of REDIS_MASTER_NAME.
+ * Parameters:
+ *   - sockfd: Connection to the Sentinel.
+ *   - addr: Receives the address (job CCSID).
+ *   - addr_size: Size of addr.
+ *   - port: Receives the port.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int query_primary(int sockfd, char *addr, size_t addr_size, int *port)
+{
+    static const char *argv[] = {
+        "\xE2\xC5\xD5\xE3\xC9\xD5\xC5\xD3", // EBCDIC "SENTINEL"
+        "\xC7\xC5\xE3\x60\xD4\xC1\xE2\xE3\xC5\xD9\x60\xC1\xC4\xC4\xD9\x60\xC2\xE8\x60\xD5\xC1\xD4\xC5"}; // EBCDIC "GET-MASTER-ADDR-BY-NAME"
+    static const size_t argl[] = {8, 23};
+    char cmd[256], reply[512];
+    const char *data;
+    size_t data_len, pos = 0;
+    int len;
+
+    len = sentinel_command(cmd, sizeof(cmd), 2, argv, argl, REDIS_MASTER_NAME);
+    if (len < 0 || send(sockfd, cmd, len, 0) != len)
+        return -1;
+    len = receive_reply(sockfd, reply, sizeof(reply));
+    if (len <= 0 || read_array_header(reply, len, &pos) != 2)
+        return -1; // Nil array: the master name is unknown to this Sentinel
+    if (read_bulk(reply, len, &pos, &data, &data_len) != 0 ||
+        ascii_to_native(data, data_len, addr, addr_size) != 0)
+        return -1;
+    if (read_bulk(reply, len, &pos, &data, &data_len) != 0)
+        return -1;
+    *port = ascii_number(data, data_len);
+    return *port > 0 ? 0 : -1;
+}
+
+/**
+ * Function: query_replicas
+ * Description: Asks a Sentinel for the healthy replicas of REDIS_MASTER_NAME
+ *              and makes them the replica set used for read-only commands.
+ * Parameters:
+ *   - sockfd: Connection to the Sentinel.
+ */
+static void query_replicas(int sockfd)
+{
+    static const char *argv[] = {
+        "\xE2\xC5\xD5\xE3\xC9\xD5\xC5\xD3", // EBCDIC "SENTINEL"
+        "\xD9\xC5\xD7\xD3\xC9\xC3\xC1\xE2"}; // EBCDIC "REPLICAS"
+    static const size_t argl[] = {8, 8};
+    RedisSentinelNode found[REDIS_MAX_ENDPOINTS];
+    char cmd[256], *reply;
+    const char *field, *value;
+    size_t field_len, value_len, pos = 0;
+    long replicas, fields, i, j;
+    int len, count = 0, healthy;
+
+    len = sentinel_command(cmd, sizeof(cmd), 2, argv, argl, REDIS_MASTER_NAME);
+    if (len < 0 || send(sockfd, cmd, len, 0) != len)
+        return;
+    reply = malloc(32768);
+    if (reply == NULL)
+        return;
+    len = receive_reply(sockfd, reply, 32768);
+    replicas = len > 0 ? read_array_header(reply, len, &pos) : -1;
+    if (replicas < 0)
+    {
+        free(reply);
+        return;
+    }
+
+    // Each replica is a flat list of field/value pairs
+    for (i = 0; i < replicas && count < REDIS_MAX_ENDPOINTS; i++)
+    {
+        fields = read_array_header(reply, len, &pos);
+        if (fields < 0)
+            break;
+        found[count].addr[0] = '\0';
+        found[count].port = 0;
+        healthy = 1;
+        for (j = 0; j + 1 < fields; j += 2)
+        {
+            if (read_bulk(reply, len, &pos, &field, &field_len) != 0 ||
+                read_bulk(reply, len, &pos, &value, &value_len) != 0)
+            {
+                free(reply);
+                return;
+            }
+            if (field_len == 2 && memcmp(field, "\x69\x70", 2) == 0) // ASCII "ip"
+                ascii_to_native(value, value_len, found[count].addr, sizeof(found[count].addr));
+            else if (field_len == 4 && memcmp(field, "\x70\x6F\x72\x74", 4) == 0) // ASCII "port"
+                found[count].port = ascii_number(value, value_len);
+            else if (field_len == 5 && memcmp(field, "\x66\x6C\x61\x67\x73", 5) == 0) // ASCII "flags"
+                healthy = !contains(value, value_len, "\x5F\x64\x6F\x77\x6E", 5) && // ASCII "_down"
+                          !contains(value, value_len, "\x64\x69\x73\x63\x6F\x6E\x6E\x65\x63\x74\x65\x64", 12); // ASCII "disconnected"
+        }
+        if (healthy && found[count].addr[0] != '\0' && found[count].port > 0)
+            count++;
+    }
+    free(reply);
+
+    for (i = 0; i < known_replica_count; i++)
+        set_redis_replica(known_replicas[i].addr, known_replicas[i].port, 0);
+    for (i = 0; i < count; i++)
+    {
+        set_redis_replica(found[i].addr, found[i].port, 1);
+        known_replicas[i] = found[i];
+    }
+    known_replica_count = count;
+}
+
+/**
+ * Function: subscribe_switch_master
+ * Description: Opens the +switch-master subscription on a Sentinel.
+ * Parameters:
+ *   - addr: Sentinel address (job CCSID).
+ *   - port: Sentinel port.
+ */
+static void subscribe_switch_master(const char *addr, int port)
+{
+    static const char *argv[] = {"\xE2\xE4\xC2\xE2\xC3\xD9\xC9\xC2\xC5"}; // EBCDIC "SUBSCRIBE"
+    static const size_t argl[] = {9};
+    char cmd[128], reply[256];
+    int sockfd, len;
+
+    len = sentinel_command(cmd, sizeof(cmd), 1, argv, argl, "+switch-master"); // Channel (job CCSID)
+    if (len < 0 || connect_to_redis_addr(&sockfd, addr, port) != 0)
+        return;
+    if (send(sockfd, cmd, len, 0) != len || receive_reply(sockfd, reply, sizeof(reply)) <= 0)
+    {
+        close(sockfd);
+        return;
+    }
+    subscription_fd = sockfd;
+    subscription_len = 0;
+}
+
+/**
+ * Function: resolve_from_sentinels
+ * Description: Queries the Sentinels in REDIS_SENTINELS order until one
+ *              knows REDIS_MASTER_NAME, then updates the primary, the
+ *              replicas and (re)opens the subscription. Caller holds
+ *              sentinel_lock.
+ * Returns:
+ *   - 1 if the primary changed, 0 if not, negative value if no Sentinel answered.
+ */
+static int resolve_from_sentinels(void)
+{
+    const char *spec = REDIS_SENTINELS, *comma, *colon;
+    char sentinel[64], addr[64];
+    size_t len, addr_len;
+    int sentinel_port, port, sockfd, rc = -1;
+
+    gettimeofday(&last_attempt, NULL);
+    while (*spec != '\0' && rc < 0)
+    {
+        comma = strchr(spec, ',');
+        len = comma ? (size_t)(comma - spec) : strlen(spec);
+        while (len > 0 && *spec == ' ')
+        {
+            spec++;
+            len--;
+        }
+        colon = memchr(spec, ':', len);
+        addr_len = colon ? (size_t)(colon - spec) : len;
+        if (len > 0 && addr_len < sizeof(sentinel))
+        {
+            memcpy(sentinel, spec, addr_len);
+            sentinel[addr_len] = '\0';
+            sentinel_port = colon ? atoi(colon + 1) : 26379;
+
+            // Subscribe first so that no switch is missed after the query
+            if (subscription_fd < 0)
+                subscribe_switch_master(sentinel, sentinel_port);
+            if (connect_to_redis_addr(&sockfd, sentinel, sentinel_port) == 0)
+            {
+                if (query_primary(sockfd, addr, sizeof(addr), &port) == 0)
+                {
+                    rc = set_redis_primary(addr, port);
+                    if (REDIS_REPLICAS[0] == '\0')
+                        query_replicas(sockfd);
+                    resolved = 1;
+                }
+                close(sockfd);
+            }
+            if (rc < 0 && subscription_fd >= 0)
+            {
+                close(subscription_fd); // This Sentinel does not know the master
+                subscription_fd = -1;
+            }
+        }
+        if (comma == NULL)
+            break;
+        spec = comma + 1;
+    }
+    return rc;
+}
+
+/**
+ * Function: drain_subscription
+ * Description: Reads pending +switch-master messages without blocking.
+ *              Caller holds sentinel_lock.
+ * Returns:
+ *   - 1 if a failover of REDIS_MASTER_NAME was announced, 0 otherwise.
+ */
+static int drain_subscription(void)
+{
+    char name[128], addr[64];
+    const char *kind, *channel, *payload, *field[5];
+    size_t kind_len, channel_len, payload_len, field_len[5], pos, name_len;
+    struct timeval no_wait;
+    fd_set read_fds;
+    long span;
+    int received, n, i, switched = 0;
+
+    for (;;)
+    {
+        FD_ZERO(&read_fds);
+        FD_SET(subscription_fd, &read_fds);
+        no_wait.tv_sec = 0;
+        no_wait.tv_usec = 0;
+        if (select(subscription_fd + 1, &read_fds, NULL, NULL, &no_wait) <= 0)
+            break;
+        received = recv(subscription_fd, subscription_buf + subscription_len,
+                        sizeof(subscription_buf) - subscription_len, 0);
+        if (received <= 0 || subscription_len + received >= sizeof(subscription_buf))
+        {
+            // Sentinel went away (or sent garbage): resubscribe and re-query
+            close(subscription_fd);
+            subscription_fd = -1;
+            subscription_len = 0;
+            return 1;
+        }
+        subscription_len += received;
+    }
+
+    // Messages: *3 $7 message $14 +switch-master $<n> <name> <old ip> <old port> <new ip> <new port>
+    name_len = strlen(REDIS_MASTER_NAME);
+#ifdef __OS400__
+    ConvertToASCII(REDIS_MASTER_NAME, name_len, name, sizeof(name));
+#else
+    memcpy(name, REDIS_MASTER_NAME, name_len < sizeof(name) ? name_len : sizeof(name));
+#endif
+    pos = 0;
+    while (pos < subscription_len)
+    {
+        span = redis_reply_span(subscription_buf, subscription_len, pos);
+        if (span < 0)
+            break;
+        if (read_array_header(subscription_buf, span, &pos) == 3 &&
+            read_bulk(subscription_buf, span, &pos, &kind, &kind_len) == 0 &&
+            read_bulk(subscription_buf, span, &pos, &channel, &channel_len) == 0 &&
+            read_bulk(subscription_buf, span, &pos, &payload, &payload_len) == 0)
+        {
+            for (n = 0, i = 0; n < 5 && (size_t)i < payload_len; n++)
+            {
+                field[n] = payload + i;
+                while ((size_t)i < payload_len && payload[i] != 0x20)
+                    i++;
+                field_len[n] = payload + i - field[n];
+                i++;
+            }
+            if (n == 5 && field_len[0] == name_len && memcmp(field[0], name, name_len) == 0 &&
+                ascii_to_native(field[3], field_len[3], addr, sizeof(addr)) == 0)
+            {
+                set_redis_primary(addr, ascii_number(field[4], field_len[4]));
+                switched = 1;
+            }
+        }
+        pos = span;
+    }
+    memmove(subscription_buf, subscription_buf + pos, subscription_len - pos);
+    subscription_len -= pos;
+    return switched;
+}
+
+/**********************************************************************/
+/* Connection Layer Hooks */
+/**********************************************************************/
+
+/**
+ * Function: redis_sentinel_poll
+ * Description: Called before a connection is handed out. Applies pending
+ *              +switch-master events, resolves the primary on first use
+ *              and retries unreachable Sentinels at most once a second.
+ *              Costs one non-blocking select when nothing happened.
+ */
+void redis_sentinel_poll(void)
+{
+    struct timeval now;
+
+    if (REDIS_SENTINELS[0] == '\0')
+        return;
+    if (pthread_mutex_trylock(&sentinel_lock) != 0)
+        return; // Another thread is talking to the Sentinels
+
+    if (subscription_fd >= 0 && drain_subscription())
+        resolve_from_sentinels(); // Refresh replicas (or resubscribe)
+    if (!resolved || subscription_fd < 0)
+    {
+        gettimeofday(&now, NULL);
+        if (last_attempt.tv_sec == 0 || now.tv_sec - last_attempt.tv_sec >= 1)
+            resolve_from_sentinels();
+    }
+    pthread_mutex_unlock(&sentinel_lock);
+}
+
+/**
+ * Function: redis_sentinel_refresh
+ * Description: Asks the Sentinels for the primary again, e.g. after the
+ *              cached primary refused a connection.
+ * Returns:
+ *   - 1 if the primary changed, 0 otherwise.
+ */
+int redis_sentinel_refresh(void)
+{
+    int rc;
+
+    if (REDIS_SENTINELS[0] == '\0')
+        return 0;
+    pthread_mutex_lock(&sentinel_lock);
+    rc = resolve_from_sentinels();
+    pthread_mutex_unlock(&sentinel_lock);
+    return rc > 0;
+}
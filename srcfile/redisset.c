@@ -18,6 +18,9 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+#define REPLY_BUFFER 33000 // Size of each receive buffer
+
 /**********************************************************************/
 /* SQL External Function: SET */
 /**********************************************************************/
@@ -28,7 +31,8 @@
  * Parameters:
  *   - key: Input Redis key (VARCHAR(255), EBCDIC).
  *   - value: Input Redis value (VARCHAR(16370), EBCDIC).
- *   - response: Output Redis response (VARCHAR(128), EBCDIC).
+ *   - response: Output Redis response (VARCHAR(128), EBCDIC); "QUEUED" in
+ *     write-behind mode.
  *   - keyInd: Null indicator for the key.
  *   - valueInd: Null indicator for the value.
  *   - responseInd: Null indicator for the output response.
@@ -54,8 +58,7 @@ void SQL_API_FN setRedisValue(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[33000], ebcdic_payload[33000];
-	char ebcdic_key_len[10] = {0}, ebcdic_value_len[10] = {0};
+	char *ascii_send_buf, *recv_buf, *ebcdic_payload;
 	int len, total_len = 0;
 
 #ifdef USE_ICONV
@@ -91,103 +94,62 @@ void SQL_API_FN setRedisValue(
 	response[0] = '\0';
 	*responseInd = 0;
 
-	// Connect to Redis and log
-	if (connect_to_redis(&sockfd) != 0)
+	// Call buffers come from the thread's arena and are given back on release
+	ascii_send_buf = redis_arena_alloc(SEND_BUFFER + 2 * REPLY_BUFFER);
+	if (ascii_send_buf == NULL)
 	{
-		strncpy(sqlstate, "38901", 5);
-		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(-1, sqlstate);
 		return;
 	}
+	recv_buf = ascii_send_buf + SEND_BUFFER;
+	ebcdic_payload = recv_buf + REPLY_BUFFER;
 	// snprintf(msgtext, 70, "Connected to Redis socket=%d", sockfd);
 	// strncpy(sqlstate, "00001", 5); // Debug state
 	//*responseInd = 0;
 
-	// Format Redis SET command in EBCDIC
-	ebcdic_send_buf[0] = '\0';
-
-	// Calculate and format key length in EBCDIC (up to 255 bytes)
-	int key_len = strlen(key);
+	// Build SET command in ASCII: prebuilt "*3\r\n$3\r\nSET\r\n" plus key and value
+	size_t key_len = strlen(key);
 	if (key_len > 255)
 		key_len = 255; // Truncate to match VARCHAR(255)
-	if (key_len < 10)
-	{
-		ebcdic_key_len[0] = 0xF0 + key_len;
-		ebcdic_key_len[1] = '\0';
-	}
-	else
-	{
-		int i = 0, temp_len = key_len;
-		while (temp_len > 0)
-		{
-			ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_key_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_key_len[j];
-			ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
-			ebcdic_key_len[i - 1 - j] = tmp;
-		}
-	}
-
-	// Calculate and format value length in EBCDIC (up to 16370 bytes)
-	int value_len = strlen(value);
+	size_t value_len = strlen(value);
 	if (value_len > 16370)
 		value_len = 16370; // Truncate to match VARCHAR(16370)
-	if (value_len < 10)
+	const char *args[2] = {key, value};
+	size_t argl[2] = {key_len, value_len};
+	int cmd_len = format_redis_template(ascii_send_buf, SEND_BUFFER, REDIS_TEMPLATE(SET),
+	                                    2, args, argl);
+	if (cmd_len < 0)
 	{
-		ebcdic_value_len[0] = 0xF0 + value_len;
-		ebcdic_value_len[1] = '\0';
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Failed to convert command to ASCII", 70);
+		*responseInd = -1;
+		release_redis_connection(-1, sqlstate);
+		return;
 	}
-	else
+
+	// Write-behind mode: queue the command for the flusher and return
+	if (redis_write_behind_enabled())
 	{
-		int i = 0, temp_len = value_len;
-		while (temp_len > 0)
-		{
-			ebcdic_value_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_value_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_value_len[j];
-			ebcdic_value_len[j] = ebcdic_value_len[i - 1 - j];
-			ebcdic_value_len[i - 1 - j] = tmp;
-		}
+		if (redis_write_behind_queue(key, ascii_send_buf, cmd_len, sqlstate, msgtext) == 0)
+			strcpy(response, "\xD8\xE4\xC5\xE4\xC5\xC4"); // EBCDIC "QUEUED"
+		else
+			*responseInd = -1;
+		release_redis_connection(-1, sqlstate);
+		return;
 	}
 
-	// Build SET command in EBCDIC:
-	// 	"*3\r\n$3\r\nSET\r\n$<key_len>\r\n<key>\r\n$<value_len>\r\n<value>\r\n"
-	strcat(ebcdic_send_buf, "\x5C\xF3\x0D\x25\x5B\xF3\x0D\x25\xE2\xC5\xE3\x0D\x25"); // EBCDIC "*3\r\n$3\r\nSET\r\n"
-	strcat(ebcdic_send_buf, "\x5B");
-	strcat(ebcdic_send_buf, ebcdic_key_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, key, key_len); // Use strncat to limit to 255 bytes
-	strcat(ebcdic_send_buf, "\x0D\x25\x5B");
-	strcat(ebcdic_send_buf, ebcdic_value_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, value, value_len); // Use strncat to limit to 16370 bytes
-	strcat(ebcdic_send_buf, "\x0D\x25");
-
-	// Log EBCDIC command for debugging
-	// snprintf(msgtext, 70, "EBCDIC Command: %.20s...", ebcdic_send_buf);
-	// strncpy(sqlstate, "00001", 5); // Debug state
-	//*responseInd = 0;
-
-	// Convert EBCDIC SET command to ASCII before sending
-	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	// Connect to Redis and log
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
-		strncpy(sqlstate, "38902", 5);
-		strncpy(msgtext, "Failed to convert command to ASCII", 70);
+		strncpy(sqlstate, "38901", 5);
+		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(-1, sqlstate);
 		return;
 	}
-	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Log ASCII command for debugging
 	// snprintf(msgtext, 70, "ASCII Command: %.20s...", ascii_send_buf);
@@ -195,13 +157,13 @@ void SQL_API_FN setRedisValue(
 	//*responseInd = 0;
 
 	// Send SET command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, cmd_len);
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	// snprintf(msgtext, 70, "Sent SET command, bytes sent=%d", len);
@@ -209,7 +171,7 @@ void SQL_API_FN setRedisValue(
 	//*responseInd = 0;
 
 	// Receive response from Redis with detailed logging
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -223,7 +185,7 @@ void SQL_API_FN setRedisValue(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -231,7 +193,7 @@ void SQL_API_FN setRedisValue(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
@@ -244,12 +206,12 @@ void SQL_API_FN setRedisValue(
 	//*responseInd = 0;
 
 	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
+	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, REPLY_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38907", 5);
 		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ebcdic_payload[total_len] = '\0';
@@ -280,13 +242,11 @@ void SQL_API_FN setRedisValue(
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		snprintf(msgtext, 70, "Failed to extract payload from Redis reply: %.20s...", ebcdic_payload);
 		*responseInd = -1;
 	}
-	//if (payload)
-	//	free(payload);
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(setRedisValue, OS)
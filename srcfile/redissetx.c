@@ -19,6 +19,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of each send buffer
+
 /**********************************************************************/
 /* SQL External Function: SETEX */
 /**********************************************************************/
@@ -40,7 +42,8 @@ void SQL_API_FN setexRedisKey(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[1024], ebcdic_payload[1024];
+	char *ebcdic_send_buf, *ascii_send_buf;
+	char recv_buf[1024], ebcdic_payload[1024];
 	char ebcdic_key_len[10] = {0}, ebcdic_ttl_len[10] = {0}, ebcdic_value_len[10] = {0};
 	int len, total_len = 0;
 
@@ -86,15 +89,26 @@ void SQL_API_FN setexRedisKey(
 	*responseInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*responseInd = -1;
-		close(sockfd);
 		return;
 	}
 
+	// Call buffers come from the thread's arena and are given back on release
+	ebcdic_send_buf = redis_arena_alloc(2 * SEND_BUFFER);
+	if (ebcdic_send_buf == NULL)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
+		*responseInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	ascii_send_buf = ebcdic_send_buf + SEND_BUFFER;
+
 	// Format Redis SETEX command in EBCDIC
 	ebcdic_send_buf[0] = '\0';
 
@@ -198,29 +212,29 @@ void SQL_API_FN setexRedisKey(
 
 	// Convert EBCDIC command to ASCII before sending
 	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, SEND_BUFFER - 1) < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send SETEX command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -234,7 +248,7 @@ void SQL_API_FN setexRedisKey(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -242,7 +256,7 @@ void SQL_API_FN setexRedisKey(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
@@ -255,7 +269,7 @@ void SQL_API_FN setexRedisKey(
 		strncpy(sqlstate, "38907", 5);
 		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
 		*responseInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	ebcdic_payload[total_len] = '\0';
@@ -285,7 +299,7 @@ void SQL_API_FN setexRedisKey(
 		*responseInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(setexRedisKey, OS)
@@ -0,0 +1,214 @@
+/******************************************************************************
+ * File: redisshrd.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Client-side sharding for the REDISILE service program.
+ *              Spreads keys over the standalone servers listed in
+ *              REDIS_SHARDS with a ketama-style consistent-hash ring:
+ *              every shard owns REDIS_SHARD_VNODES points, a key belongs
+ *              to the first point at or after its hash, so adding or
+ *              removing a shard only moves the keys next to its points.
+ *              Keys with a {hash tag} are hashed on the tag only.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+/**********************************************************************/
+/* Consistent-Hash Ring */
+/**********************************************************************/
+
+typedef struct
+{
+    unsigned int hash; // Position on the ring
+    int endpoint;      // Shard owning the arc ending at this point
+} RedisRingPoint;
+
+static RedisRingPoint ring[REDIS_MAX_ENDPOINTS * REDIS_SHARD_VNODES];
+static int ring_points = 0;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Function: ring_hash
+ * Description: FNV-1a over the bytes, finished with the MurmurHash3 mixer
+ *              so that similar names spread evenly over the ring.
+ * Parameters:
+ *   - buf: Data (ASCII).
+ *   - len: Length of the data.
+ * Returns:
+ *   - 32-bit hash.
+ */
+static unsigned int ring_hash(const unsigned char *buf, size_t len)
+{
+    unsigned int h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= buf[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * Function: compare_points
+ * Description: qsort comparator ordering ring points by hash.
+ */
+static int compare_points(const void *a, const void *b)
+{
+    const RedisRingPoint *pa = (const RedisRingPoint *)a;
+    const RedisRingPoint *pb = (const RedisRingPoint *)b;
+
+    if (pa->hash != pb->hash)
+        return pa->hash < pb->hash ? -1 : 1;
+    return pa->endpoint - pb->endpoint;
+}
+
+/**
+ * Function: add_shard
+ * Description: Registers one "host[:port]" entry of REDIS_SHARDS and places
+ *              its points, named "<host>:<port>-<n>" (hashed in ASCII so the
+ *              ring is the same on every platform).
+ * Parameters:
+ *   - spec: Shard specification (job CCSID, not null-terminated).
+ *   - len: Length of the specification.
+ */
+static void add_shard(const char *spec, size_t len)
+{
+    char addr[64], name[96], ascii[96];
+    const char *colon;
+    size_t addr_len;
+    int port, endpoint, i, name_len;
+
+    while (len > 0 && *spec == ' ')
+    {
+        spec++;
+        len--;
+    }
+    while (len > 0 && spec[len - 1] == ' ')
+        len--;
+    if (len == 0)
+        return;
+
+    colon = memchr(spec, ':', len);
+    addr_len = colon ? (size_t)(colon - spec) : len;
+    if (addr_len >= sizeof(addr))
+        return;
+    memcpy(addr, spec, addr_len);
+    addr[addr_len] = '\0';
+    port = colon ? atoi(colon + 1) : REDIS_SERVER_PORT;
+
+    endpoint = find_redis_endpoint(addr, port);
+    if (endpoint < 0 || ring_points + REDIS_SHARD_VNODES > REDIS_MAX_ENDPOINTS * REDIS_SHARD_VNODES)
+        return;
+
+    for (i = 0; i < REDIS_SHARD_VNODES; i++)
+    {
+        name_len = sprintf(name, "%s:%d-%d", addr, port, i);
+#ifdef __OS400__
+        ConvertToASCII(name, name_len, ascii, sizeof(ascii));
+#else
+        memcpy(ascii, name, name_len);
+#endif
+        ring[ring_points].hash = ring_hash((unsigned char *)ascii, name_len);
+        ring[ring_points].endpoint = endpoint;
+        ring_points++;
+    }
+}
+
+/**
+ * Function: init_ring
+ * Description: Builds the ring from REDIS_SHARDS once per job.
+ */
+static void init_ring(void)
+{
+    const char *spec = REDIS_SHARDS, *comma;
+
+    while (*spec != '\0')
+    {
+        comma = strchr(spec, ',');
+        add_shard(spec, comma ? (size_t)(comma - spec) : strlen(spec));
+        if (comma == NULL)
+            break;
+        spec = comma + 1;
+    }
+    qsort(ring, ring_points, sizeof(RedisRingPoint), compare_points);
+}
+
+/**********************************************************************/
+/* Routing */
+/**********************************************************************/
+
+/**
+ * Function: redis_shards_enabled
+ * Description: Tells whether REDIS_SHARDS lists servers for client-side sharding.
+ * Returns:
+ *   - 1 when the consistent-hash ring has shards, 0 otherwise.
+ */
+int redis_shards_enabled(void)
+{
+    if (REDIS_SHARDS[0] == '\0')
+        return 0;
+    pthread_once(&ring_once, init_ring);
+    return ring_points > 0;
+}
+
+/**
+ * Function: redis_shard_for_key
+ * Description: Returns the shard owning a key: the first ring point at or
+ *              after the key's hash, wrapping around to the first point.
+ * Parameters:
+ *   - key: Redis key (EBCDIC).
+ *   - len: Length of the key.
+ * Returns:
+ *   - Endpoint index, negative value when REDIS_SHARDS is empty.
+ */
+int redis_shard_for_key(const char *key, size_t len)
+{
+    char small[256];
+    unsigned char *ascii = (unsigned char *)small;
+    size_t offset, hashed;
+    unsigned int hash;
+    int low, high, mid;
+
+    if (!redis_shards_enabled())
+        return -1;
+
+    if (len > sizeof(small))
+    {
+        ascii = malloc(len);
+        if (ascii == NULL)
+            return ring[0].endpoint;
+    }
+    ConvertToASCII((char *)key, len, (char *)ascii, len);
+    hashed = redis_hash_tag(ascii, len, &offset);
+    hash = ring_hash(ascii + offset, hashed);
+    if (ascii != (unsigned char *)small)
+        free(ascii);
+
+    low = 0;
+    high = ring_points;
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        if (ring[mid].hash < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return ring[low == ring_points ? 0 : low].endpoint;
+}
@@ -0,0 +1,776 @@
+/******************************************************************************
+ * File: redisstat.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Per-command statistics for the REDISILE service program and
+ *              the REDIS_STATS table function that reports them.
+ *              Every call that takes a connection is timed from
+ *              acquisition to release and counted under the name of the
+ *              first command it sends, together with its bytes on the
+ *              wire, its SQLSTATE and a latency histogram. Each thread
+ *              updates its own counters, so recording takes no lock;
+ *              REDIS_STATS adds them up when it is queried. Opening a
+ *              new connection (TCP connect and handshake) is counted as
+ *              the CONNECT command. Statistics cover the current job.
+ *              When REDIS_PROFILE switches profiling on, sampled calls
+ *              are also split into phases (connect, encode, translate,
+ *              send, wait, parse) by the probes of the shared call path.
+ *              Every finished call is also handed to the flight recorder
+ *              (redisfrec.c).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/**********************************************************************/
+/* Statistics Store */
+/**********************************************************************/
+
+#define STATS_COMMANDS 64 // Distinct command names tracked per job
+#define STATS_NAME_LEN 16 // Longest command name kept (ASCII, null-terminated)
+#define STATS_STATES 6    // Distinct error SQLSTATEs kept per command
+
+/**
+ * Histogram with 16 linear sub-buckets per power of two (HDR-style, about
+ * 6% resolution) from 1 microsecond to over an hour.
+ */
+#define STATS_SUB 16
+#define STATS_BUCKETS (STATS_SUB * 29)
+
+typedef struct
+{
+    long long calls;
+    long long errors;
+    char states[STATS_STATES][6]; // Error SQLSTATEs (job CCSID); the last one collects the rest
+    long long state_count[STATS_STATES];
+    long long sent;     // Bytes sent
+    long long received; // Bytes received
+    long long total_us; // Sum of the latencies
+    unsigned int max_us;
+    long long profiled;                 // Calls split into phases
+    long long phase_us[REDIS_PHASES];   // Time per phase over the profiled calls
+    long long bucket[STATS_BUCKETS];
+} RedisCommandStats;
+
+typedef struct RedisThreadStats
+{
+    struct RedisThreadStats *next;
+    RedisCommandStats *commands[STATS_COMMANDS]; // Allocated on first use
+    int number;                                  // Thread number within the job
+
+    // Call in progress on this thread
+    int depth;                  // Connections held (redirections, fan-out)
+    struct timeval start;       // Acquisition of the first connection
+    char name[STATS_NAME_LEN];  // First command sent (ASCII), empty until then
+    long long sent, received;
+    char command[REDIS_RECORDER_PREFIX]; // Beginning of the first command (ASCII)
+    char reply[REDIS_RECORDER_PREFIX];   // Beginning of the first reply (ASCII)
+    size_t command_len, reply_len;
+
+    // Phase profiling of the call in progress
+    unsigned int sample_count;        // Calls started, for the sampling rate
+    int sampled;                      // The call in progress is profiled
+    int probe_level;                  // Nesting of probe regions
+    int replied;                      // A reply was received (gaps are PARSE)
+    struct timeval mark;              // End of the last timed region
+    long long phase_us[REDIS_PHASES];
+} RedisThreadStats;
+
+static char command_names[STATS_COMMANDS][STATS_NAME_LEN] = {
+    {0x43, 0x4F, 0x4E, 0x4E, 0x45, 0x43, 0x54}}; // ASCII "CONNECT"
+static int command_count = 1;
+static int thread_count = 0;
+static volatile int profile_rate = 0; // REDIS_PROFILE: 0 = off, N = every Nth call
+static RedisThreadStats *thread_list = NULL;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Function: create_stats_key
+ * Description: Creates the thread-specific key of the statistics blocks.
+ *              Blocks outlive their threads so that the job totals stay
+ *              complete.
+ */
+static void create_stats_key(void)
+{
+    pthread_key_create(&stats_key, NULL);
+}
+
+/**
+ * Function: thread_stats
+ * Description: Returns the statistics block of the current thread,
+ *              creating and registering it on first use.
+ * Returns:
+ *   - Statistics block, NULL if it cannot be allocated.
+ */
+static RedisThreadStats *thread_stats(void)
+{
+    RedisThreadStats *ts;
+
+    pthread_once(&stats_once, create_stats_key);
+    ts = (RedisThreadStats *)pthread_getspecific(stats_key);
+    if (ts != NULL)
+        return ts;
+
+    ts = calloc(1, sizeof(RedisThreadStats));
+    if (ts == NULL)
+        return NULL;
+    pthread_setspecific(stats_key, ts);
+    pthread_mutex_lock(&stats_lock);
+    ts->number = ++thread_count;
+    ts->next = thread_list;
+    thread_list = ts;
+    pthread_mutex_unlock(&stats_lock);
+    return ts;
+}
+
+/**
+ * Function: command_index
+ * Description: Returns the slot of a command name, registering the name on
+ *              first use. Names are only ever appended, so the lookup runs
+ *              without the lock.
+ * Parameters:
+ *   - name: Command name (ASCII, null-terminated).
+ * Returns:
+ *   - Slot index, negative value when the table is full.
+ */
+static int command_index(const char *name)
+{
+    int i, count = command_count;
+
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(command_names[i], name) == 0)
+            return i;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    for (i = 0; i < command_count; i++)
+    {
+        if (strcmp(command_names[i], name) == 0)
+            break;
+    }
+    if (i == command_count)
+    {
+        if (command_count < STATS_COMMANDS)
+        {
+            strcpy(command_names[i], name);
+            command_count++;
+        }
+        else
+        {
+            i = -1;
+        }
+    }
+    pthread_mutex_unlock(&stats_lock);
+    return i;
+}
+
+/**
+ * Function: stats_bucket
+ * Description: Returns the histogram bucket of a latency.
+ * Parameters:
+ *   - us: Latency in microseconds.
+ * Returns:
+ *   - Bucket index.
+ */
+static int stats_bucket(unsigned int us)
+{
+    int bits = 0, index;
+    unsigned int v = us;
+
+    if (us < STATS_SUB)
+        return (int)us;
+    while (v >>= 1)
+        bits++;
+    // bits >= 4: keep the top five bits of the value
+    index = (bits - 3) * STATS_SUB + (int)(us >> (bits - 4)) - STATS_SUB;
+    return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+}
+
+/**
+ * Function: stats_bucket_upper
+ * Description: Returns the highest latency that falls into a bucket.
+ * Parameters:
+ *   - index: Bucket index.
+ * Returns:
+ *   - Latency in microseconds.
+ */
+static unsigned int stats_bucket_upper(int index)
+{
+    int shift;
+
+    if (index < STATS_SUB)
+        return (unsigned int)index;
+    shift = index / STATS_SUB - 1;
+    return ((unsigned int)(index % STATS_SUB + STATS_SUB + 1) << shift) - 1;
+}
+
+/**
+ * Function: record_command
+ * Description: Adds one call to the current thread's counters.
+ * Parameters:
+ *   - ts: Statistics block of the current thread.
+ *   - name: Command name (ASCII, null-terminated).
+ *   - us: Latency in microseconds.
+ *   - sqlstate: SQLSTATE of the call; anything outside class 00-02 is an error.
+ *   - sent: Bytes sent.
+ *   - received: Bytes received.
+ *   - phase_us: Time per phase, NULL if the call was not profiled.
+ */
+static void record_command(RedisThreadStats *ts, const char *name, unsigned int us,
+                           const char *sqlstate, long long sent, long long received,
+                           const long long *phase_us)
+{
+    RedisCommandStats *cs;
+    int index = command_index(name), i;
+
+    if (index < 0)
+        return;
+    cs = ts->commands[index];
+    if (cs == NULL)
+    {
+        cs = calloc(1, sizeof(RedisCommandStats));
+        if (cs == NULL)
+            return;
+        ts->commands[index] = cs;
+    }
+
+    cs->calls++;
+    cs->sent += sent;
+    cs->received += received;
+    cs->total_us += us;
+    cs->bucket[stats_bucket(us)]++;
+    if (us > cs->max_us)
+        cs->max_us = us;
+    if (phase_us != NULL)
+    {
+        cs->profiled++;
+        for (i = 0; i < REDIS_PHASES; i++)
+            cs->phase_us[i] += phase_us[i];
+    }
+
+    if (sqlstate[0] == '0' && sqlstate[1] <= '2')
+        return;
+    cs->errors++;
+    for (i = 0; i < STATS_STATES - 1; i++)
+    {
+        if (cs->states[i][0] == '\0')
+            memcpy(cs->states[i], sqlstate, 5);
+        if (memcmp(cs->states[i], sqlstate, 5) == 0)
+            break;
+    }
+    if (i == STATS_STATES - 1)
+        memcpy(cs->states[i], "?????", 5); // Too many distinct states
+    cs->state_count[i]++;
+}
+
+/**
+ * Function: interval_us
+ * Description: Returns the microseconds between two points in time.
+ * Parameters:
+ *   - start: Start time.
+ *   - end: End time.
+ * Returns:
+ *   - Elapsed microseconds (0 if the clock went backwards).
+ */
+static unsigned int interval_us(const struct timeval *start, const struct timeval *end)
+{
+    long long us = (end->tv_sec - start->tv_sec) * 1000000LL + (end->tv_usec - start->tv_usec);
+
+    return us < 0 ? 0 : us > 0xFFFFFFFFLL ? 0xFFFFFFFFu : (unsigned int)us;
+}
+
+/**
+ * Function: elapsed_us
+ * Description: Returns the microseconds elapsed since a point in time.
+ * Parameters:
+ *   - start: Start time.
+ * Returns:
+ *   - Elapsed microseconds (0 if the clock went backwards).
+ */
+static unsigned int elapsed_us(const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return interval_us(start, &now);
+}
+
+/**
+ * Function: charge_gap
+ * Description: Charges the time since the end of the last timed region to
+ *              ENCODE or PARSE and moves the mark to now.
+ * Parameters:
+ *   - ts: Statistics block of the current thread.
+ *   - now: Current time.
+ */
+static void charge_gap(RedisThreadStats *ts, const struct timeval *now)
+{
+    ts->phase_us[ts->replied ? REDIS_PHASE_PARSE : REDIS_PHASE_ENCODE] += interval_us(&ts->mark, now);
+    ts->mark = *now;
+}
+
+/**********************************************************************/
+/* Recording Hooks */
+/**********************************************************************/
+
+/**
+ * Function: redis_stats_begin
+ * Description: Marks that the current thread takes a connection. The first
+ *              connection starts the call; the ones taken while it is held
+ *              (redirections, fan-out) belong to the same call.
+ */
+void redis_stats_begin(void)
+{
+    RedisThreadStats *ts = thread_stats();
+
+    if (ts == NULL)
+        return;
+    if (ts->depth++ == 0)
+    {
+        gettimeofday(&ts->start, NULL);
+        ts->name[0] = '\0';
+        ts->sent = 0;
+        ts->received = 0;
+        ts->command_len = 0;
+        ts->reply_len = 0;
+
+        ts->sampled = profile_rate > 0 && ++ts->sample_count % profile_rate == 0;
+        if (ts->sampled)
+        {
+            memset(ts->phase_us, 0, sizeof(ts->phase_us));
+            ts->probe_level = 0;
+            ts->replied = 0;
+            ts->mark = ts->start;
+        }
+    }
+}
+
+/**
+ * Function: redis_stats_abort
+ * Description: Undoes redis_stats_begin when no connection could be taken.
+ *              A call that never got a connection is not recorded; the
+ *              failure shows up in the CONNECT row.
+ */
+void redis_stats_abort(void)
+{
+    RedisThreadStats *ts = thread_stats();
+
+    if (ts != NULL && ts->depth > 0)
+        ts->depth--;
+}
+
+/**
+ * Function: redis_stats_sent
+ * Description: Counts a command sent during the current call. The first
+ *              command names the call.
+ * Parameters:
+ *   - buf: Encoded command (ASCII).
+ *   - len: Length of the command.
+ */
+void redis_stats_sent(const char *buf, size_t len)
+{
+    RedisThreadStats *ts = thread_stats();
+    size_t pos = 0, name_len = 0, i;
+
+    if (ts == NULL || ts->depth == 0)
+        return; // Not a pooled call (e.g., a Sentinel query)
+    ts->sent += len;
+    if (ts->name[0] != '\0')
+        return;
+    ts->command_len = len < REDIS_RECORDER_PREFIX ? len : REDIS_RECORDER_PREFIX;
+    memcpy(ts->command, buf, ts->command_len);
+
+    // "*<argc>\r\n$<len>\r\n<name>\r\n": the name is the first bulk string
+    while (pos < len && buf[pos] != 0x0A) // ASCII '\n'
+        pos++;
+    if (++pos >= len || buf[pos] != 0x24) // ASCII '$'
+        return;
+    for (pos++; pos < len && buf[pos] >= 0x30 && buf[pos] <= 0x39; pos++)
+        name_len = name_len * 10 + (buf[pos] - 0x30);
+    pos += 2; // "\r\n"
+    if (name_len == 0 || pos + name_len > len)
+        return;
+    if (name_len >= STATS_NAME_LEN)
+        name_len = STATS_NAME_LEN - 1;
+    for (i = 0; i < name_len; i++)
+    {
+        unsigned char c = (unsigned char)buf[pos + i];
+        ts->name[i] = (c >= 0x61 && c <= 0x7A) ? c - 0x20 : c; // ASCII upper case
+    }
+    ts->name[name_len] = '\0';
+}
+
+/**
+ * Function: redis_stats_received
+ * Description: Counts replies received during the current call and keeps
+ *              the beginning of the first one for the flight recorder.
+ * Parameters:
+ *   - buf: Replies (ASCII).
+ *   - len: Number of bytes received.
+ */
+void redis_stats_received(const char *buf, size_t len)
+{
+    RedisThreadStats *ts = thread_stats();
+
+    // Handshake replies arrive before the first command and are not counted
+    if (ts == NULL || ts->depth == 0 || ts->name[0] == '\0')
+        return;
+    ts->received += len;
+    if (ts->reply_len == 0)
+    {
+        ts->reply_len = len < REDIS_RECORDER_PREFIX ? len : REDIS_RECORDER_PREFIX;
+        memcpy(ts->reply, buf, ts->reply_len);
+    }
+}
+
+/**
+ * Function: redis_stats_end
+ * Description: Marks that the current thread released a connection. The
+ *              last release ends the call and records it.
+ * Parameters:
+ *   - sqlstate: SQLSTATE of the call.
+ */
+void redis_stats_end(const char *sqlstate)
+{
+    RedisThreadStats *ts = thread_stats();
+    struct timeval now;
+    unsigned int us;
+    int error = errno, failed = !(sqlstate[0] == '0' && sqlstate[1] <= '2');
+
+    if (ts == NULL || ts->depth == 0 || --ts->depth > 0)
+        return;
+    if (ts->name[0] == '\0')
+        return; // Released without sending anything: nothing to report
+
+    gettimeofday(&now, NULL);
+    if (ts->sampled)
+        charge_gap(ts, &now);
+    us = interval_us(&ts->start, &now);
+    record_command(ts, ts->name, us, sqlstate, ts->sent, ts->received,
+                   ts->sampled ? ts->phase_us : NULL);
+
+    redis_recorder_add(ts->number, &ts->start, us, ts->command, ts->command_len, ts->reply, ts->reply_len,
+                       ts->sent, ts->received, sqlstate, failed ? error : 0);
+    if (failed)
+        redis_recorder_error(sqlstate);
+}
+
+/**
+ * Function: redis_stats_connect
+ * Description: Records the opening of a new connection (TCP connect and
+ *              handshake) as the CONNECT command.
+ * Parameters:
+ *   - start: Time the connection attempt started.
+ *   - failed: Non-zero if the connection could not be opened.
+ */
+void redis_stats_connect(const struct timeval *start, int failed)
+{
+    RedisThreadStats *ts = thread_stats();
+    unsigned int us = elapsed_us(start);
+    int error = errno;
+
+    if (ts == NULL)
+        return;
+    record_command(ts, command_names[0], us, failed ? "38901" : "00000", 0, 0, NULL);
+    if (failed)
+    {
+        // Recorded as a command-less call: the UDF fails with 38901
+        redis_recorder_add(ts->number, start, us, "", 0, "", 0, 0, 0, "38901", error);
+        redis_recorder_error("38901");
+    }
+}
+
+/**********************************************************************/
+/* Phase Probes */
+/**********************************************************************/
+
+/**
+ * Function: set_redis_profile_rate
+ * Description: Sets how often calls of the job are profiled by phase.
+ * Parameters:
+ *   - rate: 0 = off, N = every Nth call of each thread.
+ * Returns:
+ *   - Previous rate.
+ */
+int set_redis_profile_rate(int rate)
+{
+    int previous = profile_rate;
+
+    profile_rate = rate;
+    return previous;
+}
+
+/**
+ * Function: redis_probe_enter
+ * Description: Starts a timed region of a profiled call. Time since the
+ *              previous region is charged to ENCODE (before the first
+ *              reply) or PARSE (after it). Nested regions (e.g., the
+ *              handshake inside CONNECT) are part of the outer one.
+ */
+void redis_probe_enter(void)
+{
+    RedisThreadStats *ts = thread_stats();
+    struct timeval now;
+
+    if (ts == NULL || !ts->sampled || ts->depth == 0 || ts->probe_level++ > 0)
+        return;
+    gettimeofday(&now, NULL);
+    charge_gap(ts, &now);
+}
+
+/**
+ * Function: redis_probe_leave
+ * Description: Ends the timed region started by redis_probe_enter.
+ * Parameters:
+ *   - phase: Phase the region belongs to (REDIS_PHASE_*).
+ */
+void redis_probe_leave(int phase)
+{
+    RedisThreadStats *ts = thread_stats();
+    struct timeval now;
+
+    if (ts == NULL || !ts->sampled || ts->depth == 0 || ts->probe_level == 0 || --ts->probe_level > 0)
+        return;
+    gettimeofday(&now, NULL);
+    ts->phase_us[phase] += interval_us(&ts->mark, &now);
+    ts->mark = now;
+    if (phase == REDIS_PHASE_WAIT)
+        ts->replied = 1;
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: statsRedis
+ * Description: SQL external table function returning one row per command
+ *              called in the current job. The scratchpad keeps the next
+ *              command to report; each row adds up the counters of all
+ *              threads when it is fetched.
+ * Parameters:
+ *   - command: Output command name (VARCHAR(16), EBCDIC).
+ *   - calls: Output number of calls.
+ *   - errors: Output number of calls that failed.
+ *   - timeouts: Output number of calls that timed out (SQLSTATE 38904).
+ *   - errorStates: Output failures per SQLSTATE, e.g. "38904:2 38905:1"
+ *     (VARCHAR(128), EBCDIC).
+ *   - bytesSent: Output bytes sent.
+ *   - bytesReceived: Output bytes received.
+ *   - avgUs: Output average latency in microseconds.
+ *   - p50Us: Output median latency in microseconds.
+ *   - p99Us: Output 99th percentile latency in microseconds.
+ *   - maxUs: Output maximum latency in microseconds.
+ *   - profiled: Output number of calls split into phases (REDIS_PROFILE).
+ *   - phaseUs: Output average microseconds per profiled call spent in the
+ *     connect, encode, translate, send, wait and parse phases (NULL when
+ *     no call was profiled).
+ *   - *Ind: Null indicators for the output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the cursor.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN statsRedis(
+    SQLUDF_VARCHAR *command,           // Output: command name (EBCDIC)
+    SQLUDF_BIGINT *calls,              // Output: calls
+    SQLUDF_BIGINT *errors,             // Output: failed calls
+    SQLUDF_BIGINT *timeouts,           // Output: calls that timed out
+    SQLUDF_VARCHAR *errorStates,       // Output: failures per SQLSTATE (EBCDIC)
+    SQLUDF_BIGINT *bytesSent,          // Output: bytes sent
+    SQLUDF_BIGINT *bytesReceived,      // Output: bytes received
+    SQLUDF_BIGINT *avgUs,              // Output: average latency
+    SQLUDF_BIGINT *p50Us,              // Output: median latency
+    SQLUDF_BIGINT *p99Us,              // Output: 99th percentile latency
+    SQLUDF_BIGINT *maxUs,              // Output: maximum latency
+    SQLUDF_BIGINT *profiled,           // Output: calls split into phases
+    SQLUDF_DOUBLE *connectUs,          // Output: average CONNECT phase
+    SQLUDF_DOUBLE *encodeUs,           // Output: average ENCODE phase
+    SQLUDF_DOUBLE *translateUs,        // Output: average TRANSLATE phase
+    SQLUDF_DOUBLE *sendUs,             // Output: average SEND phase
+    SQLUDF_DOUBLE *waitUs,             // Output: average WAIT phase
+    SQLUDF_DOUBLE *parseUs,            // Output: average PARSE phase
+    SQLUDF_NULLIND *commandInd,        // Null indicator for command
+    SQLUDF_NULLIND *callsInd,          // Null indicator for calls
+    SQLUDF_NULLIND *errorsInd,         // Null indicator for errors
+    SQLUDF_NULLIND *timeoutsInd,       // Null indicator for timeouts
+    SQLUDF_NULLIND *errorStatesInd,    // Null indicator for errorStates
+    SQLUDF_NULLIND *bytesSentInd,      // Null indicator for bytesSent
+    SQLUDF_NULLIND *bytesReceivedInd,  // Null indicator for bytesReceived
+    SQLUDF_NULLIND *avgUsInd,          // Null indicator for avgUs
+    SQLUDF_NULLIND *p50UsInd,          // Null indicator for p50Us
+    SQLUDF_NULLIND *p99UsInd,          // Null indicator for p99Us
+    SQLUDF_NULLIND *maxUsInd,          // Null indicator for maxUs
+    SQLUDF_NULLIND *profiledInd,       // Null indicator for profiled
+    SQLUDF_NULLIND *connectUsInd,      // Null indicator for connectUs
+    SQLUDF_NULLIND *encodeUsInd,       // Null indicator for encodeUs
+    SQLUDF_NULLIND *translateUsInd,    // Null indicator for translateUs
+    SQLUDF_NULLIND *sendUsInd,         // Null indicator for sendUs
+    SQLUDF_NULLIND *waitUsInd,         // Null indicator for waitUs
+    SQLUDF_NULLIND *parseUsInd,        // Null indicator for parseUs
+    char *sqlstate,                    // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                    // Fully qualified function name
+    char *specname,                    // Specific name
+    char *msgtext,                     // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,     // Cursor between calls
+    SQLUDF_CALL_TYPE *calltype)        // Open, fetch or close
+{
+    static RedisCommandStats total; // Only used under stats_lock
+    SQLUDF_DOUBLE *phases[REDIS_PHASES];
+    SQLUDF_NULLIND *phaseInds[REDIS_PHASES];
+    RedisThreadStats *ts;
+    const RedisCommandStats *cs;
+    long long rank, seen;
+    int cursor, index, i, j, pos;
+    unsigned int upper;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+        cursor = 0;
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    memcpy(&cursor, scratchpad->data, sizeof(cursor));
+    pthread_mutex_lock(&stats_lock);
+    for (index = cursor; index < command_count; index++)
+    {
+        // Add up the threads (they keep counting while this runs)
+        memset(&total, 0, sizeof(total));
+        for (ts = thread_list; ts != NULL; ts = ts->next)
+        {
+            cs = ts->commands[index];
+            if (cs == NULL)
+                continue;
+            total.calls += cs->calls;
+            total.errors += cs->errors;
+            total.sent += cs->sent;
+            total.received += cs->received;
+            total.total_us += cs->total_us;
+            if (cs->max_us > total.max_us)
+                total.max_us = cs->max_us;
+            total.profiled += cs->profiled;
+            for (i = 0; i < REDIS_PHASES; i++)
+                total.phase_us[i] += cs->phase_us[i];
+            for (i = 0; i < STATS_BUCKETS; i++)
+                total.bucket[i] += cs->bucket[i];
+            for (i = 0; i < STATS_STATES && cs->states[i][0] != '\0'; i++)
+            {
+                for (j = 0; j < STATS_STATES - 1 && total.states[j][0] != '\0' &&
+                            memcmp(total.states[j], cs->states[i], 5) != 0;
+                     j++)
+                    ;
+                if (total.states[j][0] == '\0')
+                    memcpy(total.states[j], cs->states[i], 5);
+                else if (memcmp(total.states[j], cs->states[i], 5) != 0)
+                    memcpy(total.states[j], "?????", 5); // Too many distinct states
+                total.state_count[j] += cs->state_count[i];
+            }
+        }
+        if (total.calls > 0)
+            break;
+    }
+
+    if (index >= command_count)
+    {
+        pthread_mutex_unlock(&stats_lock);
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+
+    // Command name (ASCII -> EBCDIC)
+    i = strlen(command_names[index]);
+    ConvertToEBCDIC(command_names[index], i, command, STATS_NAME_LEN);
+    command[i] = '\0';
+    pthread_mutex_unlock(&stats_lock);
+
+    *calls = total.calls;
+    *errors = total.errors;
+    *timeouts = 0;
+    pos = 0;
+    errorStates[0] = '\0';
+    for (i = 0; i < STATS_STATES && total.states[i][0] != '\0'; i++)
+    {
+        if (memcmp(total.states[i], "38904", 5) == 0)
+            *timeouts = total.state_count[i];
+        pos += sprintf(errorStates + pos, "%s%.5s:%lld", pos > 0 ? " " : "",
+                       total.states[i], total.state_count[i]);
+    }
+    *bytesSent = total.sent;
+    *bytesReceived = total.received;
+    *avgUs = total.total_us / total.calls;
+    *maxUs = total.max_us;
+
+    // Percentiles: upper edge of the bucket holding the rank, capped by the maximum
+    for (j = 0; j < 2; j++)
+    {
+        rank = j == 0 ? (total.calls + 1) / 2 : (total.calls * 99 + 99) / 100;
+        seen = 0;
+        for (i = 0; i < STATS_BUCKETS - 1 && seen + total.bucket[i] < rank; i++)
+            seen += total.bucket[i];
+        upper = stats_bucket_upper(i);
+        *(j == 0 ? p50Us : p99Us) = upper < total.max_us ? upper : total.max_us;
+    }
+
+    *commandInd = 0;
+    *callsInd = 0;
+    *errorsInd = 0;
+    *timeoutsInd = 0;
+    *errorStatesInd = 0;
+    *bytesSentInd = 0;
+    *bytesReceivedInd = 0;
+    *avgUsInd = 0;
+    *p50UsInd = 0;
+    *p99UsInd = 0;
+    *maxUsInd = 0;
+
+    // Average phase breakdown of the profiled calls
+    phases[REDIS_PHASE_CONNECT] = connectUs;
+    phases[REDIS_PHASE_ENCODE] = encodeUs;
+    phases[REDIS_PHASE_TRANSLATE] = translateUs;
+    phases[REDIS_PHASE_SEND] = sendUs;
+    phases[REDIS_PHASE_WAIT] = waitUs;
+    phases[REDIS_PHASE_PARSE] = parseUs;
+    phaseInds[REDIS_PHASE_CONNECT] = connectUsInd;
+    phaseInds[REDIS_PHASE_ENCODE] = encodeUsInd;
+    phaseInds[REDIS_PHASE_TRANSLATE] = translateUsInd;
+    phaseInds[REDIS_PHASE_SEND] = sendUsInd;
+    phaseInds[REDIS_PHASE_WAIT] = waitUsInd;
+    phaseInds[REDIS_PHASE_PARSE] = parseUsInd;
+    *profiled = total.profiled;
+    *profiledInd = 0;
+    for (i = 0; i < REDIS_PHASES; i++)
+    {
+        if (total.profiled > 0)
+        {
+            *phases[i] = (double)total.phase_us[i] / total.profiled;
+            *phaseInds[i] = 0;
+        }
+        else
+        {
+            *phaseInds[i] = -1;
+        }
+    }
+
+    cursor = index + 1;
+    memcpy(scratchpad->data, &cursor, sizeof(cursor));
+}
+
+#pragma linkage(statsRedis, OS)
@@ -0,0 +1,464 @@
+/******************************************************************************
+ * File: redistran.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the REDIS_TRANSACTION table function for
+ *              IBM i. Runs several commands as one MULTI/EXEC transaction:
+ *              MULTI, the commands and EXEC are written as a single
+ *              pipeline on one connection, and the EXEC results are
+ *              returned as rows like REDIS_COMMAND_TABLE returns a reply.
+ *              A WATCH list makes the transaction fail when one of the
+ *              keys changes. A call with only a WATCH list keeps its
+ *              connection for the next transaction of the thread, so
+ *              values read in between are protected (check-and-set).
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#define _MULTI_THREADED // Required for pthread on IBM i
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define TRANSACTION_VALUE 16370 // Length of the VALUE column
+
+/**********************************************************************/
+/* Watched Connection */
+/**********************************************************************/
+
+static int watch_fd = -1;      // Connection holding a WATCH, kept between calls
+static pthread_t watch_thread; // Thread that issued it
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Function: take_watched
+ * Description: Takes the connection kept by an earlier WATCH of the
+ *              calling thread.
+ * Returns:
+ *   - Socket file descriptor, -1 if the thread watches nothing.
+ */
+static int take_watched(void)
+{
+    int sockfd = -1;
+
+    pthread_mutex_lock(&watch_lock);
+    if (watch_fd >= 0 && pthread_equal(watch_thread, pthread_self()))
+    {
+        sockfd = watch_fd;
+        watch_fd = -1;
+    }
+    pthread_mutex_unlock(&watch_lock);
+    return sockfd;
+}
+
+/**
+ * Function: keep_watched
+ * Description: Keeps a connection holding a WATCH for the next transaction
+ *              of the calling thread. A connection watched by another
+ *              thread is given back to the pool, dropping its WATCH.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - sqlstate: SQLSTATE of the call.
+ */
+static void keep_watched(int sockfd, const char *sqlstate)
+{
+    int previous;
+
+    pthread_mutex_lock(&watch_lock);
+    previous = watch_fd;
+    watch_fd = sockfd;
+    watch_thread = pthread_self();
+    pthread_mutex_unlock(&watch_lock);
+
+    suspend_redis_call(sqlstate);
+    if (previous >= 0)
+    {
+        resume_redis_call(previous);
+        release_redis_connection(previous, "38003"); // Not reused: it still watches keys
+    }
+}
+
+/**********************************************************************/
+/* Command Parsing */
+/**********************************************************************/
+
+/**
+ * Function: append_commands
+ * Description: Encodes every command of a list as a RESP command.
+ * Parameters:
+ *   - text: Commands (EBCDIC), separated by semicolons or line feeds.
+ *   - prefix: Command name put before every command (EBCDIC, e.g. "WATCH"
+ *     to turn a key list into one command), NULL for none.
+ *   - buf: Command buffer (ASCII).
+ *   - size: Size of the command buffer.
+ *   - pos: Length so far.
+ *   - word: Work buffer, at least as long as the text.
+ *   - key: Receives the first key (EBCDIC, 256 bytes) if still empty.
+ *   - count: Receives the number of commands.
+ * Returns:
+ *   - New length, -1 if it does not fit or cannot be converted, -2 for an
+ *     unterminated quote.
+ */
+static int append_commands(const char *text, const char *prefix, char *buf, size_t size, int pos,
+                           char *word, char *key, int *count)
+{
+    const char *p = text, *end;
+    size_t len;
+    int words, rc, i;
+
+    *count = 0;
+    while (*p != '\0' && pos >= 0)
+    {
+        // Count the words of the command, then encode them
+        end = p;
+        for (words = 0; (rc = next_redis_word(&end, word, &len)) == 1; words++)
+            ;
+        if (rc < 0)
+            return -2;
+        if (words > 0)
+        {
+            pos = append_redis_header(buf, size, pos, words + (prefix != NULL));
+            if (prefix != NULL)
+                pos = append_redis_argument(buf, size, pos, prefix, strlen(prefix), 0);
+            for (i = 0; i < words && pos >= 0; i++)
+            {
+                next_redis_word(&p, word, &len);
+                pos = append_redis_argument(buf, size, pos, word, len, 0);
+                if (key[0] == '\0' && i == (prefix == NULL))
+                {
+                    if (len > 255)
+                        len = 255;
+                    memcpy(key, word, len);
+                    key[len] = '\0';
+                }
+            }
+            (*count)++;
+        }
+        p = *end != '\0' ? end + 1 : end; // Past the separator
+    }
+    return pos;
+}
+
+/**********************************************************************/
+/* SQL External Function */
+/**********************************************************************/
+
+/**
+ * Function: transactionRedis
+ * Description: SQL external table function to run commands as one
+ *              MULTI/EXEC transaction. The elements of the EXEC reply (one
+ *              per command) are rows at level 1, numbered like the
+ *              commands; nested arrays are returned as by
+ *              REDIS_COMMAND_TABLE. A call with only a WATCH list returns
+ *              the WATCH reply as a row at level 0 and keeps the
+ *              connection for the next transaction of the thread.
+ * Parameters:
+ *   - commands: Input commands (EBCDIC), separated by semicolons or line
+ *     feeds, words separated by blanks, "..." to quote a word.
+ *   - watch: Input keys to watch (EBCDIC), separated by blanks.
+ *   - position: Output 1-based position in the enclosing array.
+ *   - level: Output nesting level.
+ *   - type: Output type: status, error, integer, string, array or nil
+ *     (VARCHAR(8), EBCDIC).
+ *   - value: Output text of the value (EBCDIC); NULL for arrays and nil.
+ *   - integerValue: Output value of integers, element count of arrays.
+ *   - *Ind: Null indicators for the inputs and output columns.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" ends the table,
+ *     "38911" is an error reply (the transaction was not run), "38912" a
+ *     transaction aborted because a watched key changed.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - scratchpad: Scratchpad holding the cursor and the reply.
+ *   - calltype: Table function call type (open, fetch, close).
+ */
+void SQL_API_FN transactionRedis(
+    SQLUDF_VARCHAR *commands,        // Input: commands (EBCDIC)
+    SQLUDF_VARCHAR *watch,           // Input: keys to watch (EBCDIC)
+    SQLUDF_INTEGER *position,        // Output: position in the enclosing array
+    SQLUDF_INTEGER *level,           // Output: nesting level
+    SQLUDF_VARCHAR *type,            // Output: RESP type (EBCDIC)
+    SQLUDF_VARCHAR *value,           // Output: text of the value (EBCDIC)
+    SQLUDF_BIGINT *integerValue,     // Output: integer value or element count
+    SQLUDF_NULLIND *commandsInd,     // Null indicators for inputs
+    SQLUDF_NULLIND *watchInd,
+    SQLUDF_NULLIND *positionInd,     // Null indicators for outputs
+    SQLUDF_NULLIND *levelInd,
+    SQLUDF_NULLIND *typeInd,
+    SQLUDF_NULLIND *valueInd,
+    SQLUDF_NULLIND *integerValueInd,
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    SQLUDF_SCRATCHPAD *scratchpad,   // Cursor and reply between calls
+    SQLUDF_CALL_TYPE *calltype)      // Open, fetch or close
+{
+    char *reply = scratchpad->data + sizeof(RedisReplyCursor);
+    char *send_buf, *word, key[256];
+    size_t commands_len, watch_len, size, pos;
+    RedisReplyCursor cursor;
+    RedisReplyItem item, error;
+    int sockfd, cmd_len, count, replies, watched, len, rc, i;
+
+    strcpy(sqlstate, "00000");
+    if (*calltype == SQLUDF_TF_OPEN)
+    {
+#ifdef USE_ICONV
+        if (!initialized)
+        {
+            initialize_conversion();
+            initialized = 1;
+        }
+        if (errno != 0)
+        {
+            strcpy(sqlstate, "38999");
+            strcpy(msgtext, "iconv initialization failed");
+            return;
+        }
+#endif
+        memset(&cursor, 0, sizeof(cursor));
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+
+        // Check for NULL input
+        if (*commandsInd < 0 && *watchInd < 0)
+        {
+            strcpy(sqlstate, "38001");
+            strcpy(msgtext, "Input commands and watch list are NULL");
+            return;
+        }
+        if (scratchpad->length < sizeof(RedisReplyCursor) + 1024)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "Scratchpad too small: create the function with SCRATCHPAD 32767");
+            return;
+        }
+
+        // Encoded, a command takes at most 6 times its length, a WATCH 12 times
+        commands_len = *commandsInd < 0 ? 0 : strlen(commands);
+        watch_len = *watchInd < 0 ? 0 : strlen(watch);
+        size = 6 * commands_len + 12 * watch_len + 128;
+        send_buf = redis_arena_alloc(size + commands_len + watch_len + 1);
+        if (send_buf == NULL)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, "Out of memory for call buffers");
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+        word = send_buf + size;
+
+        // WATCH, MULTI, the commands and EXEC as one pipeline
+        key[0] = '\0';
+        cmd_len = 0;
+        replies = 0;
+        if (watch_len > 0)
+        {
+            // The keys as a single command: "WATCH k1 k2 ..."
+            cmd_len = append_commands(watch, "\xE6\xC1\xE3\xC3\xC8", send_buf, size, cmd_len, word,
+                                      key, &count); // EBCDIC "WATCH"
+            replies += count;
+        }
+        if (commands_len > 0 && cmd_len >= 0)
+        {
+            memcpy(send_buf + cmd_len, REDIS_TEMPLATE_MULTI, sizeof(REDIS_TEMPLATE_MULTI) - 1);
+            cmd_len += sizeof(REDIS_TEMPLATE_MULTI) - 1;
+            cmd_len = append_commands(commands, NULL, send_buf, size, cmd_len, word, key, &count);
+            if (cmd_len >= 0 && count == 0)
+            {
+                strcpy(sqlstate, "38003");
+                strcpy(msgtext, "Input commands are empty");
+                release_redis_connection(-1, sqlstate);
+                return;
+            }
+            if (cmd_len >= 0)
+            {
+                memcpy(send_buf + cmd_len, REDIS_TEMPLATE_EXEC, sizeof(REDIS_TEMPLATE_EXEC) - 1);
+                cmd_len += sizeof(REDIS_TEMPLATE_EXEC) - 1;
+            }
+            replies += count + 2;
+        }
+        if (cmd_len == -1)
+        {
+            strcpy(sqlstate, "38902");
+            strcpy(msgtext, "Failed to convert command to ASCII");
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+        if (cmd_len < 0 || replies == 0)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, cmd_len == -2 ? "Unterminated quote in the commands"
+                                          : "Input commands and watch list are empty");
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+
+        // The connection of an earlier WATCH, or one for the first key
+        sockfd = take_watched();
+        watched = sockfd >= 0;
+        if (watched)
+        {
+            redis_write_behind_barrier(); // Queued writes are not taken here
+            resume_redis_call(sockfd);
+        }
+        else if ((key[0] ? connect_to_redis_key(&sockfd, key) : connect_to_redis(&sockfd)) != 0)
+        {
+            strcpy(sqlstate, "38901");
+            snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+            release_redis_connection(-1, sqlstate);
+            return;
+        }
+
+        if (send_redis_command(sockfd, send_buf, cmd_len) < 0)
+        {
+            strcpy(sqlstate, "38903");
+            snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
+
+        // Receive every reply straight into the scratchpad, behind the cursor
+        len = recv_redis_replies(sockfd, reply, scratchpad->length - sizeof(RedisReplyCursor), replies);
+        if (len <= 0)
+        {
+            if (len < 0 && (errno == EWOULDBLOCK || errno == EAGAIN))
+            {
+                strcpy(sqlstate, "38904");
+                snprintf(msgtext, 70, "Receive timeout from Redis: errno=%d, socket=%d", errno, sockfd);
+            }
+            else if (len < 0)
+            {
+                strcpy(sqlstate, "38905");
+                snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
+            }
+            else
+            {
+                strcpy(sqlstate, "38906");
+                snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
+            }
+            release_redis_connection(sockfd, sqlstate);
+            return;
+        }
+
+        // WATCH, MULTI and QUEUED replies: keep the first error
+        pos = 0;
+        error.type = 0;
+        for (i = 0; i < replies - 1; i++)
+        {
+            if (redis_reply_item(reply, len, &pos, &item) != 0)
+                break;
+            if (item.type == 0x2D && error.type == 0) // ASCII '-'
+                error = item;
+        }
+        cursor.len = len;
+        if (i < replies - 1 || redis_reply_span(reply, len, pos) != len ||
+            redis_reply_item(reply, len, &pos, &item) != 0)
+        {
+            if ((size_t)len == scratchpad->length - sizeof(RedisReplyCursor))
+            {
+                strcpy(sqlstate, "38908");
+                strcpy(msgtext, "Transaction results exceed the scratchpad");
+            }
+            else
+            {
+                strcpy(sqlstate, "38909");
+                strcpy(msgtext, "Failed to parse Redis response");
+            }
+        }
+        else if (commands_len == 0)
+        {
+            // WATCH only: its reply is the row, the connection is kept
+            if (item.type == 0x2D)
+            {
+                error = item;
+            }
+            else
+            {
+                memcpy(scratchpad->data, &cursor, sizeof(cursor));
+                keep_watched(sockfd, sqlstate);
+                return;
+            }
+        }
+        else if (item.type == 0x2A && item.nil) // ASCII '*': EXEC aborted by WATCH
+        {
+            strcpy(sqlstate, "38912");
+            strcpy(msgtext, "Transaction aborted: a watched key was changed");
+        }
+        else if (item.type == 0x2A) // The results are the rows
+        {
+            cursor.pos = (int)pos;
+            cursor.depth = 1;
+            cursor.remaining[0] = (int)item.len;
+        }
+        else if (error.type == 0)
+        {
+            error = item; // EXEC itself failed
+        }
+        if (error.type == 0x2D && sqlstate[0] == '0')
+        {
+            // A command was rejected while queued: Redis discarded the transaction
+            len = error.len < 70 ? (int)error.len : 70;
+            ConvertToEBCDIC((char *)error.data, len, msgtext, 70);
+            msgtext[len] = '\0';
+            strcpy(sqlstate, "38911");
+        }
+        release_redis_connection(sockfd, sqlstate);
+        memcpy(scratchpad->data, &cursor, sizeof(cursor));
+        return;
+    }
+    if (*calltype != SQLUDF_TF_FETCH)
+        return; // Close: nothing to free
+
+    memcpy(&cursor, scratchpad->data, sizeof(cursor));
+    rc = redis_reply_row(reply, &cursor, &item, position, level);
+    if (rc == 1)
+    {
+        strcpy(sqlstate, "02000"); // End of table
+        return;
+    }
+    if (rc != 0)
+    {
+        strcpy(sqlstate, "38909");
+        strcpy(msgtext, rc == -2 ? "Reply nested too deeply" : "Failed to parse Redis response");
+        return;
+    }
+    if (item.type != 0x2A && item.len > TRANSACTION_VALUE)
+    {
+        strcpy(sqlstate, "38908");
+        strcpy(msgtext, "Value exceeds maximum length");
+        return;
+    }
+
+    strcpy(type, redis_reply_type(&item));
+    *positionInd = 0;
+    *levelInd = 0;
+    *typeInd = 0;
+
+    if (item.type == 0x2A || item.nil)
+    {
+        *valueInd = -1;
+    }
+    else
+    {
+        ConvertToEBCDIC((char *)item.data, item.len, value, TRANSACTION_VALUE);
+        value[item.len] = '\0';
+        *valueInd = 0;
+    }
+    *integerValueInd = -1;
+    if ((item.type == 0x3A || item.type == 0x2A) && !item.nil) // ASCII ':' / '*'
+    {
+        *integerValue = item.number;
+        *integerValueInd = 0;
+    }
+    memcpy(scratchpad->data, &cursor, sizeof(cursor));
+}
+
+#pragma linkage(transactionRedis, OS)
@@ -10,17 +10,21 @@
  * Version: 1.0.0
  ******************************************************************************/
 
+#define _MULTI_THREADED // Required for pthread on IBM i
 #include "redis_utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 #define _XOPEN_SOURCE 520
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/types.h>
+#include <pthread.h>
 #ifdef USE_ICONV
 #include <qtqiconv.h>
 #endif
@@ -43,11 +47,13 @@
 int ConvertToEBCDIC(char *ibuf, size_t ileft, char *obuf, size_t oleft)
 {
     int rc;
+    REDIS_PROBE_ENTER();
 #ifdef USE_ICONV
     rc = iconv(ecd, (const char **)&ibuf, &ileft, &obuf, &oleft);
 #else
     rc = Translate((uchar *)ibuf, ileft, (uchar *)obuf, EbcdicTable);
 #endif
+    REDIS_PROBE_LEAVE(REDIS_PHASE_TRANSLATE);
     return rc;
 }
 
@@ -65,11 +71,13 @@ int ConvertToEBCDIC(char *ibuf, size_t ileft, char *obuf, size_t oleft)
 int ConvertToASCII(char *ibuf, size_t ileft, char *obuf, size_t oleft)
 {
     int rc;
+    REDIS_PROBE_ENTER();
 #ifdef USE_ICONV
     rc = iconv(acd, (const char **)&ibuf, &ileft, &obuf, &oleft);
 #else
     rc = Translate((uchar *)ibuf, ileft, (uchar *)obuf, AsciiTable);
 #endif
+    REDIS_PROBE_LEAVE(REDIS_PHASE_TRANSLATE);
     return rc;
 }
 
@@ -99,45 +107,2260 @@ int Translate(uchar *ip, size_t ilen, uchar *op, uchar *table)
 #endif
 
 /**********************************************************************/
-/* Redis Connection */
+/* Command Encoding */
+/**********************************************************************/
+
+/**
+ * Function: format_ebcdic_number
+ * Description: Formats a non-negative number as EBCDIC digits (0xF0-0xF9).
+ * Parameters:
+ *   - number: Value to format.
+ *   - out: Output buffer (at least 20 bytes, not null-terminated).
+ * Returns:
+ *   - Number of digits written.
+ */
+static int format_ebcdic_number(size_t number, char *out)
+{
+    char digits[20];
+    int count = 0, i;
+
+    do
+    {
+        digits[count++] = 0xF0 + (number % 10);
+        number /= 10;
+    } while (number > 0);
+
+    for (i = 0; i < count; i++)
+        out[i] = digits[count - 1 - i];
+    return count;
+}
+
+/**
+ * Function: format_ascii_number
+ * Description: Formats a non-negative number as ASCII digits (0x30-0x39).
+ * Parameters:
+ *   - number: Value to format.
+ *   - out: Output buffer (at least 20 bytes, not null-terminated).
+ * Returns:
+ *   - Number of digits written.
+ */
+static int format_ascii_number(size_t number, char *out)
+{
+    char digits[20];
+    int count = 0, i;
+
+    do
+    {
+        digits[count++] = 0x30 + (number % 10);
+        number /= 10;
+    } while (number > 0);
+
+    for (i = 0; i < count; i++)
+        out[i] = digits[count - 1 - i];
+    return count;
+}
+
+/**
+ * Function: format_redis_command
+ * Description: Builds a RESP command ("*<argc>\r\n$<len>\r\n<arg>\r\n...") in EBCDIC.
+ * Parameters:
+ *   - buf: Output buffer (EBCDIC).
+ *   - size: Size of the output buffer.
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Argument values (EBCDIC).
+ *   - argl: Argument lengths.
+ * Returns:
+ *   - Length of the command, negative value if it does not fit.
+ */
+int format_redis_command(char *buf, size_t size, int argc, const char **argv, const size_t *argl)
+{
+    size_t pos = 0;
+    int i;
+
+    // Worst case per header: marker + 20 digits + CRLF, plus the trailing null
+    if (size < 24)
+        return -1;
+
+    buf[pos++] = 0x5C; // EBCDIC '*'
+    pos += format_ebcdic_number((size_t)argc, buf + pos);
+    buf[pos++] = 0x0D;
+    buf[pos++] = 0x25;
+
+    for (i = 0; i < argc; i++)
+    {
+        if (pos + 23 + argl[i] + 2 + 1 > size)
+            return -1;
+        buf[pos++] = 0x5B; // EBCDIC '$'
+        pos += format_ebcdic_number(argl[i], buf + pos);
+        buf[pos++] = 0x0D;
+        buf[pos++] = 0x25;
+        memcpy(buf + pos, argv[i], argl[i]);
+        pos += argl[i];
+        buf[pos++] = 0x0D;
+        buf[pos++] = 0x25;
+    }
+    buf[pos] = '\0';
+    return (int)pos;
+}
+
+/**
+ * Function: format_redis_template
+ * Description: Builds a RESP command in ASCII from a prebuilt ASCII header
+ *              (REDIS_TEMPLATE) and the variable arguments. The header is
+ *              copied as is; only the arguments are translated.
+ * Parameters:
+ *   - buf: Output buffer (ASCII).
+ *   - size: Size of the output buffer.
+ *   - header: Command header (ASCII), e.g. "*2\r\n$3\r\nGET\r\n".
+ *   - header_len: Length of the header.
+ *   - argc: Number of arguments after the command name.
+ *   - argv: Argument values (EBCDIC).
+ *   - argl: Argument lengths.
+ * Returns:
+ *   - Length of the command, negative value if it does not fit or an
+ *     argument cannot be converted.
+ */
+int format_redis_template(char *buf, size_t size, const char *header, size_t header_len,
+                          int argc, const char **argv, const size_t *argl)
+{
+    int pos = (int)header_len;
+    int i;
+
+    if (header_len + 1 > size)
+        return -1;
+    memcpy(buf, header, header_len);
+    buf[pos] = '\0';
+
+    for (i = 0; i < argc && pos >= 0; i++)
+        pos = append_redis_argument(buf, size, pos, argv[i], argl[i], 0);
+    return pos;
+}
+
+/**
+ * Function: append_redis_argument
+ * Description: Appends one argument ("$<len>\r\n<arg>\r\n") to a command
+ *              built in ASCII.
+ * Parameters:
+ *   - buf: Command buffer (ASCII).
+ *   - size: Size of the command buffer.
+ *   - pos: Length of the command so far.
+ *   - arg: Argument value.
+ *   - len: Argument length.
+ *   - ascii: 1 if the argument is already ASCII, 0 if it is EBCDIC.
+ * Returns:
+ *   - New length of the command, negative value if it does not fit or the
+ *     argument cannot be converted.
+ */
+int append_redis_argument(char *buf, size_t size, int pos, const char *arg, size_t len, int ascii)
+{
+    if (pos < 0 || (size_t)pos + 23 + len + 2 + 1 > size)
+        return -1;
+    buf[pos++] = 0x24; // ASCII '$'
+    pos += format_ascii_number(len, buf + pos);
+    buf[pos++] = 0x0D;
+    buf[pos++] = 0x0A;
+    if (ascii)
+        memcpy(buf + pos, arg, len);
+    else if (len > 0 && ConvertToASCII((char *)arg, len, buf + pos, size - pos) < 0)
+        return -1;
+    pos += (int)len;
+    buf[pos++] = 0x0D;
+    buf[pos++] = 0x0A;
+    buf[pos] = '\0';
+    return pos;
+}
+
+/**
+ * Function: append_redis_header
+ * Description: Appends "*<argc>\r\n" to a command built in ASCII.
+ * Parameters:
+ *   - buf: Command buffer (ASCII).
+ *   - size: Size of the command buffer.
+ *   - pos: Length so far, negative after an earlier failure.
+ *   - argc: Number of arguments of the command.
+ * Returns:
+ *   - New length, -1 if it does not fit.
+ */
+int append_redis_header(char *buf, size_t size, int pos, int argc)
+{
+    if (pos < 0 || (size_t)pos + 23 > size)
+        return -1;
+    buf[pos++] = 0x2A; // ASCII '*'
+    pos += format_ascii_number(argc, buf + pos);
+    buf[pos++] = 0x0D;
+    buf[pos++] = 0x0A;
+    return pos;
+}
+
+/**
+ * Function: next_redis_word
+ * Description: Reads the next word of a command written as text. Blanks
+ *              separate words, a semicolon or a line feed ends the
+ *              command; double quotes protect both, "" is a double quote.
+ * Parameters:
+ *   - p: Position in the text (EBCDIC); advanced past the word.
+ *   - out: Receives the word (EBCDIC, null-terminated).
+ *   - len: Receives the length of the word.
+ * Returns:
+ *   - 1 for a word, 0 at the end of the command, -1 for an unterminated
+ *     quote.
+ */
+int next_redis_word(const char **p, char *out, size_t *len)
+{
+    const char *s = *p;
+    size_t n = 0;
+
+    while (*s == 0x40 || *s == 0x05 || *s == 0x0D) // EBCDIC ' ', tab, CR
+        s++;
+    *p = s;
+    if (*s == '\0' || *s == 0x5E || *s == 0x25 || *s == 0x15) // EBCDIC ';', LF, NL
+        return 0;
+
+    if (*s == 0x7F) // EBCDIC '"'
+    {
+        for (s++;; s++)
+        {
+            if (*s == '\0')
+                return -1;
+            if (*s == 0x7F)
+            {
+                if (s[1] != 0x7F)
+                    break;
+                s++; // "" inside quotes
+            }
+            out[n++] = *s;
+        }
+        s++;
+    }
+    else
+    {
+        while (*s != '\0' && *s != 0x40 && *s != 0x05 && *s != 0x0D &&
+               *s != 0x5E && *s != 0x25 && *s != 0x15)
+            out[n++] = *s++;
+    }
+    out[n] = '\0';
+    *len = n;
+    *p = s;
+    return 1;
+}
+
+/**
+ * Function: split_redis_keys
+ * Description: Splits a blank-separated list of keys (the KEYS argument of
+ *              the multi-list functions) with next_redis_word; a key in
+ *              double quotes may contain blanks.
+ * Parameters:
+ *   - text: The list (EBCDIC, null-terminated).
+ *   - words: Receives the keys, each null-terminated (at least twice the
+ *     length of text plus 2 bytes).
+ *   - max: Most keys accepted.
+ *   - argv: Receives a pointer to each key in words.
+ *   - argl: Receives the length of each key.
+ * Returns:
+ *   - Number of keys, -1 for an unterminated quote, -2 for more than max.
+ */
+int split_redis_keys(const char *text, char *words, int max, const char **argv, size_t *argl)
+{
+    size_t len;
+    int keyc = 0, rc;
+
+    for (;;)
+    {
+        rc = next_redis_word(&text, words, &len);
+        if (rc < 0)
+            return -1;
+        if (rc == 0 && *text == '\0')
+            return keyc;
+        if (rc == 0)
+        {
+            text++; // Separator between keys
+            continue;
+        }
+        if (keyc == max)
+            return -2;
+        argv[keyc] = words;
+        argl[keyc++] = len;
+        words += len + 1;
+    }
+}
+
+/**
+ * Function: parse_redis_direction
+ * Description: Reads a list direction, LEFT or RIGHT in either case.
+ * Parameters:
+ *   - text: The direction (EBCDIC, null-terminated).
+ *   - left: Receives 1 for LEFT (head), 0 for RIGHT (tail).
+ * Returns:
+ *   - 0 on success, -1 for anything else.
+ */
+int parse_redis_direction(const char *text, int *left)
+{
+    char word[7];
+    size_t len;
+
+    // EBCDIC lowercase is uppercase minus 0x40
+    for (len = 0; text[len] != '\0' && len < 6; len++)
+        word[len] = text[len] | 0x40;
+    word[len] = '\0';
+    *left = strcmp(word, "\xD3\xC5\xC6\xE3") == 0; // LEFT
+    return *left || strcmp(word, "\xD9\xC9\xC7\xC8\xE3") == 0 ? 0 : -1; // RIGHT
+}
+
+/**
+ * Function: split_redis_fields
+ * Description: Splits a comma-separated list of names (the FIELDS argument
+ *              of REDIS_LOAD_HASH and REDIS_HSET_MANY); blanks around the
+ *              names are dropped.
+ * Parameters:
+ *   - text: The list (EBCDIC, null-terminated).
+ *   - max: Most names accepted.
+ *   - names: Receives the start of each name in text.
+ *   - lens: Receives the length of each name.
+ * Returns:
+ *   - Number of names, -1 if there are more than max or a name is empty.
+ */
+int split_redis_fields(const char *text, int max, const char **names, size_t *lens)
+{
+    const char *end;
+    int count = 0;
+
+    for (;;)
+    {
+        while (*text == 0x40) // EBCDIC ' '
+            text++;
+        for (end = text; *end != '\0' && *end != 0x6B; end++) // EBCDIC ','
+            ;
+        if (count == max)
+            return -1;
+        names[count] = text;
+        lens[count] = end - text;
+        while (lens[count] > 0 && text[lens[count] - 1] == 0x40)
+            lens[count]--;
+        if (lens[count] == 0)
+            return -1;
+        count++;
+        if (*end == '\0')
+            return count;
+        text = end + 1;
+    }
+}
+
+/**********************************************************************/
+/* Number Codec */
+/**********************************************************************/
+
+// Powers of ten that a double holds exactly
+static const double exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+#define EXACT_MANTISSA 9007199254740992.0 // 2^53: larger integers are not all exact
+
+/**
+ * Function: number_char
+ * Description: Maps a character of a number between the job CCSID (as
+ *              written by printf and read by strtod) and ASCII. Only the
+ *              characters of decimal numbers are known.
+ * Parameters:
+ *   - c: Character to map.
+ *   - to_ascii: 1 to map from the job CCSID to ASCII, 0 for the reverse.
+ * Returns:
+ *   - Mapped character, 0 if c is not part of a number.
+ */
+static char number_char(char c, int to_ascii)
+{
+    static const char native[] = "0123456789.-+eE";
+    static const char ascii[] = "\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x2E\x2D\x2B\x65\x45";
+    const char *from = to_ascii ? native : ascii;
+    const char *to = to_ascii ? ascii : native;
+    int i;
+
+    for (i = 0; i < (int)sizeof(native) - 1; i++)
+    {
+        if (from[i] == c)
+            return to[i];
+    }
+    return 0;
+}
+
+/**
+ * Function: format_redis_double
+ * Description: Formats a double as the shortest ASCII text that reads back
+ *              as the same value. Whole numbers are written digit by digit;
+ *              other values take the fewest of 15, 16 or 17 significant
+ *              digits that round-trip.
+ * Parameters:
+ *   - value: Value to format.
+ *   - out: Output buffer (ASCII), at least REDIS_DOUBLE_TEXT bytes.
+ * Returns:
+ *   - Number of bytes written (not null-terminated).
+ */
+int format_redis_double(double value, char *out)
+{
+    char text[REDIS_DOUBLE_TEXT];
+    long long whole;
+    int len = 0, precision;
+
+    if (value != value)
+    {
+        memcpy(out, "\x6E\x61\x6E", 3); // ASCII "nan"
+        return 3;
+    }
+    if (value - value != 0)
+    {
+        if (value < 0)
+            out[len++] = 0x2D; // ASCII '-'
+        memcpy(out + len, "\x69\x6E\x66", 3); // ASCII "inf"
+        return len + 3;
+    }
+
+    if (value > -EXACT_MANTISSA && value < EXACT_MANTISSA && (whole = (long long)value) == value)
+    {
+        if (whole < 0)
+        {
+            out[len++] = 0x2D; // ASCII '-'
+            whole = -whole;
+        }
+        return len + format_ascii_number((size_t)whole, out + len);
+    }
+
+    for (precision = 15;; precision++)
+    {
+        snprintf(text, sizeof(text), "%.*g", precision, value);
+        if (precision == 17 || strtod(text, NULL) == value)
+            break;
+    }
+    for (len = 0; text[len] != '\0'; len++)
+        out[len] = number_char(text[len], 1);
+    return len;
+}
+
+/**
+ * Function: format_redis_integer
+ * Description: Formats a 64-bit integer as ASCII digits, with a leading
+ *              '-' when negative.
+ * Parameters:
+ *   - value: Value to format.
+ *   - out: Output buffer (ASCII), at least REDIS_DOUBLE_TEXT bytes.
+ * Returns:
+ *   - Number of bytes written (not null-terminated).
+ */
+int format_redis_integer(long long value, char *out)
+{
+    unsigned long long number = value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value;
+    char digits[20];
+    int count = 0, len = 0, i;
+
+    if (value < 0)
+        out[len++] = 0x2D; // ASCII '-'
+    do
+    {
+        digits[count++] = 0x30 + (int)(number % 10);
+        number /= 10;
+    } while (number > 0);
+
+    for (i = 0; i < count; i++)
+        out[len++] = digits[count - 1 - i];
+    return len;
+}
+
+/**
+ * Function: format_ebcdic_integer
+ * Description: Formats a 64-bit integer as EBCDIC digits, for numbers
+ *              passed where EBCDIC text is expected (e.g., the arguments
+ *              of eval_redis_script).
+ * Parameters:
+ *   - value: Value to format.
+ *   - out: Output buffer (EBCDIC), at least REDIS_DOUBLE_TEXT bytes.
+ * Returns:
+ *   - Number of bytes written (null-terminated, terminator excluded).
+ */
+int format_ebcdic_integer(long long value, char *out)
+{
+    int len = format_redis_integer(value, out), i;
+
+    for (i = 0; i < len; i++)
+        out[i] = out[i] == 0x2D ? 0x60 : (char)(0xF0 + out[i] - 0x30); // EBCDIC '-', '0'-'9'
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * Function: parse_ascii_double
+ * Description: Converts ASCII number text to a double. Up to 19
+ *              significant digits with a mantissa of at most 2^53 and a
+ *              power of ten within 10^22 are converted with a single exact
+ *              multiplication or division; anything else is translated to
+ *              the job CCSID for strtod(). Both round correctly.
+ * Parameters:
+ *   - text: Number text (ASCII, not null-terminated).
+ *   - len: Length of the text.
+ *   - value: Receives the value.
+ * Returns:
+ *   - 0 on success, -1 if the text is not a number.
+ */
+static int parse_ascii_double(const char *text, size_t len, double *value)
+{
+    char native[128];
+    unsigned long long mantissa = 0;
+    int negative = 0, digits = 0, seen = 0, inexact = 0;
+    int exponent = 0, exp_value = 0, exp_negative = 0;
+    size_t i = 0;
+    char *end;
+
+    if (len > 0 && (text[0] == 0x2D || text[0] == 0x2B)) // ASCII '-' / '+'
+    {
+        negative = text[0] == 0x2D;
+        i++;
+    }
+    // Infinite scores are sent as "inf", "+inf" or "-inf"
+    if (len - i == 3 && (text[i] | 0x20) == 0x69 && (text[i + 1] | 0x20) == 0x6E &&
+        (text[i + 2] | 0x20) == 0x66)
+    {
+        *value = negative ? -HUGE_VAL : HUGE_VAL;
+        return 0;
+    }
+
+    for (; i < len && text[i] >= 0x30 && text[i] <= 0x39; i++, seen++)
+    {
+        if (mantissa == 0 && text[i] == 0x30)
+            continue; // Leading zero
+        if (digits++ < 19)
+            mantissa = mantissa * 10 + (text[i] - 0x30);
+        else
+            inexact = 1;
+    }
+    if (i < len && text[i] == 0x2E) // ASCII '.'
+    {
+        for (i++; i < len && text[i] >= 0x30 && text[i] <= 0x39; i++, seen++)
+        {
+            if (mantissa == 0 && text[i] == 0x30)
+            {
+                exponent--;
+                continue;
+            }
+            if (digits++ < 19)
+            {
+                mantissa = mantissa * 10 + (text[i] - 0x30);
+                exponent--;
+            }
+            else
+                inexact = 1;
+        }
+    }
+    if (seen == 0)
+        return -1;
+    if (i < len && (text[i] | 0x20) == 0x65) // ASCII 'e' / 'E'
+    {
+        i++;
+        if (i < len && (text[i] == 0x2D || text[i] == 0x2B))
+            exp_negative = text[i++] == 0x2D;
+        if (i >= len || text[i] < 0x30 || text[i] > 0x39)
+            return -1;
+        for (; i < len && text[i] >= 0x30 && text[i] <= 0x39; i++)
+        {
+            if (exp_value < 100000)
+                exp_value = exp_value * 10 + (text[i] - 0x30);
+        }
+    }
+    if (i != len)
+        return -1;
+    exponent += exp_negative ? -exp_value : exp_value;
+
+    if (!inexact && mantissa <= (unsigned long long)EXACT_MANTISSA && exponent >= -22 && exponent <= 22)
+    {
+        *value = exponent < 0 ? (double)mantissa / exact_powers[-exponent]
+                              : (double)mantissa * exact_powers[exponent];
+        if (negative)
+            *value = -*value;
+        return 0;
+    }
+
+    if (len >= sizeof(native))
+        return -1;
+    for (i = 0; i < len; i++)
+        native[i] = number_char(text[i], 0);
+    native[len] = '\0';
+    *value = strtod(native, &end);
+    return end == native + len ? 0 : -1;
+}
+
 /**********************************************************************/
+/* Reply Framing */
+/**********************************************************************/
+
+static void mark_redis_connection_broken(int sockfd);
+static int last_redis_command(int sockfd, const char **cmd, size_t *cmd_len, double *wait);
+
+/**
+ * Function: redis_reply_span
+ * Description: Finds the end of the RESP reply starting at pos. Works on the
+ *              raw ASCII bytes received from Redis (before translation).
+ * Parameters:
+ *   - buf: Received data (ASCII).
+ *   - len: Number of bytes received.
+ *   - pos: Offset of the reply type byte.
+ * Returns:
+ *   - Offset just past the reply, -1 if more data is needed,
+ *     -2 if the data is not valid RESP.
+ */
+long redis_reply_span(const char *buf, size_t len, size_t pos)
+{
+    size_t line_end = pos;
+    long count, i, next;
+    int negative = 0;
+    size_t digits = pos + 1;
+
+    if (pos >= len)
+        return -1;
+
+    // Find the CRLF that terminates the type line
+    while (line_end + 1 < len && !(buf[line_end] == 0x0D && buf[line_end + 1] == 0x0A))
+        line_end++;
+    if (line_end + 1 >= len)
+        return -1;
+
+    switch ((unsigned char)buf[pos])
+    {
+    case 0x2B: // ASCII '+' simple string
+    case 0x2D: // ASCII '-' error
+    case 0x3A: // ASCII ':' integer
+        return (long)(line_end + 2);
+    case 0x24: // ASCII '$' bulk string
+    case 0x2A: // ASCII '*' array
+        break;
+    default:
+        return -2;
+    }
+
+    // Parse the length/count field (ASCII digits, optional '-')
+    if (digits < line_end && buf[digits] == 0x2D)
+    {
+        negative = 1;
+        digits++;
+    }
+    if (digits >= line_end)
+        return -2;
+    count = 0;
+    for (; digits < line_end; digits++)
+    {
+        if (buf[digits] < 0x30 || buf[digits] > 0x39)
+            return -2;
+        count = count * 10 + (buf[digits] - 0x30);
+    }
+    next = (long)(line_end + 2);
+    if (negative)
+        return next; // $-1 / *-1 null reply
+
+    if (buf[pos] == 0x24)
+    {
+        if ((size_t)next + count + 2 > len)
+            return -1;
+        return next + count + 2;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        next = redis_reply_span(buf, len, (size_t)next);
+        if (next < 0)
+            return next;
+    }
+    return next;
+}
+
+/**
+ * Function: redis_reply_item
+ * Description: Reads the RESP value at *pos of a complete reply. Arrays
+ *              yield a header with their element count; the elements are
+ *              read by the following calls.
+ * Parameters:
+ *   - buf: Received data (ASCII).
+ *   - len: Number of bytes received.
+ *   - pos: Offset of the value; advanced past it (past the header for arrays).
+ *   - item: Receives the value.
+ * Returns:
+ *   - 0 on success, -1 if the data ends early, -2 if it is not valid RESP.
+ */
+int redis_reply_item(const char *buf, size_t len, size_t *pos, RedisReplyItem *item)
+{
+    size_t start = *pos, line_end = start, digits = start + 1;
+    long long number = 0;
+    int negative = 0;
+
+    if (start >= len)
+        return -1;
+    while (line_end + 1 < len && !(buf[line_end] == 0x0D && buf[line_end + 1] == 0x0A))
+        line_end++;
+    if (line_end + 1 >= len)
+        return -1;
+
+    memset(item, 0, sizeof(*item));
+    item->type = buf[start];
+    switch ((unsigned char)buf[start])
+    {
+    case 0x2B: // ASCII '+' simple string
+    case 0x2D: // ASCII '-' error
+        item->data = buf + start + 1;
+        item->len = line_end - start - 1;
+        *pos = line_end + 2;
+        return 0;
+    case 0x3A: // ASCII ':' integer
+    case 0x24: // ASCII '$' bulk string
+    case 0x2A: // ASCII '*' array
+        break;
+    default:
+        return -2;
+    }
+
+    // Number, length or count field (ASCII digits, optional '-')
+    if (digits < line_end && buf[digits] == 0x2D)
+    {
+        negative = 1;
+        digits++;
+    }
+    if (digits >= line_end)
+        return -2;
+    for (; digits < line_end; digits++)
+    {
+        if (buf[digits] < 0x30 || buf[digits] > 0x39)
+            return -2;
+        number = number * 10 + (buf[digits] - 0x30);
+    }
+    number = negative ? -number : number;
+    *pos = line_end + 2;
+
+    if (item->type == 0x3A)
+    {
+        item->data = buf + start + 1; // Digits as sent
+        item->len = line_end - start - 1;
+        item->number = number;
+    }
+    else if (number < 0)
+    {
+        item->nil = 1; // $-1 / *-1
+    }
+    else if (item->type == 0x2A)
+    {
+        item->len = (size_t)number;
+        item->number = number;
+    }
+    else
+    {
+        if (*pos + (size_t)number + 2 > len)
+            return -1;
+        item->data = buf + *pos;
+        item->len = (size_t)number;
+        *pos += (size_t)number + 2;
+    }
+    return 0;
+}
+
+/**
+ * Function: redis_reply_row
+ * Description: Reads the next row of a reply returned as a table. Arrays
+ *              fully returned are closed first; a non-empty array opens a
+ *              level for its elements.
+ * Parameters:
+ *   - reply: Reply (ASCII).
+ *   - cursor: Position in the reply; advanced past the row.
+ *   - item: Receives the value of the row.
+ *   - position: Receives the 1-based position in the enclosing array.
+ *   - level: Receives the nesting level.
+ * Returns:
+ *   - 0 for a row, 1 at the end, -1 if malformed, -2 if nested too deeply.
+ */
+int redis_reply_row(const char *reply, RedisReplyCursor *cursor, RedisReplyItem *item,
+                    int *position, int *level)
+{
+    size_t pos;
+
+    while (cursor->depth > 0 && cursor->remaining[cursor->depth - 1] == 0)
+        cursor->depth--; // Arrays fully returned
+    if (cursor->pos >= cursor->len)
+        return 1;
+
+    pos = cursor->pos;
+    if (redis_reply_item(reply, cursor->len, &pos, item) != 0)
+        return -1;
+
+    *level = cursor->depth;
+    *position = 1;
+    if (cursor->depth > 0)
+    {
+        cursor->remaining[cursor->depth - 1]--;
+        *position = ++cursor->index[cursor->depth - 1];
+    }
+
+    // A non-empty nested array: its elements are the next rows
+    if (item->type == 0x2A && !item->nil && item->len > 0) // ASCII '*'
+    {
+        if (cursor->depth == REDIS_CURSOR_DEPTH)
+            return -2;
+        cursor->remaining[cursor->depth] = (int)item->len;
+        cursor->index[cursor->depth] = 0;
+        cursor->depth++;
+    }
+    cursor->pos = (int)pos;
+    return 0;
+}
+
+/**
+ * Function: redis_reply_type
+ * Description: Returns the TYPE column value for a RESP value.
+ */
+const char *redis_reply_type(const RedisReplyItem *item)
+{
+    if (item->nil)
+        return "nil";
+    switch ((unsigned char)item->type)
+    {
+    case 0x2B: // ASCII '+'
+        return "status";
+    case 0x2D: // ASCII '-'
+        return "error";
+    case 0x3A: // ASCII ':'
+        return "integer";
+    case 0x2A: // ASCII '*'
+        return "array";
+    default:
+        return "string";
+    }
+}
+
+/**
+ * Function: receive_replies
+ * Description: Receives until the buffer holds count complete RESP replies.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the replies (ASCII).
+ *   - size: Size of the buffer.
+ *   - count: Number of replies expected.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure (errno set by recv).
+ */
+static int receive_replies(int sockfd, char *buf, size_t size, int count)
+{
+    size_t total = 0;
+    long next;
+    int len, i;
+
+    while (total < size)
+    {
+        len = recv(sockfd, buf + total, size - total, 0);
+        if (len <= 0)
+        {
+            if (total > 0)
+                mark_redis_connection_broken(sockfd);
+            return len;
+        }
+        total += len;
+
+        next = 0;
+        for (i = 0; i < count && next >= 0; i++)
+            next = redis_reply_span(buf, total, (size_t)next);
+        if (next >= 0)
+        {
+            if ((size_t)next != total)
+                mark_redis_connection_broken(sockfd); // Unexpected trailing data
+            return (int)total;
+        }
+        if (next == -2)
+        {
+            mark_redis_connection_broken(sockfd);
+            return (int)total;
+        }
+    }
+
+    // Reply larger than the caller's buffer: the rest is still on the socket
+    mark_redis_connection_broken(sockfd);
+    return (int)total;
+}
+
+/**
+ * Function: recv_redis_replies
+ * Description: Receives until the buffer holds count complete RESP replies.
+ *              The time spent here is the WAIT phase of the call.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the replies (ASCII).
+ *   - size: Size of the buffer.
+ *   - count: Number of replies expected.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure (errno set by recv).
+ */
+int recv_redis_replies(int sockfd, char *buf, size_t size, int count)
+{
+    int len;
+
+    REDIS_PROBE_ENTER();
+    len = receive_replies(sockfd, buf, size, count);
+    REDIS_PROBE_LEAVE(REDIS_PHASE_WAIT);
+    if (len > 0)
+        redis_stats_received(buf, len);
+    return len;
+}
+
+/**
+ * Function: recv_redis_stream
+ * Description: Receives whatever has arrived of a pipelined reply stream,
+ *              for callers that keep several batches in flight and count
+ *              the replies themselves (e.g., the bulk loader).
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the data (ASCII).
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure (errno set by recv).
+ */
+int recv_redis_stream(int sockfd, char *buf, size_t size)
+{
+    int len;
+
+    REDIS_PROBE_ENTER();
+    len = recv(sockfd, buf, size, 0);
+    REDIS_PROBE_LEAVE(REDIS_PHASE_WAIT);
+    if (len > 0)
+        redis_stats_received(buf, len);
+    return len;
+}
+
+/**
+ * Function: recv_redis_reply
+ * Description: Receives one complete RESP reply (ASCII) from Redis. In
+ *              cluster mode, -MOVED and -ASK redirections are followed by
+ *              resending the last command to the node that owns the slot.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Buffer to receive the reply.
+ *   - size: Size of the buffer.
+ * Returns:
+ *   - Number of bytes received, 0 if the connection was closed,
+ *     negative value on failure (errno set by recv).
+ */
+int recv_redis_reply(int sockfd, char *buf, size_t size)
+{
+    const char *cmd;
+    size_t cmd_len;
+    double wait;
+    int len = recv_redis_replies(sockfd, buf, size, 1);
+
+    if (len > 0 && buf[0] == 0x2D && redis_cluster_enabled() && // ASCII '-' error reply
+        last_redis_command(sockfd, &cmd, &cmd_len, &wait) == 0)
+        len = follow_redis_redirect(cmd, cmd_len, wait, buf, size, len);
+    return len;
+}
+
+/**
+ * Function: send_redis_buffer
+ * Description: Sends a complete buffer, retrying on partial writes.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - buf: Data to send (ASCII).
+ *   - len: Number of bytes to send.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int send_redis_buffer(int sockfd, const char *buf, size_t len)
+{
+    size_t sent = 0;
+    int rc;
+
+    while (sent < len)
+    {
+        rc = send(sockfd, buf + sent, len - sent, 0);
+        if (rc <= 0)
+            return -1;
+        sent += rc;
+    }
+    return 0;
+}
+
+/**********************************************************************/
+/* Redis Connection */
+/**********************************************************************/
+
+/**
+ * Redis server endpoint. Endpoint 0 is the primary (REDIS_IP/REDIS_PORT),
+ * the following ones are the read replicas listed in REDIS_REPLICAS.
+ */
+typedef struct
+{
+    char addr[64];   // IPv4 address
+    int port;        // TCP port
+    int outstanding; // Connections currently owned by UDF calls
+    double ewma_ms;  // Smoothed call latency in milliseconds
+    int replica;     // 1 when read-only commands may be served here
+} RedisEndpoint;
+
+/**
+ * Pooled connection slot. Connections stay open between UDF calls in the
+ * same job, so the handshake (AUTH, SELECT, CLIENT SETNAME) is paid once.
+ */
+typedef struct
+{
+    int sockfd;              // Socket, -1 when the slot is empty
+    int in_use;              // 1 while a UDF call owns the connection
+    int broken;              // 1 when the reply stream is out of sync
+    int endpoint;            // Index into endpoints[]
+    struct timeval acquired; // When the current call took the connection
+    const char *last_cmd;    // Last command sent (ASCII), for redirections
+    size_t last_len;         // Length of last_cmd
+    double wait;             // Server-side block of the call in seconds, negative when none
+} RedisPoolSlot;
+
+static RedisEndpoint endpoints[REDIS_MAX_ENDPOINTS];
+static int endpoint_count = 0;
+static int replica_count = 0;           // Endpoints flagged as replicas
+static unsigned int replica_cursor = 0; // Round-robin position
+static int reads_on_primary = 0;        // Read-your-writes switch (REDIS_ROUTE_READS)
+static RedisPoolSlot pool_slots[REDIS_POOL_SIZE];
+static int pool_initialized = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static char session_password[256] = {0}; // Set by REDIS_AUTH, overrides REDIS_PASSWORD
+
+/**
+ * Function: add_endpoint
+ * Description: Appends an endpoint parsed from "host[:port]". Caller holds pool_lock.
+ * Parameters:
+ *   - spec: Endpoint specification (job CCSID, not null-terminated).
+ *   - len: Length of the specification.
+ * Returns:
+ *   - Index of the new endpoint, negative value if it was not added.
+ */
+static int add_endpoint(const char *spec, size_t len)
+{
+    RedisEndpoint *ep;
+    const char *colon;
+    size_t addr_len;
+
+    while (len > 0 && *spec == ' ')
+    {
+        spec++;
+        len--;
+    }
+    while (len > 0 && spec[len - 1] == ' ')
+        len--;
+    if (len == 0 || endpoint_count >= REDIS_MAX_ENDPOINTS)
+        return -1;
+
+    ep = &endpoints[endpoint_count];
+    colon = memchr(spec, ':', len);
+    addr_len = colon ? (size_t)(colon - spec) : len;
+    if (addr_len >= sizeof(ep->addr))
+        return -1;
+    memcpy(ep->addr, spec, addr_len);
+    ep->addr[addr_len] = '\0';
+    ep->port = colon ? atoi(colon + 1) : REDIS_SERVER_PORT;
+    ep->outstanding = 0;
+    ep->ewma_ms = 0.0;
+    ep->replica = 0;
+    return endpoint_count++;
+}
+
+/**
+ * Function: init_pool
+ * Description: Marks every pool slot empty and loads the endpoint list.
+ *              Caller holds pool_lock.
+ */
+static void init_pool(void)
+{
+    int i, index;
+    const char *spec, *comma;
+
+    if (pool_initialized)
+        return;
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        pool_slots[i].sockfd = -1;
+        pool_slots[i].in_use = 0;
+        pool_slots[i].broken = 0;
+        pool_slots[i].endpoint = 0;
+        pool_slots[i].wait = -1.0;
+    }
+
+    // Endpoint 0: primary, then the comma-separated replica list
+    endpoint_count = 0;
+    replica_count = 0;
+    add_endpoint(REDIS_SERVER_ADDR, strlen(REDIS_SERVER_ADDR));
+    for (spec = REDIS_REPLICAS; *spec; spec = comma + 1)
+    {
+        comma = strchr(spec, ',');
+        index = add_endpoint(spec, comma ? (size_t)(comma - spec) : strlen(spec));
+        if (index > 0)
+        {
+            endpoints[index].replica = 1;
+            replica_count++;
+        }
+        if (!comma)
+            break;
+    }
+    pool_initialized = 1;
+}
+
+/**
+ * Function: mark_redis_connection_broken
+ * Description: Flags a pooled connection so release closes it instead of
+ *              keeping it (unread reply data would corrupt the next call).
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ */
+static void mark_redis_connection_broken(int sockfd)
+{
+    int i;
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd)
+            pool_slots[i].broken = 1;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/**
+ * Function: last_redis_command
+ * Description: Returns the last command sent on a pooled connection.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - cmd: Receives the command (ASCII).
+ *   - cmd_len: Receives the command length.
+ *   - wait: Receives the blocking timeout set with set_redis_wait,
+ *     negative when none.
+ * Returns:
+ *   - 0 on success, negative value if the connection is not pooled.
+ */
+static int last_redis_command(int sockfd, const char **cmd, size_t *cmd_len, double *wait)
+{
+    int i, rc = -1;
+
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd && pool_slots[i].in_use && pool_slots[i].last_cmd)
+        {
+            *cmd = pool_slots[i].last_cmd;
+            *cmd_len = pool_slots[i].last_len;
+            *wait = pool_slots[i].wait;
+            rc = 0;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return rc;
+}
+
+/**
+ * Function: send_redis_command
+ * Description: Sends an encoded command (ASCII) on a pooled connection and
+ *              remembers it so that a cluster redirection can resend it.
+ * Parameters:
+ *   - sockfd: Socket file descriptor from connect_to_redis.
+ *   - buf: Encoded command (ASCII). Must stay valid until the reply is read.
+ *   - len: Length of the command.
+ * Returns:
+ *   - Number of bytes sent, negative value on failure.
+ */
+int send_redis_command(int sockfd, const char *buf, size_t len)
+{
+    int i;
+
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd && pool_slots[i].in_use)
+        {
+            pool_slots[i].last_cmd = buf;
+            pool_slots[i].last_len = len;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    redis_stats_sent(buf, len);
+    REDIS_PROBE_ENTER();
+    i = send_redis_buffer(sockfd, buf, len);
+    REDIS_PROBE_LEAVE(REDIS_PHASE_SEND);
+    if (i != 0)
+        return -1;
+    return (int)len;
+}
+
+/**
+ * Function: find_redis_endpoint
+ * Description: Returns the index of the endpoint with the given address,
+ *              adding it to the endpoint list when it is not known yet.
+ * Parameters:
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ * Returns:
+ *   - Endpoint index, negative value if the endpoint list is full.
+ */
+int find_redis_endpoint(const char *addr, int port)
+{
+    char spec[80];
+    int i, index = -1;
+
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    for (i = 0; i < endpoint_count; i++)
+    {
+        if (endpoints[i].port == port && strcmp(endpoints[i].addr, addr) == 0)
+        {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0 && strlen(addr) < sizeof(endpoints[0].addr))
+    {
+        sprintf(spec, "%s:%d", addr, port);
+        index = add_endpoint(spec, strlen(spec));
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return index;
+}
+
+/**
+ * Function: redis_connection_idle
+ * Description: Checks that a pooled socket has nothing pending. A readable
+ *              idle socket means the server closed it or sent stray data.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ * Returns:
+ *   - 1 if the connection can be reused, 0 otherwise.
+ */
+static int redis_connection_idle(int sockfd)
+{
+    fd_set read_fds;
+    struct timeval no_wait;
+
+    FD_ZERO(&read_fds);
+    FD_SET(sockfd, &read_fds);
+    no_wait.tv_sec = 0;
+    no_wait.tv_usec = 0;
+    return select(sockfd + 1, &read_fds, NULL, NULL, &no_wait) == 0;
+}
+
+/**
+ * Function: set_receive_timeout
+ * Description: Sets how long a receive on the socket waits for data.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - seconds: Timeout in seconds, 0 to wait without limit.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int set_receive_timeout(int sockfd, double seconds)
+{
+    struct timeval timeout;
+
+    timeout.tv_sec = (long)seconds;
+    timeout.tv_usec = (long)((seconds - timeout.tv_sec) * 1000000.0);
+    return setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0 ? -1 : 0;
+}
+
+/**
+ * Function: open_redis_socket
+ * Description: Opens a new TCP connection to a Redis endpoint.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - ep: Endpoint to connect to.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int open_redis_socket(int *sockfd, const RedisEndpoint *ep)
+{
+    struct sockaddr_in server_addr;
+
+    *sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*sockfd < 0)
+        return -1;
+
+    if (set_receive_timeout(*sockfd, REDIS_RECV_TIMEOUT) != 0)
+    {
+        close(*sockfd);
+        return -2;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(ep->port);
+    server_addr.sin_addr.s_addr = inet_addr(ep->addr);
+
+    if (connect(*sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        close(*sockfd);
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * Function: send_handshake
+ * Description: Sends the handshake commands as one pipelined write and
+ *              checks that none of the replies is an error.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ *   - ebcdic_cmds: Encoded commands (EBCDIC).
+ *   - cmds_len: Length of the encoded commands.
+ *   - count: Number of commands in the pipeline.
+ *   - error_reply: Receives the first error reply (ASCII), if any.
+ *   - error_size: Size of error_reply.
+ * Returns:
+ *   - 0 if every reply succeeded, negative value otherwise.
+ */
+static int send_handshake(int sockfd, char *ebcdic_cmds, size_t cmds_len, int count, char *error_reply, size_t error_size)
+{
+    char ascii_cmds[2048], replies[4096];
+    long pos = 0;
+    int len, i;
+
+    if (ConvertToASCII(ebcdic_cmds, cmds_len, ascii_cmds, sizeof(ascii_cmds)) < 0)
+        return -1;
+    if (send_redis_buffer(sockfd, ascii_cmds, cmds_len) != 0)
+        return -2;
+
+    len = recv_redis_replies(sockfd, replies, sizeof(replies), count);
+    if (len <= 0)
+        return -3;
+
+    for (i = 0; i < count; i++)
+    {
+        if (pos >= len)
+            return -3;
+        if (replies[pos] == 0x2D) // ASCII '-' error reply
+        {
+            size_t copy = (size_t)(len - pos) < error_size - 1 ? (size_t)(len - pos) : error_size - 1;
+            memcpy(error_reply, replies + pos, copy);
+            error_reply[copy] = '\0';
+            return -4;
+        }
+        pos = redis_reply_span(replies, len, (size_t)pos);
+        if (pos < 0)
+            return -3;
+    }
+    return 0;
+}
+
+/**
+ * Function: redis_handshake
+ * Description: Applies the configured credentials, client name and database
+ *              to a new connection. HELLO 2 (which keeps RESP2 replies)
+ *              carries AUTH and SETNAME, and SELECT is pipelined behind it,
+ *              so the whole handshake costs one round trip. Servers older
+ *              than Redis 6 fall back to AUTH / CLIENT SETNAME / SELECT.
+ * Parameters:
+ *   - sockfd: Socket file descriptor of a freshly opened connection.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int redis_handshake(int sockfd)
+{
+    char password[sizeof(session_password)];
+    const char *user = REDIS_USER[0] ? REDIS_USER : "\x84\x85\x86\x81\xA4\x93\xA3"; // EBCDIC "default"
+    const char *argv[REDIS_MAX_ARGS];
+    size_t argl[REDIS_MAX_ARGS];
+    char cmds[2048], error_reply[64];
+    int argc, len, pos = 0, count = 0, rc, sent_hello = 0;
+    int select_db = atoi(REDIS_DB) != 0;
+
+    // REDIS_AUTH may replace the session password while this runs
+    pthread_mutex_lock(&pool_lock);
+    snprintf(password, sizeof(password), "%s", session_password[0] ? session_password : REDIS_PASSWORD);
+    pthread_mutex_unlock(&pool_lock);
+
+    if (!password[0] && !REDIS_CLIENT_NAME[0] && !select_db)
+        return 0; // Nothing configured, keep the connection free of extra traffic
+
+    // HELLO 2 [AUTH <user> <password>] [SETNAME <name>]
+    argc = 0;
+    argv[argc] = "\xC8\xC5\xD3\xD3\xD6"; argl[argc++] = 5; // EBCDIC "HELLO"
+    argv[argc] = "\xF2"; argl[argc++] = 1;                   // EBCDIC "2"
+    if (password[0])
+    {
+        argv[argc] = "\xC1\xE4\xE3\xC8"; argl[argc++] = 4;  // EBCDIC "AUTH"
+        argv[argc] = user; argl[argc] = strlen(user); argc++;
+        argv[argc] = password; argl[argc] = strlen(password); argc++;
+    }
+    if (REDIS_CLIENT_NAME[0])
+    {
+        argv[argc] = "\xE2\xC5\xE3\xD5\xC1\xD4\xC5"; argl[argc++] = 7; // EBCDIC "SETNAME"
+        argv[argc] = REDIS_CLIENT_NAME; argl[argc] = strlen(REDIS_CLIENT_NAME); argc++;
+    }
+    if (argc > 2)
+    {
+        len = format_redis_command(cmds + pos, sizeof(cmds) - pos, argc, argv, argl);
+        if (len < 0)
+            return -4;
+        pos += len;
+        count++;
+        sent_hello = 1;
+    }
+
+    // SELECT <db>
+    if (select_db)
+    {
+        argv[0] = "\xE2\xC5\xD3\xC5\xC3\xE3"; argl[0] = 6; // EBCDIC "SELECT"
+        argv[1] = REDIS_DB; argl[1] = strlen(REDIS_DB);
+        len = format_redis_command(cmds + pos, sizeof(cmds) - pos, 2, argv, argl);
+        if (len < 0)
+            return -4;
+        pos += len;
+        count++;
+    }
+
+    error_reply[0] = '\0';
+    rc = send_handshake(sockfd, cmds, pos, count, error_reply, sizeof(error_reply));
+    if (rc != -4 || !sent_hello ||
+        strncmp(error_reply, "\x2D\x45\x52\x52\x20\x75\x6E\x6B\x6E\x6F\x77\x6E", 12) != 0) // ASCII "-ERR unknown"
+        return rc;
+
+    // Pre-6.0 server without HELLO: AUTH [<user>] <password>, CLIENT SETNAME, SELECT
+    pos = 0;
+    count = 0;
+    if (password[0])
+    {
+        argc = 0;
+        argv[argc] = "\xC1\xE4\xE3\xC8"; argl[argc++] = 4; // EBCDIC "AUTH"
+        if (REDIS_USER[0])
+        {
+            argv[argc] = REDIS_USER; argl[argc] = strlen(REDIS_USER); argc++;
+        }
+        argv[argc] = password; argl[argc] = strlen(password); argc++;
+        len = format_redis_command(cmds + pos, sizeof(cmds) - pos, argc, argv, argl);
+        if (len < 0)
+            return -4;
+        pos += len;
+        count++;
+    }
+    if (REDIS_CLIENT_NAME[0])
+    {
+        argv[0] = "\xC3\xD3\xC9\xC5\xD5\xE3"; argl[0] = 6;         // EBCDIC "CLIENT"
+        argv[1] = "\xE2\xC5\xE3\xD5\xC1\xD4\xC5"; argl[1] = 7; // EBCDIC "SETNAME"
+        argv[2] = REDIS_CLIENT_NAME; argl[2] = strlen(REDIS_CLIENT_NAME);
+        len = format_redis_command(cmds + pos, sizeof(cmds) - pos, 3, argv, argl);
+        if (len < 0)
+            return -4;
+        pos += len;
+        count++;
+    }
+    if (select_db)
+    {
+        argv[0] = "\xE2\xC5\xD3\xC5\xC3\xE3"; argl[0] = 6; // EBCDIC "SELECT"
+        argv[1] = REDIS_DB; argl[1] = strlen(REDIS_DB);
+        len = format_redis_command(cmds + pos, sizeof(cmds) - pos, 2, argv, argl);
+        if (len < 0)
+            return -4;
+        pos += len;
+        count++;
+    }
+    return send_handshake(sockfd, cmds, pos, count, error_reply, sizeof(error_reply));
+}
+
+/**
+ * Function: acquire_connection
+ * Description: Returns a ready-to-use connection to one endpoint. An idle
+ *              pooled connection is reused when available; otherwise a new
+ *              TCP connection is opened and the handshake is applied once.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - endpoint: Index into endpoints[].
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+static int acquire_connection(int *sockfd, int endpoint)
+{
+    RedisEndpoint target;
+    struct timeval opened;
+    int i, rc;
+
+    // Writes queued by the job go out before any other command
+    redis_write_behind_barrier();
+
+    // The call is timed from its first connection to its last release
+    redis_stats_begin();
+    REDIS_PROBE_ENTER();
+
+    // Apply a pending Sentinel failover before handing out a connection
+    redis_sentinel_poll();
+
+    // Reuse an idle pooled connection when one is healthy
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd < 0 || pool_slots[i].in_use || pool_slots[i].endpoint != endpoint)
+            continue;
+        if (redis_connection_idle(pool_slots[i].sockfd))
+        {
+            pool_slots[i].in_use = 1;
+            pool_slots[i].last_cmd = NULL;
+            pool_slots[i].wait = -1.0;
+            gettimeofday(&pool_slots[i].acquired, NULL);
+            endpoints[endpoint].outstanding++;
+            *sockfd = pool_slots[i].sockfd;
+            pthread_mutex_unlock(&pool_lock);
+            redis_arena_begin();
+            REDIS_PROBE_LEAVE(REDIS_PHASE_CONNECT);
+            return 0;
+        }
+        close(pool_slots[i].sockfd); // Closed by the server or out of sync
+        pool_slots[i].sockfd = -1;
+    }
+    target = endpoints[endpoint];
+    pthread_mutex_unlock(&pool_lock);
+
+    gettimeofday(&opened, NULL);
+    rc = open_redis_socket(sockfd, &target);
+    if (rc != 0 && endpoint == 0 && redis_sentinel_refresh() > 0)
+    {
+        // The primary is gone and Sentinel named a new one: retry there
+        pthread_mutex_lock(&pool_lock);
+        target = endpoints[0];
+        pthread_mutex_unlock(&pool_lock);
+        rc = open_redis_socket(sockfd, &target);
+    }
+    if (rc == 0 && redis_handshake(*sockfd) != 0)
+    {
+        close(*sockfd);
+        rc = -4;
+    }
+    redis_stats_connect(&opened, rc != 0);
+    if (rc != 0)
+    {
+        REDIS_PROBE_LEAVE(REDIS_PHASE_CONNECT);
+        redis_stats_abort();
+        return rc;
+    }
+
+    // Keep the new connection in the pool if there is room
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd < 0)
+        {
+            endpoints[endpoint].outstanding++;
+            pool_slots[i].sockfd = *sockfd;
+            pool_slots[i].in_use = 1;
+            pool_slots[i].broken = 0;
+            pool_slots[i].endpoint = endpoint;
+            pool_slots[i].last_cmd = NULL;
+            pool_slots[i].wait = -1.0;
+            gettimeofday(&pool_slots[i].acquired, NULL);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    redis_arena_begin();
+    REDIS_PROBE_LEAVE(REDIS_PHASE_CONNECT);
+    return 0;
+}
+
+/**
+ * Function: connect_to_redis
+ * Description: Returns a connection to the primary. Used by every command
+ *              that writes, and by reads that must see the latest writes.
+ *              Every successful call must be paired with
+ *              release_redis_connection.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis(int *sockfd)
+{
+    return acquire_connection(sockfd, 0);
+}
+
+/**
+ * Function: connect_to_redis_addr
+ * Description: Opens a plain connection (no pooling, no handshake) to an
+ *              address, e.g. to query a Sentinel. Close it with close().
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_addr(int *sockfd, const char *addr, int port)
+{
+    RedisEndpoint target;
+
+    if (strlen(addr) >= sizeof(target.addr))
+        return -1;
+    strcpy(target.addr, addr);
+    target.port = port;
+    return open_redis_socket(sockfd, &target);
+}
+
+/**
+ * Function: set_redis_primary
+ * Description: Moves the primary (endpoint 0) to a new address after a
+ *              failover. Idle pooled connections to the old primary are
+ *              closed; those in use are closed when they are released.
+ * Parameters:
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ * Returns:
+ *   - 1 if the primary changed, 0 otherwise.
+ */
+int set_redis_primary(const char *addr, int port)
+{
+    int i;
+
+    if (strlen(addr) >= sizeof(endpoints[0].addr))
+        return 0;
+
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    if (endpoints[0].port == port && strcmp(endpoints[0].addr, addr) == 0)
+    {
+        pthread_mutex_unlock(&pool_lock);
+        return 0;
+    }
+    strcpy(endpoints[0].addr, addr);
+    endpoints[0].port = port;
+    endpoints[0].ewma_ms = 0.0;
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd < 0 || pool_slots[i].endpoint != 0)
+            continue;
+        if (pool_slots[i].in_use)
+            pool_slots[i].broken = 1;
+        else
+        {
+            close(pool_slots[i].sockfd);
+            pool_slots[i].sockfd = -1;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return 1;
+}
+
+/**
+ * Function: set_redis_replica
+ * Description: Adds or removes an address from the replicas that serve
+ *              read-only commands.
+ * Parameters:
+ *   - addr: IPv4 address (job CCSID, null-terminated).
+ *   - port: TCP port.
+ *   - replica: 1 to serve reads from the address, 0 to stop.
+ */
+void set_redis_replica(const char *addr, int port, int replica)
+{
+    char spec[80];
+    int i, endpoint = -1;
+
+    if (strlen(addr) >= sizeof(endpoints[0].addr))
+        return;
+
+    // Endpoint 0 is skipped: after a failover it may carry the same address
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    for (i = 1; i < endpoint_count && endpoint < 0; i++)
+    {
+        if (endpoints[i].port == port && strcmp(endpoints[i].addr, addr) == 0)
+            endpoint = i;
+    }
+    if (endpoint < 0 && replica)
+    {
+        sprintf(spec, "%s:%d", addr, port);
+        endpoint = add_endpoint(spec, strlen(spec));
+    }
+    if (endpoint > 0 && endpoints[endpoint].replica != replica)
+    {
+        endpoints[endpoint].replica = replica;
+        replica_count += replica ? 1 : -1;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
 
 /**
- * Function: connect_to_redis
- * Description: Establishes a TCP connection to a Redis server.
+ * Function: connect_to_redis_endpoint
+ * Description: Returns a connection to a specific endpoint (cluster node or
+ *              shard). Pair with release_redis_connection.
  * Parameters:
  *   - sockfd: Pointer to store the socket file descriptor.
+ *   - endpoint: Endpoint index from find_redis_endpoint.
  * Returns:
  *   - 0 on success, negative value on failure.
  */
-int connect_to_redis(int *sockfd)
+int connect_to_redis_endpoint(int *sockfd, int endpoint)
 {
-    struct sockaddr_in server_addr;
+    return acquire_connection(sockfd, endpoint);
+}
 
-    *sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (*sockfd < 0)
+/**
+ * Function: redis_connection_endpoint
+ * Description: Tells which endpoint a pooled connection is open to.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ * Returns:
+ *   - Endpoint index, -1 if the connection is not pooled.
+ */
+int redis_connection_endpoint(int sockfd)
+{
+    int i, endpoint = -1;
+
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd && pool_slots[i].in_use)
+            endpoint = pool_slots[i].endpoint;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return endpoint;
+}
+
+/**
+ * Function: connect_to_redis_key
+ * Description: Returns a connection for a command that writes a single key.
+ *              In cluster mode the node owning the key's hash slot is used,
+ *              otherwise the primary.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - key: Redis key (EBCDIC, null-terminated).
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_key(int *sockfd, const char *key)
+{
+    int endpoint = redis_endpoint_for_key(key, strlen(key));
+
+    if (endpoint < 0)
+        return connect_to_redis(sockfd);
+    return acquire_connection(sockfd, endpoint);
+}
+
+/**
+ * Function: connect_to_redis_read_key
+ * Description: Returns a connection for a command that reads a single key.
+ *              In cluster mode the node owning the key's hash slot is used,
+ *              otherwise the read routing of connect_to_redis_read applies.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ *   - key: Redis key (EBCDIC, null-terminated).
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_read_key(int *sockfd, const char *key)
+{
+    int endpoint = redis_endpoint_for_key(key, strlen(key));
+
+    if (endpoint < 0)
+        return connect_to_redis_read(sockfd);
+    return acquire_connection(sockfd, endpoint);
+}
+
+/**
+ * Function: choose_replica
+ * Description: Picks a replica according to REDIS_READ_POLICY:
+ *              "round-robin" (default), "least-outstanding" (fewest calls in
+ *              flight) or "latency" (lowest smoothed call time).
+ *              Caller holds pool_lock.
+ * Returns:
+ *   - Endpoint index of the chosen replica.
+ */
+static int choose_replica(void)
+{
+    int best = 0, nth, i;
+
+    if (strcmp(REDIS_READ_POLICY, "least-outstanding") == 0)
+    {
+        for (i = 1; i < endpoint_count; i++)
+        {
+            if (endpoints[i].replica && (best == 0 || endpoints[i].outstanding < endpoints[best].outstanding))
+                best = i;
+        }
+        return best;
+    }
+    if (strcmp(REDIS_READ_POLICY, "latency") == 0)
+    {
+        for (i = 1; i < endpoint_count; i++)
+        {
+            if (endpoints[i].replica && (best == 0 || endpoints[i].ewma_ms < endpoints[best].ewma_ms))
+                best = i;
+        }
+        return best;
+    }
+
+    // Round-robin over the endpoints flagged as replicas
+    nth = (int)(replica_cursor++ % (unsigned int)replica_count);
+    for (i = 1; i < endpoint_count; i++)
+    {
+        if (endpoints[i].replica && nth-- == 0)
+            return i;
+    }
+    return 0;
+}
+
+/**
+ * Function: connect_to_redis_read
+ * Description: Returns a connection for a read-only command. Reads go to a
+ *              replica when REDIS_REPLICAS is configured, unless the job
+ *              switched reads to the primary with REDIS_ROUTE_READS. Falls
+ *              back to the primary if the replica cannot be reached.
+ * Parameters:
+ *   - sockfd: Pointer to store the socket file descriptor.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int connect_to_redis_read(int *sockfd)
+{
+    int endpoint = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    if (replica_count > 0 && !reads_on_primary)
+        endpoint = choose_replica();
+    pthread_mutex_unlock(&pool_lock);
+
+    if (endpoint != 0 && acquire_connection(sockfd, endpoint) == 0)
+        return 0;
+    return acquire_connection(sockfd, 0);
+}
+
+/**
+ * Function: set_redis_read_mode
+ * Description: Switches where read-only commands are sent for this job.
+ * Parameters:
+ *   - primary: 1 to read from the primary (read-your-writes), 0 for replicas.
+ * Returns:
+ *   - The previous setting.
+ */
+int set_redis_read_mode(int primary)
+{
+    int previous;
+
+    pthread_mutex_lock(&pool_lock);
+    previous = reads_on_primary;
+    reads_on_primary = primary;
+    pthread_mutex_unlock(&pool_lock);
+    return previous;
+}
+
+/**
+ * Function: release_redis_connection
+ * Description: Returns a connection obtained from connect_to_redis. The socket
+ *              is kept open for the next call unless the call failed.
+ * Parameters:
+ *   - sockfd: Socket file descriptor from connect_to_redis (ignored if negative).
+ *   - sqlstate: SQLSTATE of the call; anything outside class 00-02 closes it,
+ *     except 38911 (error reply from Redis, read in full) and 38912
+ *     (transaction aborted by WATCH, read in full).
+ */
+void release_redis_connection(int sockfd, const char *sqlstate)
+{
+    RedisEndpoint *ep;
+    struct timeval now;
+    double elapsed_ms;
+    int i;
+    // An error reply or an aborted transaction read in full (38911, 38912) leaves the connection in sync
+    int reusable = (sqlstate[0] == '0' && sqlstate[1] <= '2') || strncmp(sqlstate, "38911", 5) == 0 ||
+                   strncmp(sqlstate, "38912", 5) == 0;
+
+    // The last release of a call gives back its arena memory
+    redis_arena_end(sockfd >= 0);
+    if (sockfd < 0)
+        return; // No connection was taken (e.g., a cluster fan-out)
+
+    redis_stats_end(sqlstate);
+    gettimeofday(&now, NULL);
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd && pool_slots[i].in_use)
+        {
+            // Feed the latency-based read policy
+            ep = &endpoints[pool_slots[i].endpoint];
+            elapsed_ms = (now.tv_sec - pool_slots[i].acquired.tv_sec) * 1000.0 +
+                         (now.tv_usec - pool_slots[i].acquired.tv_usec) / 1000.0;
+            ep->ewma_ms = ep->ewma_ms == 0.0 ? elapsed_ms : ep->ewma_ms * 0.8 + elapsed_ms * 0.2;
+            ep->outstanding--;
+
+            // A connection lent to a blocking command gets the normal receive timeout back
+            if (reusable && !pool_slots[i].broken &&
+                (pool_slots[i].wait < 0.0 || set_receive_timeout(sockfd, REDIS_RECV_TIMEOUT) == 0))
+            {
+                pool_slots[i].in_use = 0;
+                pool_slots[i].wait = -1.0;
+            }
+            else
+            {
+                close(sockfd);
+                pool_slots[i].sockfd = -1;
+                pool_slots[i].in_use = 0;
+                pool_slots[i].broken = 0;
+                pool_slots[i].wait = -1.0;
+            }
+            pthread_mutex_unlock(&pool_lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    close(sockfd); // Overflow connection, not pooled
+}
+
+/**
+ * Function: suspend_redis_call
+ * Description: Ends the call on a connection that the caller keeps across
+ *              UDF calls (e.g., a bulk load holding its connections from
+ *              row to row). The call is recorded and its arena memory given
+ *              back as on release; the connection stays with the caller.
+ * Parameters:
+ *   - sqlstate: SQLSTATE of the call.
+ */
+void suspend_redis_call(const char *sqlstate)
+{
+    redis_arena_end(1);
+    redis_stats_end(sqlstate);
+}
+
+/**
+ * Function: resume_redis_call
+ * Description: Starts a new call on a connection kept with
+ *              suspend_redis_call. It ends with suspend_redis_call again or
+ *              with release_redis_connection.
+ * Parameters:
+ *   - sockfd: Socket file descriptor.
+ */
+void resume_redis_call(int sockfd)
+{
+    int i;
+
+    redis_stats_begin();
+    redis_arena_begin();
+
+    // Latency of the endpoint is measured from here, not from the connect
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd && pool_slots[i].in_use)
+        {
+            gettimeofday(&pool_slots[i].acquired, NULL);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/**
+ * Function: set_redis_wait
+ * Description: Lets a connection wait for the reply of a blocking command
+ *              (BLPOP, BRPOP, BLMOVE) beyond the normal receive timeout:
+ *              the server-side timeout plus REDIS_RECV_TIMEOUT for the
+ *              round trip, or without limit for a timeout of 0. The normal
+ *              timeout is restored when the connection is released.
+ * Parameters:
+ *   - sockfd: Socket file descriptor from connect_to_redis.
+ *   - timeout: Server-side timeout of the command in seconds, 0 for none.
+ * Returns:
+ *   - 0 on success, negative value on failure.
+ */
+int set_redis_wait(int sockfd, double timeout)
+{
+    int i;
+
+    if (set_receive_timeout(sockfd, timeout > 0.0 ? timeout + REDIS_RECV_TIMEOUT : 0.0) != 0)
         return -1;
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
+    {
+        if (pool_slots[i].sockfd == sockfd && pool_slots[i].in_use)
+            pool_slots[i].wait = timeout;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+}
 
-    struct timeval timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
-    if (setsockopt(*sockfd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0)
+/**
+ * Function: set_redis_password
+ * Description: Remembers a password accepted by REDIS_AUTH so that every
+ *              connection opened later in the job authenticates with it.
+ *              Idle pooled connections are closed so they re-handshake.
+ * Parameters:
+ *   - password: Password (EBCDIC, null-terminated).
+ */
+void set_redis_password(const char *password)
+{
+    int i;
+
+    pthread_mutex_lock(&pool_lock);
+    init_pool();
+    strncpy(session_password, password, sizeof(session_password) - 1);
+    session_password[sizeof(session_password) - 1] = '\0';
+    for (i = 0; i < REDIS_POOL_SIZE; i++)
     {
-        close(*sockfd);
-        return -2;
+        if (pool_slots[i].sockfd >= 0 && !pool_slots[i].in_use)
+        {
+            close(pool_slots[i].sockfd);
+            pool_slots[i].sockfd = -1;
+        }
     }
+    pthread_mutex_unlock(&pool_lock);
+}
 
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(REDIS_SERVER_PORT);
-    server_addr.sin_addr.s_addr = inet_addr(REDIS_SERVER_ADDR);
+/**********************************************************************/
+/* Generic Commands */
+/**********************************************************************/
 
-    if (connect(*sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+/**
+ * Function: collect_redis_arguments
+ * Description: Builds the argument list of a generic command from a
+ *              command text and optional arguments. The command text is
+ *              split at blanks ("OBJECT ENCODING" gives two arguments);
+ *              trailing NULL arguments are left out.
+ * Parameters:
+ *   - command: Command text (EBCDIC, null-terminated).
+ *   - args: Arguments (EBCDIC, null-terminated).
+ *   - inds: Null indicators of the arguments.
+ *   - count: Number of arguments.
+ *   - argv: Receives the argument pointers (REDIS_MAX_ARGS entries).
+ *   - argl: Receives the argument lengths.
+ *   - key: Receives the index in argv of the first argument (the key the
+ *     command is routed by), -1 if there is none.
+ * Returns:
+ *   - Number of entries in argv, -1 if the command text is blank, -2 if a
+ *     NULL argument is followed by a non-NULL one, -3 if there are more
+ *     than REDIS_MAX_ARGS.
+ */
+int collect_redis_arguments(const char *command, const char **args, const SQLUDF_NULLIND *inds,
+                            int count, const char **argv, size_t *argl, int *key)
+{
+    const char *p = command;
+    int argc = 0, last = -1, i;
+
+    while (*p != '\0')
     {
-        close(*sockfd);
+        while (*p == 0x40) // EBCDIC ' '
+            p++;
+        if (*p == '\0')
+            break;
+        if (argc == REDIS_MAX_ARGS)
+            return -3;
+        argv[argc] = p;
+        while (*p != '\0' && *p != 0x40)
+            p++;
+        argl[argc] = p - argv[argc];
+        argc++;
+    }
+    if (argc == 0)
+        return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        if (inds[i] >= 0)
+            last = i;
+    }
+    for (i = 0; i <= last; i++)
+    {
+        if (inds[i] < 0)
+            return -2;
+    }
+    if (argc + last + 1 > REDIS_MAX_ARGS)
         return -3;
+
+    *key = last >= 0 ? argc : -1;
+    for (i = 0; i <= last; i++)
+    {
+        argv[argc] = args[i];
+        argl[argc++] = strlen(args[i]);
     }
-    return 0;
+    return argc;
+}
+
+/**
+ * Function: run_redis_command
+ * Description: Runs any command on the shared path: connection from the
+ *              pool (routed by the key argument in cluster or sharded
+ *              mode), encoding, translation, send and receipt of one
+ *              complete reply. On success the connection is left to the
+ *              caller, who releases it with the final SQLSTATE.
+ * Parameters:
+ *   - sockfd: Receives the connection (-1 after a failure).
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Arguments (EBCDIC); argv[key] must be null-terminated.
+ *   - argl: Argument lengths.
+ *   - key: Index of the argument the command is routed by, -1 for none.
+ *   - wait: Server-side timeout of a blocking command (set_redis_wait),
+ *     negative for other commands.
+ *   - buf: Receives the reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure (connection already released).
+ */
+static int run_redis_command(int *sockfd, int argc, const char **argv, const size_t *argl, int key,
+                             double wait, char *buf, size_t size, char *sqlstate, char *msgtext)
+{
+    char *ebcdic_cmd, *ascii_cmd;
+    size_t cmd_size = 24;
+    int len, i;
+
+    *sockfd = -1;
+    for (i = 0; i < argc; i++)
+        cmd_size += argl[i] + 27; // "$" + 20 digits + CRLF, value, CRLF
+
+    if ((key >= 0 ? connect_to_redis_key(sockfd, argv[key]) : connect_to_redis(sockfd)) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        strcpy(msgtext, "Failed to connect to Redis");
+        *sockfd = -1;
+        return -1;
+    }
+    if (wait >= 0.0 && set_redis_wait(*sockfd, wait) != 0)
+    {
+        strcpy(sqlstate, "38901");
+        strcpy(msgtext, "Failed to set the receive timeout");
+        release_redis_connection(*sockfd, sqlstate);
+        *sockfd = -1;
+        return -1;
+    }
+
+    // Kept in the call's arena until the release (cluster redirections resend it)
+    ebcdic_cmd = redis_arena_alloc(cmd_size * 2);
+    if (ebcdic_cmd == NULL)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Out of memory building the command");
+        release_redis_connection(*sockfd, sqlstate);
+        *sockfd = -1;
+        return -1;
+    }
+    ascii_cmd = ebcdic_cmd + cmd_size;
+
+    len = format_redis_command(ebcdic_cmd, cmd_size, argc, argv, argl);
+    if (len < 0 || ConvertToASCII(ebcdic_cmd, len, ascii_cmd, cmd_size - 1) < 0)
+    {
+        strcpy(sqlstate, "38902");
+        strcpy(msgtext, "Failed to convert command to ASCII");
+        release_redis_connection(*sockfd, sqlstate);
+        *sockfd = -1;
+        return -1;
+    }
+
+    if (send_redis_command(*sockfd, ascii_cmd, len) < 0)
+    {
+        strcpy(sqlstate, "38903");
+        strcpy(msgtext, "Failed to send command to Redis");
+        release_redis_connection(*sockfd, sqlstate);
+        *sockfd = -1;
+        return -1;
+    }
+
+    len = recv_redis_reply(*sockfd, buf, size - 1);
+    if (len < 0)
+    {
+        if (errno == EWOULDBLOCK || errno == EAGAIN)
+        {
+            strcpy(sqlstate, "38904");
+            strcpy(msgtext, "Receive timeout from Redis");
+        }
+        else
+        {
+            strcpy(sqlstate, "38905");
+            strcpy(msgtext, "Failed to receive data from Redis");
+        }
+    }
+    else if (len == 0)
+    {
+        strcpy(sqlstate, "38906");
+        strcpy(msgtext, "Connection closed by Redis");
+    }
+    else if (redis_reply_span(buf, len, 0) < 0)
+    {
+        if ((size_t)len >= size - 1)
+        {
+            strcpy(sqlstate, "38908");
+            strcpy(msgtext, "Response exceeds maximum length");
+        }
+        else
+        {
+            strcpy(sqlstate, "38909");
+            strcpy(msgtext, "Failed to parse Redis response");
+        }
+        len = -1;
+    }
+    if (len <= 0)
+    {
+        release_redis_connection(*sockfd, sqlstate);
+        *sockfd = -1;
+        return -1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Function: execute_redis_command
+ * Description: Runs any command on the shared path (see run_redis_command).
+ *              On success the connection is left to the caller, who
+ *              releases it with the final SQLSTATE.
+ * Parameters:
+ *   - sockfd: Receives the connection (-1 after a failure).
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Arguments (EBCDIC); argv[key] must be null-terminated.
+ *   - argl: Argument lengths.
+ *   - key: Index of the argument the command is routed by, -1 for none.
+ *   - buf: Receives the reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure (connection already released).
+ */
+int execute_redis_command(int *sockfd, int argc, const char **argv, const size_t *argl, int key,
+                          char *buf, size_t size, char *sqlstate, char *msgtext)
+{
+    return run_redis_command(sockfd, argc, argv, argl, key, -1.0, buf, size, sqlstate, msgtext);
+}
+
+/**
+ * Function: execute_redis_blocking
+ * Description: Runs a blocking command (BLPOP, BRPOP, BLMOVE) like
+ *              execute_redis_command, on a connection that waits for the
+ *              command's own timeout instead of the normal receive timeout.
+ *              The connection is held by the call for the whole wait.
+ * Parameters:
+ *   - sockfd: Receives the connection (-1 after a failure).
+ *   - argc: Number of arguments (command name included).
+ *   - argv: Arguments (EBCDIC); argv[key] must be null-terminated.
+ *   - argl: Argument lengths.
+ *   - key: Index of the argument the command is routed by, -1 for none.
+ *   - timeout: Timeout of the command in seconds, 0 to block without limit.
+ *   - buf: Receives the reply (ASCII, null-terminated).
+ *   - size: Size of the buffer.
+ *   - sqlstate: Receives the SQLSTATE of a failure.
+ *   - msgtext: Receives the message text of a failure.
+ * Returns:
+ *   - Length of the reply, -1 on failure (connection already released).
+ */
+int execute_redis_blocking(int *sockfd, int argc, const char **argv, const size_t *argl, int key,
+                           double timeout, char *buf, size_t size, char *sqlstate, char *msgtext)
+{
+    return run_redis_command(sockfd, argc, argv, argl, key, timeout, buf, size, sqlstate, msgtext);
+}
+
+/**
+ * Function: format_ebcdic_timeout
+ * Description: Formats a timeout in seconds as EBCDIC text for the blocking
+ *              commands (e.g., "0.5", "30").
+ * Parameters:
+ *   - timeout: Timeout in seconds.
+ *   - out: Output buffer (EBCDIC), at least REDIS_DOUBLE_TEXT bytes.
+ * Returns:
+ *   - Number of bytes written (null-terminated, terminator excluded).
+ */
+int format_ebcdic_timeout(double timeout, char *out)
+{
+    char text[REDIS_DOUBLE_TEXT];
+    int len = format_redis_double(timeout, text);
+
+    ConvertToEBCDIC(text, len, out, REDIS_DOUBLE_TEXT);
+    out[len] = '\0';
+    return len;
 }
 
 /**********************************************************************/
@@ -146,7 +2369,10 @@ int connect_to_redis(int *sockfd)
 
 /**
  * Function: extract_redis_payload
- * Description: Extracts the payload from a Redis server response.
+ * Description: Extracts the payload from a Redis server response. Bulk
+ *              payloads point into the response; status, integer and error
+ *              payloads are copied to the arena of the call and stay valid
+ *              until the connection is released (no free needed).
  * Parameters:
  *   - response: The response from the Redis server.
  *   - payload_out: Pointer to store the extracted payload.
@@ -167,7 +2393,7 @@ int extract_redis_payload(char *response, char **payload_out, size_t *length_out
         size_t value_len = crlf - value_start; // Length of the string between '+' and '\r\n'
         if (value_len > 0)
         {
-            *payload_out = (char *)malloc(value_len + 1);
+            *payload_out = (char *)redis_arena_alloc(value_len + 1);
             if (*payload_out)
             {
                 strncpy(*payload_out, value_start, value_len);
@@ -207,6 +2433,9 @@ int extract_redis_payload(char *response, char **payload_out, size_t *length_out
         *payload_out = crlf + 2;
         *length_out = payload_length;
 
+        // A reply cut off by the caller's buffer ends before the declared length
+        if (memchr(*payload_out, '\0', payload_length + 2) != NULL)
+            return -1;
         if (strncmp(*payload_out + payload_length, "\x0D\x25", 2) != 0)
             return -1;
 
@@ -223,7 +2452,7 @@ int extract_redis_payload(char *response, char **payload_out, size_t *length_out
         size_t value_len = crlf - value_start;
         if (value_len > 0)
         {
-            *payload_out = (char *)malloc(value_len + 1);
+            *payload_out = (char *)redis_arena_alloc(value_len + 1);
             if (*payload_out)
             {
                 strncpy(*payload_out, value_start, value_len);
@@ -245,7 +2474,7 @@ int extract_redis_payload(char *response, char **payload_out, size_t *length_out
         size_t error_len = crlf - error_start;
         if (error_len > 0)
         {
-            *payload_out = (char *)malloc(error_len + 1);
+            *payload_out = (char *)redis_arena_alloc(error_len + 1);
             if (*payload_out)
             {
                 strncpy(*payload_out, error_start, error_len);
@@ -259,6 +2488,63 @@ int extract_redis_payload(char *response, char **payload_out, size_t *length_out
     return -1; // Unknown or invalid response format
 }
 
+/**
+ * Function: parse_redis_integer
+ * Description: Reads an integer reply straight from the ASCII bytes
+ *              received: no translation and no copy of the digits.
+ * Parameters:
+ *   - reply: Received reply (ASCII).
+ *   - len: Length of the reply.
+ *   - value: Receives the integer.
+ * Returns:
+ *   - 0 on success, -2 for a nil reply, -1 for any other reply.
+ */
+int parse_redis_integer(const char *reply, size_t len, long long *value)
+{
+    RedisReplyItem item;
+    size_t pos = 0;
+
+    if (redis_reply_item(reply, len, &pos, &item) != 0)
+        return -1;
+    if (item.nil)
+        return -2;
+    if (item.type != 0x3A) // ASCII ':'
+        return -1;
+    *value = item.number;
+    return 0;
+}
+
+/**
+ * Function: parse_redis_double
+ * Description: Reads a floating-point reply (bulk string or integer)
+ *              straight from the ASCII bytes received.
+ * Parameters:
+ *   - reply: Received reply (ASCII).
+ *   - len: Length of the reply.
+ *   - value: Receives the value.
+ * Returns:
+ *   - 0 on success, -2 for a nil reply, -1 for any other reply or text
+ *     that is not a number.
+ */
+int parse_redis_double(const char *reply, size_t len, double *value)
+{
+    RedisReplyItem item;
+    size_t pos = 0;
+
+    if (redis_reply_item(reply, len, &pos, &item) != 0)
+        return -1;
+    if (item.nil)
+        return -2;
+    if (item.type == 0x3A) // ASCII ':'
+    {
+        *value = (double)item.number;
+        return 0;
+    }
+    if (item.type != 0x24) // ASCII '$'
+        return -1;
+    return parse_ascii_double(item.data, item.len, value);
+}
+
 /**********************************************************************/
 /* Initialization for USE_ICONV */
 /**********************************************************************/
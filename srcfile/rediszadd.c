@@ -19,6 +19,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define SEND_BUFFER 33000 // Size of the send buffer
+
 /**********************************************************************/
 /* SQL External Function: ZADD */
 /**********************************************************************/
@@ -59,9 +61,8 @@ void SQL_API_FN zaddRedisSortedSet(
 	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
 {
 	int sockfd;
-	char ebcdic_send_buf[33000], ascii_send_buf[33000], recv_buf[1024], ebcdic_payload[1024];
-	char ebcdic_key_len[10] = {0}, ebcdic_score_len[10] = {0}, ebcdic_member_len[10] = {0};
-	char score_str[64] = {0}, ebcdic_score[64] = {0};
+	char *ascii_send_buf;
+	char recv_buf[1024];
 	int len, total_len = 0;
 
 #ifdef USE_ICONV
@@ -98,164 +99,61 @@ void SQL_API_FN zaddRedisSortedSet(
 	*resultInd = 0;
 
 	// Connect to Redis
-	if (connect_to_redis(&sockfd) != 0)
+	if (connect_to_redis_key(&sockfd, key) != 0)
 	{
 		strncpy(sqlstate, "38901", 5);
 		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
 		return;
 	}
 
-	// Convert DOUBLE score to ASCII string
-	snprintf(score_str, sizeof(score_str), "%.17g", *score);
-
-	// Convert ASCII score string to EBCDIC
-	int score_str_len = strlen(score_str);
+	// Call buffer comes from the thread's arena and is given back on release
+	ascii_send_buf = redis_arena_alloc(SEND_BUFFER);
+	if (ascii_send_buf == NULL)
 	{
-		int si;
-		for (si = 0; si < score_str_len; si++)
-		{
-			char c = score_str[si];
-			if (c >= '0' && c <= '9')
-				ebcdic_score[si] = 0xF0 + (c - '0');
-			else if (c == '.')
-				ebcdic_score[si] = 0x4B;
-			else if (c == '-')
-				ebcdic_score[si] = 0x60;
-			else if (c == '+')
-				ebcdic_score[si] = 0x4E;
-			else if (c == 'e')
-				ebcdic_score[si] = 0x85;
-			else if (c == 'E')
-				ebcdic_score[si] = 0xC5;
-			else
-				ebcdic_score[si] = 0x4B; // fallback to '.'
-		}
-		ebcdic_score[si] = '\0';
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
+		*resultInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
 	}
 
-	// Format Redis ZADD command in EBCDIC
-	ebcdic_send_buf[0] = '\0';
-
-	// Calculate and format key length in EBCDIC (up to 255 bytes)
-	int key_len = strlen(key);
+	// Build ZADD command in ASCII: prebuilt "*4\r\n$4\r\nZADD\r\n", key, score and member.
+	// The score is formatted straight to ASCII, as the shortest text that reads back exactly.
+	size_t key_len = strlen(key);
 	if (key_len > 255)
-		key_len = 255;
-	if (key_len < 10)
-	{
-		ebcdic_key_len[0] = 0xF0 + key_len;
-		ebcdic_key_len[1] = '\0';
-	}
-	else
-	{
-		int i = 0, temp_len = key_len;
-		while (temp_len > 0)
-		{
-			ebcdic_key_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_key_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_key_len[j];
-			ebcdic_key_len[j] = ebcdic_key_len[i - 1 - j];
-			ebcdic_key_len[i - 1 - j] = tmp;
-		}
-	}
-
-	// Calculate and format score length in EBCDIC
-	int score_len = score_str_len;
-	if (score_len < 10)
-	{
-		ebcdic_score_len[0] = 0xF0 + score_len;
-		ebcdic_score_len[1] = '\0';
-	}
-	else
-	{
-		int i = 0, temp_len = score_len;
-		while (temp_len > 0)
-		{
-			ebcdic_score_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_score_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_score_len[j];
-			ebcdic_score_len[j] = ebcdic_score_len[i - 1 - j];
-			ebcdic_score_len[i - 1 - j] = tmp;
-		}
-	}
-
-	// Calculate and format member length in EBCDIC (up to 16370 bytes)
-	int member_len = strlen(member);
+		key_len = 255; // Truncate to match VARCHAR(255)
+	size_t member_len = strlen(member);
 	if (member_len > 16370)
 		member_len = 16370;
-	if (member_len < 10)
-	{
-		ebcdic_member_len[0] = 0xF0 + member_len;
-		ebcdic_member_len[1] = '\0';
-	}
-	else
-	{
-		int i = 0, temp_len = member_len;
-		while (temp_len > 0)
-		{
-			ebcdic_member_len[i++] = 0xF0 + (temp_len % 10);
-			temp_len /= 10;
-		}
-		ebcdic_member_len[i] = '\0';
-		for (int j = 0; j < i / 2; j++)
-		{
-			char tmp = ebcdic_member_len[j];
-			ebcdic_member_len[j] = ebcdic_member_len[i - 1 - j];
-			ebcdic_member_len[i - 1 - j] = tmp;
-		}
-	}
-
-	// Build ZADD command in EBCDIC:
-	// 	"*4\r\n$4\r\nZADD\r\n$<key_len>\r\n<key>\r\n$<score_len>\r\n<score>\r\n$<member_len>\r\n<member>\r\n"
-	strcat(ebcdic_send_buf, "\x5C\xF4\x0D\x25\x5B\xF4\x0D\x25\xE9\xC1\xC4\xC4\x0D\x25"); // EBCDIC "*4\r\n$4\r\nZADD\r\n"
-	strcat(ebcdic_send_buf, "\x5B");
-	strcat(ebcdic_send_buf, ebcdic_key_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, key, key_len);
-	strcat(ebcdic_send_buf, "\x0D\x25\x5B");
-	strcat(ebcdic_send_buf, ebcdic_score_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, ebcdic_score, score_len);
-	strcat(ebcdic_send_buf, "\x0D\x25\x5B");
-	strcat(ebcdic_send_buf, ebcdic_member_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-	strncat(ebcdic_send_buf, member, member_len);
-	strcat(ebcdic_send_buf, "\x0D\x25");
-
-	// Convert EBCDIC ZADD command to ASCII before sending
-	size_t ebcdic_len_size = strlen(ebcdic_send_buf);
-	if (ConvertToASCII(ebcdic_send_buf, ebcdic_len_size, ascii_send_buf, sizeof(ascii_send_buf) - 1) < 0)
+	const char *args[1] = {key};
+	char ascii_score[REDIS_DOUBLE_TEXT];
+	int score_len = format_redis_double(*score, ascii_score);
+	int cmd_len = format_redis_template(ascii_send_buf, SEND_BUFFER, REDIS_TEMPLATE(ZADD), 1, args, &key_len);
+	cmd_len = append_redis_argument(ascii_send_buf, SEND_BUFFER, cmd_len, ascii_score, score_len, 1);
+	cmd_len = append_redis_argument(ascii_send_buf, SEND_BUFFER, cmd_len, member, member_len, 0);
+	if (cmd_len < 0)
 	{
 		strncpy(sqlstate, "38902", 5);
 		strncpy(msgtext, "Failed to convert command to ASCII", 70);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
-	ascii_send_buf[ebcdic_len_size] = '\0';
 
 	// Send ZADD command to Redis
-	len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+	len = send_redis_command(sockfd, ascii_send_buf, cmd_len);
 	if (len < 0)
 	{
 		strncpy(sqlstate, "38903", 5);
 		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	// Receive response from Redis
-	len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
 	if (len < 0)
 	{
 		if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -269,7 +167,7 @@ void SQL_API_FN zaddRedisSortedSet(
 			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
 		}
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 	else if (len == 0)
@@ -277,41 +175,29 @@ void SQL_API_FN zaddRedisSortedSet(
 		strncpy(sqlstate, "38906", 5);
 		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
 		*resultInd = -1;
-		close(sockfd);
+		release_redis_connection(sockfd, sqlstate);
 		return;
 	}
 
 	total_len = len;
 	recv_buf[total_len] = '\0';
 
-	// Convert ASCII response to EBCDIC
-	if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_payload, sizeof(ebcdic_payload) - 1) < 0)
-	{
-		strncpy(sqlstate, "38907", 5);
-		strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
-		*resultInd = -1;
-		close(sockfd);
-		return;
-	}
-	ebcdic_payload[total_len] = '\0';
-
-	// Extract Redis response
-	char *payload = NULL;
-	size_t payload_length;
-	if (extract_redis_payload(ebcdic_payload, &payload, &payload_length) == 0)
+	// Parse the integer reply from the received bytes
+	long long number;
+	if (parse_redis_integer(recv_buf, total_len, &number) == 0)
 	{
-		// Parse the integer value from the payload (1=added, 0=updated)
-		*result = atol(payload);
+		// Integer value of the reply (1=added, 0=updated)
+		*result = number;
 		*resultInd = 0;
 	}
 	else
 	{
 		strncpy(sqlstate, "38909", 5);
-		snprintf(msgtext, 512, "Failed to extract payload from Redis response: EBCDIC=%.462s...", ebcdic_payload);
+		strncpy(msgtext, "Failed to extract payload from Redis response", 70);
 		*resultInd = -1;
 	}
 
-	close(sockfd);
+	release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(zaddRedisSortedSet, OS)
@@ -0,0 +1,224 @@
+/******************************************************************************
+ * File: rediszaddm.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the Redis ZADD_MANY function for IBM i.
+ *              Adds many members with their scores to a Redis sorted set
+ *              with one ZADD command. Returns the number of members added.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+/**********************************************************************/
+/* SQL External Function: ZADD_MANY */
+/**********************************************************************/
+
+/**
+ * Function: zaddManyRedis
+ * Description: SQL external function to add many members to a sorted set
+ *              with one ZADD. NULL members leave their score out; when every
+ *              member is NULL nothing is sent.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - scores: Input comma-separated scores, one per member
+ *     (VARCHAR(4096), EBCDIC), e.g. '1,2.5,-inf'.
+ *   - member1 .. member40: Input members (VARCHAR(4096), EBCDIC).
+ *   - result: Output number of members added (BIGINT, members whose score
+ *     was updated are not counted).
+ *   - *Ind: Null indicators for the inputs and the output.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "38911" is an error
+ *     reply from Redis (e.g., WRONGTYPE).
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (not used).
+ *   - nullind: Additional null indicators (not used).
+ */
+void SQL_API_FN zaddManyRedis(
+    SQLUDF_VARCHAR *key,             // Input: Redis key (EBCDIC)
+    SQLUDF_VARCHAR *scores,          // Input: scores (EBCDIC)
+    SQLUDF_VARCHAR *member1,         // Input: members (EBCDIC)
+    SQLUDF_VARCHAR *member2,
+    SQLUDF_VARCHAR *member3,
+    SQLUDF_VARCHAR *member4,
+    SQLUDF_VARCHAR *member5,
+    SQLUDF_VARCHAR *member6,
+    SQLUDF_VARCHAR *member7,
+    SQLUDF_VARCHAR *member8,
+    SQLUDF_VARCHAR *member9,
+    SQLUDF_VARCHAR *member10,
+    SQLUDF_VARCHAR *member11,
+    SQLUDF_VARCHAR *member12,
+    SQLUDF_VARCHAR *member13,
+    SQLUDF_VARCHAR *member14,
+    SQLUDF_VARCHAR *member15,
+    SQLUDF_VARCHAR *member16,
+    SQLUDF_VARCHAR *member17,
+    SQLUDF_VARCHAR *member18,
+    SQLUDF_VARCHAR *member19,
+    SQLUDF_VARCHAR *member20,
+    SQLUDF_VARCHAR *member21,
+    SQLUDF_VARCHAR *member22,
+    SQLUDF_VARCHAR *member23,
+    SQLUDF_VARCHAR *member24,
+    SQLUDF_VARCHAR *member25,
+    SQLUDF_VARCHAR *member26,
+    SQLUDF_VARCHAR *member27,
+    SQLUDF_VARCHAR *member28,
+    SQLUDF_VARCHAR *member29,
+    SQLUDF_VARCHAR *member30,
+    SQLUDF_VARCHAR *member31,
+    SQLUDF_VARCHAR *member32,
+    SQLUDF_VARCHAR *member33,
+    SQLUDF_VARCHAR *member34,
+    SQLUDF_VARCHAR *member35,
+    SQLUDF_VARCHAR *member36,
+    SQLUDF_VARCHAR *member37,
+    SQLUDF_VARCHAR *member38,
+    SQLUDF_VARCHAR *member39,
+    SQLUDF_VARCHAR *member40,
+    SQLUDF_BIGINT *result,           // Output: members added
+    SQLUDF_NULLIND *keyInd,          // Null indicators for inputs
+    SQLUDF_NULLIND *scoresInd,
+    SQLUDF_NULLIND *member1Ind,
+    SQLUDF_NULLIND *member2Ind,
+    SQLUDF_NULLIND *member3Ind,
+    SQLUDF_NULLIND *member4Ind,
+    SQLUDF_NULLIND *member5Ind,
+    SQLUDF_NULLIND *member6Ind,
+    SQLUDF_NULLIND *member7Ind,
+    SQLUDF_NULLIND *member8Ind,
+    SQLUDF_NULLIND *member9Ind,
+    SQLUDF_NULLIND *member10Ind,
+    SQLUDF_NULLIND *member11Ind,
+    SQLUDF_NULLIND *member12Ind,
+    SQLUDF_NULLIND *member13Ind,
+    SQLUDF_NULLIND *member14Ind,
+    SQLUDF_NULLIND *member15Ind,
+    SQLUDF_NULLIND *member16Ind,
+    SQLUDF_NULLIND *member17Ind,
+    SQLUDF_NULLIND *member18Ind,
+    SQLUDF_NULLIND *member19Ind,
+    SQLUDF_NULLIND *member20Ind,
+    SQLUDF_NULLIND *member21Ind,
+    SQLUDF_NULLIND *member22Ind,
+    SQLUDF_NULLIND *member23Ind,
+    SQLUDF_NULLIND *member24Ind,
+    SQLUDF_NULLIND *member25Ind,
+    SQLUDF_NULLIND *member26Ind,
+    SQLUDF_NULLIND *member27Ind,
+    SQLUDF_NULLIND *member28Ind,
+    SQLUDF_NULLIND *member29Ind,
+    SQLUDF_NULLIND *member30Ind,
+    SQLUDF_NULLIND *member31Ind,
+    SQLUDF_NULLIND *member32Ind,
+    SQLUDF_NULLIND *member33Ind,
+    SQLUDF_NULLIND *member34Ind,
+    SQLUDF_NULLIND *member35Ind,
+    SQLUDF_NULLIND *member36Ind,
+    SQLUDF_NULLIND *member37Ind,
+    SQLUDF_NULLIND *member38Ind,
+    SQLUDF_NULLIND *member39Ind,
+    SQLUDF_NULLIND *member40Ind,
+    SQLUDF_NULLIND *resultInd,       // Null indicator for output
+    char *sqlstate,                  // SQLSTATE (5 chars, e.g., "00000")
+    char *funcname,                  // Fully qualified function name
+    char *specname,                  // Specific name
+    char *msgtext,                   // Error message text (up to 70 chars)
+    short *sqlcode,                  // SQLCODE (optional, not used here)
+    SQLUDF_NULLIND *nullind)         // Additional null indicators for DB2SQL
+{
+    const char *members[REDIS_MANY_VALUES] = {member1, member2, member3, member4, member5, member6,
+                                              member7, member8, member9, member10, member11, member12,
+                                              member13, member14, member15, member16, member17, member18,
+                                              member19, member20, member21, member22, member23, member24,
+                                              member25, member26, member27, member28, member29, member30,
+                                              member31, member32, member33, member34, member35, member36,
+                                              member37, member38, member39, member40};
+    SQLUDF_NULLIND inds[REDIS_MANY_VALUES] = {*member1Ind, *member2Ind, *member3Ind, *member4Ind, *member5Ind,
+                                              *member6Ind, *member7Ind, *member8Ind, *member9Ind, *member10Ind,
+                                              *member11Ind, *member12Ind, *member13Ind, *member14Ind, *member15Ind,
+                                              *member16Ind, *member17Ind, *member18Ind, *member19Ind, *member20Ind,
+                                              *member21Ind, *member22Ind, *member23Ind, *member24Ind, *member25Ind,
+                                              *member26Ind, *member27Ind, *member28Ind, *member29Ind, *member30Ind,
+                                              *member31Ind, *member32Ind, *member33Ind, *member34Ind, *member35Ind,
+                                              *member36Ind, *member37Ind, *member38Ind, *member39Ind, *member40Ind};
+    const char *argv[2 * REDIS_MANY_VALUES + 2], *texts[REDIS_MANY_VALUES];
+    size_t argl[2 * REDIS_MANY_VALUES + 2], lens[REDIS_MANY_VALUES];
+    long long number;
+    int count, argc = 2, i;
+
+    strcpy(sqlstate, "00000");
+    *resultInd = -1;
+#ifdef USE_ICONV
+    if (!initialized)
+    {
+        initialize_conversion();
+        initialized = 1;
+    }
+    if (errno != 0)
+    {
+        strcpy(sqlstate, "38999");
+        strcpy(msgtext, "iconv initialization failed");
+        return;
+    }
+#endif
+
+    if (*keyInd < 0 || *scoresInd < 0)
+    {
+        strcpy(sqlstate, "38001");
+        strcpy(msgtext, "Input key or score list is NULL");
+        return;
+    }
+    count = split_redis_fields(scores, REDIS_MANY_VALUES, texts, lens);
+    if (count < 0)
+    {
+        strcpy(sqlstate, "38003");
+        strcpy(msgtext, "Score list must hold 1 to 40 scores");
+        return;
+    }
+
+    // ZADD key score member [score member ...]; Redis checks the scores
+    argv[0] = "\xE9\xC1\xC4\xC4"; // EBCDIC "ZADD"
+    argl[0] = 4;
+    argv[1] = key;
+    argl[1] = strlen(key);
+    for (i = 0; i < REDIS_MANY_VALUES; i++)
+    {
+        if (inds[i] < 0)
+            continue; // NULL leaves the score out
+        if (i >= count)
+        {
+            strcpy(sqlstate, "38003");
+            strcpy(msgtext, "More members than scores in the score list");
+            return;
+        }
+        argv[argc] = texts[i];
+        argl[argc++] = lens[i];
+        argv[argc] = members[i];
+        argl[argc++] = strlen(members[i]);
+    }
+    if (argc == 2)
+    {
+        *result = 0; // Nothing to write
+        *resultInd = 0;
+        return;
+    }
+
+    if (redis_write_many(argc, argv, argl, 0, &number, sqlstate, msgtext) == 1)
+    {
+        *result = number;
+        *resultInd = 0;
+    }
+}
+
+#pragma linkage(zaddManyRedis, OS)
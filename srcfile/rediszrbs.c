@@ -20,6 +20,8 @@
 #include <qtqiconv.h>
 #endif
 
+#define REPLY_BUFFER 32000 // Size of each receive buffer
+
 /**********************************************************************/
 /* Helper: Parse RESP array for ZRANGEBYSCORE                         */
 /**********************************************************************/
@@ -147,7 +149,7 @@ void SQL_API_FN zrangebyscoreRedisSSet(
 {
     int sockfd;
     char ebcdic_send_buf[1024], ascii_send_buf[1024];
-    char recv_buf[32000], ebcdic_response[32000];
+    char *recv_buf, *ebcdic_response;
     char ebcdic_key_len[10] = {0}, ebcdic_min_len[10] = {0}, ebcdic_max_len[10] = {0};
     int len, total_len = 0;
 
@@ -185,15 +187,26 @@ void SQL_API_FN zrangebyscoreRedisSSet(
     *valueInd = 0;
 
     // Connect to Redis
-    if (connect_to_redis(&sockfd) != 0)
+    if (connect_to_redis_read_key(&sockfd, key) != 0)
     {
         strncpy(sqlstate, "38901", 5);
         snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
         *valueInd = -1;
-        close(sockfd);
         return;
     }
 
+    // Call buffers come from the thread's arena and are given back on release
+    recv_buf = redis_arena_alloc(2 * REPLY_BUFFER);
+    if (recv_buf == NULL)
+    {
+        strncpy(sqlstate, "38902", 5);
+        strncpy(msgtext, "Out of memory for call buffers", 70);
+        *valueInd = -1;
+        release_redis_connection(sockfd, sqlstate);
+        return;
+    }
+    ebcdic_response = recv_buf + REPLY_BUFFER;
+
     // Format Redis ZRANGEBYSCORE command in EBCDIC
     ebcdic_send_buf[0] = '\0';
 
@@ -299,24 +312,24 @@ void SQL_API_FN zrangebyscoreRedisSSet(
         strncpy(sqlstate, "38902", 5);
         strncpy(msgtext, "Failed to convert command to ASCII", 70);
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ascii_send_buf[ebcdic_len_size] = '\0';
 
     // Send ZRANGEBYSCORE command to Redis
-    len = send(sockfd, ascii_send_buf, strlen(ascii_send_buf), 0);
+    len = send_redis_command(sockfd, ascii_send_buf, strlen(ascii_send_buf));
     if (len < 0)
     {
         strncpy(sqlstate, "38903", 5);
         snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
 
     // Receive response from Redis
-    len = recv(sockfd, recv_buf, sizeof(recv_buf) - 1, 0);
+    len = recv_redis_reply(sockfd, recv_buf, REPLY_BUFFER - 1);
     if (len < 0)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -330,7 +343,7 @@ void SQL_API_FN zrangebyscoreRedisSSet(
             snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
         }
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     else if (len == 0)
@@ -338,19 +351,19 @@ void SQL_API_FN zrangebyscoreRedisSSet(
         strncpy(sqlstate, "38906", 5);
         snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     total_len = len;
     recv_buf[total_len] = '\0';
 
     // Convert ASCII response to EBCDIC
-    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, sizeof(ebcdic_response) - 1) < 0)
+    if (ConvertToEBCDIC(recv_buf, total_len, ebcdic_response, REPLY_BUFFER - 1) < 0)
     {
         strncpy(sqlstate, "38907", 5);
         strncpy(msgtext, "Failed to convert response to EBCDIC", 70);
         *valueInd = -1;
-        close(sockfd);
+        release_redis_connection(sockfd, sqlstate);
         return;
     }
     ebcdic_response[total_len] = '\0';
@@ -376,7 +389,7 @@ void SQL_API_FN zrangebyscoreRedisSSet(
         *valueInd = -1;
     }
 
-    close(sockfd);
+    release_redis_connection(sockfd, sqlstate);
 }
 
 #pragma linkage(zrangebyscoreRedisSSet, OS)
@@ -0,0 +1,192 @@
+/******************************************************************************
+ * File: rediszscd.c
+ * Author: Ernest Rozloznik (e@er400.io)
+ * Date: 2025-02-22
+ * Description: Implementation of the Redis ZSCORE_D function for IBM i.
+ *              Like REDIS_ZSCORE, but returns the score as a DOUBLE: the
+ *              command is built from a prebuilt ASCII header and the score
+ *              is parsed straight from the ASCII reply, so no text
+ *              conversion happens in either direction.
+ * License: MIT (https://opensource.org/licenses/MIT)
+ * Version: 1.0.0
+ ******************************************************************************/
+
+#include "redis_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef USE_ICONV
+#include <qtqiconv.h>
+#endif
+
+#define SEND_BUFFER 33000 // Size of the send buffer
+
+/**********************************************************************/
+/* SQL External Function: ZSCORE_D */
+/**********************************************************************/
+
+/**
+ * Function: zscoreRedisSSetDouble
+ * Description: SQL external function to get the score of a member in a Redis
+ *              sorted set as a DOUBLE.
+ * Parameters:
+ *   - key: Input Redis key (VARCHAR(255), EBCDIC).
+ *   - member: Input member name (VARCHAR(16370), EBCDIC).
+ *   - value: Output score (DOUBLE); +/-infinity for "inf" scores.
+ *   - keyInd: Null indicator for the key.
+ *   - memberInd: Null indicator for the member.
+ *   - valueInd: Null indicator for the output value.
+ *   - sqlstate: SQLSTATE (5 chars, e.g., "00000"); "02000" if the member
+ *     or the key does not exist.
+ *   - funcname: Fully qualified function name.
+ *   - specname: Specific name.
+ *   - msgtext: Error message text (up to 70 chars).
+ *   - sqlcode: SQLCODE (optional, not used here).
+ *   - nullind: Additional null indicators for DB2SQL.
+ */
+void SQL_API_FN zscoreRedisSSetDouble(
+	SQLUDF_VARCHAR *key,		 // Input: Redis key (VARCHAR(255), EBCDIC)
+	SQLUDF_VARCHAR *member,		 // Input: Member name (VARCHAR(16370), EBCDIC)
+	SQLUDF_DOUBLE *value,		 // Output: score (DOUBLE)
+	SQLUDF_NULLIND *keyInd,		 // Null indicator for key
+	SQLUDF_NULLIND *memberInd,	 // Null indicator for member
+	SQLUDF_NULLIND *valueInd,	 // Null indicator for output value
+	char *sqlstate,				 // SQLSTATE (5 chars, e.g., "00000")
+	char *funcname,				 // Fully qualified function name
+	char *specname,				 // Specific name
+	char *msgtext,				 // Error message text (up to 70 chars)
+	short *sqlcode,				 // SQLCODE (optional, not used here)
+	SQLUDF_NULLIND *nullind)	 // Additional null indicators for DB2SQL
+{
+	int sockfd;
+	char *ascii_send_buf, recv_buf[1024];
+	int len, total_len = 0;
+
+#ifdef USE_ICONV
+	if (!initialized)
+	{
+		initialize_conversion();
+		initialized = 1;
+	}
+	if (errno != 0)
+	{
+		strcpy(sqlstate, "38999");
+		strcpy(msgtext, "iconv initialization failed");
+		*valueInd = -1;
+		return;
+	}
+#endif
+
+	// Initialize SQLSTATE to success
+	strncpy(sqlstate, "00000", 5);
+	sqlstate[5] = '\0';
+	msgtext[0] = '\0';
+
+	// Check for NULL inputs
+	if (*keyInd == -1 || *memberInd == -1)
+	{
+		strncpy(sqlstate, "38001", 5);
+		strncpy(msgtext, "Input key or member is NULL", 70);
+		*valueInd = -1;
+		return;
+	}
+
+	// Connect to Redis
+	if (connect_to_redis_read_key(&sockfd, key) != 0)
+	{
+		strncpy(sqlstate, "38901", 5);
+		snprintf(msgtext, 70, "Failed to connect to Redis: errno=%d", errno);
+		*valueInd = -1;
+		return;
+	}
+
+	// Call buffer comes from the thread's arena and is given back on release
+	ascii_send_buf = redis_arena_alloc(SEND_BUFFER);
+	if (ascii_send_buf == NULL)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Out of memory for call buffers", 70);
+		*valueInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+
+	// Build ZSCORE command in ASCII: prebuilt "*3\r\n$6\r\nZSCORE\r\n" plus key and member
+	size_t key_len = strlen(key);
+	if (key_len > 255)
+		key_len = 255; // Truncate to match VARCHAR(255)
+	const char *args[2] = {key, member};
+	size_t argl[2] = {key_len, strlen(member)};
+	int cmd_len = format_redis_template(ascii_send_buf, SEND_BUFFER, REDIS_TEMPLATE(ZSCORE), 2, args, argl);
+	if (cmd_len < 0)
+	{
+		strncpy(sqlstate, "38902", 5);
+		strncpy(msgtext, "Failed to convert command to ASCII", 70);
+		*valueInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+
+	// Send ZSCORE command to Redis
+	len = send_redis_command(sockfd, ascii_send_buf, cmd_len);
+	if (len < 0)
+	{
+		strncpy(sqlstate, "38903", 5);
+		snprintf(msgtext, 70, "Failed to send command to Redis: errno=%d", errno);
+		*valueInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+
+	// Receive response from Redis
+	len = recv_redis_reply(sockfd, recv_buf, sizeof(recv_buf) - 1);
+	if (len < 0)
+	{
+		if (errno == EWOULDBLOCK || errno == EAGAIN)
+		{
+			strncpy(sqlstate, "38904", 5);
+			snprintf(msgtext, 70, "Receive timeout from Redis: errno=%d, socket=%d", errno, sockfd);
+		}
+		else
+		{
+			strncpy(sqlstate, "38905", 5);
+			snprintf(msgtext, 70, "Failed to receive data from Redis: errno=%d, socket=%d", errno, sockfd);
+		}
+		*valueInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	else if (len == 0)
+	{
+		strncpy(sqlstate, "38906", 5);
+		snprintf(msgtext, 70, "Connection closed by Redis, socket=%d", sockfd);
+		*valueInd = -1;
+		release_redis_connection(sockfd, sqlstate);
+		return;
+	}
+	total_len = len;
+
+	// Parse the score from the received bytes
+	int rc = parse_redis_double(recv_buf, total_len, value);
+	if (rc == 0)
+	{
+		*valueInd = 0;
+	}
+	else if (rc == -2) // (nil) - member not found in sorted set
+	{
+		strncpy(sqlstate, "02000", 5);
+		strncpy(msgtext, "Member not found in sorted set", 70);
+		*valueInd = -1;
+	}
+	else
+	{
+		strncpy(sqlstate, "38909", 5);
+		strncpy(msgtext, "Failed to extract score from Redis response", 70);
+		*valueInd = -1;
+	}
+
+	release_redis_connection(sockfd, sqlstate);
+}
+
+#pragma linkage(zscoreRedisSSetDouble, OS)
@@ -1,5 +1,5 @@
 #!/bin/bash
-# Full test suite for all 50 Redis SQL functions
+# Full test suite for all Redis SQL functions
 # Usage: bash test_all.sh
 
 ISQL_CMD="isql -v ISSI_P10 OPS_API ops_api"
@@ -45,6 +45,33 @@ echo "VALUES REDIS400.REDIS_DEL('t_rnold')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_rnnew')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_hscn')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_sscn')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_cmd')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_cmdh')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ld1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ld2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ld3')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ldh1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ldh2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_wb')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_wbctr')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_coal')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_hinc')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_tx')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_txl')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_txc')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_eval')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_sfl:1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_sfl:2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_popn')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_popm')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_bq')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_bproc')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_hmany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_smany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_zmany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_lmany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_row')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_zscd')" | $ISQL_CMD > /dev/null 2>&1
 
 # 1. PING
 run_test "REDIS_PING" \
@@ -323,6 +350,230 @@ run_test "REDIS_DBSIZE" \
     "VALUES(REDIS400.REDIS_DBSIZE())" \
     "1"
 
+# 51. ROUTE_READS (switch to primary returns previous mode)
+run_test "REDIS_ROUTE_READS" \
+    "VALUES REDIS400.REDIS_ROUTE_READS('PRIMARY')" \
+    "REPLICA"
+echo "VALUES REDIS400.REDIS_ROUTE_READS('REPLICA')" | $ISQL_CMD > /dev/null 2>&1
+
+# 52. STATS (statistics are per job: call PING in the same session first)
+run_test "REDIS_STATS" \
+    "VALUES(REDIS400.REDIS_PING())
+SELECT COMMAND, CALLS FROM TABLE(REDIS400.REDIS_STATS()) S WHERE COMMAND = 'PING'" \
+    "PING"
+
+# 53. PROFILE (profile every call; PROFILED counts the sampled PING)
+run_test "REDIS_PROFILE" \
+    "VALUES REDIS400.REDIS_PROFILE(1)
+VALUES(REDIS400.REDIS_PING())
+SELECT 'PROFILED=' || PROFILED FROM TABLE(REDIS400.REDIS_STATS()) S WHERE COMMAND = 'PING'" \
+    "PROFILED=1"
+
+# 54. FLIGHT_DUMP (the PING above is in the ring; returns the number of calls written)
+run_test "REDIS_FLIGHT_DUMP" \
+    "VALUES(REDIS400.REDIS_PING())
+SELECT 'DUMPED=' || REDIS400.REDIS_FLIGHT_DUMP('/tmp/t_flight.log') FROM SYSIBM.SYSDUMMY1" \
+    "DUMPED=1"
+
+# --- Phase 11: Generic Commands ---
+
+# 55. COMMAND (any command; the reply comes back as text)
+echo "VALUES REDIS400.REDIS_COMMAND('SET', 't_cmd', 'generic')" | $ISQL_CMD > /dev/null 2>&1
+run_test "REDIS_COMMAND" \
+    "VALUES REDIS400.REDIS_COMMAND('GETRANGE', 't_cmd', '0', '3')" \
+    "gene"
+
+# 56. COMMAND_TABLE (typed rows: HINCRBY returns an integer)
+run_test "REDIS_COMMAND_TABLE" \
+    "SELECT TYPE || '=' || INTEGER_VALUE FROM TABLE(REDIS400.REDIS_COMMAND_TABLE('HINCRBY', 't_cmdh', 'f', '5')) C" \
+    "integer=5"
+
+# --- Phase 12: Typed Replies ---
+
+# 57. ZSCORE_D (score as a DOUBLE: 2.25 * 4 = 9)
+echo "VALUES REDIS400.REDIS_ZADD('t_zscd', 2.25, 'm')" | $ISQL_CMD > /dev/null 2>&1
+run_test "REDIS_ZSCORE_D" \
+    "VALUES INTEGER(REDIS400.REDIS_ZSCORE_D('t_zscd', 'm') * 4)" \
+    "9"
+
+# --- Phase 13: Bulk Load ---
+
+# 58. LOAD (rows of a query written in one pipelined load)
+run_test "REDIS_LOAD" \
+    "SELECT SUM(REDIS400.REDIS_LOAD(K, V)) FROM (VALUES ('t_ld1', 'a'), ('t_ld2', 'b'), ('t_ld3', 'c')) T(K, V)
+VALUES 'GOT=' || REDIS400.REDIS_GET('t_ld3')" \
+    "GOT=c"
+
+# 59. LOAD_HASH (columns named in FIELDS become hash fields)
+run_test "REDIS_LOAD_HASH" \
+    "SELECT SUM(REDIS400.REDIS_LOAD_HASH(K, 'name, city', N, C)) FROM (VALUES ('t_ldh1', 'Eva', 'Brno'), ('t_ldh2', 'Jan', 'Praha')) T(K, N, C)
+VALUES 'GOT=' || REDIS400.REDIS_HGET('t_ldh2', 'city')" \
+    "GOT=Praha"
+
+# 60. LOAD_REPORT (the load above: 2 rows, no failures)
+run_test "REDIS_LOAD_REPORT" \
+    "SELECT SUM(REDIS400.REDIS_LOAD(K, 'x', 60)) FROM (VALUES ('t_ld1'), ('t_ld2')) T(K)
+SELECT 'ROWS=' || ROW_COUNT || ' FAILED=' || FAILED FROM TABLE(REDIS400.REDIS_LOAD_REPORT()) R FETCH FIRST 1 ROW ONLY" \
+    "ROWS=2 FAILED=0"
+
+# --- Phase 14: Write-Behind ---
+
+# 61. WRITE_BEHIND (SET queued, written before the mode is switched off)
+run_test "REDIS_WRITE_BEHIND" \
+    "VALUES REDIS400.REDIS_WRITE_BEHIND('ON')
+VALUES REDIS400.REDIS_SET('t_wb', 'queued')
+VALUES REDIS400.REDIS_WRITE_BEHIND('OFF')
+VALUES 'GOT=' || REDIS400.REDIS_GET('t_wb')" \
+    "GOT=queued"
+
+# 62. FLUSH (queued INCRBYs written, none failed)
+run_test "REDIS_FLUSH" \
+    "VALUES REDIS400.REDIS_WRITE_BEHIND('ON')
+VALUES REDIS400.REDIS_INCRBY('t_wbctr', 2)
+VALUES REDIS400.REDIS_INCRBY('t_wbctr', 3)
+VALUES 'FAILED=' || REDIS400.REDIS_FLUSH() || ' GOT=' || REDIS400.REDIS_GET('t_wbctr')
+VALUES REDIS400.REDIS_WRITE_BEHIND('OFF')" \
+    "FAILED=0 GOT=5"
+
+# --- Phase 15: Counter Coalescing ---
+
+# 63. COALESCE (two increments summed, written when the mode is switched off)
+run_test "REDIS_COALESCE" \
+    "VALUES REDIS400.REDIS_COALESCE('ON')
+VALUES REDIS400.REDIS_INCRBY('t_coal', 2)
+VALUES REDIS400.REDIS_INCRBY('t_coal', 3)
+VALUES REDIS400.REDIS_COALESCE('OFF')
+VALUES 'GOT=' || REDIS400.REDIS_GET('t_coal')" \
+    "GOT=5"
+
+# 64. HINCRBY (new field starts at 0)
+run_test "REDIS_HINCRBY" \
+    "VALUES REDIS400.REDIS_HINCRBY('t_hinc', 'n', 4)" \
+    "4"
+
+# --- Phase 16: Transactions ---
+
+# 65. TRANSACTION (HSET, RPUSH and INCRBY in one MULTI/EXEC; third result is the counter)
+run_test "REDIS_TRANSACTION" \
+    "SELECT 'R' || POSITION || '=' || INTEGER_VALUE FROM TABLE(REDIS400.REDIS_TRANSACTION('HSET t_tx f v; RPUSH t_txl a; INCRBY t_txc 5')) T WHERE LEVEL = 1 AND POSITION = 3" \
+    "R3=5"
+
+# --- Phase 17: Lua Scripts ---
+
+# 66. SCRIPT_LOAD (returns the SHA1 of the script)
+run_test "REDIS_SCRIPT_LOAD" \
+    "VALUES REDIS400.REDIS_SCRIPT_LOAD('return redis.call(''GET'', KEYS[1])')" \
+    "d3c21d0c2b9ca22f82737626a27bcaf5d288f99f"
+
+# 67. EVAL (script run through EVALSHA; INCRBY result as an integer row)
+run_test "REDIS_EVAL" \
+    "SELECT 'V=' || INTEGER_VALUE FROM TABLE(REDIS400.REDIS_EVAL('return redis.call(''INCRBY'', KEYS[1], ARGV[1])', 't_eval', '7')) T" \
+    "V=7"
+
+# --- Phase 18: Filtered Scans ---
+
+echo "VALUES REDIS400.REDIS_HSET('t_sfl:1', 'amt', '5')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_HSET('t_sfl:2', 'amt', '50')" | $ISQL_CMD > /dev/null 2>&1
+
+# 68. SCAN_FILTER (amt >= 10 evaluated by Redis; only t_sfl:2 comes back)
+run_test "REDIS_SCAN_FILTER" \
+    "SELECT KEY || '=' || VALUE FROM TABLE(REDIS400.REDIS_SCAN_FILTER('t_sfl:*', 'amt', 'RANGE', '10')) T" \
+    "t_sfl:2=50"
+
+# --- Phase 19: Batch Dequeue ---
+
+echo "VALUES REDIS400.REDIS_RPUSH('t_popn', 'a')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_RPUSH('t_popn', 'b')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_RPUSH('t_popn', 'c')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_RPUSH('t_popn', 'd')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_RPUSH('t_popm', 'e')" | $ISQL_CMD > /dev/null 2>&1
+
+# 69. LPOP_N (two elements from the head in one round trip)
+run_test "REDIS_LPOP_N" \
+    "SELECT LISTAGG(VALUE, ',') WITHIN GROUP (ORDER BY POSITION) FROM TABLE(REDIS400.REDIS_LPOP_N('t_popn', 2)) T" \
+    "a,b"
+
+# 70. RPOP_N (the tail first: d, then c)
+run_test "REDIS_RPOP_N" \
+    "SELECT LISTAGG(VALUE, ',') WITHIN GROUP (ORDER BY POSITION) FROM TABLE(REDIS400.REDIS_RPOP_N('t_popn', 5)) T" \
+    "d,c"
+
+# 71. LMPOP (t_popn is empty now, so the element comes from t_popm)
+run_test "REDIS_LMPOP" \
+    "SELECT KEY || '=' || VALUE FROM TABLE(REDIS400.REDIS_LMPOP('t_popn t_popm', 10)) T" \
+    "t_popm=e"
+
+# --- Phase 20: Blocking Dequeue ---
+
+echo "VALUES REDIS400.REDIS_RPUSH('t_bq', 'j1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_RPUSH('t_bq', 'j2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_RPUSH('t_bq', 'j3')" | $ISQL_CMD > /dev/null 2>&1
+
+# 72. BLPOP (an element is waiting: returned at once)
+run_test "REDIS_BLPOP" \
+    "SELECT KEY || '=' || VALUE FROM TABLE(REDIS400.REDIS_BLPOP('t_none t_bq', 5)) T" \
+    "t_bq=j1"
+
+# 73. BRPOP (from the tail)
+run_test "REDIS_BRPOP" \
+    "SELECT VALUE FROM TABLE(REDIS400.REDIS_BRPOP('t_bq', 5)) T" \
+    "j3"
+
+# 74. BLMOVE (reliable queue: the element goes to a processing list)
+run_test "REDIS_BLMOVE" \
+    "VALUES REDIS400.REDIS_BLMOVE('t_bq', 't_bproc', 5)" \
+    "j2"
+
+# 75. BLPOP timeout (the queue is empty now: no rows after 0.2 s)
+run_test "REDIS_BLPOP (timeout)" \
+    "SELECT COUNT(*) FROM TABLE(REDIS400.REDIS_BLPOP('t_bq', 0.2)) T" \
+    "0"
+
+# --- Phase 21: Variadic Writes ---
+
+# 76. HSET_MANY (one HSET for the row; the NULL value leaves its field out)
+run_test "REDIS_HSET_MANY" \
+    "VALUES REDIS400.REDIS_HSET_MANY('t_hmany', 'id, name, city, zip', '42', 'Acme', NULL, '10001')" \
+    "3"
+
+# 77. HSET_MANY read back
+run_test "REDIS_HSET_MANY (read back)" \
+    "VALUES REDIS400.REDIS_HGET('t_hmany', 'zip')" \
+    "10001"
+
+# 78. SADD_MANY (the duplicate is not counted)
+run_test "REDIS_SADD_MANY" \
+    "VALUES REDIS400.REDIS_SADD_MANY('t_smany', 'a', 'b', 'a', 'c')" \
+    "3"
+
+# 79. ZADD_MANY (scores listed in member order)
+run_test "REDIS_ZADD_MANY" \
+    "VALUES REDIS400.REDIS_ZADD_MANY('t_zmany', '3,1,2', 'c', 'a', 'b')" \
+    "3"
+
+# 80. RPUSH_MANY then LPUSH_MANY (returns the list length)
+echo "VALUES REDIS400.REDIS_RPUSH_MANY('t_lmany', 'b', 'c')" | $ISQL_CMD > /dev/null 2>&1
+run_test "REDIS_LPUSH_MANY" \
+    "VALUES REDIS400.REDIS_LPUSH_MANY('t_lmany', 'a')" \
+    "3"
+
+# --- Phase 22: Row Caching ---
+
+# 81. CACHE_ROW (bytes stored: 2 header + 3 INTEGER + 4 DECIMAL + 4 DATE + 6 VARCHAR)
+run_test "REDIS_CACHE_ROW" \
+    "VALUES REDIS400.REDIS_CACHE_ROW('t_row', 600, 'ID INTEGER, BALANCE DECIMAL(9,2), OPENED DATE, NAME VARCHAR', '1001', '-12.5', '2025-02-22', 'Acme')" \
+    "19"
+
+# 82. FETCH_ROW decimal (padded to the scale of the layout)
+run_test "REDIS_FETCH_ROW (decimal)" \
+    "SELECT VALUE FROM TABLE(REDIS400.REDIS_FETCH_ROW('t_row')) T WHERE POSITION = 2" \
+    "-12.50"
+
+# 83. FETCH_ROW date, with the names from the layout
+run_test "REDIS_FETCH_ROW (date)" \
+    "SELECT DATE_VALUE FROM TABLE(REDIS400.REDIS_FETCH_ROW('t_row', 'ID INTEGER, BALANCE DECIMAL(9,2), OPENED DATE, NAME VARCHAR')) T WHERE NAME = 'OPENED'" \
+    "2025-02-22"
+
 # Cleanup
 echo "VALUES REDIS400.REDIS_DEL('t_scan1')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_scan2')" | $ISQL_CMD > /dev/null 2>&1
@@ -340,6 +591,32 @@ echo "VALUES REDIS400.REDIS_DEL('t_rnold')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_rnnew')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_hscn')" | $ISQL_CMD > /dev/null 2>&1
 echo "VALUES REDIS400.REDIS_DEL('t_sscn')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_cmd')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_cmdh')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ld1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ld2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ld3')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ldh1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_ldh2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_wb')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_wbctr')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_coal')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_hinc')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_tx')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_txl')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_txc')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_eval')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_sfl:1')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_sfl:2')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_popn')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_popm')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_bq')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_bproc')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_hmany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_smany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_zmany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_lmany')" | $ISQL_CMD > /dev/null 2>&1
+echo "VALUES REDIS400.REDIS_DEL('t_row')" | $ISQL_CMD > /dev/null 2>&1
 
 echo ""
 echo "========================================="